@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+/*
+ * A test of the sharded TFS local block cache.  It is linked with the
+ * objects of a tree configured with the TFS module and built, see
+ * contrib/README.
+ *
+ * The blocks are spread over all the shards; they are inserted, looked
+ * up one by one and in a batch, removed, and discarded when the zone
+ * is full.  It exits with 1 if any check fails.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http_tfs_local_block_cache.h>
+
+
+#define NGX_TEST_ZONE_SIZE  (4 * 1024 * 1024)
+#define NGX_TEST_BLOCKS     4096
+#define NGX_TEST_NS_ADDR    0x7f0000010000a8c0
+
+
+/* the objects linked do not log */
+static ngx_log_t       ngx_test_log;
+static ngx_cycle_t     ngx_test_cycle;
+
+static ngx_uint_t      ngx_test_failed;
+
+volatile ngx_cycle_t  *ngx_cycle;
+ngx_pid_t              ngx_pid;
+ngx_int_t              ngx_ncpu = 1;
+
+
+void
+ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+    const char *fmt, ...)
+{
+}
+
+
+void
+ngx_debug_point(void)
+{
+}
+
+
+/*
+ * as in ngx_http_tfs_block_cache.c, which is not linked
+ * for it needs the remote block cache
+ */
+
+ngx_int_t
+ngx_http_tfs_block_cache_cmp(ngx_http_tfs_block_cache_key_t *left,
+    ngx_http_tfs_block_cache_key_t *right)
+{
+    if (left->ns_addr == right->ns_addr) {
+
+        if (left->block_id == right->block_id) {
+            return 0;
+        }
+
+        return left->block_id < right->block_id ? -1 : 1;
+    }
+
+    return left->ns_addr < right->ns_addr ? -1 : 1;
+}
+
+
+static void
+ngx_test_ok(ngx_uint_t ok, char *name)
+{
+    printf("%s - %s\n", ok ? "ok" : "not ok", name);
+
+    if (!ok) {
+        ngx_test_failed++;
+    }
+}
+
+
+static ngx_uint_t
+ngx_test_shard(ngx_http_tfs_block_cache_key_t *key)
+{
+    uint32_t  hash;
+
+    hash = ngx_murmur_hash2((u_char *) key, NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+
+    return hash & (NGX_HTTP_TFS_BLOCK_CACHE_SHARDS - 1);
+}
+
+
+static ngx_int_t
+ngx_test_init(ngx_shm_zone_t *zone, ngx_http_tfs_local_block_cache_ctx_t *ctx)
+{
+    ngx_slab_pool_t  *sp;
+
+    ngx_memzero(zone, sizeof(ngx_shm_zone_t));
+    ngx_memzero(ctx, sizeof(ngx_http_tfs_local_block_cache_ctx_t));
+
+    ngx_str_set(&zone->shm.name, "tfs_block_cache_test");
+    zone->shm.size = NGX_TEST_ZONE_SIZE;
+    zone->shm.log = &ngx_test_log;
+    zone->data = ctx;
+
+    if (ngx_shm_alloc(&zone->shm) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    /* as ngx_init_zone_pool() does */
+
+    sp = (ngx_slab_pool_t *) zone->shm.addr;
+
+    sp->end = zone->shm.addr + zone->shm.size;
+    sp->min_shift = 3;
+    sp->addr = zone->shm.addr;
+
+    if (ngx_shmtx_create(&sp->mutex, &sp->lock, NULL) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_slab_init(sp);
+
+    return ngx_http_tfs_local_block_cache_init_zone(zone, NULL);
+}
+
+
+static ngx_int_t
+ngx_test_insert(ngx_http_tfs_local_block_cache_ctx_t *ctx, uint32_t block_id)
+{
+    uint64_t                          addrs[3];
+    ngx_http_tfs_block_cache_key_t    key;
+    ngx_http_tfs_block_cache_value_t  value;
+
+    key.ns_addr = NGX_TEST_NS_ADDR;
+    key.block_id = block_id;
+
+    addrs[0] = block_id;
+    addrs[1] = block_id + 1;
+    addrs[2] = block_id + 2;
+
+    value.ds_count = 3;
+    value.ds_addrs = addrs;
+
+    return ngx_http_tfs_local_block_cache_insert(ctx, &ngx_test_log, &key,
+                                                 &value);
+}
+
+
+/* NGX_OK if the block is found with its dataservers */
+
+static ngx_int_t
+ngx_test_lookup(ngx_http_tfs_local_block_cache_ctx_t *ctx, ngx_pool_t *pool,
+    uint32_t block_id)
+{
+    ngx_int_t                         rc;
+    ngx_http_tfs_block_cache_key_t    key;
+    ngx_http_tfs_block_cache_value_t  value;
+
+    key.ns_addr = NGX_TEST_NS_ADDR;
+    key.block_id = block_id;
+
+    rc = ngx_http_tfs_local_block_cache_lookup(ctx, pool, &ngx_test_log, &key,
+                                               &value);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    if (value.ds_count != 3
+        || value.ds_addrs[0] != block_id
+        || value.ds_addrs[2] != block_id + 2)
+    {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+int ngx_cdecl
+main(int argc, char *const *argv)
+{
+    uint32_t                               id;
+    ngx_int_t                              rc;
+    ngx_uint_t                             i, n, ok;
+    ngx_uint_t                             seen[NGX_HTTP_TFS_BLOCK_CACHE_SHARDS];
+    ngx_pool_t                            *pool;
+    ngx_array_t                           *keys, *kvs;
+    ngx_shm_zone_t                         zone;
+    ngx_http_tfs_block_cache_kv_t         *kv;
+    ngx_http_tfs_block_cache_key_t        *key, k;
+    ngx_http_tfs_local_block_cache_ctx_t   ctx;
+
+    ngx_test_cycle.log = &ngx_test_log;
+    ngx_cycle = &ngx_test_cycle;
+
+    ngx_pid = ngx_getpid();
+
+    ngx_pagesize = getpagesize();
+    for (n = ngx_pagesize; n >>= 1; ngx_pagesize_shift++) { /* void */ }
+
+    ngx_slab_sizes_init();
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, &ngx_test_log);
+    if (pool == NULL) {
+        return 1;
+    }
+
+    if (ngx_test_init(&zone, &ctx) != NGX_OK) {
+        printf("not ok - init zone\n");
+        return 1;
+    }
+
+    /* insert and lookup */
+
+    ngx_memzero(seen, sizeof(seen));
+
+    ok = 1;
+
+    for (id = 0; id < NGX_TEST_BLOCKS; id++) {
+        if (ngx_test_insert(&ctx, id) != NGX_OK) {
+            ok = 0;
+        }
+    }
+
+    ngx_test_ok(ok, "insert");
+
+    ok = 1;
+
+    for (id = 0; id < NGX_TEST_BLOCKS; id++) {
+        if (ngx_test_lookup(&ctx, pool, id) != NGX_OK) {
+            ok = 0;
+        }
+    }
+
+    ngx_test_ok(ok, "lookup");
+
+    ngx_test_ok(ngx_test_lookup(&ctx, pool, NGX_TEST_BLOCKS) == NGX_DECLINED,
+                "lookup of a block not cached");
+
+    /* a batch with the blocks of every shard */
+
+    keys = ngx_array_create(pool, NGX_TEST_BLOCKS,
+                            sizeof(ngx_http_tfs_block_cache_key_t));
+    kvs = ngx_array_create(pool, NGX_TEST_BLOCKS,
+                           sizeof(ngx_http_tfs_block_cache_kv_t));
+    if (keys == NULL || kvs == NULL) {
+        return 1;
+    }
+
+    for (id = 0; id < NGX_TEST_BLOCKS; id += 16) {
+        key = ngx_array_push(keys);
+        key->ns_addr = NGX_TEST_NS_ADDR;
+        key->block_id = id;
+
+        seen[ngx_test_shard(key)] = 1;
+    }
+
+    for (i = 0, n = 0; i < NGX_HTTP_TFS_BLOCK_CACHE_SHARDS; i++) {
+        n += seen[i];
+    }
+
+    ngx_test_ok(n == NGX_HTTP_TFS_BLOCK_CACHE_SHARDS, "batch of all shards");
+
+    rc = ngx_http_tfs_local_block_cache_batch_lookup(&ctx, pool, &ngx_test_log,
+                                                     keys, kvs);
+
+    ok = (rc == NGX_OK && kvs->nelts == keys->nelts);
+
+    kv = kvs->elts;
+
+    for (i = 0; i < kvs->nelts; i++) {
+        if (kv[i].value->ds_addrs[0] != kv[i].key->block_id) {
+            ok = 0;
+        }
+    }
+
+    ngx_test_ok(ok, "batch lookup");
+
+    /* two blocks are removed, the others are kept */
+
+    key = keys->elts;
+
+    for (i = 0; i < 2; i++) {
+        ngx_http_tfs_local_block_cache_remove(&ctx, &ngx_test_log, &key[i]);
+    }
+
+    ngx_test_ok(ngx_test_lookup(&ctx, pool, key[0].block_id) == NGX_DECLINED
+                && ngx_test_lookup(&ctx, pool, key[1].block_id)
+                   == NGX_DECLINED,
+                "remove");
+
+    ok = 1;
+
+    for (id = 0; id < NGX_TEST_BLOCKS; id++) {
+        if (id == key[0].block_id || id == key[1].block_id) {
+            continue;
+        }
+
+        if (ngx_test_lookup(&ctx, pool, id) != NGX_OK) {
+            ok = 0;
+        }
+    }
+
+    ngx_test_ok(ok, "remove keeps other blocks");
+
+    kvs->nelts = 0;
+
+    rc = ngx_http_tfs_local_block_cache_batch_lookup(&ctx, pool, &ngx_test_log,
+                                                     keys, kvs);
+
+    ngx_test_ok(rc == NGX_DECLINED && kvs->nelts == keys->nelts - 2,
+                "batch lookup of removed blocks");
+
+    /*
+     * the zone is filled up: the oldest blocks of every shard are
+     * discarded to make room, and the newest ones stay
+     */
+
+    ok = 1;
+
+    for (id = NGX_TEST_BLOCKS; id < NGX_TEST_ZONE_SIZE / 16; id++) {
+        if (ngx_test_insert(&ctx, id) != NGX_OK) {
+            ok = 0;
+            break;
+        }
+    }
+
+    ngx_test_ok(ok, "insert into a full zone");
+
+    ngx_memzero(seen, sizeof(seen));
+
+    for (id = 0; id < NGX_TEST_BLOCKS; id++) {
+        if (ngx_test_lookup(&ctx, pool, id) == NGX_DECLINED) {
+            k.ns_addr = NGX_TEST_NS_ADDR;
+            k.block_id = id;
+            seen[ngx_test_shard(&k)] = 1;
+        }
+    }
+
+    for (i = 0, n = 0; i < NGX_HTTP_TFS_BLOCK_CACHE_SHARDS; i++) {
+        n += seen[i];
+    }
+
+    ngx_test_ok(n == NGX_HTTP_TFS_BLOCK_CACHE_SHARDS,
+                "discard in all shards");
+
+    ok = 1;
+
+    for (id = NGX_TEST_ZONE_SIZE / 16 - 64; id < NGX_TEST_ZONE_SIZE / 16; id++)
+    {
+        if (ngx_test_lookup(&ctx, pool, id) != NGX_OK) {
+            ok = 0;
+        }
+    }
+
+    ngx_test_ok(ok, "newest blocks kept");
+
+    ngx_shm_free(&zone.shm);
+    ngx_destroy_pool(pool);
+
+    return ngx_test_failed ? 1 : 0;
+}
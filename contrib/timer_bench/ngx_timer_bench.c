@@ -0,0 +1,162 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+/*
+ * A micro-benchmark of the event timer backends: the rbtree and the
+ * timing wheel ("timer_wheel on").  It is linked with the objects of
+ * a configured and built tree, see contrib/README.
+ *
+ * For every number of timers it measures adding the timers with random
+ * timeouts, re-arming them as a keepalive connection does on every read
+ * and expiring all of them with 1ms ticks.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+#define NGX_BENCH_MAX_TIMEOUT  60000
+
+
+volatile ngx_msec_t  ngx_current_msec;
+
+static ngx_uint_t    ngx_bench_expired;
+
+/* the debug messages of the timer code are not logged */
+static ngx_log_t     ngx_bench_log;
+
+
+#if (NGX_DEBUG)
+
+void
+ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+    const char *fmt, ...)
+{
+}
+
+#endif
+
+
+static void
+ngx_bench_handler(ngx_event_t *ev)
+{
+    ngx_bench_expired++;
+}
+
+
+static double
+ngx_bench_now(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static void
+ngx_bench_run(ngx_uint_t wheel, ngx_uint_t n, ngx_event_t *events,
+    ngx_msec_t *timeouts)
+{
+    double       start, add, rearm, expire;
+    ngx_uint_t   i;
+    ngx_event_t  *ev;
+
+    ngx_memzero(events, n * sizeof(ngx_event_t));
+
+    ngx_current_msec = 1000000;
+    ngx_bench_expired = 0;
+
+    ngx_event_timer_wheel = wheel;
+    (void) ngx_event_timer_init(&ngx_bench_log);
+
+    for (i = 0; i < n; i++) {
+        ev = &events[i];
+        ev->handler = ngx_bench_handler;
+        ev->log = &ngx_bench_log;
+    }
+
+    start = ngx_bench_now();
+
+    for (i = 0; i < n; i++) {
+        ngx_event_add_timer(&events[i], timeouts[i]);
+    }
+
+    add = ngx_bench_now() - start;
+
+    /* the time moves on, so the lazy delay does not hide re-arming */
+
+    ngx_current_msec += NGX_TIMER_LAZY_DELAY;
+
+    start = ngx_bench_now();
+
+    for (i = 0; i < n; i++) {
+        ngx_event_add_timer(&events[i], timeouts[n - 1 - i]);
+    }
+
+    rearm = ngx_bench_now() - start;
+
+    start = ngx_bench_now();
+
+    while (ngx_event_find_timer() != NGX_TIMER_INFINITE) {
+        ngx_current_msec++;
+        ngx_event_expire_timers();
+    }
+
+    expire = ngx_bench_now() - start;
+
+    if (ngx_bench_expired != n) {
+        fprintf(stderr, "%s: %lu timers expired instead of %lu\n",
+                wheel ? "wheel" : "rbtree",
+                (unsigned long) ngx_bench_expired, (unsigned long) n);
+        exit(1);
+    }
+
+    printf("%-8s %8lu  add %7.1f ns  re-arm %7.1f ns  expire %7.1f ns"
+           "  total %8.1f ms\n",
+           wheel ? "wheel" : "rbtree", (unsigned long) n,
+           add / n, rearm / n, expire / n, (add + rearm + expire) / 1e6);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    ngx_uint_t    i, k, n;
+    ngx_msec_t   *timeouts;
+    ngx_event_t  *events;
+
+    static ngx_uint_t  sizes[] = { 10000, 100000, 1000000 };
+
+    srandom(1);
+
+    for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        n = sizes[k];
+
+        events = malloc(n * sizeof(ngx_event_t));
+        timeouts = malloc(n * sizeof(ngx_msec_t));
+
+        if (events == NULL || timeouts == NULL) {
+            fprintf(stderr, "malloc() failed\n");
+            return 1;
+        }
+
+        for (i = 0; i < n; i++) {
+            timeouts[i] = 1 + random() % NGX_BENCH_MAX_TIMEOUT;
+        }
+
+        ngx_bench_run(0, n, events, timeouts);
+        ngx_bench_run(1, n, events, timeouts);
+
+        free(events);
+        free(timeouts);
+    }
+
+    return 0;
+}
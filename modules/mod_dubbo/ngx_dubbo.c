@@ -43,192 +43,225 @@ int ngx_dubbo_is_big_endian() {
 }
 
 static const u_char DUBBO_VERSION_ENCODE[] = { 0x05, 0x32, 0x2e, 0x30, 0x2e, 0x32 };            //0x05"2.0.2"
-static const u_char DUBBO_SERVICE_VERSION_ENCODE[] = { 0x05, 0x30, 0x2e, 0x30, 0x2e, 0x30 };   //0x05"0.0.0"
 
 static const u_char DUBBO_NULL[] = { 0x4e };                                                    //"N" null
 static const u_char DUBBO_FLAG_REQ_HESSIAN2 = 0xc2;                                             // 0b11000010  req & hessian2
 static const u_char DUBBO_FLAG_REQ_PING_HESSIAN2 = 0xe2;                                        // 0b11000010  req & ping & hessian2
 
+static const ngx_str_t ngx_dubbo_str_body = ngx_string("body");
+
 static ngx_int_t ngx_dubbo_get_request_props(ngx_pool_t *pool, ngx_str_t *props);
+static ngx_int_t ngx_dubbo_encode_payload_map(ngx_dubbo_hessian2_writer_t *w, ngx_dubbo_arg_t *arg);
 
-ngx_int_t 
+ngx_int_t
 ngx_dubbo_encode_request(ngx_dubbo_connection_t *dubbo_c, ngx_str_t *service_name, ngx_str_t *service_version, ngx_str_t *method_name, ngx_array_t *args, ngx_multi_request_t *multi_r)
 {
-    size_t                   len, i, arg_len = 0;
-    ngx_str_t               *args_encode;
-    ngx_dubbo_arg_t         *arg;
-    uint32_t                 tmp32;
-    uint64_t                 tmp64;
-    ngx_buf_t               *b;
-    u_char                  *p;
+    size_t                        len, i, j, arg_len = 0;
+    off_t                         size;
+    ngx_dubbo_arg_t              *arg;
+    ngx_keyval_t                 *kv;
+    uint32_t                      tmp32;
+    uint64_t                      tmp64;
+    ngx_chain_t                  *cl;
+    ngx_connection_t             *c;
+    u_char                       *p, *header;
+    u_char                        fixed[sizeof(ngx_dubbo_header_t)];
 
-    ngx_str_t                service_name_encode;
-    ngx_str_t                service_version_encode;
-    ngx_str_t                method_name_encode;
-    ngx_str_t                arg_types;
-    ngx_str_t                arg_types_encode;
+    ngx_str_t                     arg_types;
+    ngx_str_t                     props;
 
-    ngx_str_t                props;
+    ngx_dubbo_hessian2_writer_t   w;
 
-    //calc buf len
+    c = (ngx_connection_t *) dubbo_c->data;
+
+    //calc buf len of everything but the bodies
     len = sizeof(ngx_dubbo_header_t);
 
     len += sizeof(DUBBO_VERSION_ENCODE);
-
-    //service_name
-    if (NGX_OK != ngx_dubbo_hessian2_encode_str(dubbo_c->temp_pool, service_name, &service_name_encode)) {
-        ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str failed %V", service_name);
-        return NGX_ERROR;
-    }
-
-    len += service_name_encode.len;
-
-    //service version
-    if (NGX_OK != ngx_dubbo_hessian2_encode_str(dubbo_c->temp_pool, service_version, &service_version_encode)) {
-        ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str failed %V", service_version);
-        return NGX_ERROR;
-    }
-
-    len += service_version_encode.len;
-
-    //method_name
-    if (NGX_OK != ngx_dubbo_hessian2_encode_str(dubbo_c->temp_pool, method_name, &method_name_encode)) {
-        ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str failed %V", method_name);
-        return NGX_ERROR;
-    }
-
-    len += method_name_encode.len;
+    len += ngx_dubbo_hessian2_str_size(service_name->len);
+    len += ngx_dubbo_hessian2_str_size(service_version->len);
+    len += ngx_dubbo_hessian2_str_size(method_name->len);
 
     arg = args->elts;
-    args_encode = ngx_pcalloc(dubbo_c->temp_pool, sizeof(ngx_str_t) * args->nelts);
     for (i=0; i<args->nelts; i++) {
         arg_len += ngx_dubbo_arg_type_map[arg[i].type].name.len;
 
         switch(arg[i].type) {
         case DUBBO_ARG_STR:
-            if (NGX_OK != ngx_dubbo_hessian2_encode_str(dubbo_c->temp_pool, &arg[i].value.str, &args_encode[i])) {
-                ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str failed");
-                return NGX_ERROR;
-            }
-            break;
-#if 0
-        case DUBBO_ARG_INT:
-            if (NGX_OK != ngx_dubbo_hessian2_encode_int(dubbo_c->temp_pool, arg[i].value.n, &args_encode[i])) {
-                ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str int failed");
-                return NGX_ERROR;
-            }
+            len += ngx_dubbo_hessian2_str_size(arg[i].value.str.len);
             break;
+        case DUBBO_ARG_MAP:
+            len += 2;
 
-        case DUBBO_ARG_LSTR:
-            if (NGX_OK != ngx_dubbo_hessian2encode_lstr(dubbo_c->temp_pool, arg[i].value.pstr, &args_encode[i])) {
-                ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str list failed");
-                return NGX_ERROR;
+            if (arg[i].body) {
+                len += ngx_dubbo_hessian2_str_size(ngx_dubbo_str_body.len);
+
+                size = 0;
+                for (cl = arg[i].body; cl; cl = cl->next) {
+                    size += ngx_buf_size(cl->buf);
+                }
+
+                len += ngx_dubbo_hessian2_binary_size((size_t) size);
             }
-            break;
-#endif
-        case DUBBO_ARG_MAP:
-            if (NGX_OK != ngx_dubbo_hessian2_encode_payload_map(dubbo_c->temp_pool, arg[i].value.m, &args_encode[i])) {
-                ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 map failed");
-                return NGX_ERROR;
+
+            kv = arg[i].value.m->elts;
+            for (j=0; j<arg[i].value.m->nelts; j++) {
+                len += ngx_dubbo_hessian2_str_size(kv[j].key.len);
+                len += ngx_dubbo_hessian2_str_size(kv[j].value.len);
             }
             break;
         default:
             ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: args param type unknown %d", arg[i].type);
             return NGX_ERROR;
         }
+    }
+
+    len += ngx_dubbo_hessian2_str_size(arg_len);
 
-        len += args_encode[i].len;
+    if (NGX_OK != ngx_dubbo_get_request_props(dubbo_c->temp_pool, &props)) {
+        ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "encode props failed");
+        return NGX_ERROR;
     }
 
-    arg_types.data = ngx_pcalloc(dubbo_c->temp_pool, arg_len);
+    len += props.len;
+
+    arg_types.data = ngx_pnalloc(dubbo_c->temp_pool, arg_len);
     if (arg_types.data == NULL) {
         return NGX_ERROR;
     }
     p = arg_types.data;
     arg_types.len = arg_len;
     for (i=0; i<args->nelts; i++) {
-        ngx_memcpy(p, ngx_dubbo_arg_type_map[arg[i].type].name.data, ngx_dubbo_arg_type_map[arg[i].type].name.len);
-        p += ngx_dubbo_arg_type_map[arg[i].type].name.len;
+        p = ngx_cpymem(p, ngx_dubbo_arg_type_map[arg[i].type].name.data, ngx_dubbo_arg_type_map[arg[i].type].name.len);
     }
 
-    if (NGX_OK != ngx_dubbo_hessian2_encode_str(dubbo_c->temp_pool, &arg_types, &arg_types_encode)) {
-        ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str failed");
-        return NGX_ERROR;
-    }
+    /*
+     * the request is written to a chain: the fixed part goes to a buffer
+     * of the calculated size, the bodies are linked without copying
+     */
 
-    len += arg_types_encode.len;
+    ngx_dubbo_hessian2_writer_init(&w, multi_r->pool, len);
 
-    if (NGX_OK != ngx_dubbo_get_request_props(dubbo_c->temp_pool, &props)) {
-        ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "encode props failed");
+    w.sendfile = c->sendfile;
+
+    //fixed header, payload len is set when the payload is written
+    fixed[0] = MAGIC_VALUE_0;              //magic
+    fixed[1] = MAGIC_VALUE_1;              //version
+    fixed[2] = DUBBO_FLAG_REQ_HESSIAN2;    //req & hessian2
+    fixed[3] = 0;
+
+    //request id
+    dubbo_c->last_request_id++;
+    tmp64 = ngx_dubbo_hton64(dubbo_c->last_request_id);
+    multi_r->id = dubbo_c->last_request_id;
+    memcpy(fixed + 4, &tmp64, 8);
+
+    if (ngx_dubbo_hessian2_write_raw(&w, fixed, sizeof(ngx_dubbo_header_t)) != NGX_OK) {
         return NGX_ERROR;
     }
 
-    len += props.len;
+    header = w.out->buf->pos;
 
-    multi_r->out = ngx_alloc_chain_link(multi_r->pool);
-    if (multi_r->out == NULL) {
+    //dubbo version
+    if (ngx_dubbo_hessian2_write_raw(&w, (u_char *) DUBBO_VERSION_ENCODE, sizeof(DUBBO_VERSION_ENCODE)) != NGX_OK
+        || ngx_dubbo_hessian2_write_str(&w, service_name) != NGX_OK
+        || ngx_dubbo_hessian2_write_str(&w, service_version) != NGX_OK
+        || ngx_dubbo_hessian2_write_str(&w, method_name) != NGX_OK
+        || ngx_dubbo_hessian2_write_str(&w, &arg_types) != NGX_OK)
+    {
+        ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str failed");
         return NGX_ERROR;
     }
-    
-    multi_r->out->buf = ngx_create_temp_buf(multi_r->pool, len);
-    multi_r->out->next = NULL;
-    b = multi_r->out->buf;
-    if (b == NULL) {
+
+    for (i=0; i<args->nelts; i++) {
+        switch(arg[i].type) {
+        case DUBBO_ARG_STR:
+            if (NGX_OK != ngx_dubbo_hessian2_write_str(&w, &arg[i].value.str)) {
+                ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 str failed");
+                return NGX_ERROR;
+            }
+            break;
+        case DUBBO_ARG_MAP:
+            if (NGX_OK != ngx_dubbo_encode_payload_map(&w, &arg[i])) {
+                ngx_log_error(NGX_LOG_ERR, dubbo_c->log, 0, "dubbo: encode hessian2 map failed");
+                return NGX_ERROR;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    //props
+    if (ngx_dubbo_hessian2_write_raw(&w, props.data, props.len) != NGX_OK) {
         return NGX_ERROR;
     }
 
-    //fixed header
-    b->pos = b->start;
+    //payload len
+    size = ngx_dubbo_hessian2_writer_size(&w);
+    tmp32 = htonl((uint32_t) (size - sizeof(ngx_dubbo_header_t)));
+    memcpy(header + 12, &tmp32, 4);
 
-    b->pos[0] = MAGIC_VALUE_0;              //magic
-    b->pos[1] = MAGIC_VALUE_1;              //version
-    b->pos[2] = DUBBO_FLAG_REQ_HESSIAN2;    //req & hessian2
-    b->pos[3] = 0;
-    b->last += 4;
+    multi_r->out = w.out;
 
-    //request id
-    dubbo_c->last_request_id++;
-    tmp64 = ngx_dubbo_hton64(dubbo_c->last_request_id);
-    multi_r->id = dubbo_c->last_request_id;
-    memcpy(b->last, &tmp64, 8);
-    b->last += 8;
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, dubbo_c->log, 0,
+                   "dubbo: request %ui encoded, size %O", multi_r->id, size);
 
-    //payload len
-    tmp32 = htonl(len - sizeof(ngx_dubbo_header_t));
-    memcpy(b->last, &tmp32, 4);
-    b->last += 4;
+    ngx_reset_pool(dubbo_c->temp_pool);
+    return NGX_OK;
+}
 
-    //dubbo version
-    memcpy(b->last, DUBBO_VERSION_ENCODE, sizeof(DUBBO_VERSION_ENCODE));
-    b->last += sizeof(DUBBO_VERSION_ENCODE);
+static ngx_int_t
+ngx_dubbo_encode_payload_map(ngx_dubbo_hessian2_writer_t *w, ngx_dubbo_arg_t *arg)
+{
+    size_t           i;
+    ngx_buf_t        b;
+    ngx_chain_t      body;
+    ngx_keyval_t    *kv;
 
-    //service name
-    memcpy(b->last, service_name_encode.data, service_name_encode.len);
-    b->last += service_name_encode.len;
+    if (ngx_dubbo_hessian2_write_map_start(w) != NGX_OK) {
+        return NGX_ERROR;
+    }
 
-    //service version
-    memcpy(b->last, DUBBO_SERVICE_VERSION_ENCODE, sizeof(DUBBO_VERSION_ENCODE));
-    b->last += sizeof(DUBBO_SERVICE_VERSION_ENCODE);
+    if (arg->body) {
+        if (ngx_dubbo_hessian2_write_str(w, (ngx_str_t *) &ngx_dubbo_str_body) != NGX_OK
+            || ngx_dubbo_hessian2_write_binary(w, arg->body) != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
 
-    //method name
-    memcpy(b->last, method_name_encode.data, method_name_encode.len);
-    b->last += method_name_encode.len;
+    kv = arg->value.m->elts;
+    for (i=0; i<arg->value.m->nelts; i++) {
+        if (ngx_dubbo_hessian2_write_str(w, &kv[i].key) != NGX_OK) {
+            return NGX_ERROR;
+        }
 
-    //arg types
-    memcpy(b->last, arg_types_encode.data, arg_types_encode.len);
-    b->last += arg_types_encode.len;
+        if (kv[i].key.len == ngx_dubbo_str_body.len
+            && ngx_strncmp(kv[i].key.data, ngx_dubbo_str_body.data, ngx_dubbo_str_body.len) == 0)
+        {
+            //"body" is always binary
+            ngx_memzero(&b, sizeof(ngx_buf_t));
+            b.memory = 1;
+            b.pos = kv[i].value.data;
+            b.last = kv[i].value.data + kv[i].value.len;
 
-    for (i=0; i<args->nelts; i++) {
-        memcpy(b->last, args_encode[i].data, args_encode[i].len);
-        b->last += args_encode[i].len;
-    }
+            body.buf = &b;
+            body.next = NULL;
 
-    //props
-    memcpy(b->last, props.data, props.len);
-    b->last += props.len;
+            if (ngx_dubbo_hessian2_write_binary(w, &body) != NGX_OK) {
+                return NGX_ERROR;
+            }
 
-    ngx_reset_pool(dubbo_c->temp_pool);
-    return NGX_OK;
+            continue;
+        }
+
+        if (ngx_dubbo_hessian2_write_str(w, &kv[i].value) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return ngx_dubbo_hessian2_write_map_end(w);
 }
 
 static ngx_int_t
@@ -357,16 +390,27 @@ ngx_dubbo_decode_response(ngx_dubbo_connection_t *dubbo_c, ngx_chain_t *in)
 
                 break;
             case DUBBO_PARSE_READ_PAYLOAD:
-                if (resp->header.payloadlen > resp->payload_alloc || resp->payload == NULL) {
-                    if (resp->payload != NULL) {
-                        ngx_free(resp->payload);
+                if (dubbo_c->remain == 0) {
+                    /*
+                     * the payload is read once to a pool of its own,
+                     * the decoded response points to it and the pool
+                     * is passed to the request it belongs to
+                     */
+
+                    if (resp->pool == NULL) {
+                        resp->pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, dubbo_c->log);
+                        if (resp->pool == NULL) {
+                            return NGX_ERROR;
+                        }
+
+                    } else {
+                        ngx_reset_pool(resp->pool);
                     }
 
-                    resp->payload = ngx_alloc(resp->header.payloadlen, dubbo_c->log);
+                    resp->payload = ngx_pnalloc(resp->pool, resp->header.payloadlen);
                     if (resp->payload == NULL) {
                         return NGX_ERROR;
                     }
-                    resp->payload_alloc = resp->header.payloadlen;
                 }
 
                 dst = ((u_char*)resp->payload) + dubbo_c->remain;
@@ -419,10 +463,10 @@ ngx_dubbo_cleanup(void *data)
 {
     ngx_dubbo_connection_t      *dubbo_c = data;
 
-    if (dubbo_c->resp.payload != NULL) {
-        ngx_free(dubbo_c->resp.payload);
+    if (dubbo_c->resp.pool != NULL) {
+        ngx_destroy_pool(dubbo_c->resp.pool);
+        dubbo_c->resp.pool = NULL;
         dubbo_c->resp.payload = NULL;
-        dubbo_c->resp.payload_alloc = 0;
     }
 
     ngx_destroy_pool(dubbo_c->temp_pool);
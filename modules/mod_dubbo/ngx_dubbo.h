@@ -56,8 +56,8 @@ typedef struct {
 typedef struct {
     ngx_dubbo_header_t header;
 
-    u_char*  payload;
-    size_t   payload_alloc; 
+    u_char*      payload;
+    ngx_pool_t  *pool;          /* payload, passed to the request */
 } ngx_dubbo_resp_t;
 
 #if (NGX_HAVE_PACK_PRAGMA)
@@ -116,20 +116,49 @@ typedef struct {
         ngx_array_t *pstr;
         ngx_array_t *m;
     } value;
+
+    ngx_chain_t     *body;     /* "body" of DUBBO_ARG_MAP, sent as binary */
 } ngx_dubbo_arg_t;
 
+typedef struct {
+    ngx_pool_t      *pool;
+    ngx_chain_t     *out;
+    ngx_chain_t    **last_out;
+
+    ngx_buf_t       *buf;       /* temporary buffer being written */
+    u_char          *pos;       /* memory left after a linked binary */
+    u_char          *end;
+    size_t           size;
+
+    ngx_flag_t       sendfile;
+} ngx_dubbo_hessian2_writer_t;
+
+typedef struct {
+    u_char          *pos;
+    u_char          *last;
+    ngx_log_t       *log;
+} ngx_dubbo_hessian2_reader_t;
+
 ngx_int_t ngx_dubbo_encode_request(ngx_dubbo_connection_t *dubbo_c, ngx_str_t *service_name, ngx_str_t *service_version, ngx_str_t *method_name, ngx_array_t *args, ngx_multi_request_t *multi_r);
 ngx_int_t ngx_dubbo_encode_ping_request(ngx_dubbo_connection_t *dubbo_c, ngx_multi_request_t *multi_r);
 ngx_int_t ngx_dubbo_decode_response(ngx_dubbo_connection_t *dubbo_c, ngx_chain_t *in);
 
-ngx_int_t ngx_dubbo_hessian2_encode_str(ngx_pool_t *pool, ngx_str_t *in, ngx_str_t *out);
-ngx_int_t ngx_dubbo_hessian2_encode_int(ngx_pool_t *pool, int n, ngx_str_t *out);
-ngx_int_t ngx_dubbo_hessian2_encode_lstr(ngx_pool_t *pool, ngx_array_t *lstr, ngx_str_t *out);
-ngx_int_t ngx_dubbo_hessian2_encode_map(ngx_pool_t *pool, ngx_array_t *in, ngx_str_t *out);
-
-ngx_int_t ngx_dubbo_hessian2_decode_str(ngx_pool_t *pool, ngx_str_t *in, ngx_str_t *result, ngx_log_t *log);
+void ngx_dubbo_hessian2_writer_init(ngx_dubbo_hessian2_writer_t *w, ngx_pool_t *pool, size_t size);
+size_t ngx_dubbo_hessian2_str_size(size_t len);
+size_t ngx_dubbo_hessian2_binary_size(size_t len);
+ngx_int_t ngx_dubbo_hessian2_write_raw(ngx_dubbo_hessian2_writer_t *w, u_char *data, size_t len);
+ngx_int_t ngx_dubbo_hessian2_write_null(ngx_dubbo_hessian2_writer_t *w);
+ngx_int_t ngx_dubbo_hessian2_write_str(ngx_dubbo_hessian2_writer_t *w, ngx_str_t *s);
+ngx_int_t ngx_dubbo_hessian2_write_binary(ngx_dubbo_hessian2_writer_t *w, ngx_chain_t *in);
+ngx_int_t ngx_dubbo_hessian2_write_map_start(ngx_dubbo_hessian2_writer_t *w);
+ngx_int_t ngx_dubbo_hessian2_write_map_end(ngx_dubbo_hessian2_writer_t *w);
+off_t ngx_dubbo_hessian2_writer_size(ngx_dubbo_hessian2_writer_t *w);
+
+void ngx_dubbo_hessian2_reader_init(ngx_dubbo_hessian2_reader_t *rd, u_char *data, size_t len, ngx_log_t *log);
+ngx_int_t ngx_dubbo_hessian2_read_int(ngx_dubbo_hessian2_reader_t *rd, int32_t *n);
+ngx_int_t ngx_dubbo_hessian2_read_map_start(ngx_dubbo_hessian2_reader_t *rd);
+ngx_int_t ngx_dubbo_hessian2_read_map_next(ngx_dubbo_hessian2_reader_t *rd, ngx_pool_t *pool, ngx_keyval_t *kv);
 ngx_int_t ngx_dubbo_hessian2_decode_payload_map(ngx_pool_t *pool, ngx_str_t *in, ngx_array_t **result, ngx_log_t *log);
-ngx_int_t ngx_dubbo_hessian2_encode_payload_map(ngx_pool_t *pool, ngx_array_t *in, ngx_str_t *out);
 
 ngx_dubbo_connection_t* ngx_dubbo_create_connection(ngx_connection_t *c, ngx_event_handler_pt ping_handler);
 ngx_int_t ngx_dubbo_init_connection(ngx_dubbo_connection_t *dubbo_c, ngx_connection_t *c, ngx_event_handler_pt ping_handler);
@@ -0,0 +1,876 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+#include <ngx_dubbo.h>
+
+
+/*
+ * Streaming Hessian2 codec.
+ *
+ * The writer appends the encoding to a chain allocated from a pool:
+ * small values go to temporary buffers, binary values are linked as
+ * buffers referencing the caller's data.  The reader walks a payload
+ * in place, decoded strings and binaries point into the payload.
+ */
+
+
+#define NGX_DUBBO_HESSIAN2_CHUNK     0x8000
+
+
+static u_char *ngx_dubbo_hessian2_reserve(ngx_dubbo_hessian2_writer_t *w,
+    size_t size);
+static ngx_int_t ngx_dubbo_hessian2_link(ngx_dubbo_hessian2_writer_t *w,
+    ngx_buf_t *b, off_t offset, size_t size);
+
+static ngx_int_t ngx_dubbo_hessian2_read_long(ngx_dubbo_hessian2_reader_t *rd,
+    int64_t *n);
+static ngx_int_t ngx_dubbo_hessian2_read_chunks(
+    ngx_dubbo_hessian2_reader_t *rd, ngx_str_t *s);
+static ngx_int_t ngx_dubbo_hessian2_read_value(ngx_dubbo_hessian2_reader_t *rd,
+    ngx_pool_t *pool, ngx_str_t *v);
+
+
+void
+ngx_dubbo_hessian2_writer_init(ngx_dubbo_hessian2_writer_t *w,
+    ngx_pool_t *pool, size_t size)
+{
+    ngx_memzero(w, sizeof(ngx_dubbo_hessian2_writer_t));
+
+    w->pool = pool;
+    w->last_out = &w->out;
+    w->size = size;
+}
+
+
+size_t
+ngx_dubbo_hessian2_str_size(size_t len)
+{
+    /*
+     * each chunk of at most 32k characters has a 3 bytes header,
+     * a chunk is one character shorter if a surrogate pair does not fit
+     */
+
+    return len + 3 * (len / (NGX_DUBBO_HESSIAN2_CHUNK - 1) + 1);
+}
+
+
+size_t
+ngx_dubbo_hessian2_binary_size(size_t len)
+{
+    return 3 * (len / NGX_DUBBO_HESSIAN2_CHUNK + 1);
+}
+
+
+ngx_int_t
+ngx_dubbo_hessian2_write_raw(ngx_dubbo_hessian2_writer_t *w, u_char *data,
+    size_t len)
+{
+    u_char  *p;
+
+    p = ngx_dubbo_hessian2_reserve(w, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    w->buf->last = ngx_cpymem(p, data, len);
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_dubbo_hessian2_write_null(ngx_dubbo_hessian2_writer_t *w)
+{
+    return ngx_dubbo_hessian2_write_raw(w, (u_char *) "N", 1);
+}
+
+
+ngx_int_t
+ngx_dubbo_hessian2_write_map_start(ngx_dubbo_hessian2_writer_t *w)
+{
+    return ngx_dubbo_hessian2_write_raw(w, (u_char *) "H", 1);
+}
+
+
+ngx_int_t
+ngx_dubbo_hessian2_write_map_end(ngx_dubbo_hessian2_writer_t *w)
+{
+    return ngx_dubbo_hessian2_write_raw(w, (u_char *) "Z", 1);
+}
+
+
+/*
+ * string ::= x52 b1 b0 <utf8-data> string   # non-final chunk
+ *        ::= 'S' b1 b0 <utf8-data>          # string of length 0-65535
+ *        ::= [x00-x1f] <utf8-data>          # string of length 0-31
+ *        ::= [x30-x33] b0 <utf8-data>       # string of length 0-1023
+ *
+ * the length is in UTF-16 characters, a 4 bytes UTF-8 sequence is
+ * a surrogate pair of 2 characters; the data is copied since it is small
+ * compared to the body and the characters are counted anyway
+ */
+
+ngx_int_t
+ngx_dubbo_hessian2_write_str(ngx_dubbo_hessian2_writer_t *w, ngx_str_t *s)
+{
+    u_char      *p, *q, *start, *end;
+    size_t       len, n;
+    ngx_uint_t   chars;
+
+    if (s->len == 0 || s->data == NULL) {
+        return ngx_dubbo_hessian2_write_null(w);
+    }
+
+    p = ngx_dubbo_hessian2_reserve(w, ngx_dubbo_hessian2_str_size(s->len));
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    start = s->data;
+    end = s->data + s->len;
+
+    len = 0;
+
+    for (q = start; q < end; q += n, len += chars) {
+
+        chars = 1;
+
+        if (*q < 0x80) {
+            n = 1;
+
+        } else if ((*q & 0xe0) == 0xc0) {
+            n = 2;
+
+        } else if ((*q & 0xf0) == 0xe0) {
+            n = 3;
+
+        } else {
+            n = 4;
+            chars = 2;
+        }
+
+        /* a surrogate pair is not split between chunks */
+
+        if (len + chars > NGX_DUBBO_HESSIAN2_CHUNK) {
+            *p++ = 'R';
+            *p++ = (u_char) (len >> 8);
+            *p++ = (u_char) len;
+            p = ngx_cpymem(p, start, q - start);
+
+            start = q;
+            len = 0;
+        }
+    }
+
+    q = ngx_min(q, end);
+
+    if (len <= 31) {
+        *p++ = (u_char) len;
+
+    } else if (len <= 1023) {
+        *p++ = (u_char) (0x30 + (len >> 8));
+        *p++ = (u_char) len;
+
+    } else {
+        *p++ = 'S';
+        *p++ = (u_char) (len >> 8);
+        *p++ = (u_char) len;
+    }
+
+    w->buf->last = ngx_cpymem(p, start, q - start);
+
+    return NGX_OK;
+}
+
+
+/*
+ * binary ::= x41 b1 b0 <binary-data> binary  # non-final chunk
+ *        ::= 'B' b1 b0 <binary-data>         # final chunk
+ *        ::= [x20-x2f] <binary-data>         # binary of length 0-15
+ *        ::= [x34-x37] b0 <binary-data>      # binary of length 0-1023
+ *
+ * only the chunk headers are written, the data is linked as buffers
+ * pointing to the memory or the file of the input chain
+ */
+
+ngx_int_t
+ngx_dubbo_hessian2_write_binary(ngx_dubbo_hessian2_writer_t *w,
+    ngx_chain_t *in)
+{
+    off_t         offset, n, k;
+    size_t        rest, chunk;
+    u_char       *p;
+    ngx_buf_t    *b;
+    ngx_chain_t  *cl;
+
+    rest = 0;
+
+    for (cl = in; cl; cl = cl->next) {
+        rest += ngx_buf_size(cl->buf);
+    }
+
+    if (rest == 0) {
+        return ngx_dubbo_hessian2_write_null(w);
+    }
+
+    chunk = 0;
+
+    for (cl = in; cl; cl = cl->next) {
+        b = cl->buf;
+
+        n = ngx_buf_size(b);
+        offset = 0;
+
+        while (n) {
+
+            if (chunk == 0) {
+                p = ngx_dubbo_hessian2_reserve(w, 3);
+                if (p == NULL) {
+                    return NGX_ERROR;
+                }
+
+                if (rest > NGX_DUBBO_HESSIAN2_CHUNK) {
+                    chunk = NGX_DUBBO_HESSIAN2_CHUNK;
+
+                    *p++ = 'A';
+                    *p++ = (u_char) (chunk >> 8);
+                    *p++ = (u_char) chunk;
+
+                } else if (rest <= 15) {
+                    chunk = rest;
+
+                    *p++ = (u_char) (0x20 + chunk);
+
+                } else if (rest <= 1023) {
+                    chunk = rest;
+
+                    *p++ = (u_char) (0x34 + (chunk >> 8));
+                    *p++ = (u_char) chunk;
+
+                } else {
+                    chunk = rest;
+
+                    *p++ = 'B';
+                    *p++ = (u_char) (chunk >> 8);
+                    *p++ = (u_char) chunk;
+                }
+
+                w->buf->last = p;
+            }
+
+            k = ngx_min(n, (off_t) chunk);
+
+            if (ngx_dubbo_hessian2_link(w, b, offset, (size_t) k) != NGX_OK) {
+                return NGX_ERROR;
+            }
+
+            offset += k;
+            n -= k;
+            chunk -= (size_t) k;
+            rest -= (size_t) k;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+off_t
+ngx_dubbo_hessian2_writer_size(ngx_dubbo_hessian2_writer_t *w)
+{
+    off_t         size;
+    ngx_chain_t  *cl;
+
+    size = 0;
+
+    for (cl = w->out; cl; cl = cl->next) {
+        size += ngx_buf_size(cl->buf);
+    }
+
+    return size;
+}
+
+
+static u_char *
+ngx_dubbo_hessian2_reserve(ngx_dubbo_hessian2_writer_t *w, size_t size)
+{
+    u_char       *start, *end;
+    ngx_buf_t    *b;
+    ngx_chain_t  *cl;
+
+    if (w->buf) {
+        if ((size_t) (w->buf->end - w->buf->last) >= size) {
+            return w->buf->last;
+        }
+
+        /* the rest of the buffer is too small, leave it */
+
+        w->buf->end = w->buf->last;
+        w->buf = NULL;
+    }
+
+    if ((size_t) (w->end - w->pos) >= size) {
+
+        /* memory left after the last linked binary */
+
+        start = w->pos;
+        end = w->end;
+
+    } else {
+        start = ngx_pnalloc(w->pool, ngx_max(size, w->size));
+        if (start == NULL) {
+            return NULL;
+        }
+
+        end = start + ngx_max(size, w->size);
+    }
+
+    b = ngx_calloc_buf(w->pool);
+    if (b == NULL) {
+        return NULL;
+    }
+
+    b->temporary = 1;
+    b->start = start;
+    b->pos = start;
+    b->last = start;
+    b->end = end;
+
+    cl = ngx_alloc_chain_link(w->pool);
+    if (cl == NULL) {
+        return NULL;
+    }
+
+    cl->buf = b;
+    cl->next = NULL;
+
+    *w->last_out = cl;
+    w->last_out = &cl->next;
+
+    w->buf = b;
+    w->pos = NULL;
+    w->end = NULL;
+
+    return b->last;
+}
+
+
+static ngx_int_t
+ngx_dubbo_hessian2_link(ngx_dubbo_hessian2_writer_t *w, ngx_buf_t *b,
+    off_t offset, size_t size)
+{
+    u_char       *p;
+    ssize_t       n;
+    ngx_buf_t    *buf;
+    ngx_chain_t  *cl;
+
+    buf = ngx_calloc_buf(w->pool);
+    if (buf == NULL) {
+        return NGX_ERROR;
+    }
+
+    buf->tag = (ngx_buf_tag_t) &ngx_dubbo_hessian2_write_binary;
+
+    if (ngx_buf_in_memory(b)) {
+        buf->memory = 1;
+        buf->pos = b->pos + offset;
+        buf->last = buf->pos + size;
+
+    } else if (w->sendfile) {
+        buf->in_file = 1;
+        buf->file = b->file;
+        buf->file_pos = b->file_pos + offset;
+        buf->file_last = buf->file_pos + size;
+
+    } else {
+        p = ngx_pnalloc(w->pool, size);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        n = ngx_read_file(b->file, p, size, b->file_pos + offset);
+
+        if (n == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        if ((size_t) n != size) {
+            ngx_log_error(NGX_LOG_ALERT, w->pool->log, 0,
+                          "dubbo: read only %z of %uz from \"%V\"",
+                          n, size, &b->file->name);
+            return NGX_ERROR;
+        }
+
+        buf->temporary = 1;
+        buf->pos = p;
+        buf->last = p + size;
+    }
+
+    cl = ngx_alloc_chain_link(w->pool);
+    if (cl == NULL) {
+        return NGX_ERROR;
+    }
+
+    cl->buf = buf;
+    cl->next = NULL;
+
+    *w->last_out = cl;
+    w->last_out = &cl->next;
+
+    /* small values following the binary reuse the rest of the buffer */
+
+    if (w->buf) {
+        w->pos = w->buf->last;
+        w->end = w->buf->end;
+
+        w->buf->end = w->buf->last;
+        w->buf = NULL;
+    }
+
+    return NGX_OK;
+}
+
+
+void
+ngx_dubbo_hessian2_reader_init(ngx_dubbo_hessian2_reader_t *rd, u_char *data,
+    size_t len, ngx_log_t *log)
+{
+    rd->pos = data;
+    rd->last = data + len;
+    rd->log = log;
+}
+
+
+/*
+ * int ::= 'I' b3 b2 b1 b0
+ *     ::= [x80-xbf]
+ *     ::= [xc0-xcf] b0
+ *     ::= [xd0-xd7] b1 b0
+ */
+
+ngx_int_t
+ngx_dubbo_hessian2_read_int(ngx_dubbo_hessian2_reader_t *rd, int32_t *n)
+{
+    u_char  *p, tag;
+
+    p = rd->pos;
+
+    if (p == rd->last) {
+        return NGX_ERROR;
+    }
+
+    tag = *p++;
+
+    if (tag >= 0x80 && tag <= 0xbf) {
+        *n = (int32_t) tag - 0x90;
+
+    } else if (tag >= 0xc0 && tag <= 0xcf) {
+        if (rd->last - p < 1) {
+            return NGX_ERROR;
+        }
+
+        *n = ((int32_t) tag - 0xc8) * 0x100 + p[0];
+        p += 1;
+
+    } else if (tag >= 0xd0 && tag <= 0xd7) {
+        if (rd->last - p < 2) {
+            return NGX_ERROR;
+        }
+
+        *n = ((int32_t) tag - 0xd4) * 0x10000 + (p[0] << 8) + p[1];
+        p += 2;
+
+    } else if (tag == 'I') {
+        if (rd->last - p < 4) {
+            return NGX_ERROR;
+        }
+
+        *n = (int32_t) (((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8)
+                        | p[3]);
+        p += 4;
+
+    } else {
+        return NGX_DECLINED;
+    }
+
+    rd->pos = p;
+
+    return NGX_OK;
+}
+
+
+/*
+ * long ::= 'L' b7 b6 b5 b4 b3 b2 b1 b0
+ *      ::= [xd8-xef]
+ *      ::= [xf0-xff] b0
+ *      ::= [x38-x3f] b1 b0
+ *      ::= x59 b3 b2 b1 b0
+ */
+
+static ngx_int_t
+ngx_dubbo_hessian2_read_long(ngx_dubbo_hessian2_reader_t *rd, int64_t *n)
+{
+    u_char    *p, tag;
+    uint64_t   v;
+    ngx_int_t  i;
+
+    p = rd->pos;
+
+    if (p == rd->last) {
+        return NGX_ERROR;
+    }
+
+    tag = *p++;
+
+    if (tag >= 0xd8 && tag <= 0xef) {
+        *n = (int64_t) tag - 0xe0;
+
+    } else if (tag >= 0xf0) {
+        if (rd->last - p < 1) {
+            return NGX_ERROR;
+        }
+
+        *n = ((int64_t) tag - 0xf8) * 0x100 + p[0];
+        p += 1;
+
+    } else if (tag >= 0x38 && tag <= 0x3f) {
+        if (rd->last - p < 2) {
+            return NGX_ERROR;
+        }
+
+        *n = ((int64_t) tag - 0x3c) * 0x10000 + (p[0] << 8) + p[1];
+        p += 2;
+
+    } else if (tag == 'Y' || tag == 'L') {
+        i = (tag == 'Y') ? 4 : 8;
+
+        if (rd->last - p < i) {
+            return NGX_ERROR;
+        }
+
+        v = (p[0] & 0x80) ? (uint64_t) -1 : 0;
+
+        while (i--) {
+            v = (v << 8) | *p++;
+        }
+
+        *n = (int64_t) v;
+
+    } else {
+        return NGX_DECLINED;
+    }
+
+    rd->pos = p;
+
+    return NGX_OK;
+}
+
+
+/*
+ * reads a string or a binary, a value split into chunks is joined
+ * in place by moving the chunks over the headers in front of them
+ */
+
+static ngx_int_t
+ngx_dubbo_hessian2_read_chunks(ngx_dubbo_hessian2_reader_t *rd, ngx_str_t *s)
+{
+    u_char      *p, *q, tag;
+    size_t       len;
+    ngx_flag_t   string, final;
+
+    s->len = 0;
+    s->data = NULL;
+
+    p = rd->pos;
+
+    for ( ;; ) {
+
+        if (p == rd->last) {
+            return NGX_ERROR;
+        }
+
+        tag = *p++;
+
+        final = 1;
+
+        if (tag <= 0x1f) {
+            string = 1;
+            len = tag;
+
+        } else if (tag <= 0x2f) {
+            string = 0;
+            len = tag - 0x20;
+
+        } else if (tag <= 0x37) {
+            if (rd->last - p < 1) {
+                return NGX_ERROR;
+            }
+
+            string = (tag <= 0x33);
+            len = ((tag - (string ? 0x30 : 0x34)) << 8) + p[0];
+            p += 1;
+
+        } else if (tag == 'S' || tag == 'R' || tag == 'B' || tag == 'A') {
+            if (rd->last - p < 2) {
+                return NGX_ERROR;
+            }
+
+            string = (tag == 'S' || tag == 'R');
+            final = (tag == 'S' || tag == 'B');
+            len = (p[0] << 8) + p[1];
+            p += 2;
+
+        } else {
+            return NGX_ERROR;
+        }
+
+        if (string) {
+
+            /*
+             * the length is in UTF-16 characters, a 4 bytes sequence
+             * is a surrogate pair of 2 characters
+             */
+
+            for (q = p; len; len--) {
+
+                if (q >= rd->last) {
+                    return NGX_ERROR;
+                }
+
+                if (*q < 0x80) {
+                    q++;
+
+                } else if ((*q & 0xe0) == 0xc0) {
+                    q += 2;
+
+                } else if ((*q & 0xf0) == 0xe0) {
+                    q += 3;
+
+                } else {
+                    if (len < 2) {
+                        return NGX_ERROR;
+                    }
+
+                    len--;
+                    q += 4;
+                }
+            }
+
+            len = q - p;
+        }
+
+        if ((size_t) (rd->last - p) < len) {
+            return NGX_ERROR;
+        }
+
+        if (s->data == NULL) {
+            s->data = p;
+
+        } else {
+            ngx_memmove(s->data + s->len, p, len);
+        }
+
+        s->len += len;
+        p += len;
+
+        if (final) {
+            break;
+        }
+    }
+
+    rd->pos = p;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_dubbo_hessian2_read_value(ngx_dubbo_hessian2_reader_t *rd,
+    ngx_pool_t *pool, ngx_str_t *v)
+{
+    u_char     tag;
+    int32_t    n;
+    int64_t    l;
+    ngx_int_t  rc;
+
+    if (rd->pos == rd->last) {
+        return NGX_ERROR;
+    }
+
+    tag = *rd->pos;
+
+    switch (tag) {
+
+    case 'N':
+        rd->pos++;
+        ngx_str_null(v);
+        return NGX_OK;
+
+    case 'T':
+        rd->pos++;
+        ngx_str_set(v, "true");
+        return NGX_OK;
+
+    case 'F':
+        rd->pos++;
+        ngx_str_set(v, "false");
+        return NGX_OK;
+
+    case 'S':
+    case 'R':
+    case 'B':
+    case 'A':
+        return ngx_dubbo_hessian2_read_chunks(rd, v);
+    }
+
+    if (tag <= 0x37) {
+        return ngx_dubbo_hessian2_read_chunks(rd, v);
+    }
+
+    rc = ngx_dubbo_hessian2_read_int(rd, &n);
+
+    if (rc == NGX_OK) {
+        l = n;
+
+    } else if (rc == NGX_DECLINED) {
+        rc = ngx_dubbo_hessian2_read_long(rd, &l);
+    }
+
+    if (rc == NGX_DECLINED) {
+        ngx_log_error(NGX_LOG_ERR, rd->log, 0,
+                      "dubbo: unsupported hessian2 value type 0x%02Xd", tag);
+        return NGX_ERROR;
+    }
+
+    if (rc != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    v->data = ngx_pnalloc(pool, NGX_INT64_LEN);
+    if (v->data == NULL) {
+        return NGX_ERROR;
+    }
+
+    v->len = ngx_sprintf(v->data, "%L", l) - v->data;
+
+    return NGX_OK;
+}
+
+
+/*
+ * map ::= 'M' type (value value)* 'Z'  # key, value map pairs
+ *     ::= 'H' (value value)* 'Z'       # untyped key, value
+ */
+
+ngx_int_t
+ngx_dubbo_hessian2_read_map_start(ngx_dubbo_hessian2_reader_t *rd)
+{
+    int32_t    n;
+    ngx_int_t  rc;
+    ngx_str_t  type;
+
+    if (rd->pos == rd->last) {
+        return NGX_ERROR;
+    }
+
+    switch (*rd->pos++) {
+
+    case 'H':
+        return NGX_OK;
+
+    case 'M':
+
+        /* the type is a string or a reference to a type seen before */
+
+        rc = ngx_dubbo_hessian2_read_int(rd, &n);
+
+        if (rc == NGX_DECLINED) {
+            return ngx_dubbo_hessian2_read_chunks(rd, &type);
+        }
+
+        return rc;
+    }
+
+    return NGX_ERROR;
+}
+
+
+ngx_int_t
+ngx_dubbo_hessian2_read_map_next(ngx_dubbo_hessian2_reader_t *rd,
+    ngx_pool_t *pool, ngx_keyval_t *kv)
+{
+    if (rd->pos == rd->last) {
+        return NGX_ERROR;
+    }
+
+    if (*rd->pos == 'Z') {
+        rd->pos++;
+        return NGX_DONE;
+    }
+
+    if (ngx_dubbo_hessian2_read_value(rd, pool, &kv->key) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return ngx_dubbo_hessian2_read_value(rd, pool, &kv->value);
+}
+
+
+ngx_int_t
+ngx_dubbo_hessian2_decode_payload_map(ngx_pool_t *pool, ngx_str_t *in,
+    ngx_array_t **result, ngx_log_t *log)
+{
+    int32_t                       flag;
+    ngx_int_t                     rc;
+    ngx_array_t                  *pres;
+    ngx_keyval_t                 *kv, entry;
+    ngx_dubbo_hessian2_reader_t   rd;
+
+    ngx_dubbo_hessian2_reader_init(&rd, in->data, in->len, log);
+
+    /* response flag, a value with attachments is expected */
+
+    if (ngx_dubbo_hessian2_read_int(&rd, &flag) != NGX_OK
+        || ngx_dubbo_hessian2_read_map_start(&rd) != NGX_OK)
+    {
+        ngx_log_error(NGX_LOG_ERR, log, 0, "dubbo: parse result map failed");
+        return NGX_ERROR;
+    }
+
+    pres = ngx_array_create(pool, 8, sizeof(ngx_keyval_t));
+    if (pres == NULL) {
+        return NGX_ERROR;
+    }
+
+    for ( ;; ) {
+        rc = ngx_dubbo_hessian2_read_map_next(&rd, pool, &entry);
+
+        if (rc == NGX_DONE) {
+            break;
+        }
+
+        if (rc != NGX_OK) {
+            ngx_log_error(NGX_LOG_ERR, log, 0,
+                          "dubbo: parse result map entry %ui failed",
+                          pres->nelts);
+            return NGX_ERROR;
+        }
+
+        kv = ngx_array_push(pres);
+        if (kv == NULL) {
+            return NGX_ERROR;
+        }
+
+        *kv = entry;
+    }
+
+    *result = pres;
+
+    return NGX_OK;
+}
@@ -57,8 +57,17 @@ typedef struct {
 
     ngx_array_t                          *result;
     ngx_str_t                            *response_body;
+
+    ngx_flag_t                            request_sent;
 } ngx_http_dubbo_ctx_t;
 
+typedef struct {
+    ngx_multi_request_t                  *multi_r;
+    ngx_http_dubbo_ctx_t                 *ctx;      /* backend connection */
+    ngx_pool_cleanup_t                   *request_cln;
+    ngx_pool_cleanup_t                   *multi_cln;
+} ngx_http_dubbo_body_t;
+
 typedef ngx_int_t (*ngx_http_dubbo_response_handler_pt)(ngx_http_request_t *r);
 
 static ngx_int_t ngx_http_dubbo_create_request(ngx_http_request_t *r);
@@ -67,6 +76,10 @@ static ngx_int_t ngx_http_dubbo_create_dubbo_request(ngx_http_request_t *r, ngx_
         , ngx_multi_request_t **multi_rptr, ngx_chain_t *in);
 
 static ngx_int_t ngx_http_dubbo_body_output_filter(void *data, ngx_chain_t *in);
+static ngx_int_t ngx_http_dubbo_link_body(ngx_http_request_t *r,
+    ngx_http_dubbo_ctx_t *ctx, ngx_multi_request_t *multi_r);
+static void ngx_http_dubbo_multi_cleanup(void *data);
+static void ngx_http_dubbo_body_cleanup(void *data);
 static ngx_int_t ngx_http_dubbo_parse_filter(ngx_http_request_t *r);
 
 static ngx_http_dubbo_ctx_t* ngx_http_dubbo_get_ctx(ngx_http_request_t *r);
@@ -428,6 +441,13 @@ ngx_http_dubbo_create_request(ngx_http_request_t *r)
     u->output.output_filter = ngx_http_dubbo_body_output_filter;
     u->output.filter_ctx = r;
 
+    /*
+     * the body is linked to the dubbo request as is,
+     * ngx_output_chain() must not copy it in parts
+     */
+
+    u->request_bufs = NULL;
+
     return NGX_OK;
 }
 
@@ -437,6 +457,7 @@ ngx_http_dubbo_body_output_filter(void *data, ngx_chain_t *in)
     ngx_http_request_t      *r = data;
     ngx_connection_t        *pc = r->upstream->peer.connection;
     ngx_http_request_t      *fake_r = pc->data;
+    ngx_http_dubbo_ctx_t    *rctx;
     ngx_chain_t             *out, *cl, **ll, *tmp;
     ngx_multi_request_t     *multi_r;
     ngx_buf_t               *b;
@@ -478,9 +499,16 @@ ngx_http_dubbo_body_output_filter(void *data, ngx_chain_t *in)
         ctx->out = NULL;
     }
 
-    if (r != fake_r) { //no need send dubbo request when fake_r
+    rctx = ngx_http_get_module_ctx(r, ngx_http_dubbo_module);
 
-        if (NGX_OK != ngx_http_dubbo_create_dubbo_request(r, pc, &multi_r, in)) {
+    //no need send dubbo request when fake_r, or when it is already queued
+    if (r != fake_r && !rctx->request_sent) {
+
+        rctx->request_sent = 1;
+
+        if (NGX_OK != ngx_http_dubbo_create_dubbo_request(r, pc, &multi_r,
+                          r->request_body ? r->request_body->bufs : NULL))
+        {
             ngx_log_error(NGX_LOG_ERR, pc->log, 0, "dubbo: http create request failed %p, %p", pc, r);
             return NGX_ERROR;
         }
@@ -542,6 +570,7 @@ ngx_http_dubbo_body_output_filter(void *data, ngx_chain_t *in)
             if (cl->buf->last_shadow) {
                 b = cl->buf->shadow;
                 b->pos = b->last;
+                b->file_pos = b->file_last;
             }
 
             cl->buf->shadow = NULL;
@@ -599,10 +628,8 @@ ngx_http_dubbo_create_dubbo_request(ngx_http_request_t *r, ngx_connection_t *pc,
     ngx_keyval_t                *kv;
     ngx_uint_t                   n;
 
-    size_t                       len = 0;
-    ngx_int_t                    size;
-    ngx_buf_t                   *body = NULL;
-    ngx_chain_t                 *cl;
+    off_t                        len = 0;
+    ngx_chain_t                 *cl, *body;
 
     ngx_http_variable_value_t   *vv;
     size_t                       i;
@@ -610,32 +637,11 @@ ngx_http_dubbo_create_dubbo_request(ngx_http_request_t *r, ngx_connection_t *pc,
     ctx = ngx_http_dubbo_get_ctx(r);
     dubbo_c = ctx->connection;
 
-    //read body
+    //body is linked, not read
     for (cl = in; cl; cl = cl->next) {
         len += ngx_buf_size(cl->buf);
     }
 
-    if (len > 0) {
-        body = ngx_create_temp_buf(r->pool, len);
-        if (body == NULL) {
-            return NGX_ERROR;
-        }
-        for (cl = in; cl; cl = cl->next) {
-            if (cl->buf->in_file) {
-                size = ngx_read_file(cl->buf->file, body->last,
-                        cl->buf->file_last - cl->buf->file_pos, cl->buf->file_pos);
-
-                if (size == NGX_ERROR) {
-                    return NGX_ERROR;
-                }
-
-                body->last += size;
-            } else {
-                body->last = ngx_cpymem(body->last, cl->buf->pos, cl->buf->last - cl->buf->pos);
-            }
-        }
-    }
-
     if (dubbo_c == NULL) {
         return NGX_ERROR;
     }
@@ -667,19 +673,13 @@ ngx_http_dubbo_create_dubbo_request(ngx_http_request_t *r, ngx_connection_t *pc,
 
     arg->type = DUBBO_ARG_MAP;
     arg->value.m = ngx_array_create(dubbo_c->temp_pool, n, sizeof(ngx_keyval_t));
-
-    if (body && dlcf->pass_body) {
-        kv = (ngx_keyval_t*)ngx_array_push(arg->value.m);
-        if (kv == NULL) {
-            return NGX_ERROR;
-        }
-
-        kv->key.data = ngx_http_dubbo_str_body.data;
-        kv->key.len = ngx_http_dubbo_str_body.len;
-        kv->value.data = body->pos;
-        kv->value.len = body->last - body->pos;
+    if (arg->value.m == NULL) {
+        return NGX_ERROR;
     }
 
+    arg->body = (len > 0 && dlcf->pass_body) ? in : NULL;
+    body = arg->body;
+
     if (dlcf->pass_all_headers) {
         //pass all
         ngx_uint_t                              i;
@@ -760,12 +760,152 @@ ngx_http_dubbo_create_dubbo_request(ngx_http_request_t *r, ngx_connection_t *pc,
         return NGX_ERROR;
     }
 
+    if (body) {
+        return ngx_http_dubbo_link_body(r, ngx_http_dubbo_get_ctx(pc->data), multi_r);
+    }
+
     return NGX_OK;
 }
 
+static ngx_int_t
+ngx_http_dubbo_link_body(ngx_http_request_t *r, ngx_http_dubbo_ctx_t *ctx, ngx_multi_request_t *multi_r)
+{
+    ngx_pool_cleanup_t          *cln;
+    ngx_http_dubbo_body_t       *body;
+
+    if (ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    /*
+     * the dubbo request points to the request body, if the request is
+     * freed before the dubbo request is sent, the rest is copied
+     */
+
+    cln = ngx_pool_cleanup_add(r->pool, sizeof(ngx_http_dubbo_body_t));
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    body = cln->data;
+    body->multi_r = multi_r;
+    body->ctx = ctx;
+    body->request_cln = cln;
+
+    cln->handler = ngx_http_dubbo_body_cleanup;
+
+    cln = ngx_pool_cleanup_add(multi_r->pool, 0);
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_http_dubbo_multi_cleanup;
+    cln->data = body;
+
+    body->multi_cln = cln;
+
+    return NGX_OK;
+}
+
+static void
+ngx_http_dubbo_multi_cleanup(void *data)
+{
+    ngx_http_dubbo_body_t       *body = data;
+
+    //dubbo request is done, the request body is not needed anymore
+    body->request_cln->handler = NULL;
+}
+
+static void
+ngx_http_dubbo_body_cleanup(void *data)
+{
+    ngx_http_dubbo_body_t       *body = data;
+
+    off_t                        size;
+    u_char                      *p;
+    ssize_t                      n;
+    ngx_buf_t                   *b, *sb;
+    ngx_chain_t                 *cl, *ll;
+    ngx_multi_request_t         *multi_r;
+
+    multi_r = body->multi_r;
+
+    body->multi_cln->handler = NULL;
+
+    for (cl = multi_r->out; cl; cl = cl->next) {
+        b = cl->buf;
+
+        if (b->tag != (ngx_buf_tag_t) &ngx_dubbo_hessian2_write_binary
+            || ngx_buf_size(b) == 0)
+        {
+            continue;
+        }
+
+        //the copy being sent, see ngx_http_dubbo_body_output_filter()
+        sb = b;
+
+        for (ll = body->ctx->busy; ll; ll = ll->next) {
+            if (ll->buf->shadow == b) {
+                sb = ll->buf;
+                break;
+            }
+        }
+
+        size = ngx_buf_size(sb);
+
+        if (size == 0) {
+            continue;
+        }
+
+        p = ngx_pnalloc(multi_r->pool, (size_t) size);
+        if (p == NULL) {
+            ngx_log_error(NGX_LOG_ALERT, multi_r->pool->log, 0,
+                          "dubbo: request body of %ui dropped", multi_r->id);
+
+            sb->pos = sb->last;
+            sb->file_pos = sb->file_last;
+            continue;
+        }
+
+        if (ngx_buf_in_memory(sb)) {
+            ngx_memcpy(p, sb->pos, (size_t) size);
+
+        } else {
+            n = ngx_read_file(sb->file, p, (size_t) size, sb->file_pos);
+
+            if (n != size) {
+                ngx_log_error(NGX_LOG_ALERT, multi_r->pool->log, 0,
+                              "dubbo: request body of %ui read failed",
+                              multi_r->id);
+                ngx_memzero(p, (size_t) size);
+            }
+        }
+
+        sb->in_file = 0;
+        sb->memory = 1;
+        sb->pos = p;
+        sb->last = p + size;
+
+        if (sb != b) {
+            b->in_file = 0;
+            b->memory = 1;
+            b->pos = p;
+            b->last = p + size;
+        }
+    }
+}
+
 static ngx_int_t
 ngx_http_dubbo_reinit_request(ngx_http_request_t *r)
 {
+    ngx_http_dubbo_ctx_t    *ctx;
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_dubbo_module);
+
+    if (ctx) {
+        ctx->request_sent = 0;
+    }
+
     return NGX_OK;
 }
 
@@ -1176,6 +1316,14 @@ ngx_http_dubbo_add_response_header(ngx_http_request_t *r, ngx_str_t *name, ngx_s
     return NGX_OK;
 }
 
+static void
+ngx_http_dubbo_payload_cleanup(void *data)
+{
+    ngx_pool_t      *pool = data;
+
+    ngx_destroy_pool(pool);
+}
+
 static ngx_int_t
 ngx_http_dubbo_parse_filter(ngx_http_request_t *r)
 {
@@ -1197,6 +1345,7 @@ ngx_http_dubbo_parse_filter(ngx_http_request_t *r)
 
     ngx_http_dubbo_loc_conf_t       *dlcf;
     ngx_keyval_t                    *kv;
+    ngx_pool_cleanup_t              *cln;
 
     fake_r = r;
     fake_u = r->upstream;
@@ -1280,6 +1429,21 @@ ngx_http_dubbo_parse_filter(ngx_http_request_t *r)
                             body.data = resp->payload;
                             body.len = resp->header.payloadlen;
 
+                            //decoded response points to payload, pass it to real_r
+                            cln = ngx_pool_cleanup_add(real_r->pool, 0);
+                            if (cln == NULL) {
+                                ngx_destroy_pool(multi_r->pool);
+                                return NGX_ERROR;
+                            }
+
+                            cln->handler = ngx_http_dubbo_payload_cleanup;
+                            cln->data = resp->pool;
+
+                            //the upstream connection and its log may go away first
+                            resp->pool->log = real_r->connection->log;
+
+                            resp->pool = NULL;
+
                             multi_c->cur = multi_r->data;
 
                             if (NGX_OK != ngx_dubbo_hessian2_decode_payload_map(real_r->pool,
@@ -8,6 +8,12 @@
 #define NGX_HTTP_REQSTAT_MAX     50
 #define NGX_HTTP_REQSTAT_USER    NGX_HTTP_REQSTAT_MAX - NGX_HTTP_REQSTAT_RSRV
 
+/*
+ * latency histograms have 4 exact buckets for 0-3ms, and then
+ * 4 buckets for each power of two up to 131071ms
+ */
+#define NGX_HTTP_REQSTAT_HIST    64
+
 
 #define variable_index(str, index)  { ngx_string(str), index }
 
@@ -20,14 +26,8 @@ struct variable_index_s {
     ngx_int_t                    index;
 };
 
-struct ngx_http_reqstat_rbnode_s {
-    u_char                       color;
-    u_char                       padding[3];
-    uint32_t                     len;
-
-    ngx_queue_t                  queue;
-    ngx_queue_t                  visit;
 
+typedef struct {
     ngx_atomic_t                 bytes_in;
     ngx_atomic_t                 bytes_out;
     ngx_atomic_t                 conn_total;
@@ -58,6 +58,24 @@ struct ngx_http_reqstat_rbnode_s {
     ngx_atomic_t                 urt;
     ngx_atomic_t                 utries;
     ngx_atomic_t                 extra[NGX_HTTP_REQSTAT_USER];
+} ngx_http_reqstat_counters_t;
+
+
+struct ngx_http_reqstat_rbnode_s {
+    u_char                       color;
+    u_char                       histogram;
+    u_char                       padding[2];
+    uint32_t                     len;
+
+    ngx_queue_t                  queue;
+    ngx_queue_t                  visit;
+
+    /* one cache line aligned slot of counters per worker process */
+    u_char                      *counters;
+    ngx_uint_t                   slots;
+
+    /* odd while the node is being reused for another key */
+    ngx_atomic_t                 generation;
 
     ngx_atomic_int_t             excess;
 
@@ -67,6 +85,15 @@ struct ngx_http_reqstat_rbnode_s {
 };
 
 
+typedef struct {
+    ngx_http_reqstat_rbnode_t   *node;
+    ngx_uint_t                   generation;
+    uint32_t                     hash;
+    ngx_uint_t                   visits;
+    ngx_msec_t                   last_visit;
+} ngx_http_reqstat_cache_t;
+
+
 typedef struct {
     ngx_flag_t                   lazy;
     ngx_array_t                 *monitor;
@@ -95,6 +122,8 @@ typedef struct {
     ngx_int_t                    key_len;
     ngx_uint_t                   recycle_rate;
     ngx_int_t                    alloc_already_fail;
+    ngx_flag_t                   histogram;
+    ngx_http_reqstat_cache_t    *cache;
 } ngx_http_reqstat_ctx_t;
 
 
@@ -109,98 +138,113 @@ typedef struct {
 
 
 #define NGX_HTTP_REQSTAT_BYTES_IN                                       \
-    offsetof(ngx_http_reqstat_rbnode_t, bytes_in)
+    offsetof(ngx_http_reqstat_counters_t, bytes_in)
 
 #define NGX_HTTP_REQSTAT_BYTES_OUT                                      \
-    offsetof(ngx_http_reqstat_rbnode_t, bytes_out)
+    offsetof(ngx_http_reqstat_counters_t, bytes_out)
 
 #define NGX_HTTP_REQSTAT_CONN_TOTAL                                     \
-    offsetof(ngx_http_reqstat_rbnode_t, conn_total)
+    offsetof(ngx_http_reqstat_counters_t, conn_total)
 
 #define NGX_HTTP_REQSTAT_REQ_TOTAL                                      \
-    offsetof(ngx_http_reqstat_rbnode_t, req_total)
+    offsetof(ngx_http_reqstat_counters_t, req_total)
 
 #define NGX_HTTP_REQSTAT_2XX                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_2xx)
+    offsetof(ngx_http_reqstat_counters_t, http_2xx)
 
 #define NGX_HTTP_REQSTAT_3XX                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_3xx)
+    offsetof(ngx_http_reqstat_counters_t, http_3xx)
 
 #define NGX_HTTP_REQSTAT_4XX                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_4xx)
+    offsetof(ngx_http_reqstat_counters_t, http_4xx)
 
 #define NGX_HTTP_REQSTAT_5XX                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_5xx)
+    offsetof(ngx_http_reqstat_counters_t, http_5xx)
 
 #define NGX_HTTP_REQSTAT_OTHER_STATUS                                   \
-    offsetof(ngx_http_reqstat_rbnode_t, other_status)
+    offsetof(ngx_http_reqstat_counters_t, other_status)
 
 #define NGX_HTTP_REQSTAT_200                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_200)
+    offsetof(ngx_http_reqstat_counters_t, http_200)
 
 #define NGX_HTTP_REQSTAT_206                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_206)
+    offsetof(ngx_http_reqstat_counters_t, http_206)
 
 #define NGX_HTTP_REQSTAT_302                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_302)
+    offsetof(ngx_http_reqstat_counters_t, http_302)
 
 #define NGX_HTTP_REQSTAT_304                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_304)
+    offsetof(ngx_http_reqstat_counters_t, http_304)
 
 #define NGX_HTTP_REQSTAT_403                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_403)
+    offsetof(ngx_http_reqstat_counters_t, http_403)
 
 #define NGX_HTTP_REQSTAT_404                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_404)
+    offsetof(ngx_http_reqstat_counters_t, http_404)
 
 #define NGX_HTTP_REQSTAT_416                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_416)
+    offsetof(ngx_http_reqstat_counters_t, http_416)
 
 #define NGX_HTTP_REQSTAT_499                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_499)
+    offsetof(ngx_http_reqstat_counters_t, http_499)
 
 #define NGX_HTTP_REQSTAT_500                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_500)
+    offsetof(ngx_http_reqstat_counters_t, http_500)
 
 #define NGX_HTTP_REQSTAT_502                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_502)
+    offsetof(ngx_http_reqstat_counters_t, http_502)
 
 #define NGX_HTTP_REQSTAT_503                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_503)
+    offsetof(ngx_http_reqstat_counters_t, http_503)
 
 #define NGX_HTTP_REQSTAT_504                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_504)
+    offsetof(ngx_http_reqstat_counters_t, http_504)
 
 #define NGX_HTTP_REQSTAT_508                                            \
-    offsetof(ngx_http_reqstat_rbnode_t, http_508)
+    offsetof(ngx_http_reqstat_counters_t, http_508)
 
 #define NGX_HTTP_REQSTAT_OTHER_DETAIL_STATUS                            \
-    offsetof(ngx_http_reqstat_rbnode_t, other_detail_status)
+    offsetof(ngx_http_reqstat_counters_t, other_detail_status)
 
 #define NGX_HTTP_REQSTAT_RT                                             \
-    offsetof(ngx_http_reqstat_rbnode_t, rt)
+    offsetof(ngx_http_reqstat_counters_t, rt)
 
 #define NGX_HTTP_REQSTAT_UPS_REQ                                        \
-    offsetof(ngx_http_reqstat_rbnode_t, ureq)
+    offsetof(ngx_http_reqstat_counters_t, ureq)
 
 #define NGX_HTTP_REQSTAT_UPS_RT                                         \
-    offsetof(ngx_http_reqstat_rbnode_t, urt)
+    offsetof(ngx_http_reqstat_counters_t, urt)
 
 #define NGX_HTTP_REQSTAT_UPS_TRIES                                      \
-    offsetof(ngx_http_reqstat_rbnode_t, utries)
+    offsetof(ngx_http_reqstat_counters_t, utries)
 
 #define NGX_HTTP_REQSTAT_UPS_4XX                                        \
-    offsetof(ngx_http_reqstat_rbnode_t, http_ups_4xx)
+    offsetof(ngx_http_reqstat_counters_t, http_ups_4xx)
 
 #define NGX_HTTP_REQSTAT_UPS_5XX                                        \
-    offsetof(ngx_http_reqstat_rbnode_t, http_ups_5xx)
+    offsetof(ngx_http_reqstat_counters_t, http_ups_5xx)
 
 #define NGX_HTTP_REQSTAT_EXTRA(slot)                                    \
-    (offsetof(ngx_http_reqstat_rbnode_t, extra)                         \
+    (offsetof(ngx_http_reqstat_counters_t, extra)                       \
          + sizeof(ngx_atomic_t) * slot)
 
-#define NGX_HTTP_REQSTAT_REQ_FIELD(node, offset)                        \
-    ((ngx_atomic_t *) ((char *) node + offset))
+#define NGX_HTTP_REQSTAT_RT_HIST(bucket)                                \
+    (sizeof(ngx_http_reqstat_counters_t)                                \
+         + sizeof(ngx_atomic_t) * (bucket))
+
+#define NGX_HTTP_REQSTAT_UPS_RT_HIST(bucket)                            \
+    (sizeof(ngx_http_reqstat_counters_t)                                \
+         + sizeof(ngx_atomic_t) * (NGX_HTTP_REQSTAT_HIST + (bucket)))
+
+#define NGX_HTTP_REQSTAT_SLOT_SIZE(histogram)                           \
+    ngx_align(sizeof(ngx_http_reqstat_counters_t)                       \
+              + ((histogram) ? 2 * NGX_HTTP_REQSTAT_HIST                \
+                                 * sizeof(ngx_atomic_t) : 0),           \
+              NGX_CPU_CACHE_LINE)
+
+#define NGX_HTTP_REQSTAT_REQ_FIELD(node, slot, offset)                  \
+    ((ngx_atomic_t *) ((node)->counters + (offset)                      \
+         + (slot) * NGX_HTTP_REQSTAT_SLOT_SIZE((node)->histogram)))
 
 
 ngx_http_reqstat_rbnode_t *
@@ -6,6 +6,17 @@
 #include "ngx_http_reqstat.h"
 
 
+#define NGX_HTTP_REQSTAT_CACHE_SIZE    1024
+#define NGX_HTTP_REQSTAT_CACHE_VALID   1000
+
+#define NGX_HTTP_REQSTAT_HIST_FIELDS   10
+#define NGX_HTTP_REQSTAT_PERCENTILES   4
+
+#define NGX_HTTP_REQSTAT_HIST_LEN                                       \
+    ((2 * NGX_HTTP_REQSTAT_HIST + 2 * NGX_HTTP_REQSTAT_PERCENTILES)     \
+     * (NGX_ATOMIC_T_LEN + 1))
+
+
 static ngx_http_input_body_filter_pt  ngx_http_next_input_body_filter;
 extern ngx_int_t (*ngx_http_write_filter_stat)(ngx_http_request_t *r);
 
@@ -43,6 +54,31 @@ static variable_index_t REQSTAT_RSRV_VARIABLES[NGX_HTTP_REQSTAT_RSRV] = {
 };
 
 
+static variable_index_t
+    REQSTAT_HIST_VARIABLES[NGX_HTTP_REQSTAT_HIST_FIELDS] =
+{
+    variable_index("rt_p50", NGX_HTTP_REQSTAT_MAX + 0),
+    variable_index("rt_p90", NGX_HTTP_REQSTAT_MAX + 1),
+    variable_index("rt_p99", NGX_HTTP_REQSTAT_MAX + 2),
+    variable_index("rt_p999", NGX_HTTP_REQSTAT_MAX + 3),
+    variable_index("ups_rt_p50", NGX_HTTP_REQSTAT_MAX + 4),
+    variable_index("ups_rt_p90", NGX_HTTP_REQSTAT_MAX + 5),
+    variable_index("ups_rt_p99", NGX_HTTP_REQSTAT_MAX + 6),
+    variable_index("ups_rt_p999", NGX_HTTP_REQSTAT_MAX + 7),
+    variable_index("rt_hist", NGX_HTTP_REQSTAT_MAX + 8),
+    variable_index("ups_rt_hist", NGX_HTTP_REQSTAT_MAX + 9),
+};
+
+
+/* permilles reported by req_status_show */
+
+static ngx_uint_t
+    ngx_http_reqstat_percentiles[NGX_HTTP_REQSTAT_PERCENTILES] =
+{
+    500, 900, 990, 999
+};
+
+
 off_t ngx_http_reqstat_fields[29] = {
     NGX_HTTP_REQSTAT_BYTES_IN,
     NGX_HTTP_REQSTAT_BYTES_OUT,
@@ -98,12 +134,22 @@ static char *ngx_http_reqstat_zone_key_length(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
 static char *ngx_http_reqstat_zone_recycle(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
+static char *ngx_http_reqstat_zone_histogram(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
 static char *ngx_http_reqstat(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static void ngx_http_reqstat_count(void *data, off_t offset,
     ngx_int_t incr);
+static ngx_atomic_uint_t ngx_http_reqstat_value(
+    ngx_http_reqstat_rbnode_t *node, off_t offset);
+static ngx_uint_t ngx_http_reqstat_bucket(ngx_msec_int_t ms);
+static void ngx_http_reqstat_histogram(ngx_http_reqstat_rbnode_t *node,
+    ngx_atomic_uint_t *hist);
+static u_char *ngx_http_reqstat_show_histogram(u_char *p, u_char *last,
+    ngx_atomic_uint_t *hist, ngx_uint_t field);
 static ngx_int_t ngx_http_reqstat_init_zone(ngx_shm_zone_t *shm_zone,
     void *data);
+static ngx_int_t ngx_http_reqstat_init_process(ngx_cycle_t *cycle);
 
 static ngx_int_t ngx_http_reqstat_log_handler(ngx_http_request_t *r);
 static ngx_int_t ngx_http_reqstat_init_handler(ngx_http_request_t *r);
@@ -188,6 +234,13 @@ static ngx_command_t   ngx_http_reqstat_commands[] = {
       0,
       NULL },
 
+    { ngx_string("req_status_zone_histogram"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_http_reqstat_zone_histogram,
+      0,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -214,7 +267,7 @@ ngx_module_t  ngx_http_reqstat_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_reqstat_init_process,         /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -388,6 +441,18 @@ ngx_http_reqstat_show_field(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
                 valid = 1;
                 break;
             }
+
+            for (j = 0; !valid && j < NGX_HTTP_REQSTAT_HIST_FIELDS; j++) {
+                if (value[i].len != REQSTAT_HIST_VARIABLES[j].name.len
+                    || ngx_strncmp(REQSTAT_HIST_VARIABLES[j].name.data,
+                                   value[i].data, value[i].len) != 0)
+                {
+                    continue;
+                }
+
+                *index++ = REQSTAT_HIST_VARIABLES[j].index;
+                valid = 1;
+            }
         }
 
         if (!valid) {
@@ -607,6 +672,41 @@ ngx_http_reqstat_zone_recycle(ngx_conf_t *cf, ngx_command_t *cmd,
 }
 
 
+static char *
+ngx_http_reqstat_zone_histogram(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_str_t                         *value;
+    ngx_shm_zone_t                    *shm_zone;
+    ngx_http_reqstat_ctx_t            *ctx;
+
+    value = cf->args->elts;
+
+    shm_zone = ngx_shared_memory_add(cf, &value[1], 0,
+                                     &ngx_http_reqstat_module);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (shm_zone->data == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" should be defined first",
+                           &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    ctx = shm_zone->data;
+
+    if (ctx->histogram) {
+        return "is duplicate";
+    }
+
+    ctx->histogram = 1;
+
+    return NGX_CONF_OK;
+}
+
+
 static char *
 ngx_http_reqstat_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -1028,6 +1128,11 @@ ngx_http_reqstat_log_handler(ngx_http_request_t *r)
         ms = ngx_max(ms, 0);
         ngx_http_reqstat_count(fnode, NGX_HTTP_REQSTAT_RT, ms);
 
+        if (fnode->histogram) {
+            k = ngx_http_reqstat_bucket(ms);
+            ngx_http_reqstat_count(fnode, NGX_HTTP_REQSTAT_RT_HIST(k), 1);
+        }
+
         if (r->upstream_states != NULL && r->upstream_states->nelts > 0) {
             ngx_http_reqstat_count(fnode, NGX_HTTP_REQSTAT_UPS_REQ, 1);
 
@@ -1064,6 +1169,12 @@ ngx_http_reqstat_log_handler(ngx_http_request_t *r)
                                    total_ms);
             ngx_http_reqstat_count(fnode, NGX_HTTP_REQSTAT_UPS_TRIES,
                                    utries);
+
+            if (fnode->histogram) {
+                k = ngx_http_reqstat_bucket(total_ms);
+                ngx_http_reqstat_count(fnode, NGX_HTTP_REQSTAT_UPS_RT_HIST(k),
+                                       1);
+            }
         }
 
         if (ctx->user_defined) {
@@ -1112,6 +1223,7 @@ ngx_http_reqstat_log_handler(ngx_http_request_t *r)
 static ngx_int_t
 ngx_http_reqstat_show_handler(ngx_http_request_t *r)
 {
+    size_t                        size;
     ngx_int_t                     rc, *user, index;
     ngx_buf_t                    *b;
     ngx_uint_t                    i, j;
@@ -1123,6 +1235,7 @@ ngx_http_reqstat_show_handler(ngx_http_request_t *r)
     ngx_http_reqstat_conf_t      *rlcf;
     ngx_http_reqstat_conf_t      *smcf;
     ngx_http_reqstat_rbnode_t    *node;
+    ngx_atomic_uint_t             hist[2 * NGX_HTTP_REQSTAT_HIST];
 
     rlcf = ngx_http_get_module_loc_conf(r, ngx_http_reqstat_module);
     smcf = ngx_http_get_module_main_conf(r, ngx_http_reqstat_module);
@@ -1155,7 +1268,8 @@ ngx_http_reqstat_show_handler(ngx_http_request_t *r)
         {
             node = ngx_queue_data(q, ngx_http_reqstat_rbnode_t, queue);
 
-            if (node->conn_total == 0) {
+            if (ngx_http_reqstat_value(node, NGX_HTTP_REQSTAT_CONN_TOTAL) == 0)
+            {
                 continue;
             }
 
@@ -1169,13 +1283,23 @@ ngx_http_reqstat_show_handler(ngx_http_request_t *r)
                 return NGX_HTTP_INTERNAL_SERVER_ERROR;
             }
 
+            size = 512;
+
+            if (node->histogram) {
+                ngx_http_reqstat_histogram(node, hist);
+                size += NGX_HTTP_REQSTAT_HIST_LEN;
+
+            } else {
+                ngx_memzero(hist, sizeof(hist));
+            }
+
             tl->buf = b;
-            b->start = ngx_pcalloc(r->pool, 512);
+            b->start = ngx_pcalloc(r->pool, size);
             if (b->start == NULL) {
                 return NGX_HTTP_INTERNAL_SERVER_ERROR;
             }
 
-            b->end = b->start + 512;
+            b->end = b->start + size;
             b->last = b->pos = b->start;
             b->temporary = 1;
 
@@ -1187,13 +1311,19 @@ ngx_http_reqstat_show_handler(ngx_http_request_t *r)
                     if (user[j] < NGX_HTTP_REQSTAT_RSRV) {
                         index = user[j];
                         b->last = ngx_slprintf(b->last, b->end, "%uA,",
-                                        *NGX_HTTP_REQSTAT_REQ_FIELD(node,
+                                        ngx_http_reqstat_value(node,
                                               ngx_http_reqstat_fields[index]));
 
+                    } else if (user[j] >= NGX_HTTP_REQSTAT_MAX) {
+                        index = user[j] - NGX_HTTP_REQSTAT_MAX;
+                        b->last = ngx_http_reqstat_show_histogram(b->last,
+                                                                  b->end, hist,
+                                                                  index);
+
                     } else {
                         index = user[j] - NGX_HTTP_REQSTAT_RSRV;
                         b->last = ngx_slprintf(b->last, b->end, "%uA,",
-                                        *NGX_HTTP_REQSTAT_REQ_FIELD(node,
+                                        ngx_http_reqstat_value(node,
                                                NGX_HTTP_REQSTAT_EXTRA(index)));
                     }
                 }
@@ -1202,17 +1332,25 @@ ngx_http_reqstat_show_handler(ngx_http_request_t *r)
 
                 for (j = 0; j < NGX_HTTP_REQSTAT_RSRV; j++) {
                     b->last = ngx_slprintf(b->last, b->end, "%uA,",
-                                       *NGX_HTTP_REQSTAT_REQ_FIELD(node,
+                                       ngx_http_reqstat_value(node,
                                                   ngx_http_reqstat_fields[j]));
                 }
 
                 if (ctx->user_defined) {
                     for (j = 0; j < ctx->user_defined->nelts; j++) {
                         b->last = ngx_slprintf(b->last, b->end, "%uA,",
-                                           *NGX_HTTP_REQSTAT_REQ_FIELD(node,
+                                           ngx_http_reqstat_value(node,
                                                    NGX_HTTP_REQSTAT_EXTRA(j)));
                     }
                 }
+
+                if (node->histogram) {
+                    for (j = 0; j < 2 * NGX_HTTP_REQSTAT_PERCENTILES; j++) {
+                        b->last = ngx_http_reqstat_show_histogram(b->last,
+                                                                  b->end, hist,
+                                                                  j);
+                    }
+                }
             }
 
             *(b->last - 1) = '\n';
@@ -1246,34 +1384,205 @@ ngx_http_reqstat_count(void *data, off_t offset, ngx_int_t incr)
 {
     ngx_http_reqstat_rbnode_t    *node = data;
 
-    (void) ngx_atomic_fetch_add(NGX_HTTP_REQSTAT_REQ_FIELD(node, offset), incr);
+    /*
+     * each worker updates its own slot, the slot is shared only
+     * while old and new worker processes run at the same time
+     */
+
+    (void) ngx_atomic_fetch_add(NGX_HTTP_REQSTAT_REQ_FIELD(node,
+                                                ngx_worker % node->slots,
+                                                offset),
+                                incr);
+}
+
+
+static ngx_atomic_uint_t
+ngx_http_reqstat_value(ngx_http_reqstat_rbnode_t *node, off_t offset)
+{
+    ngx_uint_t          i;
+    ngx_atomic_uint_t   value;
+
+    value = 0;
+
+    for (i = 0; i < node->slots; i++) {
+        value += *NGX_HTTP_REQSTAT_REQ_FIELD(node, i, offset);
+    }
+
+    return value;
+}
+
+
+static ngx_uint_t
+ngx_http_reqstat_bucket(ngx_msec_int_t ms)
+{
+    ngx_uint_t  v, m, n;
+
+    v = (ngx_uint_t) ms;
+
+    if (v < 4) {
+        return v;
+    }
+
+    /* m is the highest bit set, the next two bits select the bucket */
+
+    for (m = 2; v >> (m + 1); m++) { /* void */ }
+
+    n = (m - 1) * 4 + ((v >> (m - 2)) & 3);
+
+    return ngx_min(n, NGX_HTTP_REQSTAT_HIST - 1);
+}
+
+
+static void
+ngx_http_reqstat_histogram(ngx_http_reqstat_rbnode_t *node,
+    ngx_atomic_uint_t *hist)
+{
+    ngx_uint_t  i, n;
+
+    for (n = 0; n < NGX_HTTP_REQSTAT_HIST; n++) {
+        hist[n] = 0;
+        hist[NGX_HTTP_REQSTAT_HIST + n] = 0;
+
+        for (i = 0; i < node->slots; i++) {
+            hist[n] += *NGX_HTTP_REQSTAT_REQ_FIELD(node, i,
+                                               NGX_HTTP_REQSTAT_RT_HIST(n));
+            hist[NGX_HTTP_REQSTAT_HIST + n] +=
+                *NGX_HTTP_REQSTAT_REQ_FIELD(node, i,
+                                            NGX_HTTP_REQSTAT_UPS_RT_HIST(n));
+        }
+    }
+}
+
+
+static u_char *
+ngx_http_reqstat_show_histogram(u_char *p, u_char *last,
+    ngx_atomic_uint_t *hist, ngx_uint_t field)
+{
+    ngx_uint_t          n, m, permille;
+    ngx_atomic_uint_t   total, rank, sum;
+
+    if (field >= 2 * NGX_HTTP_REQSTAT_PERCENTILES) {
+
+        /* raw buckets, separated by spaces */
+
+        hist += (field - 2 * NGX_HTTP_REQSTAT_PERCENTILES)
+                * NGX_HTTP_REQSTAT_HIST;
+
+        for (n = 0; n < NGX_HTTP_REQSTAT_HIST; n++) {
+            p = ngx_slprintf(p, last, n ? " %uA" : "%uA", hist[n]);
+        }
+
+        return ngx_slprintf(p, last, ",");
+    }
+
+    n = field % NGX_HTTP_REQSTAT_PERCENTILES;
+
+    hist += (field / NGX_HTTP_REQSTAT_PERCENTILES) * NGX_HTTP_REQSTAT_HIST;
+    permille = ngx_http_reqstat_percentiles[n];
+
+    total = 0;
+
+    for (n = 0; n < NGX_HTTP_REQSTAT_HIST; n++) {
+        total += hist[n];
+    }
+
+    if (total == 0) {
+        return ngx_slprintf(p, last, "0,");
+    }
+
+    rank = (total * permille + 999) / 1000;
+    sum = 0;
+
+    for (n = 0; n < NGX_HTTP_REQSTAT_HIST - 1; n++) {
+        sum += hist[n];
+
+        if (sum >= rank) {
+            break;
+        }
+    }
+
+    /* the highest value of the bucket */
+
+    if (n < 4) {
+        return ngx_slprintf(p, last, "%ui,", n);
+    }
+
+    m = n / 4 + 1;
+
+    return ngx_slprintf(p, last, "%ui,",
+                        ((4 + n % 4) << (m - 2)) + (1 << (m - 2)) - 1);
 }
 
 
 ngx_http_reqstat_rbnode_t *
 ngx_http_reqstat_rbtree_lookup(ngx_shm_zone_t *shm_zone, ngx_str_t *val)
 {
-    size_t                        size, len;
+    size_t                        size, len, slot_size;
     uint32_t                      hash;
     ngx_int_t                     rc, excess;
+    ngx_uint_t                    visits, slots, generation, match;
     ngx_time_t                   *tp;
     ngx_msec_t                    now;
     ngx_queue_t                  *q;
     ngx_msec_int_t                ms;
+    ngx_core_conf_t              *ccf;
     ngx_rbtree_node_t            *node, *sentinel;
     ngx_http_reqstat_ctx_t       *ctx;
+    ngx_http_reqstat_cache_t     *cache;
     ngx_http_reqstat_rbnode_t    *rs;
 
     ctx = shm_zone->data;
 
     hash = ngx_murmur_hash2(val->data, val->len);
-
-    node = ctx->sh->rbtree.root;
-    sentinel = ctx->sh->rbtree.sentinel;
+    len = ngx_min(ctx->key_len, (ssize_t) val->len);
 
     tp = ngx_timeofday();
     now = (ngx_msec_t) (tp->sec * 1000 + tp->msec);
 
+    /*
+     * the worker keeps the nodes found recently, visits are accounted
+     * in the zone at most once a second for each of them;
+     *
+     * the key of a node is compared without the lock, the generation
+     * is odd while another worker reuses the node, and is checked again
+     * after the compare, like a seqlock
+     */
+
+    cache = NULL;
+    visits = 1;
+
+    if (ctx->cache) {
+        cache = &ctx->cache[hash % NGX_HTTP_REQSTAT_CACHE_SIZE];
+        rs = cache->node;
+
+        if (rs && cache->hash == hash) {
+            generation = rs->generation;
+
+            ngx_memory_barrier();
+
+            match = (rs->len == len
+                     && ngx_strncmp(rs->data, val->data, len) == 0);
+
+            ngx_memory_barrier();
+
+            if (cache->generation == generation
+                && rs->generation == generation)
+            {
+                if (match
+                    && now - cache->last_visit < NGX_HTTP_REQSTAT_CACHE_VALID)
+                {
+                    cache->visits++;
+                    return rs;
+                }
+
+                visits += cache->visits;
+            }
+        }
+    }
+
+    node = ctx->sh->rbtree.root;
+    sentinel = ctx->sh->rbtree.sentinel;
+
     ngx_shmtx_lock(&ctx->shpool->mutex);
 
     while (node != sentinel) {
@@ -1306,7 +1615,7 @@ ngx_http_reqstat_rbtree_lookup(ngx_shm_zone_t *shm_zone, ngx_str_t *val)
             ms = (ngx_msec_int_t) (now - rs->last_visit);
 
             rs->excess = rs->excess - ngx_abs(ms) * ctx->recycle_rate / 1000
-                       + 1000;
+                       + 1000 * visits;
             rs->last_visit = now;
 
             if (rs->excess > 0) {
@@ -1317,9 +1626,7 @@ ngx_http_reqstat_rbtree_lookup(ngx_shm_zone_t *shm_zone, ngx_str_t *val)
             ngx_log_debug2(NGX_LOG_DEBUG_CORE, shm_zone->shm.log, 0,
                            "reqstat lookup exist: %*s", rs->len, rs->data);
 
-            ngx_shmtx_unlock(&ctx->shpool->mutex);
-
-            return rs;
+            goto found;
         }
 
         node = (rc < 0) ? node->left : node->right;
@@ -1328,12 +1635,19 @@ ngx_http_reqstat_rbtree_lookup(ngx_shm_zone_t *shm_zone, ngx_str_t *val)
     rc = 0;
     node = NULL;
 
-    size = offsetof(ngx_rbtree_node_t, color)
-         + offsetof(ngx_http_reqstat_rbnode_t, data)
-         + ctx->key_len;
+    size = ngx_align(offsetof(ngx_rbtree_node_t, color)
+                     + offsetof(ngx_http_reqstat_rbnode_t, data)
+                     + ctx->key_len,
+                     NGX_CPU_CACHE_LINE);
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
+                                           ngx_core_module);
+
+    slots = ngx_max(ccf->worker_processes, 1);
+    slot_size = NGX_HTTP_REQSTAT_SLOT_SIZE(ctx->histogram);
 
     if (ctx->alloc_already_fail == 0) {
-        node = ngx_slab_alloc_locked(ctx->shpool, size);
+        node = ngx_slab_alloc_locked(ctx->shpool, size + slots * slot_size);
         if (node == NULL) {
             ctx->alloc_already_fail = 1;
         }
@@ -1364,10 +1678,13 @@ ngx_http_reqstat_rbtree_lookup(ngx_shm_zone_t *shm_zone, ngx_str_t *val)
             ngx_log_debug2(NGX_LOG_DEBUG_CORE, shm_zone->shm.log, 0,
                            "reqstat lookup recycle: %*s", rs->len, rs->data);
 
-            rs->conn_total = 0;
+            /* invalidates the node in caches of all workers */
+            rs->generation++;
+
+            ngx_memory_barrier();
 
-            ngx_memzero((void *) &rs->bytes_in, size - offsetof(ngx_rbtree_node_t, color)
-                                            - offsetof(ngx_http_reqstat_rbnode_t, bytes_in));
+            ngx_memzero(rs->counters,
+                        rs->slots * NGX_HTTP_REQSTAT_SLOT_SIZE(rs->histogram));
 
         } else {
             ngx_shmtx_unlock(&ctx->shpool->mutex);
@@ -1379,10 +1696,25 @@ ngx_http_reqstat_rbtree_lookup(ngx_shm_zone_t *shm_zone, ngx_str_t *val)
 
     rs = (ngx_http_reqstat_rbnode_t *) &node->color;
 
-    len = ngx_min(ctx->key_len, (ssize_t) val->len);
+    if (!rc) {
+        rs->counters = (u_char *) node + size;
+        rs->slots = slots;
+        rs->histogram = ctx->histogram ? 1 : 0;
+        rs->generation = 0;
+
+        ngx_memzero(rs->counters, slots * slot_size);
+    }
+
     ngx_memcpy(rs->data, val->data, len);
     rs->len = len;
 
+    if (rc) {
+        ngx_memory_barrier();
+
+        /* the node is consistent again */
+        rs->generation++;
+    }
+
     ngx_rbtree_insert(&ctx->sh->rbtree, node);
     ngx_queue_insert_head(&ctx->sh->visit, &rs->visit);
     if (!rc) {
@@ -1394,6 +1726,16 @@ ngx_http_reqstat_rbtree_lookup(ngx_shm_zone_t *shm_zone, ngx_str_t *val)
 
     ngx_log_debug2(NGX_LOG_DEBUG_CORE, shm_zone->shm.log, 0, "reqstat lookup build: %*s", rs->len, rs->data);
 
+found:
+
+    if (cache) {
+        cache->node = rs;
+        cache->generation = rs->generation;
+        cache->hash = hash;
+        cache->visits = 0;
+        cache->last_visit = now;
+    }
+
     ngx_shmtx_unlock(&ctx->shpool->mutex);
 
     return rs;
@@ -1453,6 +1795,47 @@ ngx_http_reqstat_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 }
 
 
+static ngx_int_t
+ngx_http_reqstat_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                    i;
+    ngx_shm_zone_t              **shm_zone;
+    ngx_http_reqstat_ctx_t       *ctx;
+    ngx_http_reqstat_conf_t      *smcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    smcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_reqstat_module);
+
+    if (smcf == NULL || smcf->monitor == NULL) {
+        return NGX_OK;
+    }
+
+    shm_zone = smcf->monitor->elts;
+
+    for (i = 0; i < smcf->monitor->nelts; i++) {
+        ctx = shm_zone[i]->data;
+
+        if (ctx->cache) {
+            continue;
+        }
+
+        ctx->cache = ngx_pcalloc(cycle->pool,
+                                 NGX_HTTP_REQSTAT_CACHE_SIZE
+                                 * sizeof(ngx_http_reqstat_cache_t));
+        if (ctx->cache == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
 static void
 ngx_http_reqstat_rbtree_insert_value(ngx_rbtree_node_t *temp,
     ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
@@ -11,6 +11,18 @@
 #define NGX_HTTP_SYSGUARD_MODE_OR  0
 #define NGX_HTTP_SYSGUARD_MODE_AND 1
 
+#define NGX_HTTP_SYSGUARD_LOAD        0x0001
+#define NGX_HTTP_SYSGUARD_CPU         0x0002
+#define NGX_HTTP_SYSGUARD_MEM         0x0004
+#define NGX_HTTP_SYSGUARD_PSI_CPU     0x0010
+#define NGX_HTTP_SYSGUARD_PSI_MEMORY  0x0020
+#define NGX_HTTP_SYSGUARD_PSI_IO      0x0040
+#define NGX_HTTP_SYSGUARD_CGROUP      0x0100
+
+#define NGX_HTTP_SYSGUARD_PSI         (NGX_HTTP_SYSGUARD_PSI_CPU              \
+                                       |NGX_HTTP_SYSGUARD_PSI_MEMORY          \
+                                       |NGX_HTTP_SYSGUARD_PSI_IO)
+
 
 typedef struct {
     time_t           stamp;
@@ -28,6 +40,42 @@ typedef struct {
     ngx_int_t                     cached_rt;
 } ngx_http_sysguard_rt_ring_t;
 
+/* counters, the ratios are computed over the period of each guard */
+typedef struct {
+    uint64_t                      stamp;
+    ngx_cpuinfo_t                 cpu;
+    uint64_t                      pressure[3];
+    uint64_t                      nr_periods;
+    uint64_t                      nr_throttled;
+} ngx_http_sysguard_sample_t;
+
+typedef struct {
+    uint64_t                      stamp;
+
+    ngx_int_t                     load;
+    ngx_int_t                     swapstat;
+    size_t                        free;
+
+    ngx_uint_t                    current;
+    ngx_uint_t                    count;
+    ngx_uint_t                    nsamples;
+
+    /* the metrics found not provided by the system */
+    ngx_uint_t                    unavailable;
+
+    ngx_http_sysguard_sample_t    samples[1];
+} ngx_http_sysguard_shctx_t;
+
+typedef struct {
+    ngx_msec_t                    interval;
+    ngx_msec_t                    period;
+    ngx_uint_t                    metrics;
+
+    ngx_shm_zone_t               *shm_zone;
+    ngx_slab_pool_t              *shpool;
+    ngx_http_sysguard_shctx_t    *sh;
+} ngx_http_sysguard_main_conf_t;
+
 typedef struct {
     ngx_flag_t                    enable;
 
@@ -42,6 +90,12 @@ typedef struct {
     ngx_int_t                     rt;
     ngx_int_t                     rt_period;
     ngx_str_t                     rt_action;
+    ngx_int_t                     pressure[3];
+    ngx_msec_t                    pressure_period;
+    ngx_str_t                     pressure_action;
+    ngx_int_t                     throttled;
+    ngx_msec_t                    throttled_period;
+    ngx_str_t                     throttled_action;
     time_t                        interval;
     time_t                        cpu_interval;
 
@@ -52,6 +106,9 @@ typedef struct {
 } ngx_http_sysguard_conf_t;
 
 
+static ngx_int_t ngx_http_sysguard_init_process(ngx_cycle_t *cycle);
+static void *ngx_http_sysguard_create_main_conf(ngx_conf_t *cf);
+static char *ngx_http_sysguard_init_main_conf(ngx_conf_t *cf, void *conf);
 static void *ngx_http_sysguard_create_conf(ngx_conf_t *cf);
 static char *ngx_http_sysguard_merge_conf(ngx_conf_t *cf, void *parent,
     void *child);
@@ -63,6 +120,10 @@ static char *ngx_http_sysguard_mem(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_sysguard_rt(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
+static char *ngx_http_sysguard_psi(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_sysguard_cgroup(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static ngx_int_t ngx_http_sysguard_init(ngx_conf_t *cf);
 
 
@@ -125,6 +186,27 @@ static ngx_command_t  ngx_http_sysguard_commands[] = {
       0,
       NULL },
 
+    { ngx_string("sysguard_psi"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_http_sysguard_psi,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("sysguard_cgroup"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE123,
+      ngx_http_sysguard_cgroup,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("sysguard_sample_interval"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_sysguard_main_conf_t, interval),
+      NULL },
+
     { ngx_string("sysguard_interval"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_sec_slot,
@@ -147,8 +229,8 @@ static ngx_http_module_t  ngx_http_sysguard_module_ctx = {
     NULL,                                   /* preconfiguration */
     ngx_http_sysguard_init,                 /* postconfiguration */
 
-    NULL,                                   /* create main configuration */
-    NULL,                                   /* init main configuration */
+    ngx_http_sysguard_create_main_conf,     /* create main configuration */
+    ngx_http_sysguard_init_main_conf,       /* init main configuration */
 
     NULL,                                   /* create server configuration */
     NULL,                                   /* merge server configuration */
@@ -165,7 +247,7 @@ ngx_module_t  ngx_http_sysguard_module = {
     NGX_HTTP_MODULE,                        /* module type */
     NULL,                                   /* init master */
     NULL,                                   /* init module */
-    NULL,                                   /* init process */
+    ngx_http_sysguard_init_process,         /* init process */
     NULL,                                   /* init thread */
     NULL,                                   /* exit thread */
     NULL,                                   /* exit process */
@@ -174,125 +256,265 @@ ngx_module_t  ngx_http_sysguard_module = {
 };
 
 
-static time_t        ngx_http_sysguard_cached_load_exptime;
-static time_t        ngx_http_sysguard_cached_mem_exptime;
-static time_t        ngx_http_sysguard_cached_cpuusage_exptime;
-static time_t        ngx_http_sysguard_cached_cpuinfo_exptime;
-static ngx_int_t     ngx_http_sysguard_cached_load;
-static ngx_int_t     ngx_http_sysguard_cached_cpuusage;
-static ngx_cpuinfo_t ngx_http_sysguard_cached_pre_cputime;
-static ngx_cpuinfo_t ngx_http_sysguard_cached_cur_cputime;
-static ngx_int_t     ngx_http_sysguard_cached_swapstat;
-static size_t        ngx_http_sysguard_cached_free;
+static ngx_str_t  ngx_http_sysguard_pressure_names[] = {
+    ngx_string("cpu"),
+    ngx_string("memory"),
+    ngx_string("io")
+};
 
 
-static ngx_int_t
-ngx_http_sysguard_update_load(ngx_http_request_t *r, time_t exptime)
+static ngx_event_t  ngx_http_sysguard_sample_event;
+
+
+static uint64_t
+ngx_http_sysguard_now(void)
 {
-    ngx_int_t  load, rc;
+    ngx_time_t  *tp;
 
-    ngx_http_sysguard_cached_load_exptime = ngx_time() + exptime;
+    tp = ngx_timeofday();
 
-    rc = ngx_getloadavg(&load, 1, r->connection->log);
-    if (rc == NGX_ERROR) {
+    return (uint64_t) tp->sec * 1000 + tp->msec;
+}
 
-        ngx_http_sysguard_cached_load = 0;
 
-        return NGX_ERROR;
+static void
+ngx_http_sysguard_sample(ngx_http_sysguard_main_conf_t *smcf, uint64_t now,
+    ngx_log_t *log)
+{
+    ngx_int_t                    load, rc;
+    ngx_uint_t                   i, n, metrics;
+    ngx_meminfo_t                m;
+    ngx_pressure_t               pressure;
+    ngx_cgroupcpu_t              cgroup;
+    ngx_http_sysguard_shctx_t   *sh;
+    ngx_http_sysguard_sample_t  *sample;
+
+    static ngx_str_t  cpunumber = ngx_string("cpu");
+
+    sh = smcf->sh;
+
+    /* any worker may be the next to sample */
+
+    metrics = smcf->metrics & ~sh->unavailable;
+
+    if (metrics & NGX_HTTP_SYSGUARD_LOAD) {
+
+        if (ngx_getloadavg(&load, 1, log) != NGX_OK) {
+            load = 0;
+        }
+
+        sh->load = load;
     }
 
-    ngx_http_sysguard_cached_load = load;
+    if (metrics & NGX_HTTP_SYSGUARD_MEM) {
 
-    return NGX_OK;
+        if (ngx_getmeminfo(&m, log) == NGX_OK) {
+            sh->swapstat = m.totalswap == 0
+                ? 0 : (m.totalswap - m.freeswap) * 100 * 100 / m.totalswap;
+            sh->free = m.freeram + m.cachedram + m.bufferram;
+
+        } else {
+            sh->swapstat = 0;
+            sh->free = NGX_CONF_UNSET_SIZE;
+        }
+    }
+
+    /* the next slot is filled, then published */
+
+    n = (sh->current + 1) % sh->nsamples;
+    sample = &sh->samples[n];
+
+    ngx_memzero(sample, sizeof(ngx_http_sysguard_sample_t));
+
+    sample->stamp = now;
+
+    if (metrics & NGX_HTTP_SYSGUARD_CPU) {
+        (void) ngx_getcpuinfo(&cpunumber, &sample->cpu, log);
+    }
+
+    for (i = 0; i < 3; i++) {
+
+        if (!(metrics & (NGX_HTTP_SYSGUARD_PSI_CPU << i))) {
+            continue;
+        }
+
+        rc = ngx_getpressure(i, &pressure, log);
+
+        if (rc == NGX_DECLINED) {
+            ngx_log_error(NGX_LOG_WARN, log, 0,
+                          "sysguard %V pressure is not available",
+                          &ngx_http_sysguard_pressure_names[i]);
+
+            sh->unavailable |= NGX_HTTP_SYSGUARD_PSI_CPU << i;
+            continue;
+        }
+
+        sample->pressure[i] = pressure.some;
+    }
+
+    if (metrics & NGX_HTTP_SYSGUARD_CGROUP) {
+
+        rc = ngx_getcgroupcpu(&cgroup, log);
+
+        if (rc == NGX_DECLINED) {
+            ngx_log_error(NGX_LOG_WARN, log, 0,
+                          "sysguard cgroup v2 cpu.stat is not available");
+
+            sh->unavailable |= NGX_HTTP_SYSGUARD_CGROUP;
+
+        } else {
+            sample->nr_periods = cgroup.nr_periods;
+            sample->nr_throttled = cgroup.nr_throttled;
+        }
+    }
+
+    ngx_memory_barrier();
+
+    sh->current = n;
+
+    if (sh->count < sh->nsamples) {
+        sh->count++;
+    }
+
+    sh->stamp = now;
 }
 
 
-static ngx_int_t
-ngx_http_sysguard_update_cpuusage(ngx_http_request_t *r, time_t exptime)
+static void
+ngx_http_sysguard_sample_handler(ngx_event_t *ev)
 {
-    time_t         cpu_diff, total_diff;
-    ngx_cpuinfo_t  pre, cur;
+    uint64_t                        now;
+    ngx_msec_t                      due;
+    ngx_http_sysguard_main_conf_t  *smcf;
 
-    pre = ngx_http_sysguard_cached_pre_cputime;
-    cur = ngx_http_sysguard_cached_cur_cputime;
+    smcf = ev->data;
 
-    ngx_http_sysguard_cached_cpuusage_exptime = ngx_time() + exptime;
+    now = ngx_http_sysguard_now();
+    due = smcf->interval - smcf->interval / 10;
 
-    cpu_diff = (cur.usr + cur.nice + cur.sys) - (pre.usr + pre.nice + pre.sys);
+    /*
+     * every worker has the timer, the first one to find the samples
+     * out of date reads the system information for all of them
+     */
 
-    total_diff = (cur.usr + cur.nice + cur.sys + cur.iowait + cur.irq
-                 + cur.softirq + cur.idle)
-                 - (pre.usr + pre.nice + pre.sys + pre.iowait + pre.irq
-                 + pre.softirq + pre.idle);
+    if (now - smcf->sh->stamp >= due
+        && ngx_shmtx_trylock(&smcf->shpool->mutex))
+    {
+        if (now - smcf->sh->stamp >= due) {
+            ngx_http_sysguard_sample(smcf, now, ev->log);
+        }
 
-    if (total_diff == 0) {
-        total_diff = 1;
+        ngx_shmtx_unlock(&smcf->shpool->mutex);
     }
 
-    ngx_http_sysguard_cached_cpuusage = cpu_diff * 100 * 100 / total_diff;
-
-    return NGX_OK;
+    ngx_add_timer(ev, smcf->interval);
 }
 
 
-void
-ngx_http_sysguard_update_cpuinfo(ngx_http_request_t *r)
+static ngx_int_t
+ngx_http_sysguard_samples(ngx_http_sysguard_main_conf_t *smcf,
+    ngx_msec_t period, ngx_http_sysguard_sample_t **first,
+    ngx_http_sysguard_sample_t **last)
 {
-    ngx_int_t                       rc;
-    ngx_cpuinfo_t                   cpuinfo;
-    ngx_http_sysguard_conf_t       *glcf;
-    ngx_str_t                       cpunumber;
+    ngx_uint_t                  back, current, count;
+    ngx_http_sysguard_shctx_t  *sh;
 
-    ngx_str_set(&cpunumber, "cpu");
+    sh = smcf->sh;
 
-    glcf = ngx_http_get_module_loc_conf(r, ngx_http_sysguard_module);
+    current = sh->current;
+    count = sh->count;
 
-    if (!glcf->enable) {
-        return;
+    back = ngx_max(period / smcf->interval, 1);
+
+    if (back >= count) {
+        if (count < 2) {
+            return NGX_DECLINED;
+        }
+
+        back = count - 1;
     }
 
-    if (glcf->cpuusage == NGX_CONF_UNSET) {
-        return;
+    *first = &sh->samples[(current + sh->nsamples - back) % sh->nsamples];
+    *last = &sh->samples[current];
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_sysguard_get_cpuusage(ngx_http_sysguard_main_conf_t *smcf,
+    time_t period)
+{
+    time_t                       cpu_diff, total_diff;
+    ngx_cpuinfo_t               *pre, *cur;
+    ngx_http_sysguard_sample_t  *first, *last;
+
+    if (ngx_http_sysguard_samples(smcf, period * 1000, &first, &last)
+        != NGX_OK)
+    {
+        return 0;
     }
 
-    if (ngx_http_sysguard_cached_cpuinfo_exptime < ngx_time()) {
-        rc = ngx_getcpuinfo(&cpunumber, &cpuinfo, r->connection->log);
-        if (rc == NGX_ERROR) {
-            ngx_memzero(&cpuinfo, sizeof(ngx_cpuinfo_t));
-            return;
-        }
+    pre = &first->cpu;
+    cur = &last->cpu;
 
-        ngx_http_sysguard_cached_pre_cputime = ngx_http_sysguard_cached_cur_cputime;
-        ngx_http_sysguard_cached_cur_cputime = cpuinfo;
-        ngx_http_sysguard_cached_cpuinfo_exptime = ngx_time() + glcf->cpu_interval;
+    cpu_diff = (cur->usr + cur->nice + cur->sys)
+               - (pre->usr + pre->nice + pre->sys);
+
+    total_diff = (cur->usr + cur->nice + cur->sys + cur->iowait + cur->irq
+                 + cur->softirq + cur->idle)
+                 - (pre->usr + pre->nice + pre->sys + pre->iowait + pre->irq
+                 + pre->softirq + pre->idle);
+
+    if (total_diff == 0) {
+        total_diff = 1;
     }
 
-    return;
+    return cpu_diff * 100 * 100 / total_diff;
 }
 
 
 static ngx_int_t
-ngx_http_sysguard_update_mem(ngx_http_request_t *r, time_t exptime)
+ngx_http_sysguard_get_pressure(ngx_http_sysguard_main_conf_t *smcf,
+    ngx_uint_t resource, ngx_msec_t period)
 {
-    ngx_int_t      rc;
-    ngx_meminfo_t  m;
+    ngx_http_sysguard_sample_t  *first, *last;
 
-    ngx_http_sysguard_cached_mem_exptime = ngx_time() + exptime;
+    if (ngx_http_sysguard_samples(smcf, period, &first, &last) != NGX_OK
+        || last->stamp <= first->stamp
+        || last->pressure[resource] < first->pressure[resource])
+    {
+        return 0;
+    }
 
-    rc = ngx_getmeminfo(&m, r->connection->log);
-    if (rc == NGX_ERROR) {
+    /*
+     * the share of time some tasks stalled, stall time is in usec;
+     * it slightly exceeds 100% on a stall as the stamps are less precise
+     */
 
-        ngx_http_sysguard_cached_swapstat = 0;
-        ngx_http_sysguard_cached_free = NGX_CONF_UNSET_SIZE;
+    return ngx_min((last->pressure[resource] - first->pressure[resource])
+                   * 100 * 100 / ((last->stamp - first->stamp) * 1000),
+                   100 * 100);
+}
 
-        return NGX_ERROR;
+
+static ngx_int_t
+ngx_http_sysguard_get_throttled(ngx_http_sysguard_main_conf_t *smcf,
+    ngx_msec_t period)
+{
+    ngx_http_sysguard_sample_t  *first, *last;
+
+    if (ngx_http_sysguard_samples(smcf, period, &first, &last) != NGX_OK
+        || last->nr_periods <= first->nr_periods
+        || last->nr_throttled < first->nr_throttled)
+    {
+        return 0;
     }
 
-    ngx_http_sysguard_cached_swapstat = m.totalswap == 0
-        ? 0 : (m.totalswap - m.freeswap) * 100 / m.totalswap;
-    ngx_http_sysguard_cached_free = m.freeram + m.cachedram + m.bufferram;
+    /* the share of enforcement periods the cgroup was throttled in */
 
-    return NGX_OK;
+    return (last->nr_throttled - first->nr_throttled) * 100 * 100
+           / (last->nr_periods - first->nr_periods);
 }
 
 
@@ -447,11 +669,17 @@ ngx_http_sysguard_do_redirect(ngx_http_request_t *r, ngx_str_t *path)
 static ngx_int_t
 ngx_http_sysguard_handler(ngx_http_request_t *r)
 {
-    ngx_http_sysguard_conf_t  *glcf;
-    ngx_int_t                  load_log = 0, swap_log = 0,
-                               free_log = 0, rt_log = 0,
-                               cpu_log = 0;
-    ngx_str_t                 *action = NULL;
+    ngx_http_sysguard_conf_t       *glcf;
+    ngx_http_sysguard_main_conf_t  *smcf;
+    ngx_int_t                       load_log = 0, swap_log = 0,
+                                    free_log = 0, rt_log = 0,
+                                    cpu_log = 0, psi_log = 0,
+                                    cgroup_log = 0;
+    ngx_int_t                       load = 0, cpuusage = 0, swap = 0,
+                                    pressure = 0, throttled = 0;
+    size_t                          free = 0;
+    ngx_uint_t                      i, psi = 0;
+    ngx_str_t                      *action = NULL;
 
     if (r->main->sysguard_set) {
         return NGX_DECLINED;
@@ -465,28 +693,30 @@ ngx_http_sysguard_handler(ngx_http_request_t *r)
 
     r->main->sysguard_set = 1;
 
+    /* system information is sampled to the shared memory */
+
+    smcf = ngx_http_get_module_main_conf(r, ngx_http_sysguard_module);
+
     /* load */
 
     if (glcf->load != NGX_CONF_UNSET) {
 
-        if (ngx_http_sysguard_cached_load_exptime < ngx_time()) {
-            ngx_http_sysguard_update_load(r, glcf->interval);
-        }
+        load = smcf->sh->load;
 
         ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                        "http sysguard handler load: %1.3f %1.3f %V %V",
-                       ngx_http_sysguard_cached_load * 1.0 / 1000,
+                       load * 1.0 / 1000,
                        glcf->load * 1.0 / 1000,
                        &r->uri,
                        &glcf->load_action);
 
-        if (ngx_http_sysguard_cached_load > glcf->load) {
+        if (load > glcf->load) {
 
             if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_OR) {
 
                 ngx_log_error(glcf->log_level, r->connection->log, 0,
                               "sysguard load limited, current:%1.3f conf:%1.3f",
-                              ngx_http_sysguard_cached_load * 1.0 / 1000,
+                              load * 1.0 / 1000,
                               glcf->load * 1.0 / 1000);
 
                 return ngx_http_sysguard_do_redirect(r, &glcf->load_action);
@@ -505,24 +735,22 @@ ngx_http_sysguard_handler(ngx_http_request_t *r)
 
     if (glcf->cpuusage != NGX_CONF_UNSET) {
 
-        if (ngx_http_sysguard_cached_cpuusage_exptime < ngx_time()) {
-            ngx_http_sysguard_update_cpuusage(r, glcf->interval);
-        }
+        cpuusage = ngx_http_sysguard_get_cpuusage(smcf, glcf->cpu_interval);
 
         ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                        "http sysguard handler cpuusage: %d %d %V %V",
-                       ngx_http_sysguard_cached_cpuusage ,
+                       cpuusage,
                        glcf->cpuusage,
                        &r->uri,
                        &glcf->cpuusage_action);
 
-        if (ngx_http_sysguard_cached_cpuusage > glcf->cpuusage) {
+        if (cpuusage > glcf->cpuusage) {
 
             if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_OR) {
 
                 ngx_log_error(glcf->log_level, r->connection->log, 0,
                               "sysguard cpuusage limited, current:%d conf:%d",
-                              ngx_http_sysguard_cached_cpuusage,
+                              cpuusage,
                               glcf->cpuusage);
 
                 return ngx_http_sysguard_do_redirect(r, &glcf->cpuusage_action);
@@ -543,24 +771,22 @@ ngx_http_sysguard_handler(ngx_http_request_t *r)
 
     if (glcf->swap != NGX_CONF_UNSET) {
 
-        if (ngx_http_sysguard_cached_mem_exptime < ngx_time()) {
-            ngx_http_sysguard_update_mem(r, glcf->interval);
-        }
+        swap = smcf->sh->swapstat;
 
         ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                        "http sysguard handler swap: %i %i %V %V",
-                       ngx_http_sysguard_cached_swapstat,
+                       swap,
                        glcf->swap,
                        &r->uri,
                        &glcf->swap_action);
 
-        if (ngx_http_sysguard_cached_swapstat > glcf->swap) {
+        if (swap > glcf->swap) {
 
             if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_OR) {
 
                 ngx_log_error(glcf->log_level, r->connection->log, 0,
                               "sysguard swap limited, current:%i conf:%i",
-                              ngx_http_sysguard_cached_swapstat,
+                              swap,
                               glcf->swap);
 
                 return ngx_http_sysguard_do_redirect(r, &glcf->swap_action);
@@ -579,27 +805,25 @@ ngx_http_sysguard_handler(ngx_http_request_t *r)
 
     if (glcf->free != NGX_CONF_UNSET_SIZE) {
 
-        if (ngx_http_sysguard_cached_mem_exptime < ngx_time()) {
-            ngx_http_sysguard_update_mem(r, glcf->interval);
-        }
+        free = smcf->sh->free;
 
-        if (ngx_http_sysguard_cached_free != NGX_CONF_UNSET_SIZE) {
+        if (free != NGX_CONF_UNSET_SIZE) {
 
             ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "http sysguard handler free: %uz %uz %V %V",
-                           ngx_http_sysguard_cached_free,
+                           free,
                            glcf->free,
                            &r->uri,
                            &glcf->free_action);
 
-            if (ngx_http_sysguard_cached_free < glcf->free) {
+            if (free < glcf->free) {
 
                 if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_OR) {
 
                     ngx_log_error(glcf->log_level, r->connection->log, 0,
                                   "sysguard free limited, "
                                   "current:%uzM conf:%uzM",
-                                  ngx_http_sysguard_cached_free / 1024 / 1024,
+                                  free / 1024 / 1024,
                                   glcf->free / 1024 / 1024);
 
                     return ngx_http_sysguard_do_redirect(r, &glcf->free_action);
@@ -615,6 +839,93 @@ ngx_http_sysguard_handler(ngx_http_request_t *r)
         }
     }
 
+    /* pressure stall information, any of the resources */
+
+    for (i = 0; i < 3; i++) {
+
+        if (glcf->pressure[i] == NGX_CONF_UNSET) {
+            continue;
+        }
+
+        psi = 1;
+
+        pressure = ngx_http_sysguard_get_pressure(smcf, i,
+                                                  glcf->pressure_period);
+
+        ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http sysguard handler %V pressure: %i %i %V",
+                       &ngx_http_sysguard_pressure_names[i],
+                       pressure,
+                       glcf->pressure[i],
+                       &r->uri);
+
+        if (pressure > glcf->pressure[i]) {
+            break;
+        }
+    }
+
+    if (psi) {
+
+        if (i < 3) {
+
+            if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_OR) {
+
+                ngx_log_error(glcf->log_level, r->connection->log, 0,
+                              "sysguard %V pressure limited, "
+                              "current:%1.2f%% conf:%1.2f%%",
+                              &ngx_http_sysguard_pressure_names[i],
+                              pressure * 1.0 / 100,
+                              glcf->pressure[i] * 1.0 / 100);
+
+                return ngx_http_sysguard_do_redirect(r,
+                                                     &glcf->pressure_action);
+            } else {
+                action = &glcf->pressure_action;
+                psi_log = i + 1;
+            }
+        } else {
+            if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_AND) {
+                goto out;
+            }
+        }
+    }
+
+    /* cgroup cpu throttling */
+
+    if (glcf->throttled != NGX_CONF_UNSET) {
+
+        throttled = ngx_http_sysguard_get_throttled(smcf,
+                                                    glcf->throttled_period);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http sysguard handler throttled: %i %i %V",
+                       throttled,
+                       glcf->throttled,
+                       &r->uri);
+
+        if (throttled > glcf->throttled) {
+
+            if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_OR) {
+
+                ngx_log_error(glcf->log_level, r->connection->log, 0,
+                              "sysguard cgroup throttled limited, "
+                              "current:%1.2f%% conf:%1.2f%%",
+                              throttled * 1.0 / 100,
+                              glcf->throttled * 1.0 / 100);
+
+                return ngx_http_sysguard_do_redirect(r,
+                                                     &glcf->throttled_action);
+            } else {
+                action = &glcf->throttled_action;
+                cgroup_log = 1;
+            }
+        } else {
+            if (glcf->mode == NGX_HTTP_SYSGUARD_MODE_AND) {
+                goto out;
+            }
+        }
+    }
+
     /* response time */
 
     if (glcf->rt != NGX_CONF_UNSET) {
@@ -654,31 +965,48 @@ ngx_http_sysguard_handler(ngx_http_request_t *r)
         if (load_log) {
             ngx_log_error(glcf->log_level, r->connection->log, 0,
                           "sysguard load limited, current:%1.3f conf:%1.3f",
-                          ngx_http_sysguard_cached_load * 1.0 / 1000,
+                          load * 1.0 / 1000,
                           glcf->load * 1.0 / 1000);
         }
 
         if (cpu_log) {
             ngx_log_error(glcf->log_level, r->connection->log, 0,
                           "sysguard cpu limited, current:%d conf:%1d",
-                          ngx_http_sysguard_cached_cpuusage,
+                          cpuusage,
                           glcf->cpuusage);
         }
 
         if (swap_log) {
             ngx_log_error(glcf->log_level, r->connection->log, 0,
                           "sysguard swap limited, current:%i conf:%i",
-                          ngx_http_sysguard_cached_swapstat,
+                          swap,
                           glcf->swap);
         }
 
         if (free_log) {
             ngx_log_error(glcf->log_level, r->connection->log, 0,
                           "sysguard free limited, current:%uzM conf:%uzM",
-                          ngx_http_sysguard_cached_free / 1024 / 1024,
+                          free / 1024 / 1024,
                           glcf->free / 1024 / 1024);
         }
 
+        if (psi_log) {
+            ngx_log_error(glcf->log_level, r->connection->log, 0,
+                          "sysguard %V pressure limited, "
+                          "current:%1.2f%% conf:%1.2f%%",
+                          &ngx_http_sysguard_pressure_names[psi_log - 1],
+                          pressure * 1.0 / 100,
+                          glcf->pressure[psi_log - 1] * 1.0 / 100);
+        }
+
+        if (cgroup_log) {
+            ngx_log_error(glcf->log_level, r->connection->log, 0,
+                          "sysguard cgroup throttled limited, "
+                          "current:%1.2f%% conf:%1.2f%%",
+                          throttled * 1.0 / 100,
+                          glcf->throttled * 1.0 / 100);
+        }
+
         if (rt_log) {
             ngx_log_error(glcf->log_level, r->connection->log, 0,
                           "sysguard rt limited, current:%1.3f conf:%1.3f",
@@ -711,6 +1039,8 @@ ngx_http_sysguard_create_conf(ngx_conf_t *cf)
      *     conf->cpuusage_action = {0, NULL};
      *     conf->swap_action = {0, NULL};
      *     conf->rt_action = {0, NULL};
+     *     conf->pressure_action = {0, NULL};
+     *     conf->throttled_action = {0, NULL};
      *     conf->ring = NULL;
      */
 
@@ -721,6 +1051,12 @@ ngx_http_sysguard_create_conf(ngx_conf_t *cf)
     conf->free = NGX_CONF_UNSET_SIZE;
     conf->rt = NGX_CONF_UNSET;
     conf->rt_period = NGX_CONF_UNSET;
+    conf->pressure[NGX_PRESSURE_CPU] = NGX_CONF_UNSET;
+    conf->pressure[NGX_PRESSURE_MEMORY] = NGX_CONF_UNSET;
+    conf->pressure[NGX_PRESSURE_IO] = NGX_CONF_UNSET;
+    conf->pressure_period = NGX_CONF_UNSET_MSEC;
+    conf->throttled = NGX_CONF_UNSET;
+    conf->throttled_period = NGX_CONF_UNSET_MSEC;
     conf->interval = NGX_CONF_UNSET;
     conf->cpu_interval = NGX_CONF_UNSET;
     conf->log_level = NGX_CONF_UNSET_UINT;
@@ -736,18 +1072,36 @@ ngx_http_sysguard_merge_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_http_sysguard_conf_t  *prev = parent;
     ngx_http_sysguard_conf_t  *conf = child;
 
+    ngx_uint_t                      i;
+    ngx_http_sysguard_main_conf_t  *smcf;
+
     ngx_conf_merge_value(conf->enable, prev->enable, 0);
     ngx_conf_merge_str_value(conf->load_action, prev->load_action, "");
     ngx_conf_merge_str_value(conf->cpuusage_action, prev->cpuusage_action, "");
     ngx_conf_merge_str_value(conf->swap_action, prev->swap_action, "");
     ngx_conf_merge_str_value(conf->free_action, prev->free_action, "");
     ngx_conf_merge_str_value(conf->rt_action, prev->rt_action, "");
+    ngx_conf_merge_str_value(conf->pressure_action, prev->pressure_action,
+                             "");
+    ngx_conf_merge_str_value(conf->throttled_action, prev->throttled_action,
+                             "");
     ngx_conf_merge_value(conf->load, prev->load, NGX_CONF_UNSET);
     ngx_conf_merge_value(conf->cpuusage, prev->cpuusage, NGX_CONF_UNSET);
     ngx_conf_merge_value(conf->swap, prev->swap, NGX_CONF_UNSET);
     ngx_conf_merge_size_value(conf->free, prev->free, NGX_CONF_UNSET_SIZE);
     ngx_conf_merge_value(conf->rt, prev->rt, NGX_CONF_UNSET);
     ngx_conf_merge_value(conf->rt_period, prev->rt_period, 1);
+    ngx_conf_merge_value(conf->pressure[NGX_PRESSURE_CPU],
+                         prev->pressure[NGX_PRESSURE_CPU], NGX_CONF_UNSET);
+    ngx_conf_merge_value(conf->pressure[NGX_PRESSURE_MEMORY],
+                         prev->pressure[NGX_PRESSURE_MEMORY], NGX_CONF_UNSET);
+    ngx_conf_merge_value(conf->pressure[NGX_PRESSURE_IO],
+                         prev->pressure[NGX_PRESSURE_IO], NGX_CONF_UNSET);
+    ngx_conf_merge_msec_value(conf->pressure_period, prev->pressure_period,
+                              1000);
+    ngx_conf_merge_value(conf->throttled, prev->throttled, NGX_CONF_UNSET);
+    ngx_conf_merge_msec_value(conf->throttled_period, prev->throttled_period,
+                              1000);
     ngx_conf_merge_value(conf->interval, prev->interval, 1);
     ngx_conf_merge_value(conf->cpu_interval, prev->cpu_interval, 3);
     ngx_conf_merge_uint_value(conf->log_level, prev->log_level, NGX_LOG_ERR);
@@ -774,10 +1128,167 @@ ngx_http_sysguard_merge_conf(ngx_conf_t *cf, void *parent, void *child)
         conf->rt_ring->slots[0].stamp = ngx_time();
     }
 
+    if (!conf->enable) {
+        return NGX_CONF_OK;
+    }
+
+    /* the sampler reads what any enabled guard needs */
+
+    smcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_sysguard_module);
+
+    if (conf->load != NGX_CONF_UNSET) {
+        smcf->metrics |= NGX_HTTP_SYSGUARD_LOAD;
+    }
+
+    if (conf->cpuusage != NGX_CONF_UNSET) {
+        smcf->metrics |= NGX_HTTP_SYSGUARD_CPU;
+        smcf->period = ngx_max(smcf->period,
+                               (ngx_msec_t) conf->cpu_interval * 1000);
+    }
+
+    if (conf->swap != NGX_CONF_UNSET || conf->free != NGX_CONF_UNSET_SIZE) {
+        smcf->metrics |= NGX_HTTP_SYSGUARD_MEM;
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (conf->pressure[i] != NGX_CONF_UNSET) {
+            smcf->metrics |= NGX_HTTP_SYSGUARD_PSI_CPU << i;
+            smcf->period = ngx_max(smcf->period, conf->pressure_period);
+        }
+    }
+
+    if (conf->throttled != NGX_CONF_UNSET) {
+        smcf->metrics |= NGX_HTTP_SYSGUARD_CGROUP;
+        smcf->period = ngx_max(smcf->period, conf->throttled_period);
+    }
+
     return NGX_CONF_OK;
 }
 
 
+static void *
+ngx_http_sysguard_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_sysguard_main_conf_t  *smcf;
+
+    smcf = ngx_pcalloc(cf->pool, sizeof(ngx_http_sysguard_main_conf_t));
+    if (smcf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     smcf->period = 0;
+     *     smcf->metrics = 0;
+     *     smcf->shm_zone = NULL;
+     */
+
+    smcf->interval = NGX_CONF_UNSET_MSEC;
+
+    return smcf;
+}
+
+
+static char *
+ngx_http_sysguard_init_main_conf(ngx_conf_t *cf, void *conf)
+{
+    ngx_http_sysguard_main_conf_t  *smcf = conf;
+
+    ngx_conf_init_msec_value(smcf->interval, 100);
+
+    if (smcf->interval == 0) {
+        return "\"sysguard_sample_interval\" must be greater than 0";
+    }
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_sysguard_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_sysguard_main_conf_t  *osmcf = data;
+
+    size_t                          size;
+    ngx_uint_t                      nsamples;
+    ngx_http_sysguard_main_conf_t  *smcf;
+
+    smcf = shm_zone->data;
+
+    nsamples = smcf->period / smcf->interval + 2;
+
+    if (osmcf) {
+        smcf->shpool = osmcf->shpool;
+
+        if (osmcf->sh->nsamples == nsamples) {
+            smcf->sh = osmcf->sh;
+
+            /* the metrics are tried again after a reload */
+            smcf->sh->unavailable = 0;
+
+            return NGX_OK;
+        }
+
+        ngx_slab_free(smcf->shpool, osmcf->sh);
+
+    } else {
+        smcf->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+        if (shm_zone->shm.exists) {
+            smcf->sh = smcf->shpool->data;
+            return NGX_OK;
+        }
+    }
+
+    size = sizeof(ngx_http_sysguard_shctx_t)
+           + (nsamples - 1) * sizeof(ngx_http_sysguard_sample_t);
+
+    smcf->sh = ngx_slab_calloc(smcf->shpool, size);
+    if (smcf->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    smcf->sh->nsamples = nsamples;
+    smcf->sh->current = nsamples - 1;
+    smcf->sh->free = NGX_CONF_UNSET_SIZE;
+
+    smcf->shpool->data = smcf->sh;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_sysguard_init_process(ngx_cycle_t *cycle)
+{
+    ngx_event_t                    *ev;
+    ngx_http_sysguard_main_conf_t  *smcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    smcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_sysguard_module);
+    if (smcf == NULL || smcf->shm_zone == NULL) {
+        return NGX_OK;
+    }
+
+    ev = &ngx_http_sysguard_sample_event;
+
+    ev->handler = ngx_http_sysguard_sample_handler;
+    ev->data = smcf;
+    ev->log = cycle->log;
+    ev->cancelable = 1;
+
+    ngx_http_sysguard_sample_handler(ev);
+
+    return NGX_OK;
+}
+
+
 static char *
 ngx_http_sysguard_load(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -1089,11 +1600,191 @@ invalid:
 }
 
 
+static char *
+ngx_http_sysguard_psi(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_sysguard_conf_t  *glcf = conf;
+
+    size_t      len;
+    ngx_str_t  *value, *name, ss;
+    ngx_uint_t  i, n;
+
+    value = cf->args->elts;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        for (n = 0; n < 3; n++) {
+            name = &ngx_http_sysguard_pressure_names[n];
+
+            if (value[i].len > name->len
+                && ngx_strncmp(value[i].data, name->data, name->len) == 0
+                && value[i].data[name->len] == '=')
+            {
+                break;
+            }
+        }
+
+        if (n < 3) {
+
+            if (glcf->pressure[n] != NGX_CONF_UNSET) {
+                return "is duplicate";
+            }
+
+            len = ngx_http_sysguard_pressure_names[n].len + 1;
+
+            if (value[i].len == len
+                || value[i].data[value[i].len - 1] != '%')
+            {
+                goto invalid;
+            }
+
+            glcf->pressure[n] = ngx_atofp(value[i].data + len,
+                                          value[i].len - len - 1, 2);
+            if (glcf->pressure[n] == NGX_ERROR) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "period=", 7) == 0) {
+
+            ss.data = value[i].data + 7;
+            ss.len = value[i].len - 7;
+
+            glcf->pressure_period = ngx_parse_time(&ss, 0);
+            if (glcf->pressure_period == (ngx_msec_t) NGX_ERROR
+                || glcf->pressure_period == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "action=", 7) == 0) {
+
+            if (value[i].len == 7) {
+                goto invalid;
+            }
+
+            if (value[i].data[7] != '/' && value[i].data[7] != '@') {
+                goto invalid;
+            }
+
+            glcf->pressure_action.data = value[i].data + 7;
+            glcf->pressure_action.len = value[i].len - 7;
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    if (glcf->pressure[NGX_PRESSURE_CPU] == NGX_CONF_UNSET
+        && glcf->pressure[NGX_PRESSURE_MEMORY] == NGX_CONF_UNSET
+        && glcf->pressure[NGX_PRESSURE_IO] == NGX_CONF_UNSET)
+    {
+        return "requires \"cpu\", \"memory\" or \"io\" parameter";
+    }
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
+static char *
+ngx_http_sysguard_cgroup(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_sysguard_conf_t  *glcf = conf;
+
+    ngx_str_t  *value, ss;
+    ngx_uint_t  i;
+
+    value = cf->args->elts;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "throttled=", 10) == 0) {
+
+            if (glcf->throttled != NGX_CONF_UNSET) {
+                return "is duplicate";
+            }
+
+            if (value[i].len == 10
+                || value[i].data[value[i].len - 1] != '%')
+            {
+                goto invalid;
+            }
+
+            glcf->throttled = ngx_atofp(value[i].data + 10,
+                                        value[i].len - 11, 2);
+            if (glcf->throttled == NGX_ERROR) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "period=", 7) == 0) {
+
+            ss.data = value[i].data + 7;
+            ss.len = value[i].len - 7;
+
+            glcf->throttled_period = ngx_parse_time(&ss, 0);
+            if (glcf->throttled_period == (ngx_msec_t) NGX_ERROR
+                || glcf->throttled_period == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "action=", 7) == 0) {
+
+            if (value[i].len == 7) {
+                goto invalid;
+            }
+
+            if (value[i].data[7] != '/' && value[i].data[7] != '@') {
+                goto invalid;
+            }
+
+            glcf->throttled_action.data = value[i].data + 7;
+            glcf->throttled_action.len = value[i].len - 7;
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    if (glcf->throttled == NGX_CONF_UNSET) {
+        return "requires \"throttled\" parameter";
+    }
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
 static ngx_int_t
 ngx_http_sysguard_log_handler(ngx_http_request_t *r)
 {
     ngx_http_sysguard_update_rt_node(r);
-    ngx_http_sysguard_update_cpuinfo(r);
     return NGX_OK;
 }
 
@@ -1101,8 +1792,12 @@ ngx_http_sysguard_log_handler(ngx_http_request_t *r)
 static ngx_int_t
 ngx_http_sysguard_init(ngx_conf_t *cf)
 {
-    ngx_http_handler_pt        *h;
-    ngx_http_core_main_conf_t  *cmcf;
+    size_t                          size;
+    ngx_http_handler_pt            *h;
+    ngx_http_core_main_conf_t      *cmcf;
+    ngx_http_sysguard_main_conf_t  *smcf;
+
+    static ngx_str_t  name = ngx_string("sysguard");
 
     cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
 
@@ -1120,5 +1815,26 @@ ngx_http_sysguard_init(ngx_conf_t *cf)
 
     *h = ngx_http_sysguard_log_handler;
 
+    smcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_sysguard_module);
+
+    if (smcf->metrics == 0) {
+        return NGX_OK;
+    }
+
+    size = sizeof(ngx_http_sysguard_shctx_t)
+           + (smcf->period / smcf->interval + 1)
+             * sizeof(ngx_http_sysguard_sample_t);
+
+    size = ngx_align(size, ngx_pagesize) + 8 * ngx_pagesize;
+
+    smcf->shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                           &ngx_http_sysguard_module);
+    if (smcf->shm_zone == NULL) {
+        return NGX_ERROR;
+    }
+
+    smcf->shm_zone->init = ngx_http_sysguard_init_zone;
+    smcf->shm_zone->data = smcf;
+
     return NGX_OK;
 }
@@ -20,6 +20,9 @@
 
 #define NGX_HTTP_TFS_BLOCK_CACHE_STAT_COUNT  (3000 * 60 * 60)
 
+/* power of two, each shard has its own lock, hash buckets and LRU queue */
+#define NGX_HTTP_TFS_BLOCK_CACHE_SHARDS 64
+
 #define NGX_HTTP_TFS_NO_BLOCK_CACHE      0x0
 #define NGX_HTTP_TFS_LOCAL_BLOCK_CACHE   0x1
 #define NGX_HTTP_TFS_REMOTE_BLOCK_CACHE  0x2
@@ -43,13 +46,24 @@ typedef struct {
 } ngx_http_tfs_block_cache_kv_t;
 
 
+typedef struct ngx_http_tfs_block_cache_node_s
+    ngx_http_tfs_block_cache_node_t;
+
+
 typedef struct {
-    ngx_rbtree_t                         rbtree;
-    ngx_rbtree_node_t                    sentinel;
+    ngx_shmtx_sh_t                       lock;
+    ngx_shmtx_t                          mutex;
+    ngx_http_tfs_block_cache_node_t    **buckets;
     ngx_queue_t                          queue;
-    uint64_t                             discard_item_count;
     uint64_t                             hit_count;
     uint64_t                             miss_count;
+} ngx_http_tfs_block_cache_shard_t;
+
+
+typedef struct {
+    ngx_http_tfs_block_cache_shard_t    shards[NGX_HTTP_TFS_BLOCK_CACHE_SHARDS];
+    ngx_uint_t                           bucket_mask;
+    uint64_t                             discard_item_count;
 } ngx_http_tfs_block_cache_shctx_t;
 
 
@@ -7,15 +7,50 @@
 #include <ngx_http_tfs_local_block_cache.h>
 
 
-static void ngx_http_tfs_local_block_cache_rbtree_insert_value(
-    ngx_rbtree_node_t *temp, ngx_rbtree_node_t *node,
-    ngx_rbtree_node_t *sentinel);
+#define ngx_http_tfs_local_block_cache_shard(sh, hash)                       \
+    (&(sh)->shards[(hash) & (NGX_HTTP_TFS_BLOCK_CACHE_SHARDS - 1)])
+
+#define ngx_http_tfs_local_block_cache_bucket(sh, shard, hash)               \
+    (&(shard)->buckets[((hash) / NGX_HTTP_TFS_BLOCK_CACHE_SHARDS)            \
+                       & (sh)->bucket_mask])
+
+
+typedef struct {
+    uint32_t                                hash;
+    ngx_http_tfs_block_cache_key_t         *key;
+} ngx_http_tfs_block_cache_hkey_t;
+
+
+static ngx_http_tfs_block_cache_node_t **ngx_http_tfs_local_block_cache_find(
+    ngx_http_tfs_block_cache_shctx_t *sh,
+    ngx_http_tfs_block_cache_shard_t *shard, uint32_t hash,
+    ngx_http_tfs_block_cache_key_t *key);
+static void ngx_http_tfs_local_block_cache_free(
+    ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_node_t **link);
+static void ngx_http_tfs_local_block_cache_expire(
+    ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_shard_t *locked);
+static void ngx_http_tfs_local_block_cache_discard(
+    ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_shard_t *shard);
+static ngx_int_t ngx_http_tfs_local_block_cache_copy(ngx_pool_t *pool,
+    ngx_http_tfs_block_cache_node_t *bcn,
+    ngx_http_tfs_block_cache_value_t *value);
+static void ngx_http_tfs_local_block_cache_stat(
+    ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_shard_t *shard, ngx_log_t *log);
+static int ngx_libc_cdecl ngx_http_tfs_local_block_cache_cmp_shard(
+    const void *one, const void *two);
 
 
 ngx_int_t
 ngx_http_tfs_local_block_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 {
+    u_char                                *file;
     size_t                                 len;
+    ngx_uint_t                             i, n;
+    ngx_http_tfs_block_cache_shard_t      *shard;
     ngx_http_tfs_local_block_cache_ctx_t  *ctx;
     ngx_http_tfs_local_block_cache_ctx_t  *octx = data;
 
@@ -36,22 +71,61 @@ ngx_http_tfs_local_block_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
         return NGX_OK;
     }
 
-    ctx->sh = ngx_slab_alloc(ctx->shpool,
-                             sizeof(ngx_http_tfs_block_cache_shctx_t));
+    ctx->sh = ngx_slab_calloc(ctx->shpool,
+                              sizeof(ngx_http_tfs_block_cache_shctx_t));
     if (ctx->sh == NULL) {
         return NGX_ERROR;
     }
 
-    ctx->sh->discard_item_count = NGX_HTTP_TFS_BLOCK_CACHE_DISCARD_ITEM_COUNT;
-    ctx->sh->hit_count = 0;
-    ctx->sh->miss_count = 0;
+    ctx->sh->discard_item_count = NGX_HTTP_TFS_BLOCK_CACHE_DISCARD_ITEM_COUNT
+                                  / NGX_HTTP_TFS_BLOCK_CACHE_SHARDS;
+
+    /*
+     * about one bucket per 128 bytes of the zone, the usual size
+     * of a cached block with its dataservers
+     */
+
+    n = shm_zone->shm.size / 128 / NGX_HTTP_TFS_BLOCK_CACHE_SHARDS;
+
+    for (i = 1; i * 2 <= n; i *= 2) { /* void */ }
+
+    ctx->sh->bucket_mask = i - 1;
 
     ctx->shpool->data = ctx->sh;
 
-    ngx_rbtree_init(&ctx->sh->rbtree, &ctx->sh->sentinel,
-                    ngx_http_tfs_local_block_cache_rbtree_insert_value);
+#if (NGX_HAVE_ATOMIC_OPS)
+
+    file = NULL;
+
+#else
+
+    file = ngx_pnalloc(ngx_cycle->pool, ngx_cycle->lock_file.len
+                                        + shm_zone->shm.name.len);
+    if (file == NULL) {
+        return NGX_ERROR;
+    }
+
+    (void) ngx_sprintf(file, "%V%V%Z", &ngx_cycle->lock_file,
+                       &shm_zone->shm.name);
 
-    ngx_queue_init(&ctx->sh->queue);
+#endif
+
+    for (i = 0; i < NGX_HTTP_TFS_BLOCK_CACHE_SHARDS; i++) {
+        shard = &ctx->sh->shards[i];
+
+        if (ngx_shmtx_create(&shard->mutex, &shard->lock, file) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        shard->buckets = ngx_slab_calloc(ctx->shpool,
+                                         (ctx->sh->bucket_mask + 1)
+                                   * sizeof(ngx_http_tfs_block_cache_node_t *));
+        if (shard->buckets == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_queue_init(&shard->queue);
+    }
 
     len = sizeof(" in tfs block cache zone \"\"") + shm_zone->shm.name.len;
 
@@ -67,42 +141,26 @@ ngx_http_tfs_local_block_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 }
 
 
-void
-ngx_http_tfs_local_block_cache_rbtree_insert_value(ngx_rbtree_node_t *temp,
-    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
+static ngx_http_tfs_block_cache_node_t **
+ngx_http_tfs_local_block_cache_find(ngx_http_tfs_block_cache_shctx_t *sh,
+    ngx_http_tfs_block_cache_shard_t *shard, uint32_t hash,
+    ngx_http_tfs_block_cache_key_t *key)
 {
-    ngx_rbtree_node_t                **p;
-    ngx_http_tfs_block_cache_node_t  *tbn, *tbnt;
-
-    for ( ;; ) {
-
-        if (node->key < temp->key) {
-            p = &temp->left;
+    ngx_http_tfs_block_cache_node_t  **link;
 
-        } else if (node->key > temp->key) {
-            p = &temp->right;
+    link = ngx_http_tfs_local_block_cache_bucket(sh, shard, hash);
 
-        } else {
-            /* node->key == temp->key */
-            tbn = (ngx_http_tfs_block_cache_node_t *) &node->color;
-            tbnt = (ngx_http_tfs_block_cache_node_t *) &temp->color;
-
-            p = (ngx_http_tfs_block_cache_cmp(&tbn->key, &tbnt->key) < 0)
-                 ? &temp->left : &temp->right;
-        }
-
-        if (*p == sentinel) {
+    while (*link) {
+        if ((*link)->hash == hash
+            && ngx_http_tfs_block_cache_cmp(key, &(*link)->key) == 0)
+        {
             break;
         }
 
-        temp = *p;
+        link = &(*link)->next;
     }
 
-    *p = node;
-    node->parent = temp;
-    node->left = sentinel;
-    node->right = sentinel;
-    ngx_rbt_red(node);
+    return link;
 }
 
 
@@ -111,77 +169,45 @@ ngx_http_tfs_local_block_cache_lookup(ngx_http_tfs_local_block_cache_ctx_t *ctx,
     ngx_pool_t *pool, ngx_log_t *log, ngx_http_tfs_block_cache_key_t* key,
     ngx_http_tfs_block_cache_value_t *value)
 {
-    double                            hit_ratio;
-    ngx_int_t                         rc;
-    ngx_uint_t                        hash;
-    ngx_slab_pool_t                  *shpool;
-    ngx_rbtree_node_t                *node, *sentinel;
-    ngx_http_tfs_block_cache_node_t  *bcn;
+    uint32_t                           hash;
+    ngx_int_t                          rc;
+    ngx_http_tfs_block_cache_node_t   *bcn;
+    ngx_http_tfs_block_cache_shard_t  *shard;
 
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
                    "lookup local block cache, ns addr: %uL, block id: %uD",
                    key->ns_addr, key->block_id);
 
-    shpool = ctx->shpool;
-    ngx_shmtx_lock(&shpool->mutex);
+    hash = ngx_murmur_hash2((u_char*)key, NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+    shard = ngx_http_tfs_local_block_cache_shard(ctx->sh, hash);
 
-    node = ctx->sh->rbtree.root;
-    sentinel = ctx->sh->rbtree.sentinel;
+    ngx_shmtx_lock(&shard->mutex);
 
-    hash = ngx_murmur_hash2((u_char*)key, NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+    bcn = *ngx_http_tfs_local_block_cache_find(ctx->sh, shard, hash, key);
 
-    while (node != sentinel) {
+    if (bcn == NULL) {
+        shard->miss_count++;
+        ngx_shmtx_unlock(&shard->mutex);
 
-        if (hash < node->key) {
-            node = node->left;
-            continue;
-        }
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
+                       "lookup local block cache, "
+                       "ns addr: %uL, block id: %uD not found",
+                       key->ns_addr, key->block_id);
 
-        if (hash > node->key) {
-            node = node->right;
-            continue;
-        }
+        return NGX_DECLINED;
+    }
 
-        /* hash == node->key */
-        bcn = (ngx_http_tfs_block_cache_node_t *) &node->color;
-        rc = ngx_http_tfs_block_cache_cmp(key, &bcn->key);
-        if (rc == 0) {
-            value->ds_count = bcn->count;
-            value->ds_addrs = ngx_pcalloc(pool,
-                                          value->ds_count * sizeof(uint64_t));
-            if (value->ds_addrs == NULL) {
-                ngx_shmtx_unlock(&shpool->mutex);
-                return NGX_ERROR;
-            }
-            ngx_memcpy(value->ds_addrs, bcn->data,
-                       value->ds_count * sizeof(uint64_t));
-            ngx_queue_remove(&bcn->queue);
-            ngx_queue_insert_head(&ctx->sh->queue, &bcn->queue);
-            ctx->sh->hit_count++;
-            if (ctx->sh->hit_count >= NGX_HTTP_TFS_BLOCK_CACHE_STAT_COUNT) {
-                hit_ratio = 100 * (double)((double)ctx->sh->hit_count
-                                           / (double)(ctx->sh->hit_count
-                                                      + ctx->sh->miss_count));
-                ngx_log_error(NGX_LOG_INFO, log, 0,
-                              "local block cache hit_ratio: %.2f%%",
-                              hit_ratio);
-                ctx->sh->hit_count = 0;
-                ctx->sh->miss_count = 0;
-            }
-            ngx_shmtx_unlock(&shpool->mutex);
-            return NGX_OK;
-        }
-        node = (rc < 0) ? node->left : node->right;
+    rc = ngx_http_tfs_local_block_cache_copy(pool, bcn, value);
+    if (rc == NGX_OK) {
+        ngx_queue_remove(&bcn->queue);
+        ngx_queue_insert_head(&shard->queue, &bcn->queue);
+        shard->hit_count++;
+        ngx_http_tfs_local_block_cache_stat(ctx, shard, log);
     }
-    ctx->sh->miss_count++;
-    ngx_shmtx_unlock(&shpool->mutex);
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
-                   "lookup local block cache, "
-                   "ns addr: %uL, block id: %uD not found",
-                   key->ns_addr, key->block_id);
+    ngx_shmtx_unlock(&shard->mutex);
 
-    return NGX_DECLINED;
+    return rc;
 }
 
 
@@ -190,46 +216,52 @@ ngx_http_tfs_local_block_cache_insert(ngx_http_tfs_local_block_cache_ctx_t *ctx,
     ngx_log_t *log, ngx_http_tfs_block_cache_key_t *key,
     ngx_http_tfs_block_cache_value_t *value)
 {
-    size_t                            n;
-    ngx_slab_pool_t                  *shpool;
-    ngx_rbtree_node_t                *node;
-    ngx_http_tfs_block_cache_node_t  *bcn;
+    size_t                             n;
+    uint32_t                           hash;
+    ngx_http_tfs_block_cache_node_t   *bcn, **link;
+    ngx_http_tfs_block_cache_shard_t  *shard;
 
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
                    "insert local block cache, ns addr: %uL, block id: %uD",
                    key->ns_addr, key->block_id);
 
-    shpool = ctx->shpool;
-
-    ngx_shmtx_lock(&shpool->mutex);
+    hash = ngx_murmur_hash2((u_char*)key, NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+    shard = ngx_http_tfs_local_block_cache_shard(ctx->sh, hash);
 
-    n = offsetof(ngx_rbtree_node_t, color)
-        + offsetof(ngx_http_tfs_block_cache_node_t, data)
+    n = offsetof(ngx_http_tfs_block_cache_node_t, data)
         + value->ds_count * sizeof(uint64_t);
 
-    node = ngx_slab_alloc_locked(shpool, n);
-    if (node == NULL) { // full, discard
-        ngx_http_tfs_local_block_cache_discard(ctx);
-        node = ngx_slab_alloc_locked(shpool, n);
-        if (node == NULL) {
-            ngx_shmtx_unlock(&shpool->mutex);
+    ngx_shmtx_lock(&shard->mutex);
+
+    /* an entry of the block is replaced */
+
+    link = ngx_http_tfs_local_block_cache_find(ctx->sh, shard, hash, key);
+    if (*link) {
+        ngx_http_tfs_local_block_cache_free(ctx, link);
+    }
+
+    bcn = ngx_slab_alloc(ctx->shpool, n);
+    if (bcn == NULL) { // full, discard
+        ngx_http_tfs_local_block_cache_expire(ctx, shard);
+        bcn = ngx_slab_alloc(ctx->shpool, n);
+        if (bcn == NULL) {
+            ngx_shmtx_unlock(&shard->mutex);
             return NGX_ERROR;
         }
     }
 
-    bcn = (ngx_http_tfs_block_cache_node_t *) &node->color;
-
-    node->key = ngx_murmur_hash2((u_char*)key,
-                                 NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+    bcn->hash = hash;
     ngx_memcpy(&bcn->key, key, NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
-    bcn->len = (u_char) value->ds_count * sizeof(uint64_t);
     bcn->count = value->ds_count;
-    ngx_memcpy(bcn->data, value->ds_addrs, bcn->len);
+    ngx_memcpy(bcn->data, value->ds_addrs, value->ds_count * sizeof(uint64_t));
+
+    link = ngx_http_tfs_local_block_cache_bucket(ctx->sh, shard, hash);
+    bcn->next = *link;
+    *link = bcn;
 
-    ngx_rbtree_insert(&(ctx->sh->rbtree), node);
-    ngx_queue_insert_head(&ctx->sh->queue, &bcn->queue);
+    ngx_queue_insert_head(&shard->queue, &bcn->queue);
 
-    ngx_shmtx_unlock(&shpool->mutex);
+    ngx_shmtx_unlock(&shard->mutex);
 
     return NGX_OK;
 }
@@ -239,52 +271,27 @@ void
 ngx_http_tfs_local_block_cache_remove(ngx_http_tfs_local_block_cache_ctx_t *ctx,
     ngx_log_t *log, ngx_http_tfs_block_cache_key_t* key)
 {
-    ngx_int_t                         rc;
-    ngx_uint_t                        hash;
-    ngx_slab_pool_t                  *shpool;
-    ngx_rbtree_node_t                *node, *sentinel;
-    ngx_http_tfs_block_cache_node_t  *bcn;
+    uint32_t                           hash;
+    ngx_http_tfs_block_cache_node_t  **link;
+    ngx_http_tfs_block_cache_shard_t  *shard;
 
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
                    "remove local block cache, ns addr: %uL, block id: %uD",
                    key->ns_addr, key->block_id);
 
-    shpool = ctx->shpool;
-    ngx_shmtx_lock(&shpool->mutex);
-
-    node = ctx->sh->rbtree.root;
-    sentinel = ctx->sh->rbtree.sentinel;
-
     hash = ngx_murmur_hash2((u_char*)key, NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+    shard = ngx_http_tfs_local_block_cache_shard(ctx->sh, hash);
 
-    while (node != sentinel) {
-
-        if (hash < node->key) {
-            node = node->left;
-            continue;
-        }
-
-        if (hash > node->key) {
-            node = node->right;
-            continue;
-        }
+    ngx_shmtx_lock(&shard->mutex);
 
-        /* hash == node->key */
-        do {
-            bcn = (ngx_http_tfs_block_cache_node_t *) &node->color;
-            rc = ngx_http_tfs_block_cache_cmp(key, &bcn->key);
-            if (rc == 0) {
-                ngx_rbtree_delete(&ctx->sh->rbtree, node);
-                ngx_slab_free_locked(ctx->shpool, node);
-                ngx_queue_remove(&bcn->queue);
-                ngx_shmtx_unlock(&shpool->mutex);
-                return;
-            }
-            node = (rc < 0) ? node->left : node->right;
-        } while (node != sentinel && hash == node->key);
-        break;
+    link = ngx_http_tfs_local_block_cache_find(ctx->sh, shard, hash, key);
+    if (*link) {
+        ngx_http_tfs_local_block_cache_free(ctx, link);
+        ngx_shmtx_unlock(&shard->mutex);
+        return;
     }
-    ngx_shmtx_unlock(&shpool->mutex);
+
+    ngx_shmtx_unlock(&shard->mutex);
 
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
                    "remove local block cache, "
@@ -294,43 +301,126 @@ ngx_http_tfs_local_block_cache_remove(ngx_http_tfs_local_block_cache_ctx_t *ctx,
 }
 
 
-void
-ngx_http_tfs_local_block_cache_discard(
-    ngx_http_tfs_local_block_cache_ctx_t *ctx)
+static void
+ngx_http_tfs_local_block_cache_free(ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_node_t **link)
 {
-    ngx_uint_t                        i;
-    ngx_queue_t                      *q, *h, *p;
-    ngx_rbtree_node_t                *node;
     ngx_http_tfs_block_cache_node_t  *bcn;
 
-    h = &ctx->sh->queue;
-    if (ngx_queue_empty(h)) {
-        return;
+    bcn = *link;
+    *link = bcn->next;
+
+    ngx_queue_remove(&bcn->queue);
+    ngx_slab_free(ctx->shpool, bcn);
+}
+
+
+static void
+ngx_http_tfs_local_block_cache_expire(ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_shard_t *locked)
+{
+    ngx_uint_t                         i;
+    ngx_http_tfs_block_cache_shard_t  *shard;
+
+    /*
+     * the slab pages are shared by all shards, so the oldest entries
+     * of every shard are discarded; the shards busy in other workers
+     * are skipped rather than waited for
+     */
+
+    for (i = 0; i < NGX_HTTP_TFS_BLOCK_CACHE_SHARDS; i++) {
+        shard = &ctx->sh->shards[i];
+
+        if (shard == locked) {
+            ngx_http_tfs_local_block_cache_discard(ctx, shard);
+            continue;
+        }
+
+        if (ngx_shmtx_trylock(&shard->mutex)) {
+            ngx_http_tfs_local_block_cache_discard(ctx, shard);
+            ngx_shmtx_unlock(&shard->mutex);
+        }
     }
-    q = ngx_queue_last(h);
+}
+
+
+static void
+ngx_http_tfs_local_block_cache_discard(
+    ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_shard_t *shard)
+{
+    ngx_uint_t                         i;
+    ngx_queue_t                       *q, *h;
+    ngx_http_tfs_block_cache_node_t   *bcn, **link;
+
+    h = &shard->queue;
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
 
     for (i = 0; i < ctx->sh->discard_item_count; i++) {
-        if (q == ngx_queue_sentinel(h)) {
-            ngx_queue_init(h);
-            return;
+        if (ngx_queue_empty(h)) {
+            break;
         }
 
-        p = ngx_queue_prev(q);
+        q = ngx_queue_last(h);
+        ngx_queue_remove(q);
 
         bcn = ngx_queue_data(q, ngx_http_tfs_block_cache_node_t, queue);
 
-        node = (ngx_rbtree_node_t *)
-            ((u_char *) bcn - offsetof(ngx_rbtree_node_t, color));
+        link = ngx_http_tfs_local_block_cache_bucket(ctx->sh, shard,
+                                                     bcn->hash);
+        while (*link != bcn) {
+            link = &(*link)->next;
+        }
 
-        ngx_rbtree_delete(&ctx->sh->rbtree, node);
+        *link = bcn->next;
 
-        ngx_slab_free_locked(ctx->shpool, node);
+        ngx_slab_free_locked(ctx->shpool, bcn);
+    }
 
-        q = p;
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+}
+
+
+static ngx_int_t
+ngx_http_tfs_local_block_cache_copy(ngx_pool_t *pool,
+    ngx_http_tfs_block_cache_node_t *bcn,
+    ngx_http_tfs_block_cache_value_t *value)
+{
+    value->ds_count = bcn->count;
+    value->ds_addrs = ngx_pcalloc(pool, value->ds_count * sizeof(uint64_t));
+    if (value->ds_addrs == NULL) {
+        return NGX_ERROR;
     }
 
-    q->next = h;
-    h->prev = q;
+    ngx_memcpy(value->ds_addrs, bcn->data, value->ds_count * sizeof(uint64_t));
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_tfs_local_block_cache_stat(ngx_http_tfs_local_block_cache_ctx_t *ctx,
+    ngx_http_tfs_block_cache_shard_t *shard, ngx_log_t *log)
+{
+    double  hit_ratio;
+
+    /* every shard samples its share of the lookups */
+
+    if (shard->hit_count < NGX_HTTP_TFS_BLOCK_CACHE_STAT_COUNT
+                           / NGX_HTTP_TFS_BLOCK_CACHE_SHARDS)
+    {
+        return;
+    }
+
+    hit_ratio = 100 * (double)((double)shard->hit_count
+                               / (double)(shard->hit_count
+                                          + shard->miss_count));
+    ngx_log_error(NGX_LOG_INFO, log, 0,
+                  "local block cache shard %ui hit_ratio: %.2f%%",
+                  shard - ctx->sh->shards, hit_ratio);
+    shard->hit_count = 0;
+    shard->miss_count = 0;
 }
 
 
@@ -339,96 +429,93 @@ ngx_http_tfs_local_block_cache_batch_lookup(
     ngx_http_tfs_local_block_cache_ctx_t *ctx,
     ngx_pool_t *pool, ngx_log_t *log, ngx_array_t *keys, ngx_array_t *kvs)
 {
-    double                           hit_ratio;
-    ngx_int_t                        rc;
-    ngx_uint_t                       i, hash, hit_count;
-    ngx_slab_pool_t                  *shpool;
-    ngx_rbtree_node_t                *node, *sentinel;
+    ngx_uint_t                        i, hit_count;
     ngx_http_tfs_block_cache_kv_t    *kv;
     ngx_http_tfs_block_cache_key_t   *key;
     ngx_http_tfs_block_cache_node_t  *bcn;
+    ngx_http_tfs_block_cache_hkey_t  *hkeys;
+    ngx_http_tfs_block_cache_shard_t *shard, *locked;
     ngx_http_tfs_block_cache_value_t *value;
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
                    "batch lookup local block cache, block count: %ui",
                    keys->nelts);
 
+    if (keys->nelts == 0) {
+        return NGX_OK;
+    }
+
+    hkeys = ngx_palloc(pool,
+                       keys->nelts * sizeof(ngx_http_tfs_block_cache_hkey_t));
+    if (hkeys == NULL) {
+        return NGX_ERROR;
+    }
+
     key = keys->elts;
-    shpool = ctx->shpool;
-    rc = NGX_ERROR;
-    ngx_shmtx_lock(&shpool->mutex);
 
-    sentinel = ctx->sh->rbtree.sentinel;
-    hit_count = 0;
+    for (i = 0; i < keys->nelts; i++) {
+        hkeys[i].hash = ngx_murmur_hash2((u_char*)&key[i],
+                                         NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+        hkeys[i].key = &key[i];
+    }
 
-    for (i = 0; i < keys->nelts; i++, key++) {
-        node = ctx->sh->rbtree.root;
-        hash = ngx_murmur_hash2((u_char*)key,
-                                NGX_HTTP_TFS_BLOCK_CACHE_KEY_SIZE);
+    /* the keys are grouped by shard, so every shard is locked once */
 
-        while (node != sentinel) {
+    ngx_qsort(hkeys, keys->nelts, sizeof(ngx_http_tfs_block_cache_hkey_t),
+              ngx_http_tfs_local_block_cache_cmp_shard);
 
-            if (hash < node->key) {
-                node = node->left;
-                continue;
-            }
+    locked = NULL;
+    hit_count = 0;
 
-            if (hash > node->key) {
-                node = node->right;
-                continue;
-            }
+    for (i = 0; i < keys->nelts; i++) {
+        shard = ngx_http_tfs_local_block_cache_shard(ctx->sh, hkeys[i].hash);
 
-            /* hash == node->key */
-            bcn = (ngx_http_tfs_block_cache_node_t *) &node->color;
-            rc = ngx_http_tfs_block_cache_cmp(key, &bcn->key);
-            if (rc == 0) {
-                value = ngx_pcalloc(pool,
-                                    sizeof(ngx_http_tfs_block_cache_value_t));
-                if (value == NULL) {
-                    ngx_shmtx_unlock(&shpool->mutex);
-                    return NGX_ERROR;
-                }
-
-                value->ds_count = bcn->count;
-                value->ds_addrs = ngx_pcalloc(pool,
-                                            value->ds_count * sizeof(uint64_t));
-                if (value->ds_addrs == NULL) {
-                    ngx_shmtx_unlock(&shpool->mutex);
-                    return NGX_ERROR;
-                }
-                ngx_memcpy(value->ds_addrs, bcn->data,
-                           value->ds_count * sizeof(uint64_t));
-
-                kv = (ngx_http_tfs_block_cache_kv_t *)ngx_array_push(kvs);
-                kv->key = key;
-                kv->value = value;
-
-                ngx_queue_remove(&bcn->queue);
-                ngx_queue_insert_head(&ctx->sh->queue, &bcn->queue);
-                hit_count++;
-                break;
+        if (shard != locked) {
+            if (locked) {
+                ngx_http_tfs_local_block_cache_stat(ctx, locked, log);
+                ngx_shmtx_unlock(&locked->mutex);
             }
-            node = (rc < 0) ? node->left : node->right;
+
+            ngx_shmtx_lock(&shard->mutex);
+            locked = shard;
         }
 
-        if (node == sentinel) {
-            ctx->sh->miss_count++;
+        bcn = *ngx_http_tfs_local_block_cache_find(ctx->sh, shard,
+                                                   hkeys[i].hash,
+                                                   hkeys[i].key);
+        if (bcn == NULL) {
+            shard->miss_count++;
+            continue;
         }
-    }
 
-    ctx->sh->hit_count += hit_count;
-    if (ctx->sh->hit_count >= NGX_HTTP_TFS_BLOCK_CACHE_STAT_COUNT) {
-        hit_ratio = 100 * (double)((double)ctx->sh->hit_count
-                                   / (double)(ctx->sh->hit_count
-                                              + ctx->sh->miss_count));
-        ngx_log_error(NGX_LOG_INFO, log, 0,
-                      "local block cache hit_ratio: %.2f%%",
-                      hit_ratio);
-        ctx->sh->hit_count = 0;
-        ctx->sh->miss_count = 0;
+        value = ngx_pcalloc(pool, sizeof(ngx_http_tfs_block_cache_value_t));
+        if (value == NULL) {
+            ngx_shmtx_unlock(&shard->mutex);
+            return NGX_ERROR;
+        }
+
+        if (ngx_http_tfs_local_block_cache_copy(pool, bcn, value) != NGX_OK) {
+            ngx_shmtx_unlock(&shard->mutex);
+            return NGX_ERROR;
+        }
+
+        kv = (ngx_http_tfs_block_cache_kv_t *)ngx_array_push(kvs);
+        if (kv == NULL) {
+            ngx_shmtx_unlock(&shard->mutex);
+            return NGX_ERROR;
+        }
+
+        kv->key = hkeys[i].key;
+        kv->value = value;
+
+        ngx_queue_remove(&bcn->queue);
+        ngx_queue_insert_head(&shard->queue, &bcn->queue);
+        shard->hit_count++;
+        hit_count++;
     }
 
-    ngx_shmtx_unlock(&shpool->mutex);
+    ngx_http_tfs_local_block_cache_stat(ctx, locked, log);
+    ngx_shmtx_unlock(&locked->mutex);
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
                    "batch lookup local block cache, hit_count: %ui",
@@ -436,8 +523,24 @@ ngx_http_tfs_local_block_cache_batch_lookup(
 
     /* not all hit */
     if (hit_count < keys->nelts) {
-        rc = NGX_DECLINED;
+        return NGX_DECLINED;
     }
 
-    return rc;
+    return NGX_OK;
+}
+
+
+static int ngx_libc_cdecl
+ngx_http_tfs_local_block_cache_cmp_shard(const void *one, const void *two)
+{
+    ngx_uint_t                        a, b;
+    ngx_http_tfs_block_cache_hkey_t  *first, *second;
+
+    first = (ngx_http_tfs_block_cache_hkey_t *) one;
+    second = (ngx_http_tfs_block_cache_hkey_t *) two;
+
+    a = first->hash & (NGX_HTTP_TFS_BLOCK_CACHE_SHARDS - 1);
+    b = second->hash & (NGX_HTTP_TFS_BLOCK_CACHE_SHARDS - 1);
+
+    return (a > b) - (a < b);
 }
@@ -10,17 +10,16 @@
 #include <ngx_http_tfs_block_cache.h>
 
 
-typedef struct {
-    u_char                                  color;
-    u_char                                  dummy;
+struct ngx_http_tfs_block_cache_node_s {
+    ngx_http_tfs_block_cache_node_t        *next;
     ngx_queue_t                             queue;
+    uint32_t                                hash;
 
     ngx_http_tfs_block_cache_key_t          key;
 
-    u_char                                  len;
     u_short                                 count;
     u_char                                  data[1];
-} ngx_http_tfs_block_cache_node_t;
+};
 
 
 ngx_int_t ngx_http_tfs_local_block_cache_init_zone(ngx_shm_zone_t *shm_zone,
@@ -41,9 +40,6 @@ void ngx_http_tfs_local_block_cache_remove(
     ngx_http_tfs_local_block_cache_ctx_t *ctx,
     ngx_log_t *log, ngx_http_tfs_block_cache_key_t *key);
 
-void ngx_http_tfs_local_block_cache_discard(
-    ngx_http_tfs_local_block_cache_ctx_t *ctx);
-
 ngx_int_t ngx_http_tfs_local_block_cache_batch_lookup(
     ngx_http_tfs_local_block_cache_ctx_t *ctx,
     ngx_pool_t *pool, ngx_log_t *log, ngx_array_t *keys, ngx_array_t *kvs);
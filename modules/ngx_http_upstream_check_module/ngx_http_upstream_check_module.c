@@ -90,7 +90,9 @@ typedef struct {
     ngx_msec_t                               access_time;
 
     ngx_uint_t                               fall_count;
-    ngx_uint_t                               rise_count;
+
+    /* reset by the passive checks of any worker */
+    ngx_atomic_t                             rise_count;
 
     ngx_uint_t                               busyness;
     ngx_uint_t                               access_count;
@@ -105,6 +107,9 @@ typedef struct {
 
     ngx_atomic_t                             down;
 
+    /* bad responses in a row, reported by the workers which proxy to it */
+    ngx_atomic_t                             passive_fails;
+
     u_char                                   padding[64];
 } ngx_http_upstream_check_peer_shm_t;
 
@@ -141,6 +146,10 @@ struct ngx_http_upstream_check_peer_s {
     ngx_str_t                               *upstream_name;
     ngx_addr_t                              *check_peer_addr;
     ngx_addr_t                              *peer_addr;
+
+    /* the addresses of a dynamic peer, they outlive the upstream servers */
+    ngx_pool_t                              *addr_pool;
+
     ngx_event_t                              check_ev;
     ngx_event_t                              check_timeout_ev;
     ngx_peer_connection_t                    pc;
@@ -156,10 +165,33 @@ struct ngx_http_upstream_check_peer_s {
     ngx_http_upstream_check_peer_shm_t      *shm;
     ngx_http_upstream_check_srv_conf_t      *conf;
 
+    /* a link in the check wheel of the worker which checks the peer */
+    ngx_queue_t                              queue;
+    ngx_uint_t                               rounds;
+    unsigned                                 scheduled:1;
+
     unsigned                                 delete;
 };
 
 
+/*
+ * Each worker checks its own part of the peers, and all its checks are
+ * started from a wheel with NGX_HTTP_CHECK_WHEEL_TICK ms slots, driven
+ * by a single timer.
+ */
+
+#define NGX_HTTP_CHECK_WHEEL_SIZE            256
+#define NGX_HTTP_CHECK_WHEEL_TICK            100
+
+typedef struct {
+    ngx_event_t                              event;
+    ngx_connection_t                         dummy;
+    ngx_queue_t                              slots[NGX_HTTP_CHECK_WHEEL_SIZE];
+    ngx_uint_t                               current;
+    ngx_uint_t                               count;
+} ngx_http_upstream_check_wheel_t;
+
+
 typedef struct {
     ngx_str_t                                check_shm_name;
     ngx_uint_t                               checksum;
@@ -261,6 +293,10 @@ struct ngx_http_upstream_check_srv_conf_s {
 
     ngx_uint_t                               default_down;
     ngx_uint_t                               unique;
+
+    ngx_uint_t                               passive_fails;
+    ngx_msec_t                               passive_slow;
+    ngx_uint_t                               passive_5xx;
 };
 
 
@@ -377,6 +413,16 @@ static ngx_int_t ngx_http_upstream_check_add_timer(
     ngx_http_upstream_check_peer_t *peer, ngx_check_conf_t *check_conf,
     ngx_msec_t timer, ngx_log_t *log);
 
+static ngx_uint_t ngx_http_upstream_check_own_peer(
+    ngx_http_upstream_check_peer_t *peer);
+static void ngx_http_upstream_check_schedule(
+    ngx_http_upstream_check_peer_t *peer, ngx_msec_t delay);
+static void ngx_http_upstream_check_unschedule(
+    ngx_http_upstream_check_peer_t *peer);
+static void ngx_http_upstream_check_wheel_handler(ngx_event_t *event);
+static void ngx_http_upstream_check_reset_rise(
+    ngx_http_upstream_check_peer_shm_t *shm);
+
 static ngx_int_t ngx_http_upstream_check_peek_one_byte(ngx_connection_t *c);
 
 static void ngx_http_upstream_check_begin_handler(ngx_event_t *event);
@@ -475,6 +521,8 @@ static char *ngx_http_upstream_check(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
 static char *ngx_http_upstream_check_keepalive_requests(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
+static char *ngx_http_upstream_check_passive_conf(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
 static char *ngx_http_upstream_check_http_send(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
 static char *ngx_http_upstream_check_http_expect_alive(ngx_conf_t *cf,
@@ -557,6 +605,13 @@ static ngx_command_t  ngx_http_upstream_check_commands[] = {
       0,
       NULL },
 
+    { ngx_string("check_passive"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_1MORE,
+      ngx_http_upstream_check_passive_conf,
+      0,
+      0,
+      NULL },
+
     { ngx_string("check_http_send"),
       NGX_HTTP_UPS_CONF|NGX_CONF_TAKE1,
       ngx_http_upstream_check_http_send,
@@ -806,6 +861,7 @@ static ngx_check_status_command_t ngx_check_status_commands[] =  {
 
 static ngx_uint_t ngx_http_upstream_check_shm_generation = 0;
 static ngx_http_upstream_check_peers_t *check_peers_ctx = NULL;
+static ngx_http_upstream_check_wheel_t  ngx_http_upstream_check_wheel;
 
 
 ngx_uint_t
@@ -894,6 +950,8 @@ ngx_http_upstream_check_add_dynamic_peer(ngx_pool_t *pool,
                               np[i].check_ev.data, &np[i],
                               &p[i].check_ev, &np[i].check_ev);
 
+                p[i].addr_pool = NULL;
+
                 ngx_http_upstream_check_clear_peer(&p[i]);
 
                 ngx_memzero(&np[i].pc, sizeof(ngx_peer_connection_t));
@@ -912,24 +970,55 @@ ngx_http_upstream_check_add_dynamic_peer(ngx_pool_t *pool,
     peer->conf = ucscf;
     peer->index = index;
     peer->upstream_name = &us->host;
-    peer->peer_addr = peer_addr;
 
     ngx_log_debug3(NGX_LOG_DEBUG_HTTP, pool->log, 0,
                    "http upstream check add dynamic upstream: %V, "
                    "peer: %V, index: %ui",
                    &us->host, &peer_addr->name, index);
 
+    /* the address may be freed with the servers it was taken from */
+
+    peer->addr_pool = ngx_create_pool(512, pool->log);
+    if (peer->addr_pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    peer->peer_addr = ngx_palloc(peer->addr_pool, sizeof(ngx_addr_t));
+    if (peer->peer_addr == NULL) {
+        goto failed;
+    }
+
+    peer->peer_addr->socklen = peer_addr->socklen;
+    peer->peer_addr->sockaddr = ngx_palloc(peer->addr_pool,
+                                           peer_addr->socklen);
+    if (peer->peer_addr->sockaddr == NULL) {
+        goto failed;
+    }
+
+    ngx_memcpy(peer->peer_addr->sockaddr, peer_addr->sockaddr,
+               peer_addr->socklen);
+
+    peer->peer_addr->name.len = peer_addr->name.len;
+    peer->peer_addr->name.data = ngx_pstrdup(peer->addr_pool,
+                                             &peer_addr->name);
+    if (peer->peer_addr->name.data == NULL) {
+        goto failed;
+    }
+
+    peer_addr = peer->peer_addr;
+
     if (ucscf->port) {
-        peer->check_peer_addr = ngx_pcalloc(pool, sizeof(ngx_addr_t));
+        peer->check_peer_addr = ngx_pcalloc(peer->addr_pool,
+                                            sizeof(ngx_addr_t));
         if (peer->check_peer_addr == NULL) {
-            return NGX_ERROR;
+            goto failed;
         }
 
-        if (ngx_http_upstream_check_addr_change_port(pool,
+        if (ngx_http_upstream_check_addr_change_port(peer->addr_pool,
                 peer->check_peer_addr, peer_addr, ucscf->port)
             != NGX_OK) {
 
-            return NGX_ERROR;
+            goto failed;
         }
 
     } else {
@@ -949,6 +1038,15 @@ ngx_http_upstream_check_add_dynamic_peer(ngx_pool_t *pool,
         ngx_murmur_hash2(peer_addr->name.data, peer_addr->name.len);
 
     return peer->index;
+
+failed:
+
+    /* the slot is not used, so nothing else frees the address */
+
+    ngx_destroy_pool(peer->addr_pool);
+    peer->addr_pool = NULL;
+
+    return NGX_ERROR;
 }
 
 
@@ -1391,6 +1489,90 @@ ngx_http_upstream_check_free_peer(ngx_uint_t index)
 }
 
 
+/*
+ * Reports the outcome of a request proxied to the peer.  A peer which
+ * gave passive_fails bad responses in a row is marked down at once for
+ * all workers, the active checks bring it back.
+ */
+
+void
+ngx_http_upstream_check_passive(ngx_uint_t index, ngx_uint_t state,
+    ngx_msec_t elapsed)
+{
+    ngx_atomic_uint_t                    fails;
+    ngx_http_upstream_check_peer_t      *peer;
+    ngx_http_upstream_check_srv_conf_t  *ucscf;
+    ngx_http_upstream_check_peer_shm_t  *shm;
+
+    if (upstream_check_index_invalid(check_peers_ctx, index)) {
+        return;
+    }
+
+    peer = check_peers_ctx->peers.elts;
+    peer = &peer[index];
+    ucscf = peer->conf;
+
+    if (ucscf == NULL || ucscf->passive_fails == 0) {
+        return;
+    }
+
+    shm = peer->shm;
+
+    if (!(state & NGX_PEER_FAILED)
+        && !((state & NGX_PEER_ERROR) && ucscf->passive_5xx)
+        && !(ucscf->passive_slow && elapsed >= ucscf->passive_slow))
+    {
+        fails = shm->passive_fails;
+
+        if (fails) {
+            (void) ngx_atomic_cmp_set(&shm->passive_fails, fails, 0);
+        }
+
+        return;
+    }
+
+    if (shm->down) {
+        return;
+    }
+
+    fails = ngx_atomic_fetch_add(&shm->passive_fails, 1) + 1;
+
+    if (fails < ucscf->passive_fails) {
+        return;
+    }
+
+    /*
+     * the status is also updated by the worker which checks the peer,
+     * so only the worker which counted the last failure ejects it
+     */
+
+    if (!ngx_atomic_cmp_set(&shm->passive_fails, fails, 0)) {
+        return;
+    }
+
+    ngx_http_upstream_check_reset_rise(shm);
+
+    if (!ngx_atomic_cmp_set(&shm->down, 0, 1)) {
+        return;
+    }
+
+    ngx_log_error(NGX_LOG_ERR, ngx_cycle->log, 0,
+                  "disable check peer: %V by passive check",
+                  &peer->check_peer_addr->name);
+}
+
+
+static void
+ngx_http_upstream_check_reset_rise(ngx_http_upstream_check_peer_shm_t *shm)
+{
+    ngx_atomic_uint_t  rise;
+
+    do {
+        rise = shm->rise_count;
+    } while (rise && !ngx_atomic_cmp_set(&shm->rise_count, rise, 0));
+}
+
+
 static ngx_int_t
 ngx_http_upstream_check_add_timers(ngx_cycle_t *cycle)
 {
@@ -1402,6 +1584,19 @@ ngx_http_upstream_check_add_timers(ngx_cycle_t *cycle)
     ngx_http_upstream_check_peer_shm_t  *peer_shm;
     ngx_http_upstream_check_peers_shm_t *peers_shm;
 
+    ngx_http_upstream_check_wheel.dummy.fd = (ngx_socket_t) -1;
+
+    ngx_http_upstream_check_wheel.event.handler =
+        ngx_http_upstream_check_wheel_handler;
+    ngx_http_upstream_check_wheel.event.data =
+        &ngx_http_upstream_check_wheel.dummy;
+    ngx_http_upstream_check_wheel.event.log = cycle->log;
+    ngx_http_upstream_check_wheel.event.cancelable = 1;
+
+    for (i = 0; i < NGX_HTTP_CHECK_WHEEL_SIZE; i++) {
+        ngx_queue_init(&ngx_http_upstream_check_wheel.slots[i]);
+    }
+
     peers = check_peers_ctx;
     if (peers == NULL) {
         return NGX_OK;
@@ -1452,6 +1647,15 @@ ngx_http_upstream_check_add_timer(ngx_http_upstream_check_peer_t *peer,
     peer->check_ev.log = log;
     peer->check_ev.data = peer;
     peer->check_ev.timer_set = 0;
+    peer->scheduled = 0;
+
+    ngx_shmtx_lock(&peer->shm->mutex);
+    peer->shm->ref++;
+    ngx_shmtx_unlock(&peer->shm->mutex);
+
+    if (!ngx_http_upstream_check_own_peer(peer)) {
+        return NGX_OK;
+    }
 
     peer->check_timeout_ev.handler =
         ngx_http_upstream_check_timeout_handler;
@@ -1473,15 +1677,124 @@ ngx_http_upstream_check_add_timer(ngx_http_upstream_check_peer_t *peer,
     peer->parse = check_conf->parse;
     peer->reinit = check_conf->reinit;
 
-    ngx_add_timer(&peer->check_ev, timer);
-
-    /* TODO: lock */
-    peer->shm->ref++;
+    ngx_http_upstream_check_schedule(peer, timer);
 
     return NGX_OK;
 }
 
 
+static ngx_uint_t
+ngx_http_upstream_check_own_peer(ngx_http_upstream_check_peer_t *peer)
+{
+    ngx_core_conf_t  *ccf;
+
+    if (ngx_process == NGX_PROCESS_SINGLE) {
+        return 1;
+    }
+
+    if (ngx_process != NGX_PROCESS_WORKER) {
+        return 0;
+    }
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
+                                           ngx_core_module);
+
+    if (ccf->worker_processes <= 1) {
+        return 1;
+    }
+
+    return peer->index % ccf->worker_processes == ngx_worker;
+}
+
+
+static void
+ngx_http_upstream_check_schedule(ngx_http_upstream_check_peer_t *peer,
+    ngx_msec_t delay)
+{
+    ngx_uint_t                        ticks;
+    ngx_http_upstream_check_wheel_t  *wheel;
+
+    wheel = &ngx_http_upstream_check_wheel;
+
+    ticks = (delay + NGX_HTTP_CHECK_WHEEL_TICK - 1) / NGX_HTTP_CHECK_WHEEL_TICK;
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    peer->rounds = (ticks - 1) / NGX_HTTP_CHECK_WHEEL_SIZE;
+    peer->scheduled = 1;
+
+    ngx_queue_insert_tail(&wheel->slots[(wheel->current + ticks)
+                                        % NGX_HTTP_CHECK_WHEEL_SIZE],
+                          &peer->queue);
+
+    wheel->count++;
+
+    if (!wheel->event.timer_set) {
+        ngx_add_timer(&wheel->event, NGX_HTTP_CHECK_WHEEL_TICK);
+    }
+}
+
+
+static void
+ngx_http_upstream_check_unschedule(ngx_http_upstream_check_peer_t *peer)
+{
+    if (!peer->scheduled) {
+        return;
+    }
+
+    ngx_queue_remove(&peer->queue);
+    peer->scheduled = 0;
+
+    ngx_http_upstream_check_wheel.count--;
+}
+
+
+static void
+ngx_http_upstream_check_wheel_handler(ngx_event_t *event)
+{
+    ngx_queue_t                      *q, due;
+    ngx_http_upstream_check_peer_t   *peer;
+    ngx_http_upstream_check_wheel_t  *wheel;
+
+    if (ngx_http_upstream_check_need_exit()) {
+        return;
+    }
+
+    wheel = &ngx_http_upstream_check_wheel;
+
+    wheel->current = (wheel->current + 1) % NGX_HTTP_CHECK_WHEEL_SIZE;
+
+    /* the peers are moved aside, since the handlers schedule them again */
+
+    ngx_queue_init(&due);
+    ngx_queue_add(&due, &wheel->slots[wheel->current]);
+    ngx_queue_init(&wheel->slots[wheel->current]);
+
+    while (!ngx_queue_empty(&due)) {
+        q = ngx_queue_head(&due);
+        ngx_queue_remove(q);
+
+        peer = ngx_queue_data(q, ngx_http_upstream_check_peer_t, queue);
+
+        if (peer->rounds) {
+            peer->rounds--;
+            ngx_queue_insert_tail(&wheel->slots[wheel->current], q);
+            continue;
+        }
+
+        peer->scheduled = 0;
+        wheel->count--;
+
+        peer->check_ev.handler(&peer->check_ev);
+    }
+
+    if (wheel->count && !event->timer_set) {
+        ngx_add_timer(event, NGX_HTTP_CHECK_WHEEL_TICK);
+    }
+}
+
+
 static void
 ngx_http_upstream_check_begin_handler(ngx_event_t *event)
 {
@@ -1502,15 +1815,12 @@ ngx_http_upstream_check_begin_handler(ngx_event_t *event)
     peer = event->data;
     ucscf = peer->conf;
 
-    ngx_add_timer(event, ucscf->check_interval / 2);
-
-    /* This process is processing this peer now. */
-    if (peer->shm->owner == ngx_pid ||
-        peer->check_timeout_ev.timer_set) {
+    if (peers_shm->generation != ngx_http_upstream_check_shm_generation) {
         return;
     }
 
     interval = ngx_current_msec - peer->shm->access_time;
+
     ngx_log_debug5(NGX_LOG_DEBUG_HTTP, event->log, 0,
                    "http check begin handler index: %ui, owner: %P, "
                    "ngx_pid: %P, interval: %M, check_interval: %M",
@@ -1518,36 +1828,31 @@ ngx_http_upstream_check_begin_handler(ngx_event_t *event)
                    ngx_pid, interval,
                    ucscf->check_interval);
 
-    ngx_shmtx_lock(&peer->shm->mutex);
-
-    if (peers_shm->generation != ngx_http_upstream_check_shm_generation) {
-        ngx_shmtx_unlock(&peer->shm->mutex);
+    /* This process is processing this peer now. */
+    if (peer->shm->owner == ngx_pid
+        || peer->check_timeout_ev.timer_set)
+    {
+        ngx_http_upstream_check_schedule(peer, ucscf->check_interval / 2);
         return;
     }
 
-    if ((interval >= ucscf->check_interval)
-         && (peer->shm->owner == NGX_INVALID_PID)) {
+    /* the peer may be shared by several upstreams */
+    if (interval < ucscf->check_interval) {
+        ngx_http_upstream_check_schedule(peer,
+                                         ucscf->check_interval - interval);
+        return;
+    }
 
-        peer->shm->owner = ngx_pid;
+    /*
+     * Only this worker checks the peer, so neither claiming the peer
+     * nor publishing its status needs the peer mutex.
+     */
 
-    } else if (interval >= (ucscf->check_interval << 4)) {
+    peer->shm->owner = ngx_pid;
 
-        /*
-         * If the check peer has been untouched for 2^4 times of
-         * the check interval, activate the current timer.
-         * Sometimes, the checking process may disappear
-         * under some abnormal circumstances, and the clean event
-         * will never be triggered.
-         */
-        peer->shm->owner = ngx_pid;
-        peer->shm->access_time = ngx_current_msec;
-    }
-
-    ngx_shmtx_unlock(&peer->shm->mutex);
+    ngx_http_upstream_check_schedule(peer, ucscf->check_interval);
 
-    if (peer->shm->owner == ngx_pid) {
-        ngx_http_upstream_check_connect_handler(event);
-    }
+    ngx_http_upstream_check_connect_handler(event);
 }
 
 
@@ -2970,32 +3275,33 @@ static void
 ngx_http_upstream_check_status_update(ngx_http_upstream_check_peer_t *peer,
     ngx_int_t result)
 {
+    ngx_atomic_uint_t                    rise;
     ngx_http_upstream_check_srv_conf_t  *ucscf;
 
     ucscf = peer->conf;
 
-    ngx_shmtx_lock(&peer->shm->mutex);
-
     if (peer->shm->delete == PEER_DELETED) {
-
-        ngx_shmtx_unlock(&peer->shm->mutex);
         return;
     }
 
+    /* the passive checks of other workers may eject the peer meanwhile */
+
     if (result) {
-        peer->shm->rise_count++;
+        rise = ngx_atomic_fetch_add(&peer->shm->rise_count, 1) + 1;
         peer->shm->fall_count = 0;
-        if (peer->shm->down && peer->shm->rise_count >= ucscf->rise_count) {
-            peer->shm->down = 0;
+        if (peer->shm->down && rise >= ucscf->rise_count
+            && ngx_atomic_cmp_set(&peer->shm->down, 1, 0))
+        {
             ngx_log_error(NGX_LOG_ERR, ngx_cycle->log, 0,
                           "enable check peer: %V ",
                           &peer->check_peer_addr->name);
         }
     } else {
-        peer->shm->rise_count = 0;
+        ngx_http_upstream_check_reset_rise(peer->shm);
         peer->shm->fall_count++;
-        if (!peer->shm->down && peer->shm->fall_count >= ucscf->fall_count) {
-            peer->shm->down = 1;
+        if (!peer->shm->down && peer->shm->fall_count >= ucscf->fall_count
+            && ngx_atomic_cmp_set(&peer->shm->down, 0, 1))
+        {
             ngx_log_error(NGX_LOG_ERR, ngx_cycle->log, 0,
                           "disable check peer: %V ",
                           &peer->check_peer_addr->name);
@@ -3003,8 +3309,6 @@ ngx_http_upstream_check_status_update(ngx_http_upstream_check_peer_t *peer,
     }
 
     peer->shm->access_time = ngx_current_msec;
-
-    ngx_shmtx_unlock(&peer->shm->mutex);
 }
 
 
@@ -3109,6 +3413,10 @@ ngx_http_upstream_check_clear_all_events()
 
     has_cleared = 1;
 
+    if (ngx_http_upstream_check_wheel.event.timer_set) {
+        ngx_del_timer(&ngx_http_upstream_check_wheel.event);
+    }
+
     peers = check_peers_ctx;
 
     peer = peers->peers.elts;
@@ -3136,9 +3444,7 @@ ngx_http_upstream_check_clear_peer(ngx_http_upstream_check_peer_t  *peer)
         peer->pc.connection = NULL;
     }
 
-    if (peer->check_ev.timer_set) {
-        ngx_del_timer(&peer->check_ev);
-    }
+    ngx_http_upstream_check_unschedule(peer);
 
     if (peer->check_timeout_ev.timer_set) {
         ngx_del_timer(&peer->check_timeout_ev);
@@ -3149,6 +3455,11 @@ ngx_http_upstream_check_clear_peer(ngx_http_upstream_check_peer_t  *peer)
         peer->pool = NULL;
     }
 
+    if (peer->addr_pool != NULL) {
+        ngx_destroy_pool(peer->addr_pool);
+        peer->addr_pool = NULL;
+    }
+
     ngx_memzero(peer, sizeof(ngx_http_upstream_check_peer_t));
 
     peer->delete = 1;
@@ -3783,6 +4094,72 @@ ngx_http_upstream_check_keepalive_requests(ngx_conf_t *cf, ngx_command_t *cmd,
 }
 
 
+static char *
+ngx_http_upstream_check_passive_conf(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_str_t                           *value, s;
+    ngx_uint_t                           i;
+    ngx_http_upstream_check_srv_conf_t  *ucscf;
+
+    value = cf->args->elts;
+
+    ucscf = ngx_http_conf_get_module_srv_conf(cf,
+                                              ngx_http_upstream_check_module);
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "fails=", 6) == 0) {
+            s.len = value[i].len - 6;
+            s.data = value[i].data + 6;
+
+            ucscf->passive_fails = ngx_atoi(s.data, s.len);
+            if (ucscf->passive_fails == (ngx_uint_t) NGX_ERROR
+                || ucscf->passive_fails == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "slow=", 5) == 0) {
+            s.len = value[i].len - 5;
+            s.data = value[i].data + 5;
+
+            ucscf->passive_slow = ngx_parse_time(&s, 0);
+            if (ucscf->passive_slow == (ngx_msec_t) NGX_ERROR
+                || ucscf->passive_slow == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "http_5xx") == 0) {
+            ucscf->passive_5xx = 1;
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    if (ucscf->passive_fails == 0) {
+        ucscf->passive_fails = 1;
+    }
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
 static char *
 ngx_http_upstream_check_http_send(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf)
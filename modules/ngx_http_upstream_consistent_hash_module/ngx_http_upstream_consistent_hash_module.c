@@ -14,6 +14,12 @@
 #define NGX_CHASH_LESS                      -1
 #define NGX_CHASH_VIRTUAL_NODE_NUMBER       160
 
+#define NGX_CHASH_RING                      0
+#define NGX_CHASH_MAGLEV                    1
+
+#define NGX_CHASH_MAGLEV_EMPTY              0xffff
+#define NGX_CHASH_MAGLEV_MAX_PEERS          65535
+
 #if (NGX_HTTP_UPSTREAM_CHECK)
 #include "ngx_http_upstream_check_module.h"
 #endif
@@ -32,7 +38,29 @@ typedef struct {
     ngx_http_upstream_rr_peer_t            *peer;
 } ngx_http_upstream_chash_server_t;
 
+/*
+ * Maglev lookup table, every peer fills the slots of its own permutation
+ * of the table in turn, so a key is mapped with a single lookup and
+ * a changed peer only moves a small part of the keys.
+ */
+
+typedef struct {
+    ngx_uint_t                              size;
+    ngx_uint_t                              number;
+    ngx_uint_t                              ndown;
+    time_t                                  checked;
+    uint16_t                               *table;
+    uint16_t                               *live;
+    uint32_t                               *offset;
+    uint32_t                               *skip;
+    uint32_t                               *next;
+    time_t                                 *down;
+    ngx_http_upstream_rr_peer_t           **peer;
+} ngx_http_upstream_chash_maglev_t;
+
 typedef struct {
+    ngx_uint_t                              algorithm;
+    ngx_uint_t                              bounded;
     ngx_uint_t                              number;
     ngx_queue_t                             down_servers;
     ngx_array_t                            *values;
@@ -41,6 +69,11 @@ typedef struct {
     ngx_http_upstream_chash_server_t     ***real_node;
     ngx_http_upstream_chash_server_t       *servers;
     ngx_http_upstream_chash_down_server_t  *d_servers;
+    ngx_http_upstream_chash_maglev_t       *maglev;
+
+    /* the peers counting the active requests, in the upstream zone if any */
+    ngx_http_upstream_rr_peers_t           *load_peers;
+    ngx_http_upstream_rr_peer_t           **load;
 } ngx_http_upstream_chash_srv_conf_t;
 
 typedef struct {
@@ -51,6 +84,8 @@ typedef struct {
 #endif
 
     ngx_http_upstream_chash_server_t       *server;
+    ngx_http_upstream_rr_peer_t            *peer;
+    ngx_http_upstream_rr_peer_t            *load_peer;
     ngx_http_upstream_chash_srv_conf_t     *ucscf;
 } ngx_http_upstream_chash_peer_data_t;
 
@@ -72,6 +107,23 @@ static uint32_t ngx_http_upstream_chash_get_server_index(
 static void ngx_http_upstream_chash_delete_node(
     ngx_http_upstream_chash_srv_conf_t *ucscf,
     ngx_http_upstream_chash_server_t *server);
+static ngx_int_t ngx_http_upstream_init_chash_maglev(ngx_conf_t *cf,
+    ngx_http_upstream_chash_srv_conf_t *ucscf,
+    ngx_http_upstream_rr_peers_t *peers);
+static void ngx_http_upstream_chash_maglev_populate(
+    ngx_http_upstream_chash_maglev_t *maglev, uint16_t *table,
+    time_t *down);
+static ngx_int_t ngx_http_upstream_get_chash_maglev_peer(
+    ngx_peer_connection_t *pc, void *data);
+static ngx_uint_t ngx_http_upstream_chash_maglev_failed(
+    ngx_http_upstream_rr_peer_t *peer);
+static ngx_int_t ngx_http_upstream_chash_init_load(
+    ngx_http_upstream_chash_srv_conf_t *ucscf,
+    ngx_http_upstream_srv_conf_t *us);
+static ngx_uint_t ngx_http_upstream_chash_overloaded(
+    ngx_http_upstream_chash_srv_conf_t *ucscf, ngx_uint_t i);
+static void ngx_http_upstream_chash_count_load(
+    ngx_http_upstream_chash_peer_data_t *uchpd, ngx_uint_t i);
 
 #if (NGX_HTTP_SSL)
 static ngx_int_t ngx_http_upstream_chash_set_peer_session(
@@ -84,7 +136,7 @@ static void ngx_http_upstream_chash_save_peer_session(ngx_peer_connection_t *pc,
 static ngx_command_t ngx_http_upstream_chash_commands[] = {
 
     { ngx_string("consistent_hash"),
-      NGX_HTTP_UPS_CONF | NGX_CONF_TAKE1,
+      NGX_HTTP_UPS_CONF | NGX_CONF_TAKE123,
       ngx_http_upstream_chash,
       0,
       0,
@@ -170,6 +222,10 @@ ngx_http_upstream_init_chash(ngx_conf_t *cf, ngx_http_upstream_srv_conf_t *us)
         return NGX_ERROR;
     }
 
+    if (ucscf->algorithm == NGX_CHASH_MAGLEV) {
+        return ngx_http_upstream_init_chash_maglev(cf, ucscf, peers);
+    }
+
     n = peers->number;
     ucscf->number = 0;
     ucscf->real_node = ngx_pcalloc(cf->pool, n *
@@ -312,6 +368,13 @@ ngx_http_upstream_init_chash_peer(ngx_http_request_t *r,
     }
 
     uchpd->ucscf = ucscf;
+
+    if (ucscf->bounded && ucscf->load == NULL
+        && ngx_http_upstream_chash_init_load(ucscf, us) != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
     if (ngx_http_script_run(r, &hash_value,
                 ucscf->lengths->elts, 0, ucscf->values->elts) == NULL) {
         return NGX_ERROR;
@@ -319,7 +382,9 @@ ngx_http_upstream_init_chash_peer(ngx_http_request_t *r,
 
     uchpd->hash = ngx_murmur_hash2(hash_value.data, hash_value.len);
 
-    r->upstream->peer.get = ngx_http_upstream_get_chash_peer;
+    r->upstream->peer.get = ucscf->algorithm == NGX_CHASH_MAGLEV
+                            ? ngx_http_upstream_get_chash_maglev_peer
+                            : ngx_http_upstream_get_chash_peer;
     r->upstream->peer.free = ngx_http_upstream_free_chash_peer;
     r->upstream->peer.data = uchpd;
 
@@ -342,7 +407,7 @@ ngx_http_upstream_get_chash_peer(ngx_peer_connection_t *pc, void *data)
     ngx_queue_t                            *q, *temp;
     ngx_segment_node_t                      node, *p;
     ngx_http_upstream_rr_peer_t            *peer;
-    ngx_http_upstream_chash_server_t       *server;
+    ngx_http_upstream_chash_server_t       *server, *p2;
     ngx_http_upstream_chash_srv_conf_t     *ucscf;
     ngx_http_upstream_chash_peer_data_t    *uchpd = data;
     ngx_http_upstream_chash_down_server_t  *down_server;
@@ -468,7 +533,45 @@ ngx_http_upstream_get_chash_peer(ngx_peer_connection_t *pc, void *data)
         return NGX_BUSY;
     }
 
+    if (ucscf->bounded) {
+
+        ngx_http_upstream_rr_peers_wlock(ucscf->load_peers);
+
+        /* an overloaded server passes its requests on along the ring */
+
+        if (ngx_http_upstream_chash_overloaded(ucscf, server->rnindex)) {
+
+            for (index1 = server->index % ucscf->number + 1;
+                 index1 != server->index;
+                 index1 = index1 % ucscf->number + 1)
+            {
+                p2 = &ucscf->servers[index1];
+
+                if (p2->down
+                    || p2->peer->fails > p2->peer->max_fails
+                    || p2->peer->down
+#if (NGX_HTTP_UPSTREAM_CHECK)
+                    || ngx_http_upstream_check_peer_down(
+                                                   p2->peer->check_index)
+#endif
+                    || ngx_http_upstream_chash_overloaded(ucscf,
+                                                          p2->rnindex))
+                {
+                    continue;
+                }
+
+                server = p2;
+                break;
+            }
+        }
+
+        ngx_http_upstream_chash_count_load(uchpd, server->rnindex);
+
+        ngx_http_upstream_rr_peers_unlock(ucscf->load_peers);
+    }
+
     uchpd->server = server;
+    uchpd->peer = server->peer;
     peer = server->peer;
 
     pc->name = &peer->name;
@@ -500,6 +603,344 @@ ngx_http_upstream_chash_delete_node(ngx_http_upstream_chash_srv_conf_t *ucscf,
 }
 
 
+static ngx_int_t
+ngx_http_upstream_init_chash_maglev(ngx_conf_t *cf,
+    ngx_http_upstream_chash_srv_conf_t *ucscf,
+    ngx_http_upstream_rr_peers_t *peers)
+{
+    u_char                             hash_buf[256];
+    size_t                             len;
+    ngx_uint_t                         i, n, size, sid;
+    ngx_http_upstream_rr_peer_t       *peer;
+    ngx_http_upstream_chash_maglev_t  *maglev;
+
+    /* the table size is a prime, at least 100 times the number of peers */
+
+    static ngx_uint_t  sizes[] = { 65537, 131071, 262139, 524287, 1048573,
+                                   2097143, 4194301, 0 };
+
+    n = peers->number;
+
+    if (n > NGX_CHASH_MAGLEV_MAX_PEERS) {
+        ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                      "too many servers for maglev, must be less than %d",
+                      NGX_CHASH_MAGLEV_MAX_PEERS + 1);
+        return NGX_ERROR;
+    }
+
+    for (i = 0; sizes[i + 1] && sizes[i] < n * 100; i++) { /* void */ }
+
+    size = sizes[i];
+
+    maglev = ngx_pcalloc(cf->pool, sizeof(ngx_http_upstream_chash_maglev_t));
+    if (maglev == NULL) {
+        return NGX_ERROR;
+    }
+
+    maglev->size = size;
+    maglev->number = n;
+
+    maglev->table = ngx_palloc(cf->pool, size * sizeof(uint16_t));
+    maglev->live = ngx_palloc(cf->pool, size * sizeof(uint16_t));
+    maglev->offset = ngx_palloc(cf->pool, n * sizeof(uint32_t));
+    maglev->skip = ngx_palloc(cf->pool, n * sizeof(uint32_t));
+    maglev->next = ngx_palloc(cf->pool, n * sizeof(uint32_t));
+    maglev->down = ngx_pcalloc(cf->pool, n * sizeof(time_t));
+    maglev->peer = ngx_palloc(cf->pool,
+                              n * sizeof(ngx_http_upstream_rr_peer_t *));
+
+    if (maglev->table == NULL || maglev->live == NULL
+        || maglev->offset == NULL || maglev->skip == NULL
+        || maglev->next == NULL || maglev->down == NULL
+        || maglev->peer == NULL)
+    {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        peer = &peers->peer[i];
+        maglev->peer[i] = peer;
+
+        /* the permutation of a peer depends on its id or its name only */
+
+        sid = (ngx_uint_t) ngx_atoi(peer->id.data, peer->id.len);
+
+        if (sid == (ngx_uint_t) NGX_ERROR || sid > 65535) {
+            len = ngx_snprintf(hash_buf, 256, "%V", &peer->name) - hash_buf;
+
+        } else {
+            len = ngx_snprintf(hash_buf, 256, "%ui", sid) - hash_buf;
+        }
+
+        maglev->offset[i] = ngx_murmur_hash2(hash_buf, len) % size;
+        maglev->skip[i] = ngx_crc32_short(hash_buf, len) % (size - 1) + 1;
+    }
+
+    ngx_http_upstream_chash_maglev_populate(maglev, maglev->table, NULL);
+
+    if (maglev->table[0] == NGX_CHASH_MAGLEV_EMPTY) {
+        ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                      "no usable servers for maglev");
+        return NGX_ERROR;
+    }
+
+    ucscf->maglev = maglev;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_chash_maglev_populate(ngx_http_upstream_chash_maglev_t *maglev,
+    uint16_t *table, time_t *down)
+{
+    uint32_t                      c;
+    ngx_int_t                     w;
+    ngx_uint_t                    i, filled, last;
+    ngx_http_upstream_rr_peer_t  *peer;
+
+    ngx_memset(table, 0xff, maglev->size * sizeof(uint16_t));
+    ngx_memzero(maglev->next, maglev->number * sizeof(uint32_t));
+
+    filled = 0;
+
+    /* a peer takes as many slots as its weight in every round */
+
+    while (filled < maglev->size) {
+
+        last = filled;
+
+        for (i = 0; i < maglev->number && filled < maglev->size; i++) {
+            peer = maglev->peer[i];
+
+            if (peer->down || (down && down[i])) {
+                continue;
+            }
+
+            for (w = 0; w < peer->weight && filled < maglev->size; w++) {
+
+                do {
+                    c = (maglev->offset[i]
+                         + (uint64_t) maglev->next[i] * maglev->skip[i])
+                        % maglev->size;
+                    maglev->next[i]++;
+
+                } while (table[c] != NGX_CHASH_MAGLEV_EMPTY);
+
+                table[c] = (uint16_t) i;
+                filled++;
+            }
+        }
+
+        if (last == filled) {
+
+            /* all the peers are down */
+
+            return;
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_http_upstream_get_chash_maglev_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_http_upstream_chash_peer_data_t *uchpd = data;
+
+    time_t                             now;
+    uint16_t                          *table;
+    ngx_uint_t                         i, k, n, changed;
+    ngx_http_upstream_rr_peer_t       *peer;
+    ngx_http_upstream_chash_maglev_t  *maglev;
+
+    maglev = uchpd->ucscf->maglev;
+    now = ngx_time();
+    changed = 0;
+
+    /* the peers taken out are looked at once a second at most */
+
+    if (maglev->ndown && maglev->checked != now) {
+        maglev->checked = now;
+
+        for (i = 0; i < maglev->number; i++) {
+
+            if (maglev->down[i] == 0 || now < maglev->down[i]) {
+                continue;
+            }
+
+#if (NGX_HTTP_UPSTREAM_CHECK)
+            if (ngx_http_upstream_check_peer_down(
+                                             maglev->peer[i]->check_index))
+            {
+                continue;
+            }
+#endif
+
+            maglev->peer[i]->fails = 0;
+            maglev->down[i] = 0;
+            maglev->ndown--;
+            changed = 1;
+        }
+    }
+
+    pc->cached = 0;
+    pc->connection = NULL;
+
+    for ( ;; ) {
+
+        if (changed) {
+            changed = 0;
+
+            if (maglev->ndown) {
+                ngx_http_upstream_chash_maglev_populate(maglev, maglev->live,
+                                                        maglev->down);
+            }
+        }
+
+        table = maglev->ndown ? maglev->live : maglev->table;
+
+        i = table[uchpd->hash % maglev->size];
+
+        if (i == NGX_CHASH_MAGLEV_EMPTY) {
+            ngx_log_error(NGX_LOG_ERR, pc->log, 0, "all servers are down");
+            return NGX_BUSY;
+        }
+
+        peer = maglev->peer[i];
+
+        if (!ngx_http_upstream_chash_maglev_failed(peer)) {
+            break;
+        }
+
+        /* the keys of a failed peer move to the table built without it */
+
+        maglev->down[i] = now + peer->fail_timeout;
+        maglev->ndown++;
+        changed = 1;
+    }
+
+    if (uchpd->ucscf->bounded) {
+
+        ngx_http_upstream_rr_peers_wlock(uchpd->ucscf->load_peers);
+
+        /*
+         * the requests of an overloaded peer are passed on to the next
+         * slots, the same for the same key
+         */
+
+        if (ngx_http_upstream_chash_overloaded(uchpd->ucscf, i)) {
+
+            for (k = 1; k < 4 * maglev->number; k++) {
+                n = table[(uchpd->hash + k) % maglev->size];
+
+                if (n == NGX_CHASH_MAGLEV_EMPTY
+                    || ngx_http_upstream_chash_maglev_failed(maglev->peer[n])
+                    || ngx_http_upstream_chash_overloaded(uchpd->ucscf, n))
+                {
+                    continue;
+                }
+
+                i = n;
+                peer = maglev->peer[i];
+                break;
+            }
+        }
+
+        ngx_http_upstream_chash_count_load(uchpd, i);
+
+        ngx_http_upstream_rr_peers_unlock(uchpd->ucscf->load_peers);
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "consistent hash maglev [peer name]:%V %ui",
+                   &peer->name, i);
+
+    uchpd->peer = peer;
+
+    pc->name = &peer->name;
+    pc->sockaddr = peer->sockaddr;
+    pc->socklen = peer->socklen;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_chash_init_load(ngx_http_upstream_chash_srv_conf_t *ucscf,
+    ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_uint_t                     i;
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    /*
+     * the upstream zone copies the peers in the same order after the
+     * configuration is read, the copies count the requests of all workers
+     */
+
+    peers = us->peer.data;
+
+    ucscf->load = ngx_palloc(ngx_cycle->pool,
+                             peers->number
+                             * sizeof(ngx_http_upstream_rr_peer_t *));
+    if (ucscf->load == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0, peer = peers->peer; peer; i++, peer = peer->next) {
+        ucscf->load[i] = peer;
+    }
+
+    ucscf->load_peers = peers;
+
+    return NGX_OK;
+}
+
+
+static ngx_uint_t
+ngx_http_upstream_chash_overloaded(ngx_http_upstream_chash_srv_conf_t *ucscf,
+    ngx_uint_t i)
+{
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    peers = ucscf->load_peers;
+    peer = ucscf->load[i];
+
+    /* a peer takes at most "bounded" times its share of the requests */
+
+    return peer->conns * peers->total_weight * 100
+           >= (peers->conns + 1) * ucscf->bounded * peer->weight;
+}
+
+
+static void
+ngx_http_upstream_chash_count_load(ngx_http_upstream_chash_peer_data_t *uchpd,
+    ngx_uint_t i)
+{
+    ngx_http_upstream_chash_srv_conf_t  *ucscf;
+
+    ucscf = uchpd->ucscf;
+
+    uchpd->load_peer = ucscf->load[i];
+    uchpd->load_peer->conns++;
+    ucscf->load_peers->conns++;
+}
+
+
+static ngx_uint_t
+ngx_http_upstream_chash_maglev_failed(ngx_http_upstream_rr_peer_t *peer)
+{
+#if (NGX_HTTP_UPSTREAM_CHECK)
+    if (ngx_http_upstream_check_peer_down(peer->check_index)) {
+        return 1;
+    }
+#endif
+
+    return peer->max_fails && peer->fails >= peer->max_fails;
+}
+
+
 static uint32_t
 ngx_http_upstream_chash_get_server_index(
     ngx_http_upstream_chash_server_t *servers, uint32_t n, uint32_t hash)
@@ -538,12 +979,28 @@ ngx_http_upstream_free_chash_peer(ngx_peer_connection_t *pc, void *data,
     ngx_log_debug(NGX_LOG_DEBUG_HTTP, pc->log, 0,
                   "consistent hash free  peer %ui", state);
 
-    if (uchpd->server == NULL) {
+    if (uchpd->peer == NULL) {
         return;
     }
 
+#if (NGX_HTTP_UPSTREAM_CHECK)
+    ngx_http_upstream_check_passive(uchpd->peer->check_index, state,
+                                    ngx_current_msec - pc->start_time);
+#endif
+
     if (state & NGX_PEER_FAILED) {
-        uchpd->server->peer->fails++;
+        uchpd->peer->fails++;
+    }
+
+    if (uchpd->load_peer) {
+        ngx_http_upstream_rr_peers_wlock(uchpd->ucscf->load_peers);
+
+        uchpd->load_peer->conns--;
+        uchpd->ucscf->load_peers->conns--;
+
+        ngx_http_upstream_rr_peers_unlock(uchpd->ucscf->load_peers);
+
+        uchpd->load_peer = NULL;
     }
 }
 
@@ -551,6 +1008,8 @@ ngx_http_upstream_free_chash_peer(ngx_peer_connection_t *pc, void *data,
 static char *
 ngx_http_upstream_chash(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
+    ngx_int_t                            bounded;
+    ngx_uint_t                           i;
     ngx_str_t                           *value;
     ngx_http_script_compile_t            sc;
     ngx_http_upstream_srv_conf_t        *uscf;
@@ -572,6 +1031,37 @@ ngx_http_upstream_chash(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strcmp(value[i].data, "algorithm=maglev") == 0) {
+            ucscf->algorithm = NGX_CHASH_MAGLEV;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "algorithm=ring") == 0) {
+            ucscf->algorithm = NGX_CHASH_RING;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "bounded=", 8) == 0) {
+            bounded = ngx_atofp(value[i].data + 8, value[i].len - 8, 2);
+
+            if (bounded == NGX_ERROR || bounded <= 100) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid bounded load factor \"%V\", "
+                                   "it must be greater than 1", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            ucscf->bounded = bounded;
+            continue;
+        }
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
+    }
+
     ngx_memzero(&sc, sizeof(ngx_http_script_compile_t));
 
     sc.cf = cf;
@@ -27,9 +27,39 @@ typedef struct {
     ngx_http_upstream_init_pt         original_init_upstream;
     ngx_http_upstream_init_peer_pt    original_init_peer;
 
+    ngx_http_upstream_srv_conf_t     *upstream;
+    ngx_array_t                      *hosts;
+
+    ngx_resolver_t                   *resolver;
+    ngx_msec_t                        resolver_timeout;
+
+    ngx_uint_t                        refreshes;
+    ngx_uint_t                        changes;
+    ngx_uint_t                        failures;
+
 } ngx_http_upstream_dynamic_srv_conf_t;
 
 
+typedef struct {
+    ngx_pool_t                       *pool;
+    ngx_addr_t                       *addrs;
+    ngx_uint_t                        naddrs;
+} ngx_http_upstream_dynamic_addrs_t;
+
+
+typedef struct {
+    ngx_str_t                              name;
+    ngx_http_upstream_dynamic_srv_conf_t  *conf;
+
+    ngx_http_upstream_dynamic_addrs_t     *addrs;
+    ngx_uint_t                             current;
+    time_t                                 valid;
+    ngx_uint_t                             failed;
+
+    ngx_event_t                            event;
+} ngx_http_upstream_dynamic_host_t;
+
+
 typedef struct {
     ngx_http_upstream_dynamic_srv_conf_t  *conf;
 
@@ -56,6 +86,17 @@ static ngx_int_t ngx_http_upstream_get_dynamic_peer(ngx_peer_connection_t *pc,
     void *data);
 static void ngx_http_upstream_free_dynamic_peer(ngx_peer_connection_t *pc,
     void *data, ngx_uint_t state);
+static ngx_int_t ngx_http_upstream_dynamic_set_addr(ngx_http_request_t *r,
+    ngx_peer_connection_t *pc, struct sockaddr *sockaddr, socklen_t socklen);
+static ngx_int_t ngx_http_upstream_dynamic_get_host_peer(
+    ngx_http_upstream_dynamic_peer_data_t *bp, ngx_peer_connection_t *pc,
+    ngx_http_upstream_dynamic_host_t *host);
+static ngx_http_upstream_dynamic_host_t *ngx_http_upstream_dynamic_find_host(
+    ngx_http_upstream_dynamic_srv_conf_t *dcf, ngx_str_t *name);
+static void ngx_http_upstream_dynamic_refresh_handler(ngx_event_t *ev);
+static void ngx_http_upstream_dynamic_refresh_done(ngx_resolver_ctx_t *ctx);
+static ngx_int_t ngx_http_upstream_dynamic_addrs_changed(
+    ngx_http_upstream_dynamic_addrs_t *addrs, ngx_resolver_ctx_t *ctx);
 
 
 #if (NGX_HTTP_SSL)
@@ -65,6 +106,7 @@ static void ngx_http_upstream_dynamic_save_session(ngx_peer_connection_t *pc,
     void *data);
 #endif
 
+static ngx_int_t ngx_http_upstream_dynamic_init_process(ngx_cycle_t *cycle);
 static void *ngx_http_upstream_dynamic_create_conf(ngx_conf_t *cf);
 static char *ngx_http_upstream_dynamic(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
@@ -111,7 +153,7 @@ ngx_module_t  ngx_http_upstream_dynamic_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_upstream_dynamic_init_process, /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -126,8 +168,9 @@ ngx_http_upstream_init_dynamic(ngx_conf_t *cf,
 {
     ngx_uint_t                             i;
     ngx_http_upstream_dynamic_srv_conf_t  *dcf;
+    ngx_http_upstream_dynamic_host_t      *host;
     ngx_http_upstream_server_t            *server;
-    ngx_str_t                              host;
+    ngx_str_t                              name;
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, cf->log, 0,
                    "init dynamic resolve");
@@ -142,20 +185,42 @@ ngx_http_upstream_init_dynamic(ngx_conf_t *cf,
     if (us->servers) {
         server = us->servers->elts;
 
+        dcf->hosts = ngx_array_create(cf->pool, 1,
+                                      sizeof(ngx_http_upstream_dynamic_host_t));
+        if (dcf->hosts == NULL) {
+            return NGX_ERROR;
+        }
+
+        /* every name is refreshed once, whatever number of servers use it */
+
         for (i = 0; i < us->servers->nelts; i++) {
-            host = server[i].host;
-            if (ngx_inet_addr(host.data, host.len) == INADDR_NONE) {
-                break;
+            name = server[i].host;
+
+            if (ngx_inet_addr(name.data, name.len) != INADDR_NONE
+                || ngx_http_upstream_dynamic_find_host(dcf, &name))
+            {
+                continue;
+            }
+
+            host = ngx_array_push(dcf->hosts);
+            if (host == NULL) {
+                return NGX_ERROR;
             }
+
+            ngx_memzero(host, sizeof(ngx_http_upstream_dynamic_host_t));
+
+            host->name = name;
+            host->conf = dcf;
         }
 
-        if (i == us->servers->nelts) {
+        if (dcf->hosts->nelts == 0) {
             dcf->enabled = 0;
 
             return NGX_OK;
         }
     }
 
+    dcf->upstream = us;
     dcf->original_init_peer = us->peer.init;
 
     us->peer.init = ngx_http_upstream_init_dynamic_peer;
@@ -216,17 +281,13 @@ ngx_http_upstream_dynamic_handler(ngx_resolver_ctx_t *ctx)
     ngx_http_request_t                    *r;
     ngx_http_upstream_t                   *u;
     ngx_peer_connection_t                 *pc;
-#if defined(nginx_version) && nginx_version >= 1005008
-    socklen_t                              socklen;
-    struct sockaddr                       *sockaddr, *csockaddr;
-#else
+#if !(defined(nginx_version) && nginx_version >= 1005008)
     struct sockaddr_in                    *sin, *csin;
-#endif
     in_port_t                              port;
     ngx_str_t                             *addr;
     u_char                                *p;
-
     size_t                                 len;
+#endif
     ngx_http_upstream_dynamic_srv_conf_t  *dscf;
     ngx_http_upstream_dynamic_peer_data_t *bp;
 
@@ -268,58 +329,23 @@ ngx_http_upstream_dynamic_handler(ngx_resolver_ctx_t *ctx)
 #endif
         dscf->fail_check = 0;
 #if defined(nginx_version) && nginx_version >= 1005008
-        csockaddr = ctx->addrs[0].sockaddr;
-        socklen = ctx->addrs[0].socklen;
-
-        if (ngx_cmp_sockaddr(pc->sockaddr, pc->socklen, csockaddr, socklen, 0)
+        if (ngx_cmp_sockaddr(pc->sockaddr, pc->socklen,
+                             ctx->addrs[0].sockaddr, ctx->addrs[0].socklen, 0)
             == NGX_OK)
         {
             pc->resolved = NGX_HTTP_UPSTREAM_DR_OK;
             goto out;
         }
 
-        sockaddr = ngx_pcalloc(r->pool, socklen);
-        if (sockaddr == NULL) {
-            ngx_http_upstream_finalize_request(r, u,
-                                               NGX_HTTP_INTERNAL_SERVER_ERROR);
-            return;
-        }
-
-        ngx_memcpy(sockaddr, csockaddr, socklen);
-        port = ngx_inet_get_port(pc->sockaddr);
-        
-        switch (sockaddr->sa_family) {
-#if (NGX_HAVE_INET6)
-        case AF_INET6:
-            ((struct sockaddr_in6 *) sockaddr)->sin6_port = htons(port);
-            break;
-#endif
-        default: /* AF_INET */
-            ((struct sockaddr_in *) sockaddr)->sin_port = htons(port);
-        }
-
-        p = ngx_pnalloc(r->pool, NGX_SOCKADDR_STRLEN);
-        if (p == NULL) {
-            ngx_http_upstream_finalize_request(r, u,
-                                               NGX_HTTP_INTERNAL_SERVER_ERROR);
-            return;
-        }
-
-        len = ngx_sock_ntop(sockaddr, socklen, p, NGX_SOCKADDR_STRLEN, 1);
-
-        addr = ngx_palloc(r->pool, sizeof(ngx_str_t));
-        if (addr == NULL) {
+        if (ngx_http_upstream_dynamic_set_addr(r, pc, ctx->addrs[0].sockaddr,
+                                               ctx->addrs[0].socklen)
+            != NGX_OK)
+        {
             ngx_http_upstream_finalize_request(r, u,
                                                NGX_HTTP_INTERNAL_SERVER_ERROR);
             return;
         }
 
-        addr->data = p;
-        addr->len = len;
-        pc->sockaddr = sockaddr;
-        pc->socklen = socklen;
-        pc->name = addr;
-
 #else
         /* for nginx older than 1.5.8 */
 
@@ -397,6 +423,7 @@ ngx_http_upstream_get_dynamic_peer(ngx_peer_connection_t *pc, void *data)
     ngx_http_upstream_t                    *u;
     ngx_int_t                               rc;
     ngx_http_upstream_dynamic_srv_conf_t   *dscf;
+    ngx_http_upstream_dynamic_host_t       *host;
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, pc->log, 0,
                    "get dynamic peer");
@@ -485,6 +512,17 @@ ngx_http_upstream_get_dynamic_peer(ngx_peer_connection_t *pc, void *data)
         return NGX_OK;
     }
 
+    host = ngx_http_upstream_dynamic_find_host(dscf, pc->host);
+
+    if (host && host->event.handler) {
+        return ngx_http_upstream_dynamic_get_host_peer(bp, pc, host);
+    }
+
+    /*
+     * names without a refresher, e.g. of upstreams added at run time,
+     * are resolved for the request
+     */
+
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
     if (clcf->resolver == NULL) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
@@ -530,6 +568,323 @@ ngx_http_upstream_get_dynamic_peer(ngx_peer_connection_t *pc, void *data)
 }
 
 
+static ngx_int_t
+ngx_http_upstream_dynamic_set_addr(ngx_http_request_t *r,
+    ngx_peer_connection_t *pc, struct sockaddr *sockaddr, socklen_t socklen)
+{
+    u_char           *p;
+    in_port_t         port;
+    ngx_str_t        *name;
+    struct sockaddr  *sa;
+
+    sa = ngx_pcalloc(r->pool, socklen);
+    if (sa == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(sa, sockaddr, socklen);
+
+    port = ngx_inet_get_port(pc->sockaddr);
+    ngx_inet_set_port(sa, port);
+
+    p = ngx_pnalloc(r->pool, NGX_SOCKADDR_STRLEN);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    name = ngx_palloc(r->pool, sizeof(ngx_str_t));
+    if (name == NULL) {
+        return NGX_ERROR;
+    }
+
+    name->data = p;
+    name->len = ngx_sock_ntop(sa, socklen, p, NGX_SOCKADDR_STRLEN, 1);
+
+    pc->sockaddr = sa;
+    pc->socklen = socklen;
+    pc->name = name;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_dynamic_get_host_peer(
+    ngx_http_upstream_dynamic_peer_data_t *bp, ngx_peer_connection_t *pc,
+    ngx_http_upstream_dynamic_host_t *host)
+{
+    ngx_addr_t                         *addr;
+    ngx_http_upstream_dynamic_addrs_t  *addrs;
+
+    if (host->failed) {
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                       "refresh failed, fallback: %ui", bp->conf->fallback);
+
+        switch (bp->conf->fallback) {
+
+        case NGX_HTTP_UPSTREAM_DYN_RESOLVE_STALE:
+            return NGX_OK;
+
+        case NGX_HTTP_UPSTREAM_DYN_RESOLVE_SHUTDOWN:
+            ngx_http_upstream_finalize_request(bp->request, bp->upstream,
+                                               NGX_HTTP_BAD_GATEWAY);
+            return NGX_YIELD;
+
+        default:
+            return NGX_DECLINED;
+        }
+    }
+
+    addrs = host->addrs;
+
+    if (addrs == NULL) {
+
+        /* not refreshed yet, the address resolved at start is used */
+
+        return NGX_OK;
+    }
+
+    /* the peer is spread over all addresses the name has now */
+
+    addr = &addrs->addrs[host->current++ % addrs->naddrs];
+
+    if (ngx_cmp_sockaddr(pc->sockaddr, pc->socklen,
+                         addr->sockaddr, addr->socklen, 0)
+        == NGX_OK)
+    {
+        return NGX_OK;
+    }
+
+    if (ngx_http_upstream_dynamic_set_addr(bp->request, pc, addr->sockaddr,
+                                           addr->socklen)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "dynamic peer %V is %V", &host->name, pc->name);
+
+    return NGX_OK;
+}
+
+
+static ngx_http_upstream_dynamic_host_t *
+ngx_http_upstream_dynamic_find_host(ngx_http_upstream_dynamic_srv_conf_t *dcf,
+    ngx_str_t *name)
+{
+    ngx_uint_t                         i;
+    ngx_http_upstream_dynamic_host_t  *host;
+
+    if (dcf->hosts == NULL) {
+        return NULL;
+    }
+
+    host = dcf->hosts->elts;
+
+    for (i = 0; i < dcf->hosts->nelts; i++) {
+        if (host[i].name.len == name->len
+            && ngx_strncasecmp(host[i].name.data, name->data, name->len) == 0)
+        {
+            return &host[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_http_upstream_dynamic_refresh_handler(ngx_event_t *ev)
+{
+    ngx_resolver_ctx_t                    *ctx, temp;
+    ngx_http_upstream_dynamic_host_t      *host;
+    ngx_http_upstream_dynamic_srv_conf_t  *dcf;
+
+    host = ev->data;
+    dcf = host->conf;
+
+    if (ngx_exiting) {
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "dynamic resolve refresh \"%V\"", &host->name);
+
+    temp.name = host->name;
+
+    ctx = ngx_resolve_start(dcf->resolver, &temp);
+    if (ctx == NULL) {
+        goto failed;
+    }
+
+    if (ctx == NGX_NO_RESOLVER) {
+        ngx_log_error(NGX_LOG_ERR, ev->log, 0,
+                      "no resolver defined to refresh \"%V\" in upstream "
+                      "\"%V\"", &host->name, &dcf->upstream->host);
+        return;
+    }
+
+    ctx->name = host->name;
+    ctx->handler = ngx_http_upstream_dynamic_refresh_done;
+    ctx->data = host;
+    ctx->timeout = dcf->resolver_timeout;
+    ctx->cancelable = 1;
+
+    if (ngx_resolve_name(ctx) == NGX_OK) {
+        return;
+    }
+
+failed:
+
+    dcf->refreshes++;
+    dcf->failures++;
+
+    ngx_add_timer(ev, (dcf->fail_timeout ? dcf->fail_timeout : 1) * 1000);
+}
+
+
+static void
+ngx_http_upstream_dynamic_refresh_done(ngx_resolver_ctx_t *ctx)
+{
+    time_t                                 valid;
+    ngx_uint_t                             i;
+    ngx_pool_t                            *pool;
+    ngx_http_upstream_dynamic_host_t      *host;
+    ngx_http_upstream_dynamic_addrs_t     *addrs;
+    ngx_http_upstream_dynamic_srv_conf_t  *dcf;
+
+    host = ctx->data;
+    dcf = host->conf;
+
+    dcf->refreshes++;
+
+    if (ctx->state || ctx->naddrs == 0) {
+        dcf->failures++;
+        host->failed = 1;
+
+        ngx_log_error(NGX_LOG_ERR, host->event.log, 0,
+                      "upstream \"%V\": %V could not be resolved (%i: %s), "
+                      "refreshes:%ui changes:%ui failures:%ui",
+                      &dcf->upstream->host, &ctx->name, ctx->state,
+                      ngx_resolver_strerror(ctx->state),
+                      dcf->refreshes, dcf->changes, dcf->failures);
+
+        ngx_resolve_name_done(ctx);
+
+        ngx_add_timer(&host->event,
+                      (dcf->fail_timeout ? dcf->fail_timeout : 1) * 1000);
+        return;
+    }
+
+    host->failed = 0;
+    host->valid = ctx->valid;
+
+    if (ngx_http_upstream_dynamic_addrs_changed(host->addrs, ctx)) {
+
+        /*
+         * the new set is built aside and replaces the old one at once,
+         * requests copy the address they use
+         */
+
+        pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, host->event.log);
+        if (pool == NULL) {
+            goto done;
+        }
+
+        addrs = ngx_palloc(pool, sizeof(ngx_http_upstream_dynamic_addrs_t));
+        if (addrs == NULL) {
+            ngx_destroy_pool(pool);
+            goto done;
+        }
+
+        addrs->pool = pool;
+        addrs->naddrs = ctx->naddrs;
+
+        addrs->addrs = ngx_pcalloc(pool, ctx->naddrs * sizeof(ngx_addr_t));
+        if (addrs->addrs == NULL) {
+            ngx_destroy_pool(pool);
+            goto done;
+        }
+
+        for (i = 0; i < ctx->naddrs; i++) {
+            addrs->addrs[i].socklen = ctx->addrs[i].socklen;
+
+            addrs->addrs[i].sockaddr = ngx_palloc(pool, ctx->addrs[i].socklen);
+            if (addrs->addrs[i].sockaddr == NULL) {
+                ngx_destroy_pool(pool);
+                goto done;
+            }
+
+            ngx_memcpy(addrs->addrs[i].sockaddr, ctx->addrs[i].sockaddr,
+                       ctx->addrs[i].socklen);
+        }
+
+        if (host->addrs) {
+            ngx_destroy_pool(host->addrs->pool);
+        }
+
+        host->addrs = addrs;
+        host->current = 0;
+
+        dcf->changes++;
+
+        ngx_log_error(NGX_LOG_NOTICE, host->event.log, 0,
+                      "upstream \"%V\": %V resolved to %ui addresses, "
+                      "refreshes:%ui changes:%ui failures:%ui",
+                      &dcf->upstream->host, &ctx->name, addrs->naddrs,
+                      dcf->refreshes, dcf->changes, dcf->failures);
+    }
+
+done:
+
+    ngx_resolve_name_done(ctx);
+
+    /*
+     * the next refresh is due once the answer expires, the resolver
+     * still returns it from the cache during its last second
+     */
+
+    valid = host->valid - ngx_time() + 1;
+
+    ngx_add_timer(&host->event, (ngx_msec_t) ngx_max(valid, 1) * 1000);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_dynamic_addrs_changed(
+    ngx_http_upstream_dynamic_addrs_t *addrs, ngx_resolver_ctx_t *ctx)
+{
+    ngx_uint_t  i, j;
+
+    if (addrs == NULL || addrs->naddrs != ctx->naddrs) {
+        return 1;
+    }
+
+    /* the resolver rotates addresses, so the order is not compared */
+
+    for (i = 0; i < ctx->naddrs; i++) {
+
+        for (j = 0; j < addrs->naddrs; j++) {
+            if (ngx_cmp_sockaddr(ctx->addrs[i].sockaddr, ctx->addrs[i].socklen,
+                                 addrs->addrs[j].sockaddr,
+                                 addrs->addrs[j].socklen, 0)
+                == NGX_OK)
+            {
+                break;
+            }
+        }
+
+        if (j == addrs->naddrs) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
 static void
 ngx_http_upstream_free_dynamic_peer(ngx_peer_connection_t *pc, void *data,
     ngx_uint_t state)
@@ -567,6 +922,68 @@ ngx_http_upstream_dynamic_save_session(ngx_peer_connection_t *pc, void *data)
 #endif
 
 
+static ngx_int_t
+ngx_http_upstream_dynamic_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                             i, j;
+    ngx_http_conf_ctx_t                   *ctx;
+    ngx_http_core_loc_conf_t              *clcf;
+    ngx_http_upstream_dynamic_host_t      *host;
+    ngx_http_upstream_srv_conf_t         **uscfp;
+    ngx_http_upstream_main_conf_t         *umcf;
+    ngx_http_upstream_dynamic_srv_conf_t  *dcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    umcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_upstream_module);
+    if (umcf == NULL) {
+        return NGX_OK;
+    }
+
+    /* names are refreshed with the resolver of the http block */
+
+    ctx = (ngx_http_conf_ctx_t *) cycle->conf_ctx[ngx_http_module.index];
+    clcf = ctx->loc_conf[ngx_http_core_module.ctx_index];
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        dcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                              ngx_http_upstream_dynamic_module);
+
+        if (!dcf->enabled || dcf->hosts == NULL) {
+            continue;
+        }
+
+        dcf->resolver = clcf->resolver;
+        dcf->resolver_timeout = clcf->resolver_timeout == NGX_CONF_UNSET_MSEC
+                                ? 30000 : clcf->resolver_timeout;
+
+        host = dcf->hosts->elts;
+
+        for (j = 0; j < dcf->hosts->nelts; j++) {
+            host[j].event.handler = ngx_http_upstream_dynamic_refresh_handler;
+            host[j].event.data = &host[j];
+            host[j].event.log = cycle->log;
+            host[j].event.cancelable = 1;
+
+            ngx_add_timer(&host[j].event, 0);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
 static void *
 ngx_http_upstream_dynamic_create_conf(ngx_conf_t *cf)
 {
@@ -583,6 +1000,10 @@ ngx_http_upstream_dynamic_create_conf(ngx_conf_t *cf)
      *
      *     conf->original_init_upstream = NULL;
      *     conf->original_init_peer = NULL;
+     *     conf->hosts = NULL;
+     *     conf->refreshes = 0;
+     *     conf->changes = 0;
+     *     conf->failures = 0;
      */
 
     return conf;
@@ -4,6 +4,7 @@
 
 
 #include <ngx_http.h>
+#include <ngx_channel.h>
 #include <ngx_http_dyups.h>
 #ifdef NGX_DYUPS_LUA
 #include <ngx_http_dyups_lua.h>
@@ -17,6 +18,9 @@
 
 #define NGX_DYUPS_DELETE       1
 #define NGX_DYUPS_ADD          2
+#define NGX_DYUPS_ADD_SERVER   3
+#define NGX_DYUPS_DEL_SERVER   4
+#define NGX_DYUPS_SET_SERVER   5
 
 #define ngx_dyups_add_timer(ev, timeout)                                      \
     if (!ngx_exiting && !ngx_quit) ngx_add_timer(ev, (timeout))
@@ -44,9 +48,22 @@ typedef struct {
 } ngx_http_dyups_main_conf_t;
 
 
+/*
+ * A copy of the round robin peers made by a server change, it is freed
+ * once it is replaced and no request uses it.
+ */
+
+typedef struct {
+    ngx_pool_t                          *pool;
+    ngx_uint_t                           ref;
+    ngx_uint_t                           retired;
+} ngx_http_dyups_peers_t;
+
+
 typedef struct {
     ngx_uint_t                           ref;
     ngx_http_upstream_init_peer_pt       init;
+    ngx_http_dyups_peers_t              *peers;
 } ngx_http_dyups_upstream_srv_conf_t;
 
 
@@ -149,6 +166,34 @@ static ngx_int_t ngx_dyups_do_update(ngx_str_t *name, ngx_buf_t *buf,
 static ngx_int_t ngx_dyups_sandbox_update(ngx_buf_t *buf, ngx_str_t *rv);
 static void ngx_dyups_purge_msg(ngx_pid_t opid, ngx_pid_t npid);
 static void ngx_http_dyups_clean_request(void *data);
+static void ngx_http_dyups_notify(void);
+static void ngx_http_dyups_channel_handler(ngx_event_t *ev);
+static ngx_int_t ngx_dyups_update_servers(ngx_str_t *name, ngx_buf_t *buf,
+    ngx_uint_t flag, ngx_str_t *rv);
+static ngx_int_t ngx_dyups_do_update_servers(ngx_str_t *name, ngx_buf_t *buf,
+    ngx_uint_t flag, ngx_str_t *rv);
+static ngx_array_t *ngx_dyups_parse_servers(ngx_http_dyups_srv_conf_t *duscf,
+    ngx_pool_t *pool, ngx_buf_t *buf);
+static char *ngx_dyups_server_handler(ngx_conf_t *cf, ngx_command_t *dummy,
+    void *conf);
+static ngx_int_t ngx_dyups_copy_peers(ngx_http_dyups_srv_conf_t *duscf,
+    ngx_array_t *add, ngx_array_t *del, ngx_str_t *rv);
+static ngx_int_t ngx_dyups_set_servers(ngx_http_dyups_srv_conf_t *duscf,
+    ngx_array_t *servers, ngx_str_t *rv);
+static ngx_array_t *ngx_dyups_copy_servers(ngx_pool_t *pool,
+    ngx_array_t *servers, ngx_array_t *add, ngx_array_t *del);
+static ngx_int_t ngx_dyups_copy_server(ngx_pool_t *pool,
+    ngx_http_upstream_server_t *dst, ngx_http_upstream_server_t *src,
+    ngx_array_t *del);
+static ngx_int_t ngx_dyups_copy_peer(ngx_pool_t *pool,
+    ngx_http_upstream_rr_peer_t *peer);
+static void ngx_dyups_count_peers(ngx_http_upstream_rr_peers_t *peers);
+static ngx_http_upstream_rr_peer_t *ngx_dyups_find_peer(
+    ngx_http_upstream_rr_peers_t *peers, ngx_addr_t *addr);
+static ngx_addr_t *ngx_dyups_find_addr(ngx_array_t *servers,
+    struct sockaddr *sockaddr, socklen_t socklen);
+static void ngx_http_dyups_release_peers(void *data);
+static void ngx_http_dyups_free_peers(void *data);
 
 
 #if (NGX_HTTP_SSL)
@@ -560,6 +605,7 @@ ngx_http_dyups_init_process(ngx_cycle_t *cycle)
     }
 
     ngx_http_dyups_api_enable = 1;
+    ngx_dyups_channel_handler = ngx_http_dyups_channel_handler;
 
     timer = &ngx_dyups_global_ctx.msg_timer;
     ngx_memzero(timer, sizeof(ngx_event_t));
@@ -568,6 +614,10 @@ ngx_http_dyups_init_process(ngx_cycle_t *cycle)
     timer->log = cycle->log;
     timer->data = dmcf;
 
+    /* the workers are notified of the messages, the timer is a fallback */
+
+    timer->cancelable = 1;
+
     ngx_add_timer(timer, dmcf->read_msg_timeout);
 
     shpool = ngx_dyups_global_ctx.shpool;
@@ -762,8 +812,11 @@ ngx_dyups_delete_upstream(ngx_str_t *name, ngx_str_t *rv)
         ngx_str_set(rv, "alert: delte success but not sync to other process");
         ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0, "[dyups] %V", &rv);
         status = NGX_HTTP_INTERNAL_SERVER_ERROR;
+        goto finish;
     }
 
+    ngx_http_dyups_notify();
+
  finish:
 
     ngx_shmtx_unlock(&shpool->mutex);
@@ -1136,6 +1189,7 @@ ngx_http_dyups_body_handler(ngx_http_request_t *r)
     ngx_str_t                   *value, rv, name;
     ngx_int_t                    status;
     ngx_buf_t                   *body;
+    ngx_uint_t                   flag;
     ngx_array_t                 *res;
 
     ngx_str_set(&rv, "");
@@ -1174,7 +1228,7 @@ ngx_http_dyups_body_handler(ngx_http_request_t *r)
         goto finish;
     }
 
-    if (res->nelts != 2) {
+    if (res->nelts != 2 && res->nelts != 3) {
         ngx_str_set(&rv, "not support this interface");
         status = NGX_HTTP_NOT_FOUND;
         goto finish;
@@ -1197,6 +1251,38 @@ ngx_http_dyups_body_handler(ngx_http_request_t *r)
 
     name = value[1];
 
+    if (res->nelts == 3) {
+
+        /* url: /upstream/name/add, /upstream/name/remove or /upstream/name/set */
+
+        if (value[2].len == 3
+            && ngx_strncmp(value[2].data, "add", 3) == 0)
+        {
+            flag = NGX_DYUPS_ADD_SERVER;
+
+        } else if (value[2].len == 6
+                   && ngx_strncmp(value[2].data, "remove", 6) == 0)
+        {
+            flag = NGX_DYUPS_DEL_SERVER;
+
+        } else if (value[2].len == 3
+                   && ngx_strncmp(value[2].data, "set", 3) == 0)
+        {
+            flag = NGX_DYUPS_SET_SERVER;
+
+        } else {
+            ngx_str_set(&rv, "not support this api");
+            status = NGX_HTTP_NOT_FOUND;
+            goto finish;
+        }
+
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0,
+                      "[dyups] post upstream name: %V %V", &name, &value[2]);
+
+        status = ngx_dyups_update_servers(&name, body, flag, &rv);
+        goto finish;
+    }
+
     ngx_log_error(NGX_LOG_INFO, r->connection->log, 0,
                   "[dyups] post upstream name: %V", &name);
 
@@ -1253,6 +1339,9 @@ ngx_dyups_update_upstream(ngx_str_t *name, ngx_buf_t *buf, ngx_str_t *rv)
             ngx_str_set(rv, "alert: update success "
                         "but not sync to other process");
             status = NGX_HTTP_INTERNAL_SERVER_ERROR;
+
+        } else {
+            ngx_http_dyups_notify();
         }
     }
 
@@ -1971,6 +2060,18 @@ ngx_http_dyups_init_peer(ngx_http_request_t *r,
     cln->handler = ngx_http_dyups_clean_request;
     cln->data = &dscf->ref;
 
+    if (dscf->peers) {
+        cln = ngx_pool_cleanup_add(r->pool, 0);
+        if (cln == NULL) {
+            return NGX_ERROR;
+        }
+
+        dscf->peers->ref++;
+
+        cln->handler = ngx_http_dyups_release_peers;
+        cln->data = dscf->peers;
+    }
+
     return NGX_OK;
 }
 
@@ -2343,6 +2444,26 @@ ngx_dyups_sync_cmd(ngx_pool_t *pool, ngx_str_t *name, ngx_str_t *content,
             return NGX_ERROR;
         }
 
+        return NGX_OK;
+
+    } else if (flag == NGX_DYUPS_ADD_SERVER
+               || flag == NGX_DYUPS_DEL_SERVER
+               || flag == NGX_DYUPS_SET_SERVER)
+    {
+        body.start = body.pos = content->data;
+        body.end = body.last = content->data + content->len;
+        body.temporary = 1;
+
+        rc = ngx_dyups_do_update_servers(name, &body, flag, &rv);
+
+        ngx_log_error(NGX_LOG_INFO, ngx_cycle->log, 0,
+                      "[dyups] sync servers %ui: %V rv: %V rc: %i",
+                      flag, name, &rv, rc);
+
+        if (rc != NGX_HTTP_OK) {
+            return NGX_ERROR;
+        }
+
         return NGX_OK;
     }
 
@@ -2350,6 +2471,835 @@ ngx_dyups_sync_cmd(ngx_pool_t *pool, ngx_str_t *name, ngx_str_t *content,
 }
 
 
+static void
+ngx_http_dyups_notify(void)
+{
+    ngx_int_t      i;
+    ngx_channel_t  ch;
+
+    /*
+     * The other workers are woken up through their channels to read
+     * the message at once, instead of waiting for the read_msg timer.
+     */
+
+    ngx_memzero(&ch, sizeof(ngx_channel_t));
+    ch.command = NGX_CMD_DYUPS;
+    ch.pid = ngx_pid;
+    ch.slot = ngx_process_slot;
+    ch.fd = -1;
+
+    /*
+     * the workers started later are only known by the channels passed,
+     * ngx_last_process does not count them
+     */
+
+    for (i = 0; i < NGX_MAX_PROCESSES; i++) {
+
+        if (i == ngx_process_slot
+            || ngx_processes[i].pid <= 0
+            || ngx_processes[i].channel[0] == -1)
+        {
+            continue;
+        }
+
+        (void) ngx_write_channel(ngx_processes[i].channel[0],
+                                 &ch, sizeof(ngx_channel_t), ngx_cycle->log);
+    }
+}
+
+
+static void
+ngx_http_dyups_channel_handler(ngx_event_t *ev)
+{
+    ngx_event_t  *timer;
+
+    if (!ngx_http_dyups_api_enable || ngx_exiting || ngx_quit) {
+        return;
+    }
+
+    timer = &ngx_dyups_global_ctx.msg_timer;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ev->log, 0, "[dyups] notified");
+
+    ngx_http_dyups_read_msg(timer);
+}
+
+
+static ngx_int_t
+ngx_dyups_update_servers(ngx_str_t *name, ngx_buf_t *buf, ngx_uint_t flag,
+    ngx_str_t *rv)
+{
+    ngx_int_t                    status;
+    ngx_event_t                 *timer;
+    ngx_slab_pool_t             *shpool;
+    ngx_http_dyups_main_conf_t  *dmcf;
+
+    dmcf = ngx_http_cycle_get_module_main_conf(ngx_cycle,
+                                               ngx_http_dyups_module);
+    timer = &ngx_dyups_global_ctx.msg_timer;
+    shpool = ngx_dyups_global_ctx.shpool;
+
+    if (!ngx_http_dyups_api_enable) {
+        ngx_str_set(rv, "API disabled\n");
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    if (!dmcf->trylock) {
+
+        ngx_shmtx_lock(&shpool->mutex);
+
+    } else {
+
+        if (!ngx_shmtx_trylock(&shpool->mutex)) {
+            ngx_str_set(rv, "wait and try again\n");
+            return NGX_HTTP_CONFLICT;
+        }
+    }
+
+    ngx_http_dyups_read_msg_locked(timer);
+
+    status = ngx_dyups_do_update_servers(name, buf, flag, rv);
+    if (status == NGX_HTTP_OK) {
+
+        if (ngx_http_dyups_send_msg(name, buf, flag)) {
+            ngx_str_set(rv, "alert: update success "
+                        "but not sync to other process");
+            status = NGX_HTTP_INTERNAL_SERVER_ERROR;
+
+        } else {
+            ngx_http_dyups_notify();
+        }
+    }
+
+    ngx_shmtx_unlock(&shpool->mutex);
+
+    return status;
+}
+
+
+static ngx_int_t
+ngx_dyups_do_update_servers(ngx_str_t *name, ngx_buf_t *buf, ngx_uint_t flag,
+    ngx_str_t *rv)
+{
+    ngx_int_t                            idx, status;
+    ngx_pool_t                          *pool;
+    ngx_array_t                         *servers;
+    ngx_http_dyups_srv_conf_t           *duscf;
+    ngx_http_upstream_srv_conf_t        *uscf;
+    ngx_http_dyups_upstream_srv_conf_t  *dscf;
+
+    duscf = ngx_dyups_find_upstream(name, &idx);
+    if (duscf == NULL || duscf->deleted) {
+        ngx_str_set(rv, "not found upstream");
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    uscf = duscf->upstream;
+    dscf = uscf->srv_conf[ngx_http_dyups_module.ctx_index];
+
+    /* only the round robin peers built by dyups can be changed in place */
+
+    if (duscf->pool == NULL
+        || uscf->peer.init != ngx_http_dyups_init_peer
+        || dscf->init != ngx_http_upstream_init_round_robin_peer)
+    {
+        ngx_str_set(rv, "servers of this upstream can not be changed, "
+                    "update the whole upstream");
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    /* the servers are copied to the pool of the new peers if needed */
+
+    pool = ngx_create_pool(ngx_pagesize, ngx_cycle->log);
+    if (pool == NULL) {
+        ngx_str_set(rv, "out of memory");
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    servers = ngx_dyups_parse_servers(duscf, pool, buf);
+
+    if (servers == NULL || servers->nelts == 0) {
+        ngx_str_set(rv, "invalid servers");
+        status = NGX_HTTP_BAD_REQUEST;
+        goto done;
+    }
+
+    switch (flag) {
+
+    case NGX_DYUPS_ADD_SERVER:
+        status = ngx_dyups_copy_peers(duscf, servers, NULL, rv);
+        break;
+
+    case NGX_DYUPS_DEL_SERVER:
+        status = ngx_dyups_copy_peers(duscf, NULL, servers, rv);
+        break;
+
+    default: /* NGX_DYUPS_SET_SERVER */
+        status = ngx_dyups_set_servers(duscf, servers, rv);
+        break;
+    }
+
+    if (status == NGX_HTTP_OK) {
+        ngx_str_set(rv, "success");
+    }
+
+done:
+
+    ngx_destroy_pool(pool);
+
+    return status;
+}
+
+
+static ngx_array_t *
+ngx_dyups_parse_servers(ngx_http_dyups_srv_conf_t *duscf, ngx_pool_t *pool,
+    ngx_buf_t *buf)
+{
+    ngx_buf_t                     b;
+    ngx_conf_t                    cf;
+    ngx_conf_file_t               conf_file;
+    ngx_http_upstream_srv_conf_t  uscf;
+
+    /* the servers are parsed aside, with the flags of the upstream */
+
+    uscf = *duscf->upstream;
+
+    uscf.servers = ngx_array_create(pool, 4,
+                                    sizeof(ngx_http_upstream_server_t));
+    if (uscf.servers == NULL) {
+        return NULL;
+    }
+
+    b = *buf;
+
+    ngx_memzero(&conf_file, sizeof(ngx_conf_file_t));
+    conf_file.file.fd = NGX_INVALID_FILE;
+    conf_file.buffer = &b;
+
+    ngx_memzero(&cf, sizeof(ngx_conf_t));
+    cf.name = "dyups_parse_servers";
+    cf.pool = pool;
+    cf.cycle = (ngx_cycle_t *) ngx_cycle;
+    cf.module_type = NGX_HTTP_MODULE;
+    cf.cmd_type = NGX_HTTP_UPS_CONF;
+    cf.log = ngx_cycle->log;
+    cf.ctx = duscf->ctx;
+    cf.conf_file = &conf_file;
+    cf.handler = ngx_dyups_server_handler;
+    cf.handler_conf = &uscf;
+
+    cf.args = ngx_array_create(pool, 10, sizeof(ngx_str_t));
+    if (cf.args == NULL) {
+        return NULL;
+    }
+
+    if (ngx_conf_parse(&cf, NULL) != NGX_CONF_OK) {
+        return NULL;
+    }
+
+    return uscf.servers;
+}
+
+
+static char *
+ngx_dyups_server_handler(ngx_conf_t *cf, ngx_command_t *dummy, void *conf)
+{
+    ngx_str_t      *value;
+    ngx_command_t  *cmd;
+
+    value = cf->args->elts;
+
+    if (cf->args->nelts < 2
+        || value[0].len != sizeof("server") - 1
+        || ngx_strncmp(value[0].data, "server", value[0].len) != 0)
+    {
+        ngx_conf_log_error(NGX_LOG_ERR, cf, 0,
+                           "[dyups] invalid server \"%V\"", &value[0]);
+        return NGX_CONF_ERROR;
+    }
+
+    for (cmd = ngx_http_upstream_module.commands; cmd->name.len; cmd++) {
+
+        if (cmd->name.len == value[0].len
+            && ngx_strncmp(cmd->name.data, value[0].data, value[0].len) == 0)
+        {
+            return cmd->set(cf, cmd, conf);
+        }
+    }
+
+    return NGX_CONF_ERROR;
+}
+
+
+/*
+ * Servers are added and removed on a copy of the peers, since the requests
+ * in progress keep using the peers they were started with.  Each copy has
+ * its own pool with the addresses and the server list, and nothing refers
+ * to an older copy, so it is destroyed as soon as it is not used.
+ */
+
+static ngx_int_t
+ngx_dyups_copy_peers(ngx_http_dyups_srv_conf_t *duscf, ngx_array_t *add,
+    ngx_array_t *del, ngx_str_t *rv)
+{
+    ngx_uint_t                           i, j, k, n[2];
+    ngx_addr_t                          *addr;
+    ngx_pool_t                          *pool;
+    ngx_array_t                         *servers;
+    ngx_pool_cleanup_t                  *cln;
+    ngx_http_dyups_peers_t              *version;
+    ngx_http_upstream_server_t          *us;
+    ngx_http_upstream_rr_peer_t         *peer, *p, **peerp[2];
+    ngx_http_upstream_rr_peers_t        *peers, *old, *list[2];
+    ngx_http_upstream_srv_conf_t        *uscf;
+    ngx_http_dyups_upstream_srv_conf_t  *dscf;
+#if (NGX_HTTP_UPSTREAM_CHECK)
+    ngx_addr_t                           check;
+#endif
+
+    uscf = duscf->upstream;
+    dscf = uscf->srv_conf[ngx_http_dyups_module.ctx_index];
+    old = uscf->peer.data;
+
+    n[0] = 0;
+    n[1] = 0;
+
+    for (k = 0, peers = old; peers; k++, peers = peers->next) {
+        for (peer = peers->peer; peer; peer = peer->next) {
+            if (del == NULL
+                || ngx_dyups_find_addr(del, peer->sockaddr, peer->socklen)
+                   == NULL)
+            {
+                n[k]++;
+            }
+        }
+    }
+
+    if (del) {
+        us = del->elts;
+        for (i = 0; i < del->nelts; i++) {
+            for (j = 0; j < us[i].naddrs; j++) {
+                if (ngx_dyups_find_peer(old, &us[i].addrs[j]) == NULL) {
+                    ngx_str_set(rv, "server not found");
+                    return NGX_HTTP_NOT_FOUND;
+                }
+            }
+        }
+    }
+
+    if (add) {
+        us = add->elts;
+        for (i = 0; i < add->nelts; i++) {
+            for (j = 0; j < us[i].naddrs; j++) {
+                if (ngx_dyups_find_peer(old, &us[i].addrs[j])) {
+                    ngx_str_set(rv, "server exists");
+                    return NGX_HTTP_CONFLICT;
+                }
+            }
+
+            n[us[i].backup ? 1 : 0] += us[i].naddrs;
+        }
+    }
+
+    if (n[0] == 0) {
+        ngx_str_set(rv, "no servers left");
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    pool = ngx_create_pool(ngx_pagesize, ngx_cycle->log);
+    if (pool == NULL) {
+        goto nomem;
+    }
+
+    version = ngx_pcalloc(pool, sizeof(ngx_http_dyups_peers_t));
+    if (version == NULL) {
+        goto failed;
+    }
+
+    version->pool = pool;
+
+    servers = ngx_dyups_copy_servers(pool, uscf->servers, add, del);
+    if (servers == NULL) {
+        goto failed;
+    }
+
+    list[1] = NULL;
+
+    for (k = 0; k < 2; k++) {
+
+        if (n[k] == 0) {
+            continue;
+        }
+
+        list[k] = ngx_pcalloc(pool, sizeof(ngx_http_upstream_rr_peers_t));
+        if (list[k] == NULL) {
+            goto failed;
+        }
+
+        peer = ngx_pcalloc(pool, sizeof(ngx_http_upstream_rr_peer_t) * n[k]);
+        if (peer == NULL) {
+            goto failed;
+        }
+
+        list[k]->peer = peer;
+        list[k]->name = &uscf->host;
+        peerp[k] = &list[k]->peer;
+    }
+
+    /* keep the peers which are not removed */
+
+    for (k = 0, peers = old; peers; k++, peers = peers->next) {
+
+        p = list[k] ? list[k]->peer : NULL;
+
+        for (peer = peers->peer; peer; peer = peer->next) {
+
+            if (del
+                && ngx_dyups_find_addr(del, peer->sockaddr, peer->socklen))
+            {
+#if (NGX_HTTP_UPSTREAM_CHECK)
+                if (peer->check_index != (ngx_uint_t) NGX_ERROR) {
+                    check.sockaddr = peer->sockaddr;
+                    check.socklen = peer->socklen;
+                    check.name = peer->name;
+
+                    ngx_http_upstream_check_delete_dynamic_peer(&uscf->host,
+                                                                &check);
+                }
+#endif
+                continue;
+            }
+
+            *p = *peer;
+
+            if (ngx_dyups_copy_peer(pool, p) != NGX_OK) {
+                goto failed;
+            }
+
+            /* the connections in progress are counted on the old peer */
+
+            p->conns = 0;
+#if (NGX_HTTP_SSL || NGX_COMPAT)
+            p->ssl_session = NULL;
+            p->ssl_session_len = 0;
+#endif
+
+            *peerp[k] = p;
+            peerp[k] = &p->next;
+            p++;
+        }
+
+        if (list[k]) {
+            list[k]->number = p - list[k]->peer;
+        }
+    }
+
+    if (add) {
+        us = add->elts;
+
+        for (i = 0; i < add->nelts; i++) {
+
+            k = us[i].backup ? 1 : 0;
+            p = list[k]->peer + list[k]->number;
+
+            for (j = 0; j < us[i].naddrs; j++) {
+                addr = &us[i].addrs[j];
+
+                p->sockaddr = addr->sockaddr;
+                p->socklen = addr->socklen;
+                p->name = addr->name;
+#if (T_NGX_HTTP_UPSTREAM_ID)
+                p->id = us[i].id;
+#endif
+                p->weight = us[i].weight;
+                p->effective_weight = us[i].weight;
+                p->current_weight = 0;
+                p->max_conns = us[i].max_conns;
+                p->max_fails = us[i].max_fails;
+                p->fail_timeout = us[i].fail_timeout;
+                p->down = us[i].down;
+                p->server = us[i].name;
+#if (T_NGX_HTTP_DYNAMIC_RESOLVE)
+                p->host = us[i].host;
+#endif
+
+                if (ngx_dyups_copy_peer(pool, p) != NGX_OK) {
+                    goto failed;
+                }
+
+#if (NGX_HTTP_UPSTREAM_CHECK)
+                if (!us[i].down) {
+                    p->check_index =
+                        ngx_http_upstream_check_add_dynamic_peer(duscf->pool,
+                                                                 uscf, addr);
+                } else {
+                    p->check_index = (ngx_uint_t) NGX_ERROR;
+                }
+#endif
+
+                *peerp[k] = p;
+                peerp[k] = &p->next;
+                p++;
+            }
+
+            list[k]->number = p - list[k]->peer;
+        }
+    }
+
+    list[0]->next = list[1];
+
+    for (k = 0; k < 2 && list[k]; k++) {
+        ngx_dyups_count_peers(list[k]);
+    }
+
+    list[0]->single = (list[0]->number == 1 && list[1] == NULL);
+
+    if (dscf->peers == NULL) {
+
+        /* the last copy goes away with the upstream */
+
+        cln = ngx_pool_cleanup_add(duscf->pool, 0);
+        if (cln == NULL) {
+            goto failed;
+        }
+
+        cln->handler = ngx_http_dyups_free_peers;
+        cln->data = dscf;
+
+    } else if (dscf->peers->ref == 0) {
+        ngx_destroy_pool(dscf->peers->pool);
+
+    } else {
+        dscf->peers->retired = 1;
+    }
+
+    dscf->peers = version;
+    uscf->peer.data = list[0];
+    uscf->servers = servers;
+
+    return NGX_HTTP_OK;
+
+failed:
+
+    ngx_destroy_pool(pool);
+
+nomem:
+
+    ngx_str_set(rv, "out of memory");
+    return NGX_HTTP_INTERNAL_SERVER_ERROR;
+}
+
+
+static ngx_int_t
+ngx_dyups_set_servers(ngx_http_dyups_srv_conf_t *duscf, ngx_array_t *servers,
+    ngx_str_t *rv)
+{
+    ngx_uint_t                     i, j, k, n;
+    ngx_http_upstream_server_t    *us, *s;
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    peers = duscf->upstream->peer.data;
+    us = servers->elts;
+
+    for (i = 0; i < servers->nelts; i++) {
+        for (j = 0; j < us[i].naddrs; j++) {
+            if (ngx_dyups_find_peer(peers, &us[i].addrs[j]) == NULL) {
+                ngx_str_set(rv, "server not found");
+                return NGX_HTTP_NOT_FOUND;
+            }
+        }
+    }
+
+    /* the parameters are changed in place, the backup flag is ignored */
+
+    for (i = 0; i < servers->nelts; i++) {
+        for (j = 0; j < us[i].naddrs; j++) {
+            peer = ngx_dyups_find_peer(peers, &us[i].addrs[j]);
+
+            peer->weight = us[i].weight;
+            peer->effective_weight = us[i].weight;
+            peer->max_conns = us[i].max_conns;
+            peer->max_fails = us[i].max_fails;
+            peer->fail_timeout = us[i].fail_timeout;
+            peer->down = us[i].down;
+        }
+
+        s = duscf->upstream->servers->elts;
+        n = duscf->upstream->servers->nelts;
+
+        for (k = 0; k < n; k++) {
+            for (j = 0; j < s[k].naddrs; j++) {
+                if (ngx_dyups_find_addr(servers, s[k].addrs[j].sockaddr,
+                                        s[k].addrs[j].socklen))
+                {
+                    s[k].weight = us[i].weight;
+                    s[k].max_conns = us[i].max_conns;
+                    s[k].max_fails = us[i].max_fails;
+                    s[k].fail_timeout = us[i].fail_timeout;
+                    s[k].down = us[i].down;
+                    break;
+                }
+            }
+        }
+    }
+
+    for ( /* void */ ; peers; peers = peers->next) {
+        ngx_dyups_count_peers(peers);
+    }
+
+    return NGX_HTTP_OK;
+}
+
+
+static ngx_array_t *
+ngx_dyups_copy_servers(ngx_pool_t *pool, ngx_array_t *servers,
+    ngx_array_t *add, ngx_array_t *del)
+{
+    ngx_uint_t                   i, n;
+    ngx_array_t                 *list;
+    ngx_http_upstream_server_t  *us, *s;
+
+    n = servers->nelts + (add ? add->nelts : 0);
+
+    list = ngx_array_create(pool, n, sizeof(ngx_http_upstream_server_t));
+    if (list == NULL) {
+        return NULL;
+    }
+
+    s = servers->elts;
+
+    for (i = 0; i < servers->nelts; i++) {
+        us = ngx_array_push(list);
+        if (us == NULL) {
+            return NULL;
+        }
+
+        if (ngx_dyups_copy_server(pool, us, &s[i], del) != NGX_OK) {
+            return NULL;
+        }
+
+        if (us->naddrs == 0) {
+            list->nelts--;
+        }
+    }
+
+    if (add) {
+        s = add->elts;
+
+        for (i = 0; i < add->nelts; i++) {
+            us = ngx_array_push(list);
+            if (us == NULL) {
+                return NULL;
+            }
+
+            if (ngx_dyups_copy_server(pool, us, &s[i], NULL) != NGX_OK) {
+                return NULL;
+            }
+        }
+    }
+
+    return list;
+}
+
+
+static ngx_int_t
+ngx_dyups_copy_server(ngx_pool_t *pool, ngx_http_upstream_server_t *dst,
+    ngx_http_upstream_server_t *src, ngx_array_t *del)
+{
+    ngx_uint_t   i;
+    ngx_addr_t  *addr;
+
+    *dst = *src;
+
+    dst->name.data = ngx_pstrdup(pool, &src->name);
+    if (dst->name.data == NULL) {
+        return NGX_ERROR;
+    }
+
+#if (T_NGX_HTTP_UPSTREAM_ID)
+    dst->id.data = ngx_pstrdup(pool, &src->id);
+    if (dst->id.data == NULL) {
+        return NGX_ERROR;
+    }
+#endif
+
+#if (T_NGX_HTTP_DYNAMIC_RESOLVE)
+    dst->host.data = ngx_pstrdup(pool, &src->host);
+    if (dst->host.data == NULL) {
+        return NGX_ERROR;
+    }
+#endif
+
+    dst->addrs = ngx_palloc(pool, src->naddrs * sizeof(ngx_addr_t));
+    if (dst->addrs == NULL) {
+        return NGX_ERROR;
+    }
+
+    dst->naddrs = 0;
+
+    for (i = 0; i < src->naddrs; i++) {
+
+        if (del && ngx_dyups_find_addr(del, src->addrs[i].sockaddr,
+                                       src->addrs[i].socklen))
+        {
+            continue;
+        }
+
+        addr = &dst->addrs[dst->naddrs++];
+
+        addr->socklen = src->addrs[i].socklen;
+        addr->sockaddr = ngx_palloc(pool, addr->socklen);
+        if (addr->sockaddr == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(addr->sockaddr, src->addrs[i].sockaddr, addr->socklen);
+
+        addr->name.len = src->addrs[i].name.len;
+        addr->name.data = ngx_pstrdup(pool, &src->addrs[i].name);
+        if (addr->name.data == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_dyups_copy_peer(ngx_pool_t *pool, ngx_http_upstream_rr_peer_t *peer)
+{
+    struct sockaddr  *sockaddr;
+
+    sockaddr = ngx_palloc(pool, peer->socklen);
+    if (sockaddr == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(sockaddr, peer->sockaddr, peer->socklen);
+    peer->sockaddr = sockaddr;
+
+    peer->name.data = ngx_pstrdup(pool, &peer->name);
+    if (peer->name.data == NULL) {
+        return NGX_ERROR;
+    }
+
+    peer->server.data = ngx_pstrdup(pool, &peer->server);
+    if (peer->server.data == NULL) {
+        return NGX_ERROR;
+    }
+
+#if (T_NGX_HTTP_UPSTREAM_ID)
+    peer->id.data = ngx_pstrdup(pool, &peer->id);
+    if (peer->id.data == NULL) {
+        return NGX_ERROR;
+    }
+#endif
+
+#if (T_NGX_HTTP_DYNAMIC_RESOLVE)
+    peer->host.data = ngx_pstrdup(pool, &peer->host);
+    if (peer->host.data == NULL) {
+        return NGX_ERROR;
+    }
+#endif
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_dyups_count_peers(ngx_http_upstream_rr_peers_t *peers)
+{
+    ngx_uint_t                    n, w;
+    ngx_http_upstream_rr_peer_t  *peer;
+
+    n = 0;
+    w = 0;
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+        n++;
+        w += peer->weight;
+    }
+
+    peers->number = n;
+    peers->total_weight = w;
+    peers->weighted = (w != n);
+
+#if (T_NGX_HTTP_UPSTREAM_RANDOM)
+    peers->init_number = ngx_random() % n;
+#endif
+}
+
+
+static ngx_http_upstream_rr_peer_t *
+ngx_dyups_find_peer(ngx_http_upstream_rr_peers_t *peers, ngx_addr_t *addr)
+{
+    ngx_http_upstream_rr_peer_t  *peer;
+
+    for ( /* void */ ; peers; peers = peers->next) {
+        for (peer = peers->peer; peer; peer = peer->next) {
+            if (ngx_cmp_sockaddr(peer->sockaddr, peer->socklen,
+                                 addr->sockaddr, addr->socklen, 1)
+                == NGX_OK)
+            {
+                return peer;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+static ngx_addr_t *
+ngx_dyups_find_addr(ngx_array_t *servers, struct sockaddr *sockaddr,
+    socklen_t socklen)
+{
+    ngx_uint_t                   i, j;
+    ngx_http_upstream_server_t  *us;
+
+    us = servers->elts;
+
+    for (i = 0; i < servers->nelts; i++) {
+        for (j = 0; j < us[i].naddrs; j++) {
+            if (ngx_cmp_sockaddr(us[i].addrs[j].sockaddr,
+                                 us[i].addrs[j].socklen,
+                                 sockaddr, socklen, 1)
+                == NGX_OK)
+            {
+                return &us[i].addrs[j];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_http_dyups_release_peers(void *data)
+{
+    ngx_http_dyups_peers_t  *peers = data;
+
+    if (--peers->ref == 0 && peers->retired) {
+        ngx_destroy_pool(peers->pool);
+    }
+}
+
+
+static void
+ngx_http_dyups_free_peers(void *data)
+{
+    ngx_http_dyups_upstream_srv_conf_t  *dscf = data;
+
+    if (dscf->peers) {
+        ngx_destroy_pool(dscf->peers->pool);
+        dscf->peers = NULL;
+    }
+}
+
+
 #if (NGX_HTTP_SSL)
 
 static ngx_int_t
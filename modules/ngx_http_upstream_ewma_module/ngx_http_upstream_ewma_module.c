@@ -0,0 +1,478 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+#if (NGX_HTTP_UPSTREAM_CHECK)
+#include "ngx_http_upstream_check_module.h"
+#endif
+
+
+/* the response time is kept in microseconds */
+#define NGX_HTTP_UPSTREAM_EWMA_SCALE    1000
+
+/* the cost of a peer never goes below the resolution of the timer */
+#define NGX_HTTP_UPSTREAM_EWMA_MIN      NGX_HTTP_UPSTREAM_EWMA_SCALE
+
+
+typedef struct {
+    ngx_msec_t                            decay;
+    ngx_http_upstream_rr_peer_t         **peer;
+} ngx_http_upstream_ewma_srv_conf_t;
+
+
+typedef struct {
+    /* the round robin data must be first */
+    ngx_http_upstream_rr_peer_data_t      rrp;
+
+    ngx_http_upstream_ewma_srv_conf_t    *conf;
+    ngx_msec_t                            start;
+    u_char                                tries;
+} ngx_http_upstream_ewma_peer_data_t;
+
+
+static ngx_int_t ngx_http_upstream_init_ewma(ngx_conf_t *cf,
+    ngx_http_upstream_srv_conf_t *us);
+static ngx_int_t ngx_http_upstream_update_ewma(ngx_pool_t *pool,
+    ngx_http_upstream_srv_conf_t *us);
+static ngx_int_t ngx_http_upstream_init_ewma_peer(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *us);
+static ngx_int_t ngx_http_upstream_get_ewma_peer(ngx_peer_connection_t *pc,
+    void *data);
+static void ngx_http_upstream_free_ewma_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
+static uint64_t ngx_http_upstream_ewma_score(
+    ngx_http_upstream_ewma_srv_conf_t *conf, ngx_http_upstream_rr_peer_t *peer);
+static void *ngx_http_upstream_ewma_create_conf(ngx_conf_t *cf);
+static char *ngx_http_upstream_ewma(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_upstream_ewma_commands[] = {
+
+    { ngx_string("ewma"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_NOARGS|NGX_CONF_TAKE1,
+      ngx_http_upstream_ewma,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_upstream_ewma_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    ngx_http_upstream_ewma_create_conf,    /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_upstream_ewma_module = {
+    NGX_MODULE_V1,
+    &ngx_http_upstream_ewma_module_ctx,    /* module context */
+    ngx_http_upstream_ewma_commands,       /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_int_t
+ngx_http_upstream_init_ewma(ngx_conf_t *cf, ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, cf->log, 0, "init ewma");
+
+    if (ngx_http_upstream_init_round_robin(cf, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    us->peer.init = ngx_http_upstream_init_ewma_peer;
+
+#if (NGX_HTTP_UPSTREAM_ZONE)
+    if (us->shm_zone) {
+        return NGX_OK;
+    }
+#endif
+
+    return ngx_http_upstream_update_ewma(cf->pool, us);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_update_ewma(ngx_pool_t *pool,
+    ngx_http_upstream_srv_conf_t *us)
+{
+    size_t                              size;
+    ngx_uint_t                          i;
+    ngx_http_upstream_rr_peer_t        *peer, **p;
+    ngx_http_upstream_rr_peers_t       *peers;
+    ngx_http_upstream_ewma_srv_conf_t  *ecf;
+
+    ecf = ngx_http_conf_upstream_srv_conf(us, ngx_http_upstream_ewma_module);
+
+    peers = us->peer.data;
+
+    size = peers->number * sizeof(ngx_http_upstream_rr_peer_t *);
+
+    p = pool ? ngx_palloc(pool, size) : ngx_alloc(size, ngx_cycle->log);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (peer = peers->peer, i = 0; peer; peer = peer->next, i++) {
+        p[i] = peer;
+    }
+
+    ecf->peer = p;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_init_ewma_peer(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_http_upstream_ewma_srv_conf_t   *ecf;
+    ngx_http_upstream_ewma_peer_data_t  *ep;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "init ewma peer");
+
+    ecf = ngx_http_conf_upstream_srv_conf(us, ngx_http_upstream_ewma_module);
+
+    ep = ngx_palloc(r->pool, sizeof(ngx_http_upstream_ewma_peer_data_t));
+    if (ep == NULL) {
+        return NGX_ERROR;
+    }
+
+    r->upstream->peer.data = &ep->rrp;
+
+    if (ngx_http_upstream_init_round_robin_peer(r, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->upstream->peer.get = ngx_http_upstream_get_ewma_peer;
+    r->upstream->peer.free = ngx_http_upstream_free_ewma_peer;
+
+    ep->conf = ecf;
+    ep->start = 0;
+    ep->tries = 0;
+
+    ngx_http_upstream_rr_peers_rlock(ep->rrp.peers);
+
+#if (NGX_HTTP_UPSTREAM_ZONE)
+    if (ep->rrp.peers->shpool && ecf->peer == NULL) {
+        if (ngx_http_upstream_update_ewma(NULL, us) != NGX_OK) {
+            ngx_http_upstream_rr_peers_unlock(ep->rrp.peers);
+            return NGX_ERROR;
+        }
+    }
+#endif
+
+    ngx_http_upstream_rr_peers_unlock(ep->rrp.peers);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_get_ewma_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_http_upstream_ewma_peer_data_t  *ep = data;
+
+    time_t                             now;
+    uint64_t                           s1, s2;
+    uintptr_t                          m;
+    ngx_uint_t                         i, n, p;
+    ngx_http_upstream_rr_peer_t       *peer, *prev;
+    ngx_http_upstream_rr_peers_t      *peers;
+    ngx_http_upstream_rr_peer_data_t  *rrp;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "get ewma peer, try: %ui", pc->tries);
+
+    rrp = &ep->rrp;
+    peers = rrp->peers;
+
+    ep->start = ngx_current_msec;
+
+    ngx_http_upstream_rr_peers_wlock(peers);
+
+    if (ep->tries > 20 || peers->single) {
+        ngx_http_upstream_rr_peers_unlock(peers);
+        return ngx_http_upstream_get_round_robin_peer(pc, rrp);
+    }
+
+    pc->cached = 0;
+    pc->connection = NULL;
+
+    now = ngx_time();
+
+    prev = NULL;
+
+#if (NGX_SUPPRESS_WARN)
+    p = 0;
+#endif
+
+    /* power of two choices, the peer with the lower score wins */
+
+    for ( ;; ) {
+
+        i = ngx_random() % peers->number;
+
+        peer = ep->conf->peer[i];
+
+        if (peer == prev) {
+            goto next;
+        }
+
+        n = i / (8 * sizeof(uintptr_t));
+        m = (uintptr_t) 1 << i % (8 * sizeof(uintptr_t));
+
+        if (rrp->tried[n] & m) {
+            goto next;
+        }
+
+        if (peer->down) {
+            goto next;
+        }
+
+#if (NGX_HTTP_UPSTREAM_CHECK)
+        if (ngx_http_upstream_check_peer_down(peer->check_index)) {
+            goto next;
+        }
+#endif
+
+        if (peer->max_fails
+            && peer->fails >= peer->max_fails
+            && now - peer->checked <= peer->fail_timeout)
+        {
+            goto next;
+        }
+
+        if (peer->max_conns && peer->conns >= peer->max_conns) {
+            goto next;
+        }
+
+        if (prev) {
+            s1 = ngx_http_upstream_ewma_score(ep->conf, prev);
+            s2 = ngx_http_upstream_ewma_score(ep->conf, peer);
+
+            if (s2 * prev->weight > s1 * peer->weight) {
+                peer = prev;
+                n = p / (8 * sizeof(uintptr_t));
+                m = (uintptr_t) 1 << p % (8 * sizeof(uintptr_t));
+            }
+
+            break;
+        }
+
+        prev = peer;
+        p = i;
+
+    next:
+
+        if (++ep->tries > 20) {
+            ngx_http_upstream_rr_peers_unlock(peers);
+            return ngx_http_upstream_get_round_robin_peer(pc, rrp);
+        }
+    }
+
+    rrp->current = peer;
+
+    if (now - peer->checked > peer->fail_timeout) {
+        peer->checked = now;
+    }
+
+    pc->sockaddr = peer->sockaddr;
+    pc->socklen = peer->socklen;
+    pc->name = &peer->name;
+
+    peer->conns++;
+
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+    rrp->tried[n] |= m;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_free_ewma_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
+{
+    ngx_http_upstream_ewma_peer_data_t  *ep = data;
+
+    uint64_t                           cost;
+    ngx_msec_t                         now, elapsed;
+    ngx_uint_t                         rtt;
+    ngx_http_upstream_rr_peer_t       *peer;
+    ngx_http_upstream_rr_peers_t      *peers;
+    ngx_http_upstream_rr_peer_data_t  *rrp;
+
+    rrp = &ep->rrp;
+    peers = rrp->peers;
+    peer = rrp->current;
+
+    if (peer == NULL || ep->start == 0) {
+        goto done;
+    }
+
+    now = ngx_current_msec;
+    rtt = (now - ep->start) * NGX_HTTP_UPSTREAM_EWMA_SCALE;
+
+    ep->start = 0;
+
+    ngx_http_upstream_rr_peers_rlock(peers);
+    ngx_http_upstream_rr_peer_lock(peers, peer);
+
+    /*
+     * a slower response replaces the average at once, faster ones
+     * are averaged in with a weight that grows with the time passed
+     * since the last update; a failed peer is never made cheaper
+     */
+
+    cost = peer->ewma;
+    elapsed = now - peer->ewma_stamp;
+
+    if (rtt >= cost || elapsed >= ep->conf->decay * 8) {
+        if (rtt > cost || !(state & NGX_PEER_FAILED)) {
+            cost = rtt;
+        }
+
+    } else if (!(state & NGX_PEER_FAILED)) {
+        cost = (cost * ep->conf->decay + (uint64_t) rtt * elapsed)
+               / (ep->conf->decay + elapsed);
+    }
+
+    peer->ewma = (ngx_uint_t) cost;
+    peer->ewma_stamp = now;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "free ewma peer \"%V\", rtt: %ui, ewma: %ui",
+                   &peer->name, rtt, peer->ewma);
+
+    ngx_http_upstream_rr_peer_unlock(peers, peer);
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+done:
+
+    ngx_http_upstream_free_round_robin_peer(pc, rrp, state);
+}
+
+
+static uint64_t
+ngx_http_upstream_ewma_score(ngx_http_upstream_ewma_srv_conf_t *conf,
+    ngx_http_upstream_rr_peer_t *peer)
+{
+    uint64_t    cost;
+    ngx_msec_t  elapsed;
+
+    /* the average decays to nothing while the peer gets no responses */
+
+    elapsed = ngx_current_msec - peer->ewma_stamp;
+
+    if (peer->ewma == 0 || elapsed >= conf->decay * 8) {
+        cost = 0;
+
+    } else {
+        cost = (uint64_t) peer->ewma * conf->decay / (conf->decay + elapsed);
+    }
+
+    return (cost + NGX_HTTP_UPSTREAM_EWMA_MIN) * (peer->conns + 1);
+}
+
+
+static void *
+ngx_http_upstream_ewma_create_conf(ngx_conf_t *cf)
+{
+    ngx_http_upstream_ewma_srv_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_upstream_ewma_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     conf->peer = NULL;
+     */
+
+    conf->decay = 10000;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_upstream_ewma(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_upstream_ewma_srv_conf_t  *ecf = conf;
+
+    ngx_str_t                     *value, s;
+    ngx_http_upstream_srv_conf_t  *uscf;
+
+    uscf = ngx_http_conf_get_module_srv_conf(cf, ngx_http_upstream_module);
+
+    if (uscf->peer.init_upstream) {
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "load balancing method redefined");
+    }
+
+    uscf->peer.init_upstream = ngx_http_upstream_init_ewma;
+
+    uscf->flags = NGX_HTTP_UPSTREAM_CREATE
+                  |NGX_HTTP_UPSTREAM_WEIGHT
+                  |NGX_HTTP_UPSTREAM_MAX_CONNS
+                  |NGX_HTTP_UPSTREAM_MAX_FAILS
+                  |NGX_HTTP_UPSTREAM_FAIL_TIMEOUT
+                  |NGX_HTTP_UPSTREAM_DOWN;
+
+    if (cf->args->nelts == 1) {
+        return NGX_CONF_OK;
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strncmp(value[1].data, "decay=", 6) == 0) {
+        s.len = value[1].len - 6;
+        s.data = value[1].data + 6;
+
+        ecf->decay = ngx_parse_time(&s, 0);
+        if (ecf->decay == (ngx_msec_t) NGX_ERROR || ecf->decay == 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid decay \"%V\"", &value[1]);
+            return NGX_CONF_ERROR;
+        }
+
+        return NGX_CONF_OK;
+    }
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[1]);
+
+    return NGX_CONF_ERROR;
+}
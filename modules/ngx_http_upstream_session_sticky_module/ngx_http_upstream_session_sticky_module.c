@@ -48,6 +48,9 @@ typedef struct {
 
     ngx_uint_t                          number;
     ngx_http_ss_server_t               *server;
+
+    ngx_hash_t                          sids;
+    ngx_hash_t                          names;
 } ngx_http_upstream_ss_srv_conf_t;
 
 
@@ -66,7 +69,11 @@ typedef struct {
     ngx_int_t                           tries;
     ngx_flag_t                          frist;
 
+    ngx_http_ss_server_t               *server;
     ngx_http_upstream_ss_srv_conf_t    *sscf;
+
+    u_char                              lastseen_buf[NGX_TIME_T_LEN];
+    u_char                              firstseen_buf[NGX_TIME_T_LEN];
 } ngx_http_ss_ctx_t;
 
 
@@ -92,8 +99,12 @@ static ngx_int_t
     void *data);
 static ngx_int_t ngx_http_session_sticky_header_handler(ngx_http_request_t *r);
 static ngx_int_t ngx_http_session_sticky_get_cookie(ngx_http_request_t *r);
-static void ngx_http_session_sticky_tmtoa(ngx_http_request_t *r,
-    ngx_str_t *str, time_t t);
+static void ngx_http_session_sticky_tmtoa(ngx_str_t *str, u_char *buf,
+    time_t t);
+static void ngx_http_session_sticky_set_server(ngx_http_request_t *r,
+    ngx_http_ss_ctx_t *ctx, ngx_str_t *sid);
+static ngx_http_ss_server_t *ngx_http_session_sticky_find(ngx_hash_t *hash,
+    ngx_str_t *key);
 static ngx_int_t ngx_http_session_sticky_header_filter(ngx_http_request_t *r);
 static ngx_int_t ngx_http_session_sticky_prefix(ngx_http_request_t *r,
     ngx_table_elt_t *table);
@@ -114,6 +125,8 @@ static char *ngx_http_session_sticky_hide_cookie(ngx_conf_t *cf,
     void *conf);
 static ngx_int_t ngx_http_upstream_session_sticky_init_upstream(ngx_conf_t *cf,
     ngx_http_upstream_srv_conf_t *us);
+static ngx_int_t ngx_http_upstream_session_sticky_init_hash(ngx_conf_t *cf,
+    ngx_http_upstream_ss_srv_conf_t *sscf, ngx_hash_t *hash, ngx_uint_t sid);
 static ngx_int_t ngx_http_upstream_session_sticky_set_sid(ngx_conf_t *cf,
     ngx_http_ss_server_t *s);
 
@@ -300,8 +313,9 @@ ngx_http_session_sticky_get_cookie(ngx_http_request_t *r)
 {
     time_t                           now;
     u_char                          *p, *v, *vv, *st, *last, *end;
+    u_char                          *st_lastseen;
     ngx_int_t                        diff, delimiter, legal;
-    ngx_str_t                       *cookie;
+    ngx_str_t                       *cookie, sid;
     ngx_uint_t                       i;
     ngx_table_elt_t                **cookies;
     ngx_http_ss_ctx_t               *ctx;
@@ -414,15 +428,14 @@ not_found:
     ctx->frist = 1;
     ctx->sid.len = 0;
     ctx->sid.data = NULL;
+    ctx->server = NULL;
     ctx->firstseen = now;
     ctx->lastseen = now;
 
-    ngx_http_session_sticky_tmtoa(r, &ctx->s_lastseen, ctx->lastseen);
-    ngx_http_session_sticky_tmtoa(r, &ctx->s_firstseen, ctx->firstseen);
-
-    if (ctx->s_lastseen.data == NULL || ctx->s_firstseen.data == NULL) {
-        return NGX_ERROR;
-    }
+    ngx_http_session_sticky_tmtoa(&ctx->s_lastseen, ctx->lastseen_buf,
+                                  ctx->lastseen);
+    ngx_http_session_sticky_tmtoa(&ctx->s_firstseen, ctx->firstseen_buf,
+                                  ctx->firstseen);
 
     return NGX_OK;
 
@@ -451,27 +464,26 @@ success:
         ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                        "session_sticky mode [insert]");
 
+        /*
+         * the values are parsed in place, the cookie may be changed
+         * at the finish
+         */
+
         delimiter = 0;
+        sid.len = 0;
+        st_lastseen = NULL;
+
         for (p = v; p < vv; p++) {
             if (*p == NGX_HTTP_SESSION_STICKY_DELIMITER) {
                 delimiter++;
                 if (delimiter == 1) {
-                    ctx->sid.len = p - v;
-                    ctx->sid.data = ngx_pnalloc(r->pool, ctx->sid.len);
-                    if (ctx->sid.data == NULL) {
-                        return NGX_ERROR;
-                    }
-                    ngx_memcpy(ctx->sid.data, v, ctx->sid.len);
+                    sid.len = p - v;
+                    sid.data = v;
                     v = p + 1;
 
                 } else if(delimiter == 2) {
-                    ctx->s_lastseen.len = p - v;
-                    ctx->s_lastseen.data = ngx_pnalloc(r->pool,
-                                                       ctx->s_lastseen.len);
-                    if (ctx->s_lastseen.data == NULL) {
-                        return NGX_ERROR;
-                    }
-                    ngx_memcpy(ctx->s_lastseen.data, v, ctx->s_lastseen.len);
+                    st_lastseen = v;
+                    ctx->lastseen = ngx_atotm(v, p - v);
                     v = p + 1;
                     break;
 
@@ -482,28 +494,25 @@ success:
             }
         }
 
-        if (p >= vv || v >= vv) {
+        if (p >= vv || v >= vv || st_lastseen == NULL) {
             legal = 0;
             goto finish;
 
         }
 
-        ctx->s_firstseen.len = vv - v;
-        ctx->s_firstseen.data = ngx_pnalloc(r->pool, ctx->s_firstseen.len);
-        if (ctx->s_firstseen.data == NULL) {
-            return NGX_ERROR;
-        }
-        ngx_memcpy(ctx->s_firstseen.data, v, ctx->s_firstseen.len);
-
-        ctx->firstseen = ngx_atotm(ctx->s_firstseen.data, ctx->s_firstseen.len);
-        ctx->lastseen = ngx_atotm(ctx->s_lastseen.data, ctx->s_lastseen.len);
+        ctx->firstseen = ngx_atotm(v, vv - v);
 
         if (ctx->firstseen == NGX_ERROR || ctx->lastseen == NGX_ERROR) {
             legal = 0;
             goto finish;
         }
 
-        if (ctx->sid.len != 0) {
+        ngx_http_session_sticky_tmtoa(&ctx->s_firstseen, ctx->firstseen_buf,
+                                      ctx->firstseen);
+
+        ngx_http_session_sticky_set_server(r, ctx, &sid);
+
+        if (sid.len != 0) {
             diff = (ngx_int_t) (now - ctx->lastseen);
             if (diff > ctx->sscf->maxidle || diff < -86400) {
                 legal = 0;
@@ -517,15 +526,14 @@ success:
             }
         }
 
-        ngx_http_session_sticky_tmtoa(r, &ctx->s_lastseen, now);
+        ngx_http_session_sticky_tmtoa(&ctx->s_lastseen, ctx->lastseen_buf,
+                                      now);
 
     } else {
-        ctx->sid.len = vv - v;
-        ctx->sid.data = ngx_pnalloc(r->pool, ctx->sid.len);
-        if (ctx->sid.data == NULL) {
-            return NGX_ERROR;
-        }
-        ngx_memcpy(ctx->sid.data, v, ctx->sid.len);
+        sid.len = vv - v;
+        sid.data = v;
+
+        ngx_http_session_sticky_set_server(r, ctx, &sid);
     }
 
 finish:
@@ -559,7 +567,6 @@ static ngx_int_t
 ngx_http_upstream_session_sticky_get_peer(ngx_peer_connection_t *pc, void *data)
 {
     ngx_int_t                          rc;
-    ngx_uint_t                         i, n;
     ngx_http_ss_ctx_t                 *ctx;
     ngx_http_request_t                *r;
     ngx_http_ss_server_t              *server;
@@ -568,8 +575,6 @@ ngx_http_upstream_session_sticky_get_peer(ngx_peer_connection_t *pc, void *data)
 
     sscf = sspd->sscf;
     r = sspd->r;
-    n = sscf->number;
-    server = sscf->server;
 
     ctx = ngx_http_get_module_ctx(r, ngx_http_upstream_session_sticky_module);
 
@@ -583,32 +588,35 @@ ngx_http_upstream_session_sticky_get_peer(ngx_peer_connection_t *pc, void *data)
         goto failed;
     }
 
-    for (i = 0; i < n; i++) {
-        if (ctx->sid.len == server[i].sid.len
-            && ngx_strncmp(ctx->sid.data, server[i].sid.data,
-                           ctx->sid.len) == 0)
-        {
+    /* the sid was looked up when the cookie was parsed */
+
+    server = ctx->server;
+
+    if (ctx->sscf != sscf) {
+        server = ngx_http_session_sticky_find(&sscf->sids, &ctx->sid);
+    }
+
+    if (server) {
 #if (NGX_HTTP_UPSTREAM_CHECK)
-            if (ngx_http_upstream_check_peer_down(server[i].check_index)) {
-                if (ctx->sscf->flag & NGX_HTTP_SESSION_STICKY_FALLBACK_OFF) {
-                    return NGX_BUSY;
+        if (ngx_http_upstream_check_peer_down(server->check_index)) {
+            if (ctx->sscf->flag & NGX_HTTP_SESSION_STICKY_FALLBACK_OFF) {
+                return NGX_BUSY;
 
-                } else {
-                    goto failed;
-                }
+            } else {
+                goto failed;
             }
+        }
 #endif
-            pc->name = server[i].name;
-            pc->socklen = server[i].socklen;
-            pc->sockaddr = server[i].sockaddr;
+        pc->name = server->name;
+        pc->socklen = server->socklen;
+        pc->sockaddr = server->sockaddr;
 
-            ctx->sid.len = server[i].sid.len;
-            ctx->sid.data = server[i].sid.data;
-            sspd->rrp.current = server[i].peer;
-            ctx->tries--;
+        ctx->sid.len = server->sid.len;
+        ctx->sid.data = server->sid.data;
+        sspd->rrp.current = server->peer;
+        ctx->tries--;
 
-            return NGX_OK;
-        }
+        return NGX_OK;
     }
 
 failed:
@@ -626,16 +634,12 @@ failed:
         return rc;
     }
 
-    for (i = 0; i < n; i++) {
-        if (server[i].name->len == pc->name->len
-            && ngx_strncmp(server[i].name->data, pc->name->data,
-                           pc->name->len) == 0)
-        {
-            ctx->sid.len = server[i].sid.len;
-            ctx->sid.data = server[i].sid.data;
-            break;
-        }
+    server = ngx_http_session_sticky_find(&sscf->names, pc->name);
+    if (server) {
+        ctx->sid.len = server->sid.len;
+        ctx->sid.data = server->sid.data;
     }
+
     ctx->frist = 1;
 
     return rc;
@@ -643,7 +647,40 @@ failed:
 
 
 static void
-ngx_http_session_sticky_tmtoa(ngx_http_request_t *r, ngx_str_t *str, time_t t)
+ngx_http_session_sticky_set_server(ngx_http_request_t *r,
+    ngx_http_ss_ctx_t *ctx, ngx_str_t *sid)
+{
+    ngx_http_ss_server_t  *server;
+
+    /* the sid of the server is kept, the cookie may be changed later */
+
+    server = ngx_http_session_sticky_find(&ctx->sscf->sids, sid);
+
+    ctx->server = server;
+
+    if (server) {
+        ctx->sid = server->sid;
+
+    } else {
+        ctx->sid.len = 0;
+        ctx->sid.data = NULL;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "session sticky cookie sid [%V]", sid);
+}
+
+
+static ngx_http_ss_server_t *
+ngx_http_session_sticky_find(ngx_hash_t *hash, ngx_str_t *key)
+{
+    return ngx_hash_find(hash, ngx_hash_key(key->data, key->len),
+                         key->data, key->len);
+}
+
+
+static void
+ngx_http_session_sticky_tmtoa(ngx_str_t *str, u_char *buf, time_t t)
 {
     time_t      temp;
     ngx_uint_t  len;
@@ -656,10 +693,7 @@ ngx_http_session_sticky_tmtoa(ngx_http_request_t *r, ngx_str_t *str, time_t t)
     }
 
     str->len = len;
-    str->data = ngx_pcalloc(r->pool, len);
-    if (str->data == NULL) {
-        return;
-    }
+    str->data = buf;
 
     while (t) {
         str->data[--len] = t % 10 + '0';
@@ -1379,12 +1413,79 @@ ngx_http_upstream_session_sticky_init_upstream(ngx_conf_t *cf,
         }
     }
 
+    if (ngx_http_upstream_session_sticky_init_hash(cf, sscf, &sscf->sids, 1)
+        != NGX_OK
+        || ngx_http_upstream_session_sticky_init_hash(cf, sscf, &sscf->names, 0)
+           != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
     us->peer.init = ngx_http_upstream_session_sticky_init_peer;
 
     return NGX_OK;
 }
 
 
+static ngx_int_t
+ngx_http_upstream_session_sticky_init_hash(ngx_conf_t *cf,
+    ngx_http_upstream_ss_srv_conf_t *sscf, ngx_hash_t *hash, ngx_uint_t sid)
+{
+    size_t            size;
+    ngx_str_t        *key;
+    ngx_uint_t        i;
+    ngx_pool_t       *pool;
+    ngx_array_t       keys;
+    ngx_hash_key_t   *hk;
+    ngx_hash_init_t   hinit;
+
+    /*
+     * the servers are indexed by sid and by peer name, keys are compared
+     * case-sensitively, and the first server of a duplicate key is found
+     * as before
+     */
+
+    /* upstreams initialized by dyups have no temporary pool */
+
+    pool = cf->temp_pool ? cf->temp_pool : cf->pool;
+
+    if (ngx_array_init(&keys, pool, sscf->number, sizeof(ngx_hash_key_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    size = 64;
+
+    for (i = 0; i < sscf->number; i++) {
+        key = sid ? &sscf->server[i].sid : sscf->server[i].name;
+
+        hk = ngx_array_push(&keys);
+        if (hk == NULL) {
+            return NGX_ERROR;
+        }
+
+        hk->key = *key;
+        hk->key_hash = ngx_hash_key(key->data, key->len);
+        hk->value = &sscf->server[i];
+
+        size = ngx_max(size, sizeof(void *)
+                             + ngx_align(key->len + 2, sizeof(void *))
+                             + sizeof(void *));
+    }
+
+    hinit.hash = hash;
+    hinit.key = ngx_hash_key;
+    hinit.max_size = ngx_max(512, sscf->number * 4);
+    hinit.bucket_size = ngx_align(size, ngx_cacheline_size);
+    hinit.name = sid ? "session_sticky_sid_hash" : "session_sticky_name_hash";
+    hinit.pool = cf->pool;
+    hinit.temp_pool = NULL;
+
+    return ngx_hash_init(&hinit, keys.elts, keys.nelts);
+}
+
+
 static ngx_int_t
 ngx_http_upstream_session_sticky_set_sid(ngx_conf_t *cf,
     ngx_http_ss_server_t *s)
@@ -125,7 +125,8 @@ ngx_http_multi_upstream_next(ngx_connection_t *pc, ngx_uint_t ft_type)
 
         tmp = ngx_queue_last(data);
         if (tmp == q) {
-            ngx_queue_remove(tmp);
+            ngx_multi_remove_data(pc, tmp);
+            r->multi_item = NULL;
             ngx_log_error(NGX_LOG_ERR, pc->log, 0,
                     "multi connection next but queue exist %p", pc);
             continue;
@@ -161,7 +162,8 @@ ngx_http_multi_upstream_finalize_request(ngx_connection_t *c, ngx_int_t rc)
 
         tmp = ngx_queue_last(data);
         if (tmp == q) {
-            ngx_queue_remove(tmp);
+            ngx_multi_remove_data(c, tmp);
+            r->multi_item = NULL;
             ngx_log_error(NGX_LOG_ERR, c->log, 0,
                     "multi connection finalize but queue exist %p", c);
             continue;
@@ -365,7 +367,25 @@ ngx_http_multi_upstream_read_handler(ngx_connection_t *pc)
             n = c->recv(c, b->last, b->end - b->last);
 
             if (n == NGX_AGAIN) {
-                ngx_add_timer(pc->read, u->conf->read_timeout);
+
+                /*
+                 * an idle connection is kept open for the next requests
+                 * until the worker exits
+                 */
+
+                if (!ngx_queue_empty(&multi_c->data)
+                    || !ngx_queue_empty(&multi_c->send_list))
+                {
+                    pc->idle = 0;
+                    ngx_add_timer(pc->read, u->conf->read_timeout);
+
+                } else {
+                    pc->idle = 1;
+
+                    if (pc->read->timer_set) {
+                        ngx_del_timer(pc->read);
+                    }
+                }
 
                 if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
                     ngx_http_multi_upstream_finalize_request(pc,
@@ -377,8 +397,15 @@ ngx_http_multi_upstream_read_handler(ngx_connection_t *pc)
             }
 
             if (n == 0) {
-                ngx_log_error(NGX_LOG_ERR, c->log, 0,
-                        "upstream prematurely closed connection");
+                if (ngx_queue_empty(&multi_c->data)
+                    && ngx_queue_empty(&multi_c->send_list))
+                {
+                    ngx_log_error(NGX_LOG_INFO, c->log, 0,
+                            "multi: upstream closed idle connection %p", pc);
+                } else {
+                    ngx_log_error(NGX_LOG_ERR, c->log, 0,
+                            "upstream prematurely closed connection");
+                }
             }
 
             if (n == NGX_ERROR || n == 0) {
@@ -540,6 +567,11 @@ ngx_http_multi_upstream_handler(ngx_event_t *ev)
         return;
     }
 
+    if (pc->close) {
+        ngx_http_multi_upstream_next(pc, NGX_HTTP_UPSTREAM_FT_ERROR);
+        return;
+    }
+
     ngx_http_multi_upstream_process(pc, ev->write);
 }
 
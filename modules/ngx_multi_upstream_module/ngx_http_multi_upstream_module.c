@@ -14,6 +14,9 @@
 
 typedef struct {
     ngx_uint_t                               max_cached;
+    ngx_uint_t                               min_cached;
+    ngx_uint_t                               max_inflight;
+    ngx_msec_t                               queue_wait;
 
     ngx_queue_t                              cache;
 
@@ -33,7 +36,6 @@ typedef struct {
     socklen_t                                socklen;
     u_char                                   sockaddr[NGX_SOCKADDRLEN];
     uint64_t                                 id;
-    unsigned int                             used;
 } ngx_http_multi_upstream_cache_t;
 
 
@@ -45,6 +47,9 @@ typedef struct {
 
     void                                    *data;
 
+    ngx_uint_t                               queue_depth;
+    ngx_uint_t                               connections;
+
     ngx_event_get_peer_pt                    original_get_peer;
     ngx_event_free_peer_pt                   original_free_peer;
     ngx_event_notify_peer_pt                 original_notify_peer;
@@ -84,6 +89,10 @@ static ngx_int_t
 ngx_http_multi_upstream_init_connection(ngx_connection_t *c,
     ngx_peer_connection_t *pc, void *data);
 
+static ngx_int_t ngx_http_multi_upstream_add_variables(ngx_conf_t *cf);
+static ngx_int_t ngx_http_multi_upstream_variable(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
+
 static void *ngx_http_multi_upstream_create_conf(ngx_conf_t *cf);
 static char *ngx_http_multi_upstream(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
@@ -91,7 +100,7 @@ static char *ngx_http_multi_upstream(ngx_conf_t *cf, ngx_command_t *cmd,
 static ngx_command_t  ngx_http_multi_upstream_commands[] = {
     {
         ngx_string("multi"),
-        NGX_HTTP_UPS_CONF|NGX_CONF_TAKE1,
+        NGX_HTTP_UPS_CONF|NGX_CONF_TAKE1234,
         ngx_http_multi_upstream,
         NGX_HTTP_SRV_CONF_OFFSET,
         0,
@@ -102,7 +111,7 @@ static ngx_command_t  ngx_http_multi_upstream_commands[] = {
 };
 
 static ngx_http_module_t  ngx_http_multi_upstream_module_ctx = {
-    NULL,                                  /* preconfiguration */
+    ngx_http_multi_upstream_add_variables, /* preconfiguration */
     NULL,                                  /* postconfiguration */
 
     NULL,                                  /* create main configuration */
@@ -130,6 +139,21 @@ ngx_module_t  ngx_http_multi_upstream_module = {
     NGX_MODULE_V1_PADDING
 };
 
+static ngx_http_variable_t  ngx_http_multi_upstream_vars[] = {
+
+    { ngx_string("multi_upstream_queue_depth"), NULL,
+      ngx_http_multi_upstream_variable,
+      offsetof(ngx_http_multi_upstream_peer_data_t, queue_depth),
+      NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("multi_upstream_connections"), NULL,
+      ngx_http_multi_upstream_variable,
+      offsetof(ngx_http_multi_upstream_peer_data_t, connections),
+      NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    ngx_http_null_variable
+};
+
 static char *
 ngx_http_multi_upstream(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -137,7 +161,8 @@ ngx_http_multi_upstream(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ngx_http_multi_upstream_srv_conf_t      *kcf = conf;
 
     ngx_int_t    n;
-    ngx_str_t   *value;
+    ngx_str_t   *value, s;
+    ngx_uint_t   i;
 
     if (kcf->max_cached) {
         return "is duplicate";
@@ -157,6 +182,54 @@ ngx_http_multi_upstream(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     kcf->max_cached = n;
+    kcf->min_cached = n;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "min=", 4) == 0) {
+
+            n = ngx_atoi(&value[i].data[4], value[i].len - 4);
+
+            if (n == NGX_ERROR || n == 0 || (ngx_uint_t) n > kcf->max_cached) {
+                goto invalid;
+            }
+
+            kcf->min_cached = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "max_inflight=", 13) == 0) {
+
+            n = ngx_atoi(&value[i].data[13], value[i].len - 13);
+
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            kcf->max_inflight = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "queue_wait=", 11) == 0) {
+
+            s.len = value[i].len - 11;
+            s.data = &value[i].data[11];
+
+            kcf->queue_wait = ngx_parse_time(&s, 0);
+
+            if (kcf->queue_wait == (ngx_msec_t) NGX_ERROR
+                || kcf->queue_wait == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        goto invalid;
+    }
 
     uscf = ngx_http_conf_get_module_srv_conf(cf, ngx_http_upstream_module);
 
@@ -167,6 +240,14 @@ ngx_http_multi_upstream(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     uscf->peer.init_upstream = ngx_http_multi_upstream_init;
 
     return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "multi: invalid parameter \"%V\" in \"%V\" directive",
+                       &value[i], &cmd->name);
+
+    return NGX_CONF_ERROR;
 }
 
 static ngx_int_t
@@ -206,6 +287,11 @@ ngx_http_multi_upstream_init_peer(ngx_http_request_t *r,
     kcf = ngx_http_conf_upstream_srv_conf(us,
                                           ngx_http_multi_upstream_module);
 
+    if (!(r->upstream->multi_mode & NGX_MULTI_UPS_SUPPORT_MULTI)) {
+        /* the handler cannot share connections, use a connection of its own */
+        return kcf->original_init_peer(r, us);
+    }
+
     kp = ngx_pcalloc(r->connection->pool, sizeof(ngx_http_multi_upstream_peer_data_t));
     if (kp == NULL) {
         return NGX_ERROR;
@@ -249,11 +335,13 @@ static ngx_int_t
 ngx_http_multi_upstream_get_peer(ngx_peer_connection_t *pc, void *data)
 {
     ngx_http_multi_upstream_peer_data_t     *kp = data;
-    ngx_http_multi_upstream_cache_t         *item, *best;
+    ngx_http_multi_upstream_cache_t         *item, *best, *busy;
     ngx_int_t                                rc;
     ngx_uint_t                               cnt;
     ngx_queue_t                             *q, *cache;
     ngx_connection_t                        *c;
+    ngx_multi_connection_t                  *multi_c;
+    ngx_multi_data_t                        *oldest;
     ngx_event_get_peer_pt                    save_handler;
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, pc->log, 0,
@@ -269,10 +357,17 @@ ngx_http_multi_upstream_get_peer(ngx_peer_connection_t *pc, void *data)
         return rc;
     }
 
-    /* search cache for suitable connection */
+    /*
+     * search cache for suitable connection: the one with the fewest
+     * requests in flight, connections with max_inflight requests or
+     * with a request waiting longer than queue_wait are used only
+     * when no more connections may be opened
+     */
+
     cache = &kp->conf->cache;
 
     best = NULL;
+    busy = NULL;
     cnt  = 0;
 
     for (q = ngx_queue_head(cache);
@@ -282,30 +377,70 @@ ngx_http_multi_upstream_get_peer(ngx_peer_connection_t *pc, void *data)
         item = ngx_queue_data(q, ngx_http_multi_upstream_cache_t, queue);
         c = item->connection;
 
-        ngx_log_error(NGX_LOG_INFO, c->log,
-                      0, "multi: connect list, c: %p", c);
-
         if (ngx_memn2cmp((u_char *) &item->sockaddr, (u_char *) pc->sockaddr,
                          item->socklen, pc->socklen)
-            == 0)
+            != 0)
         {
-            if (best == NULL) {
-                best = item;
-            } else {
-                if (best->used > item->used) {
-                    best = item;
-                }
+            continue;
+        }
+
+        cnt++;
+
+        multi_c = ngx_get_multi_connection(c);
+
+        ngx_log_error(NGX_LOG_INFO, c->log, 0,
+                      "multi: connect list, c: %p, inflight: %ui, "
+                      "max inflight: %ui, requests: %ui",
+                      c, multi_c->inflight, multi_c->max_inflight,
+                      multi_c->requests);
+
+        if (busy == NULL
+            || ngx_get_multi_connection(busy->connection)->inflight
+               > multi_c->inflight)
+        {
+            busy = item;
+        }
+
+        if (kp->conf->max_inflight
+            && multi_c->inflight >= kp->conf->max_inflight)
+        {
+            continue;
+        }
+
+        if (kp->conf->queue_wait && !ngx_queue_empty(&multi_c->data)) {
+            oldest = ngx_queue_data(ngx_queue_head(&multi_c->data),
+                                    ngx_multi_data_t, queue);
+
+            if (ngx_current_msec - oldest->start >= kp->conf->queue_wait) {
+                continue;
             }
-            cnt++;
+        }
+
+        if (best == NULL
+            || ngx_get_multi_connection(best->connection)->inflight
+               > multi_c->inflight)
+        {
+            best = item;
         }
     }
 
-    if (cnt >= kp->conf->max_cached) {
+    kp->connections = cnt;
+
+    if (cnt >= kp->conf->min_cached && best) {
         c = best->connection;
-        best->used++;
         goto found;
     }
 
+    if (cnt >= kp->conf->max_cached) {
+        c = busy->connection;
+        goto found;
+    }
+
+    if (cnt >= kp->conf->min_cached) {
+        ngx_log_error(NGX_LOG_INFO, pc->log, 0,
+                      "multi: all %ui connections busy, connect new", cnt);
+    }
+
     /*not find, connect new*/
     save_handler = pc->get;
     pc->get = ngx_multi_upstream_get_peer_null;
@@ -319,6 +454,9 @@ ngx_http_multi_upstream_get_peer(ngx_peer_connection_t *pc, void *data)
     }
 
     c = pc->connection;
+    kp->connections++;
+    kp->queue_depth = 0;
+
     if (ngx_http_multi_upstream_init_connection(c, pc, data) != NGX_OK) {
         ngx_log_error(NGX_LOG_ERR, pc->log,
                       0, "multi: init new connection failed, c: %p", c);
@@ -344,6 +482,8 @@ found:
         return NGX_ERROR;
     }
 
+    kp->queue_depth = ngx_get_multi_connection(c)->inflight - 1;
+
     pc->connection = c;
     pc->cached = 1;
 
@@ -364,9 +504,19 @@ ngx_http_multi_upstream_add_data(ngx_connection_t *c, ngx_http_request_t *r)
     }
 
     item_data->data = r;
+    item_data->start = ngx_current_msec;
     ngx_queue_insert_tail(&multi_c->data, &item_data->queue);
     r->multi_item = &item_data->queue;
 
+    c->idle = 0;
+
+    multi_c->inflight++;
+    multi_c->requests++;
+
+    if (multi_c->inflight > multi_c->max_inflight) {
+        multi_c->max_inflight = multi_c->inflight;
+    }
+
     return NGX_OK;
 }
 
@@ -394,7 +544,6 @@ ngx_http_multi_upstream_init_connection(ngx_connection_t *c,
 
     item->connection = c;
     item->socklen    = pc->socklen;
-    item->used       = 1;
     item->conf       = kp->conf;
 
     ngx_memcpy(&item->sockaddr, pc->sockaddr, pc->socklen);
@@ -429,6 +578,9 @@ ngx_http_multi_upstream_init_connection(ngx_connection_t *c,
     fake_u->output.aio_preload = u->output.aio_preload;
 #endif
 #endif
+#if (NGX_HAVE_FILE_IO_URING)
+    fake_u->output.aio_io_uring = u->output.aio_io_uring;
+#endif
 
 #if (NGX_THREADS || NGX_COMPAT)
     fake_u->output.thread_handler = u->output.thread_handler;
@@ -537,6 +689,13 @@ ngx_http_multi_upstream_free_peer(ngx_peer_connection_t *pc, void *data,
 
             multi_r = ngx_queue_data(q, ngx_multi_request_t, front_queue);
 
+            if (multi_r->keep) {
+                //responses come in order, the answer is read and dropped
+                ngx_queue_init(&multi_r->front_queue);
+                multi_r->data = NULL;
+                continue;
+            }
+
             //clean send_list on backend connection
             ngx_queue_remove(&multi_r->backend_queue);
 
@@ -565,7 +724,7 @@ ngx_http_multi_upstream_free_peer(ngx_peer_connection_t *pc, void *data,
 
     q = request->multi_item;
     if (q) {
-        ngx_queue_remove(q);
+        ngx_multi_remove_data(pc->connection, q);
         request->multi_item = NULL;
 
         old_tries = pc->tries;
@@ -619,6 +778,57 @@ ngx_http_multi_upstream_save_session(ngx_peer_connection_t *pc, void *data)
 
 #endif
 
+static ngx_int_t
+ngx_http_multi_upstream_add_variables(ngx_conf_t *cf)
+{
+    ngx_http_variable_t  *var, *v;
+
+    for (v = ngx_http_multi_upstream_vars; v->name.len; v++) {
+        var = ngx_http_add_variable(cf, &v->name, v->flags);
+        if (var == NULL) {
+            return NGX_ERROR;
+        }
+
+        var->get_handler = v->get_handler;
+        var->data = v->data;
+    }
+
+    return NGX_OK;
+}
+
+static ngx_int_t
+ngx_http_multi_upstream_variable(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    u_char                               *p;
+    ngx_http_upstream_t                  *u;
+    ngx_http_multi_upstream_peer_data_t  *kp;
+
+    u = r->upstream;
+
+    if (u == NULL || u->peer.get != ngx_http_multi_upstream_get_peer
+        || u->peer.sockaddr == NULL)
+    {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    kp = u->peer.data;
+
+    p = ngx_pnalloc(r->pool, NGX_INT_T_LEN);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    v->len = ngx_sprintf(p, "%ui", *(ngx_uint_t *) ((char *) kp + data)) - p;
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->data = p;
+
+    return NGX_OK;
+}
+
 static void *
 ngx_http_multi_upstream_create_conf(ngx_conf_t *cf)
 {
@@ -636,6 +846,9 @@ ngx_http_multi_upstream_create_conf(ngx_conf_t *cf)
      *     conf->original_init_upstream = NULL;
      *     conf->original_init_peer = NULL;
      *     conf->max_cached = 0;
+     *     conf->min_cached = 0;
+     *     conf->max_inflight = 0;
+     *     conf->queue_wait = 0;
      */
 
     ngx_queue_init(&conf->cache);
@@ -698,6 +911,8 @@ ngx_http_multi_upstream_connection_detach(ngx_connection_t *c)
 ngx_int_t
 ngx_http_multi_upstream_connection_close(ngx_connection_t *c)
 {
+    ngx_pool_t  *pool;
+
 #if (NGX_HTTP_SSL)
     /* TODO: do not shutdown persistent connection */
     if (c->ssl) {
@@ -717,14 +932,18 @@ ngx_http_multi_upstream_connection_close(ngx_connection_t *c)
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
             "multi: close http upstream connection: %d", c->fd);
 
-    if (c->pool) {
-        ngx_destroy_pool(c->pool);
-    }
+    /* c->log is allocated from the connection pool */
+
+    pool = c->pool;
 
     c->destroyed = 1;
 
     ngx_close_connection(c);
 
+    if (pool) {
+        ngx_destroy_pool(pool);
+    }
+
     return NGX_OK;
 }
 
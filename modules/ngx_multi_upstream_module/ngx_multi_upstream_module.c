@@ -125,6 +125,20 @@ ngx_create_multi_request(ngx_connection_t *c, void *data)
     return multi_r;
 }
 
+void
+ngx_multi_remove_data(ngx_connection_t *c, ngx_queue_t *q)
+{
+    ngx_multi_connection_t  *multi_c;
+
+    multi_c = ngx_get_multi_connection(c);
+
+    ngx_queue_remove(q);
+
+    if (multi_c->inflight) {
+        multi_c->inflight--;
+    }
+}
+
 void
 ngx_multi_clean_leak(ngx_connection_t *c)
 {
@@ -31,11 +31,16 @@ typedef struct {
     ngx_flag_t           connected:1;
 
     void                *cur;
+
+    ngx_uint_t           inflight;      //front requests on the connection
+    ngx_uint_t           max_inflight;  //peak of inflight
+    ngx_uint_t           requests;      //front requests ever attached
 } ngx_multi_connection_t;
 
 typedef struct {
     ngx_queue_t          queue;
     void                *data;
+    ngx_msec_t           start;         //time attached to the connection
 } ngx_multi_data_t;
 
 typedef struct {
@@ -51,6 +56,8 @@ typedef struct {
     ngx_chain_t         *out;
 
     void                *ctx;
+
+    ngx_flag_t           keep:1;                //stays on send_list until answered
 } ngx_multi_request_t;
 
 typedef enum {
@@ -68,6 +75,7 @@ ngx_multi_connection_t* ngx_create_multi_connection(ngx_connection_t *c);
 
 ngx_multi_request_t* ngx_create_multi_request(ngx_connection_t *c, void *data);
 
+void ngx_multi_remove_data(ngx_connection_t *c, ngx_queue_t *q);
 void ngx_multi_clean_leak(ngx_connection_t *c);
 
 #endif /* _NGX_MULTI_UPSTREAM_MODULE_H_ */
@@ -87,6 +87,9 @@ struct ngx_output_chain_ctx_s {
     unsigned                     need_in_memory:1;
     unsigned                     need_in_temp:1;
     unsigned                     aio:1;
+#if (NGX_HAVE_FILE_IO_URING)
+    unsigned                     aio_io_uring:1;
+#endif
 
 #if (NGX_HAVE_FILE_AIO || NGX_COMPAT)
     ngx_output_chain_aio_pt      aio_handler;
@@ -56,6 +56,34 @@ typedef struct {
         ((u_char *) (n) - offsetof(ngx_resolver_node_t, node))
 
 
+typedef struct {
+    ngx_rbtree_t              rbtree;
+    ngx_rbtree_node_t         sentinel;
+    ngx_queue_t               queue;
+} ngx_resolver_shared_t;
+
+
+typedef struct {
+    ngx_str_node_t            sn;
+    ngx_queue_t               queue;
+
+    time_t                    valid;
+    time_t                    updating;
+    uint32_t                  ttl;
+
+    u_short                   naddrs;
+    u_short                   naddrs6;
+
+    /* IPv4 addresses, IPv6 addresses and the name follow */
+    in_addr_t                 addrs[1];
+} ngx_resolver_shared_node_t;
+
+
+/* a cached name is refreshed once 90% of its ttl has passed */
+
+#define ngx_resolver_prefetch(ttl)  ngx_max((time_t) (ttl) / 10, 1)
+
+
 static ngx_int_t ngx_udp_connect(ngx_resolver_connection_t *rec);
 static ngx_int_t ngx_tcp_connect(ngx_resolver_connection_t *rec);
 
@@ -64,6 +92,16 @@ static void ngx_resolver_cleanup(void *data);
 static void ngx_resolver_cleanup_tree(ngx_resolver_t *r, ngx_rbtree_t *tree);
 static ngx_int_t ngx_resolve_name_locked(ngx_resolver_t *r,
     ngx_resolver_ctx_t *ctx, ngx_str_t *name);
+static ngx_int_t ngx_resolver_init_shared_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+static ngx_int_t ngx_resolver_lookup_shared(ngx_resolver_t *r,
+    ngx_resolver_ctx_t *ctx, ngx_str_t *name, uint32_t hash);
+static void ngx_resolver_update_shared(ngx_resolver_t *r,
+    ngx_resolver_node_t *rn);
+static void ngx_resolver_expire_shared(ngx_resolver_t *r,
+    ngx_resolver_shared_t *sh, ngx_uint_t force);
+static void ngx_resolver_refresh(ngx_resolver_t *r, ngx_str_t *name);
+static void ngx_resolver_refresh_handler(ngx_resolver_ctx_t *ctx);
 static void ngx_resolver_expire(ngx_resolver_t *r, ngx_rbtree_t *tree,
     ngx_queue_t *queue);
 static ngx_int_t ngx_resolver_send_query(ngx_resolver_t *r,
@@ -131,6 +169,9 @@ static ngx_resolver_node_t *ngx_resolver_lookup_addr6(ngx_resolver_t *r,
 #endif
 
 
+static ngx_uint_t  ngx_resolver_shared_tag;
+
+
 #if (T_NGX_RESOLVER_FILE)
 static ngx_int_t
 ngx_resolver_parse_resolv_address(ngx_conf_t *cf, ngx_file_t *file,
@@ -273,7 +314,9 @@ ngx_resolver_parse_resolv_address(ngx_conf_t *cf, ngx_file_t *file,
 ngx_resolver_t *
 ngx_resolver_create(ngx_conf_t *cf, ngx_str_t *names, ngx_uint_t n)
 {
-    ngx_str_t                   s;
+    u_char                     *p;
+    ssize_t                     size;
+    ngx_str_t                   s, name;
     ngx_url_t                   u;
     ngx_uint_t                  i, j;
     ngx_resolver_t             *r;
@@ -339,6 +382,7 @@ ngx_resolver_create(ngx_conf_t *cf, ngx_str_t *names, ngx_uint_t n)
     r->tcp_timeout = 5;
     r->expire = 30;
     r->valid = 0;
+    r->stale = 30;
 
     r->log = &cf->cycle->new_log;
     r->log_level = NGX_LOG_ERR;
@@ -376,6 +420,63 @@ ngx_resolver_create(ngx_conf_t *cf, ngx_str_t *names, ngx_uint_t n)
             continue;
         }
 
+        if (ngx_strncmp(names[i].data, "zone=", 5) == 0) {
+
+            name.data = names[i].data + 5;
+
+            p = (u_char *) ngx_strchr(name.data, ':');
+
+            if (p == NULL) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid zone size \"%V\"", &names[i]);
+                return NULL;
+            }
+
+            name.len = p - name.data;
+
+            s.data = p + 1;
+            s.len = names[i].data + names[i].len - s.data;
+
+            size = ngx_parse_size(&s);
+
+            if (size == NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid zone size \"%V\"", &names[i]);
+                return NULL;
+            }
+
+            if (size < (ssize_t) (8 * ngx_pagesize)) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "zone \"%V\" is too small", &names[i]);
+                return NULL;
+            }
+
+            r->shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                                &ngx_resolver_shared_tag);
+            if (r->shm_zone == NULL) {
+                return NULL;
+            }
+
+            r->shm_zone->init = ngx_resolver_init_shared_zone;
+
+            continue;
+        }
+
+        if (ngx_strncmp(names[i].data, "stale=", 6) == 0) {
+            s.len = names[i].len - 6;
+            s.data = names[i].data + 6;
+
+            r->stale = ngx_parse_time(&s, 1);
+
+            if (r->stale == (time_t) NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid parameter: %V", &names[i]);
+                return NULL;
+            }
+
+            continue;
+        }
+
 #if (NGX_HAVE_INET6)
         if (ngx_strncmp(names[i].data, "ipv6=", 5) == 0) {
 
@@ -434,6 +535,51 @@ ngx_resolver_create(ngx_conf_t *cf, ngx_str_t *names, ngx_uint_t n)
 }
 
 
+static ngx_int_t
+ngx_resolver_init_shared_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    size_t                  len;
+    ngx_slab_pool_t        *shpool;
+    ngx_resolver_shared_t  *sh;
+
+    if (data) {
+        shm_zone->data = data;
+        return NGX_OK;
+    }
+
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        shm_zone->data = shpool->data;
+        return NGX_OK;
+    }
+
+    sh = ngx_slab_alloc(shpool, sizeof(ngx_resolver_shared_t));
+    if (sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    shpool->data = sh;
+    shm_zone->data = sh;
+
+    ngx_rbtree_init(&sh->rbtree, &sh->sentinel, ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&sh->queue);
+
+    len = sizeof(" in resolver zone \"\"") + shm_zone->shm.name.len;
+
+    shpool->log_ctx = ngx_slab_alloc(shpool, len);
+    if (shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(shpool->log_ctx, " in resolver zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    return NGX_OK;
+}
+
+
 static void
 ngx_resolver_cleanup(void *data)
 {
@@ -745,6 +891,14 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
 
     hash = ngx_crc32_short(name->data, name->len);
 
+    if (r->shm_zone && ctx->service.len == 0 && !ctx->refresh) {
+        rc = ngx_resolver_lookup_shared(r, ctx, name, hash);
+
+        if (rc != NGX_DECLINED) {
+            return rc;
+        }
+    }
+
     if (ctx->service.len) {
         rn = ngx_resolver_lookup_srv(r, name, hash);
 
@@ -765,7 +919,7 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
         /* ctx can be a list after NGX_RESOLVE_CNAME */
         for (last = ctx; last->next; last = last->next);
 
-        if (rn->valid >= ngx_time()) {
+        if (rn->valid >= ngx_time() && !ctx->refresh) {
 
             ngx_log_debug0(NGX_LOG_DEBUG_CORE, r->log, 0, "resolve cached");
 
@@ -1052,6 +1206,343 @@ failed:
 }
 
 
+static ngx_int_t
+ngx_resolver_lookup_shared(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
+    ngx_str_t *name, uint32_t hash)
+{
+    size_t                       size;
+    time_t                       now, valid;
+    u_char                      *p;
+    ngx_str_t                    refresh;
+    ngx_uint_t                   naddrs;
+    ngx_str_node_t              *sn;
+    ngx_slab_pool_t             *shpool;
+    ngx_resolver_ctx_t          *next;
+    ngx_resolver_node_t          rn;
+    ngx_resolver_addr_t         *addrs;
+    ngx_resolver_shared_t       *sh;
+    ngx_resolver_shared_node_t  *node;
+
+    now = ngx_time();
+
+    shpool = (ngx_slab_pool_t *) r->shm_zone->shm.addr;
+    sh = r->shm_zone->data;
+
+    ngx_shmtx_lock(&shpool->mutex);
+
+    sn = ngx_str_rbtree_lookup(&sh->rbtree, name, hash);
+
+    if (sn == NULL) {
+        ngx_shmtx_unlock(&shpool->mutex);
+        return NGX_DECLINED;
+    }
+
+    node = (ngx_resolver_shared_node_t *) sn;
+
+    if (node->valid + r->stale < now) {
+        ngx_shmtx_unlock(&shpool->mutex);
+        return NGX_DECLINED;
+    }
+
+    /*
+     * a name close to its expiry or already expired is served as is,
+     * and one of the workers queries it again in background
+     */
+
+    refresh.len = 0;
+
+    if (node->updating < now
+        && node->valid - now <= ngx_resolver_prefetch(node->ttl))
+    {
+        node->updating = now + r->resend_timeout;
+        refresh.len = name->len;
+    }
+
+    valid = ngx_max(node->valid, now);
+
+    ngx_queue_remove(&node->queue);
+    ngx_queue_insert_head(&sh->queue, &node->queue);
+
+    ngx_memzero(&rn, sizeof(ngx_resolver_node_t));
+
+    rn.naddrs = node->naddrs;
+    size = rn.naddrs * sizeof(in_addr_t);
+#if (NGX_HAVE_INET6)
+    rn.naddrs6 = node->naddrs6;
+    size += rn.naddrs6 * sizeof(struct in6_addr);
+#endif
+
+    p = ngx_resolver_alloc(r, size + refresh.len);
+    if (p == NULL) {
+        ngx_shmtx_unlock(&shpool->mutex);
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(p, node->addrs, size);
+
+    ngx_shmtx_unlock(&shpool->mutex);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_CORE, r->log, 0,
+                   "resolve shared \"%V\", valid:%T refresh:%d",
+                   name, valid - now, refresh.len != 0);
+
+    if (rn.naddrs) {
+        rn.u.addrs = (in_addr_t *) p;
+
+        if (rn.naddrs == 1) {
+            rn.u.addr = *(in_addr_t *) p;
+        }
+    }
+
+#if (NGX_HAVE_INET6)
+    if (rn.naddrs6) {
+        rn.u6.addrs6 = (struct in6_addr *) (p + rn.naddrs * sizeof(in_addr_t));
+
+        if (rn.naddrs6 == 1) {
+            rn.u6.addr6 = *rn.u6.addrs6;
+        }
+    }
+#endif
+
+    if (refresh.len) {
+        refresh.data = p + size;
+        ngx_memcpy(refresh.data, name->data, name->len);
+    }
+
+    naddrs = rn.naddrs;
+#if (NGX_HAVE_INET6)
+    naddrs += rn.naddrs6;
+#endif
+
+    addrs = ngx_resolver_export(r, &rn, 1);
+    if (addrs == NULL) {
+        ngx_resolver_free(r, p);
+        return NGX_ERROR;
+    }
+
+    /* unlock name mutex */
+
+    do {
+        ctx->state = NGX_OK;
+        ctx->valid = valid;
+        ctx->naddrs = naddrs;
+        ctx->addrs = addrs;
+
+        next = ctx->next;
+
+        ctx->handler(ctx);
+
+        ctx = next;
+    } while (ctx);
+
+    ngx_resolver_free(r, addrs->sockaddr);
+    ngx_resolver_free(r, addrs);
+
+    if (refresh.len) {
+        ngx_resolver_refresh(r, &refresh);
+    }
+
+    ngx_resolver_free(r, p);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_resolver_update_shared(ngx_resolver_t *r, ngx_resolver_node_t *rn)
+{
+    size_t                       size, len;
+    time_t                       now;
+    u_char                      *p;
+    ngx_str_t                    name;
+    ngx_uint_t                   naddrs6;
+    ngx_str_node_t              *sn;
+    ngx_slab_pool_t             *shpool;
+    ngx_resolver_shared_t       *sh;
+    ngx_resolver_shared_node_t  *node;
+
+    now = ngx_time();
+
+    naddrs6 = 0;
+    len = rn->naddrs * sizeof(in_addr_t);
+
+#if (NGX_HAVE_INET6)
+    naddrs6 = rn->naddrs6;
+    len += naddrs6 * sizeof(struct in6_addr);
+#endif
+
+    size = offsetof(ngx_resolver_shared_node_t, addrs) + len + rn->nlen;
+
+    name.len = rn->nlen;
+    name.data = rn->name;
+
+    shpool = (ngx_slab_pool_t *) r->shm_zone->shm.addr;
+    sh = r->shm_zone->data;
+
+    ngx_shmtx_lock(&shpool->mutex);
+
+    ngx_resolver_expire_shared(r, sh, 0);
+
+    sn = ngx_str_rbtree_lookup(&sh->rbtree, &name, rn->node.key);
+
+    node = (ngx_resolver_shared_node_t *) sn;
+
+    if (node
+        && (node->naddrs != rn->naddrs || node->naddrs6 != naddrs6))
+    {
+        ngx_queue_remove(&node->queue);
+        ngx_rbtree_delete(&sh->rbtree, &node->sn.node);
+        ngx_slab_free_locked(shpool, node);
+
+        node = NULL;
+    }
+
+    if (node == NULL) {
+        node = ngx_slab_alloc_locked(shpool, size);
+
+        if (node == NULL) {
+            ngx_resolver_expire_shared(r, sh, 1);
+
+            node = ngx_slab_alloc_locked(shpool, size);
+            if (node == NULL) {
+                ngx_shmtx_unlock(&shpool->mutex);
+
+                ngx_log_error(NGX_LOG_ALERT, r->log, 0,
+                              "could not allocate node%s", shpool->log_ctx);
+                return;
+            }
+        }
+
+        node->sn.node.key = rn->node.key;
+        node->sn.str.len = rn->nlen;
+        node->sn.str.data = (u_char *) node->addrs + len;
+        node->naddrs = rn->naddrs;
+        node->naddrs6 = (u_short) naddrs6;
+
+        ngx_memcpy(node->sn.str.data, rn->name, rn->nlen);
+
+        ngx_rbtree_insert(&sh->rbtree, &node->sn.node);
+
+    } else {
+        ngx_queue_remove(&node->queue);
+    }
+
+    p = (u_char *) node->addrs;
+
+    if (rn->naddrs) {
+        p = ngx_cpymem(p, (rn->naddrs == 1) ? &rn->u.addr : rn->u.addrs,
+                       rn->naddrs * sizeof(in_addr_t));
+    }
+
+#if (NGX_HAVE_INET6)
+    if (rn->naddrs6) {
+        ngx_memcpy(p, (rn->naddrs6 == 1) ? &rn->u6.addr6 : rn->u6.addrs6,
+                   rn->naddrs6 * sizeof(struct in6_addr));
+    }
+#endif
+
+    node->valid = rn->valid;
+    node->ttl = (uint32_t) ngx_max(rn->valid - now, 1);
+    node->updating = 0;
+
+    ngx_queue_insert_head(&sh->queue, &node->queue);
+
+    ngx_shmtx_unlock(&shpool->mutex);
+}
+
+
+static void
+ngx_resolver_expire_shared(ngx_resolver_t *r, ngx_resolver_shared_t *sh,
+    ngx_uint_t force)
+{
+    time_t                       now;
+    ngx_uint_t                   n;
+    ngx_queue_t                 *q;
+    ngx_slab_pool_t             *shpool;
+    ngx_resolver_shared_node_t  *node;
+
+    now = ngx_time();
+
+    shpool = (ngx_slab_pool_t *) r->shm_zone->shm.addr;
+
+    /*
+     * n == 1 deletes one or two names served stale for too long
+     * n == 0 deletes the oldest name anyway
+     */
+
+    for (n = force ? 0 : 1; n < 3; n++) {
+
+        if (ngx_queue_empty(&sh->queue)) {
+            return;
+        }
+
+        q = ngx_queue_last(&sh->queue);
+
+        node = ngx_queue_data(q, ngx_resolver_shared_node_t, queue);
+
+        if (n && node->valid + r->stale >= now) {
+            return;
+        }
+
+        ngx_queue_remove(q);
+
+        ngx_rbtree_delete(&sh->rbtree, &node->sn.node);
+
+        ngx_slab_free_locked(shpool, node);
+    }
+}
+
+
+static void
+ngx_resolver_refresh(ngx_resolver_t *r, ngx_str_t *name)
+{
+    u_char              *data;
+    ngx_resolver_ctx_t  *ctx;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, r->log, 0,
+                   "resolve refresh: \"%V\"", name);
+
+    ctx = ngx_resolve_start(r, NULL);
+    if (ctx == NULL || ctx == NGX_NO_RESOLVER) {
+        return;
+    }
+
+    data = ngx_resolver_dup(r, name->data, name->len);
+    if (data == NULL) {
+        ngx_resolver_free(r, ctx);
+        return;
+    }
+
+    ctx->name.len = name->len;
+    ctx->name.data = data;
+    ctx->handler = ngx_resolver_refresh_handler;
+    ctx->timeout = r->resend_timeout * 1000;
+    ctx->refresh = 1;
+
+    if (ngx_resolve_name(ctx) != NGX_OK) {
+        ngx_resolver_free(r, data);
+    }
+}
+
+
+static void
+ngx_resolver_refresh_handler(ngx_resolver_ctx_t *ctx)
+{
+    u_char          *data;
+    ngx_resolver_t  *r;
+
+    r = ctx->resolver;
+    data = ctx->name.data;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, r->log, 0,
+                   "resolve refresh done: \"%V\" %i", &ctx->name, ctx->state);
+
+    ngx_resolve_name_done(ctx);
+
+    ngx_resolver_free(r, data);
+}
+
+
 ngx_int_t
 ngx_resolve_addr(ngx_resolver_ctx_t *ctx)
 {
@@ -2546,6 +3037,10 @@ ngx_resolver_process_a(ngx_resolver_t *r, u_char *buf, size_t n,
 
         ngx_queue_insert_head(&r->name_expire_queue, &rn->queue);
 
+        if (r->shm_zone) {
+            ngx_resolver_update_shared(r, rn);
+        }
+
         next = rn->waiting;
         rn->waiting = NULL;
 
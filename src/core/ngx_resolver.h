@@ -188,6 +188,10 @@ struct ngx_resolver_s {
     time_t                    expire;
     time_t                    valid;
 
+    /* names cache shared by worker processes */
+    ngx_shm_zone_t           *shm_zone;
+    time_t                    stale;
+
     ngx_uint_t                log_level;
 };
 
@@ -221,6 +225,7 @@ struct ngx_resolver_ctx_s {
     unsigned                  quick:1;
     unsigned                  async:1;
     unsigned                  cancelable:1;
+    unsigned                  refresh:1;
     ngx_uint_t                recursion;
     ngx_event_t              *event;
 };
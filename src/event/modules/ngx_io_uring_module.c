@@ -0,0 +1,747 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * The io_uring module drives readiness notification through the
+ * submission ring: every interest change is queued as an IORING_OP_POLL_ADD
+ * or IORING_OP_POLL_REMOVE request and the whole batch is handed over to
+ * the kernel by the same io_uring_enter() call that waits for completions,
+ * so a loop iteration costs one syscall instead of several epoll_ctl()
+ * calls plus epoll_wait().
+ *
+ * Poll requests are one-shot, so the module provides level-triggered
+ * semantics: a connection is re-armed on the next iteration as long as
+ * its read or write event is still active.  At most one poll request is
+ * in flight per connection, its state survives connection reuse and is
+ * kept in a separate array indexed by the connection number.
+ */
+
+
+#define NGX_IO_URING_POLL_READ   (POLLIN|POLLRDHUP)
+#define NGX_IO_URING_POLL_WRITE  POLLOUT
+
+
+typedef struct {
+    ngx_uint_t  entries;
+    ngx_uint_t  events;
+} ngx_io_uring_conf_t;
+
+
+typedef struct {
+    uint64_t    data;
+    uint32_t    armed;
+    unsigned    canceling:1;
+    unsigned    queued:1;
+} ngx_io_uring_slot_t;
+
+
+static ngx_int_t ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer);
+static ngx_int_t ngx_io_uring_notify_init(ngx_log_t *log);
+static void ngx_io_uring_notify_handler(ngx_event_t *ev);
+static void ngx_io_uring_done(ngx_cycle_t *cycle);
+static ngx_int_t ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_del_connection(ngx_connection_t *c,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_notify(ngx_event_handler_pt handler);
+static ngx_int_t ngx_io_uring_process_events(ngx_cycle_t *cycle,
+    ngx_msec_t timer, ngx_uint_t flags);
+
+static ngx_io_uring_slot_t *ngx_io_uring_slot(ngx_connection_t *c);
+static void ngx_io_uring_queue(ngx_connection_t *c);
+static ngx_int_t ngx_io_uring_cancel(ngx_connection_t *c, ngx_log_t *log);
+static ngx_int_t ngx_io_uring_flush(ngx_cycle_t *cycle);
+
+static void *ngx_io_uring_create_conf(ngx_cycle_t *cycle);
+static char *ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf);
+
+
+extern ngx_module_t         ngx_epoll_module;
+
+static ngx_io_uring_t       ring;
+
+static ngx_io_uring_slot_t *slots;
+static ngx_uint_t           nslots;
+static ngx_connection_t   **change_list;
+static ngx_uint_t           nchanges;
+static ngx_uint_t           max_changes;
+
+static int                  notify_fd = -1;
+static ngx_event_t          notify_event;
+static ngx_event_t          notify_write_event;
+static ngx_connection_t     notify_conn;
+static ngx_io_uring_slot_t  notify_slot;
+
+
+static ngx_str_t      io_uring_name = ngx_string("io_uring");
+
+static ngx_command_t  ngx_io_uring_commands[] = {
+
+    { ngx_string("io_uring_entries"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_io_uring_conf_t, entries),
+      NULL },
+
+    { ngx_string("io_uring_events"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_io_uring_conf_t, events),
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_event_module_t  ngx_io_uring_module_ctx = {
+    &io_uring_name,
+    ngx_io_uring_create_conf,            /* create configuration */
+    ngx_io_uring_init_conf,              /* init configuration */
+
+    {
+        ngx_io_uring_add_event,          /* add an event */
+        ngx_io_uring_del_event,          /* delete an event */
+        ngx_io_uring_add_event,          /* enable an event */
+        ngx_io_uring_del_event,          /* disable an event */
+        NULL,                            /* add an connection */
+        ngx_io_uring_del_connection,     /* delete an connection */
+        ngx_io_uring_notify,             /* trigger a notify */
+        ngx_io_uring_process_events,     /* process the events */
+        ngx_io_uring_init,               /* init the events */
+        ngx_io_uring_done,               /* done the events */
+#if (NGX_SSL && NGX_SSL_ASYNC)
+        NULL,                            /* add an async conn */
+        NULL,                            /* del an async conn */
+#endif
+    }
+};
+
+ngx_module_t  ngx_io_uring_module = {
+    NGX_MODULE_V1,
+    &ngx_io_uring_module_ctx,            /* module context */
+    ngx_io_uring_commands,               /* module directives */
+    NGX_EVENT_MODULE,                    /* module type */
+    NULL,                                /* init master */
+    NULL,                                /* init module */
+    NULL,                                /* init process */
+    NULL,                                /* init thread */
+    NULL,                                /* exit thread */
+    NULL,                                /* exit process */
+    NULL,                                /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_int_t
+ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer)
+{
+    ngx_io_uring_conf_t  *urcf;
+    ngx_event_module_t   *module;
+
+    urcf = ngx_event_get_conf(cycle->conf_ctx, ngx_io_uring_module);
+
+    if (ring.sqes == NULL) {
+
+        if (ngx_io_uring_create(&ring, urcf->entries, cycle->log) != NGX_OK) {
+            ngx_log_error(NGX_LOG_WARN, cycle->log, ngx_errno,
+                          "io_uring_setup() failed, falling back to epoll");
+            goto fallback;
+        }
+
+        if (!(ring.features & IORING_FEAT_EXT_ARG)
+            || !(ring.features & IORING_FEAT_NODROP))
+        {
+            ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                          "io_uring is not supported by the kernel, "
+                          "falling back to epoll");
+            ngx_io_uring_destroy(&ring, cycle->log);
+            goto fallback;
+        }
+
+#if (NGX_HAVE_FILE_AIO)
+        /* the Linux AIO eventfd is set up by the epoll module only */
+        ngx_file_aio = 0;
+#endif
+    }
+
+    if (nslots < cycle->connection_n) {
+        if (slots) {
+            ngx_free(slots);
+        }
+
+        if (change_list) {
+            ngx_free(change_list);
+        }
+
+        slots = ngx_calloc(sizeof(ngx_io_uring_slot_t) * cycle->connection_n,
+                           cycle->log);
+        if (slots == NULL) {
+            return NGX_ERROR;
+        }
+
+        max_changes = cycle->connection_n + 1;
+
+        change_list = ngx_alloc(sizeof(ngx_connection_t *) * max_changes,
+                                cycle->log);
+        if (change_list == NULL) {
+            return NGX_ERROR;
+        }
+
+        nslots = cycle->connection_n;
+        nchanges = 0;
+    }
+
+    if (notify_fd == -1 && ngx_io_uring_module_ctx.actions.notify) {
+        if (ngx_io_uring_notify_init(cycle->log) != NGX_OK) {
+            ngx_io_uring_module_ctx.actions.notify = NULL;
+        }
+    }
+
+    ngx_io = ngx_os_io;
+
+    ngx_event_actions = ngx_io_uring_module_ctx.actions;
+
+    ngx_event_flags = NGX_USE_LEVEL_EVENT;
+
+    return NGX_OK;
+
+fallback:
+
+#if (NGX_HAVE_EPOLL)
+
+    module = ngx_epoll_module.ctx;
+
+    return module->actions.init(cycle, timer);
+
+#else
+
+    (void) module;
+
+    return NGX_ERROR;
+
+#endif
+}
+
+
+static ngx_int_t
+ngx_io_uring_notify_init(ngx_log_t *log)
+{
+#if (NGX_HAVE_SYS_EVENTFD_H)
+    notify_fd = eventfd(0, EFD_NONBLOCK);
+#else
+    notify_fd = -1;
+#endif
+
+    if (notify_fd == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno, "eventfd() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "notify eventfd: %d", notify_fd);
+
+    notify_event.handler = ngx_io_uring_notify_handler;
+    notify_event.log = log;
+    notify_event.active = 1;
+
+    notify_write_event.log = log;
+
+    notify_conn.fd = notify_fd;
+    notify_conn.read = &notify_event;
+    notify_conn.write = &notify_write_event;
+    notify_conn.log = log;
+
+    ngx_io_uring_queue(&notify_conn);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_io_uring_notify_handler(ngx_event_t *ev)
+{
+    ssize_t               n;
+    uint64_t              count;
+    ngx_event_handler_pt  handler;
+
+    /* the poll request is one-shot, so the counter must be drained */
+
+    n = read(notify_fd, &count, sizeof(uint64_t));
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "read() eventfd %d: %z count:%uL", notify_fd, n, count);
+
+    if (n == -1 && ngx_errno == NGX_EAGAIN) {
+        return;
+    }
+
+    if ((size_t) n != sizeof(uint64_t)) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_errno,
+                      "read() eventfd %d failed", notify_fd);
+    }
+
+    handler = ev->data;
+
+    if (handler) {
+        handler(ev);
+    }
+}
+
+
+static void
+ngx_io_uring_done(ngx_cycle_t *cycle)
+{
+    ngx_io_uring_destroy(&ring, cycle->log);
+
+    if (notify_fd != -1 && close(notify_fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "eventfd close() failed");
+    }
+
+    notify_fd = -1;
+    ngx_memzero(&notify_slot, sizeof(ngx_io_uring_slot_t));
+
+    ngx_free(slots);
+    ngx_free(change_list);
+
+    slots = NULL;
+    nslots = 0;
+    change_list = NULL;
+    nchanges = 0;
+}
+
+
+static ngx_int_t
+ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    ngx_connection_t  *c;
+
+    c = ev->data;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring add event: fd:%d ev:%i", c->fd, event);
+
+    ev->active = 1;
+
+    ngx_io_uring_queue(c);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    ngx_event_t       *e;
+    ngx_connection_t  *c;
+
+    c = ev->data;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring del event: fd:%d ev:%i", c->fd, event);
+
+    ev->active = 0;
+
+    /*
+     * an outstanding poll request is not removed when the interest
+     * is dropped: its completion is ignored and it is not re-armed;
+     * however, the poll request holds a reference to the file,
+     * so it must be canceled before the descriptor is closed
+     */
+
+    if (flags & NGX_CLOSE_EVENT) {
+        e = (event == NGX_READ_EVENT) ? c->write : c->read;
+
+        if (!e->active) {
+            return ngx_io_uring_cancel(c, ev->log);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_del_connection(ngx_connection_t *c, ngx_uint_t flags)
+{
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "io_uring del connection: fd:%d", c->fd);
+
+    c->read->active = 0;
+    c->write->active = 0;
+
+    if (flags & NGX_CLOSE_EVENT) {
+        return ngx_io_uring_cancel(c, c->log);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_notify(ngx_event_handler_pt handler)
+{
+    static uint64_t inc = 1;
+
+    notify_event.data = handler;
+
+    if ((size_t) write(notify_fd, &inc, sizeof(uint64_t)) != sizeof(uint64_t)) {
+        ngx_log_error(NGX_LOG_ALERT, notify_event.log, ngx_errno,
+                      "write() to eventfd %d failed", notify_fd);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_io_uring_slot_t *
+ngx_io_uring_slot(ngx_connection_t *c)
+{
+    if (c == &notify_conn) {
+        return &notify_slot;
+    }
+
+    return &slots[c - ngx_cycle->connections];
+}
+
+
+static void
+ngx_io_uring_queue(ngx_connection_t *c)
+{
+    ngx_io_uring_slot_t  *slot;
+
+    slot = ngx_io_uring_slot(c);
+
+    if (slot->queued) {
+        return;
+    }
+
+    slot->queued = 1;
+    change_list[nchanges++] = c;
+}
+
+
+static ngx_int_t
+ngx_io_uring_cancel(ngx_connection_t *c, ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+    ngx_io_uring_slot_t  *slot;
+
+    slot = ngx_io_uring_slot(c);
+
+    if (slot->armed == 0 || slot->canceling) {
+        return NGX_OK;
+    }
+
+    sqe = ngx_io_uring_get_sqe(&ring, log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = slot->data;
+    sqe->user_data = 0;
+
+    slot->canceling = 1;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "io_uring poll remove: fd:%d ev:%04XD", c->fd, slot->armed);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_flush(ngx_cycle_t *cycle)
+{
+    uint32_t              events;
+    ngx_uint_t            i;
+    ngx_connection_t     *c;
+    struct io_uring_sqe  *sqe;
+    ngx_io_uring_slot_t  *slot;
+
+    for (i = 0; i < nchanges; i++) {
+        c = change_list[i];
+        slot = ngx_io_uring_slot(c);
+
+        slot->queued = 0;
+
+        if (c->fd == -1) {
+            continue;
+        }
+
+        events = 0;
+
+        if (c->read->active) {
+            events |= NGX_IO_URING_POLL_READ;
+        }
+
+        if (c->write->active) {
+            events |= NGX_IO_URING_POLL_WRITE;
+        }
+
+        if (slot->armed) {
+
+            /*
+             * the connection is re-armed from the completion
+             * of the outstanding request if the interest has grown
+             */
+
+            if ((events & ~slot->armed) && !slot->canceling) {
+                if (ngx_io_uring_cancel(c, cycle->log) != NGX_OK) {
+                    return NGX_ERROR;
+                }
+            }
+
+            continue;
+        }
+
+        if (events == 0) {
+            continue;
+        }
+
+        sqe = ngx_io_uring_get_sqe(&ring, cycle->log);
+        if (sqe == NULL) {
+            return NGX_ERROR;
+        }
+
+        slot->data = (uintptr_t) c | c->read->instance;
+        slot->armed = events;
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = c->fd;
+        sqe->poll32_events = events;
+        sqe->user_data = slot->data;
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring poll add: fd:%d ev:%04XD", c->fd, events);
+    }
+
+    nchanges = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
+    ngx_uint_t flags)
+{
+    int                   n;
+    uint32_t              revents;
+    uint64_t              data;
+    ngx_int_t             instance, res;
+    ngx_uint_t            i, level;
+    ngx_err_t             err;
+    ngx_event_t          *rev, *wev;
+    ngx_queue_t          *queue;
+    ngx_connection_t     *c;
+    ngx_io_uring_conf_t  *urcf;
+    ngx_io_uring_slot_t  *slot;
+    struct io_uring_cqe  *cqe;
+
+    if (ngx_io_uring_flush(cycle) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    /* NGX_TIMER_INFINITE == INFTIM */
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring timer: %M, submit: %ud", timer, ring.sq_pending);
+
+    n = ngx_io_uring_enter(&ring, 1, timer);
+
+    err = (n == -1) ? ngx_errno : 0;
+
+    if (flags & NGX_UPDATE_TIME || ngx_event_timer_alarm) {
+        ngx_time_update();
+    }
+
+    if (err) {
+        if (err == NGX_EINTR) {
+
+            if (ngx_event_timer_alarm) {
+                ngx_event_timer_alarm = 0;
+                return NGX_OK;
+            }
+
+            level = NGX_LOG_INFO;
+
+        } else if (err == ETIME || err == NGX_EBUSY || err == NGX_EAGAIN) {
+
+            /* timed out or the completion queue is overflowed */
+
+            level = 0;
+
+        } else {
+            level = NGX_LOG_ALERT;
+        }
+
+        if (level) {
+            ngx_log_error(level, cycle->log, err, "io_uring_enter() failed");
+            return NGX_ERROR;
+        }
+    }
+
+    urcf = ngx_event_get_conf(cycle->conf_ctx, ngx_io_uring_module);
+
+    for (i = 0; i < urcf->events; i++) {
+
+        cqe = ngx_io_uring_peek_cqe(&ring);
+        if (cqe == NULL) {
+            break;
+        }
+
+        data = cqe->user_data;
+        res = cqe->res;
+
+        ngx_io_uring_cqe_seen(&ring);
+
+        if (data == 0) {
+            /* poll remove completion */
+            continue;
+        }
+
+        c = (ngx_connection_t *) (uintptr_t) (data & (uint64_t) ~1);
+        instance = data & 1;
+
+        slot = ngx_io_uring_slot(c);
+
+        slot->armed = 0;
+        slot->canceling = 0;
+
+        ngx_io_uring_queue(c);
+
+        if (res == -NGX_ECANCELED) {
+            continue;
+        }
+
+        rev = c->read;
+
+        if (c->fd == -1 || rev->instance != instance) {
+
+            /*
+             * the stale event from a file descriptor
+             * that was just closed in this iteration
+             */
+
+            ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring: stale event %p", c);
+            continue;
+        }
+
+        revents = (res < 0) ? POLLERR : (uint32_t) res;
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: fd:%d ev:%04XD d:%p",
+                       c->fd, revents, (void *) (uintptr_t) data);
+
+        if (revents & (POLLERR|POLLHUP|POLLNVAL)) {
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring poll error on fd:%d ev:%04XD",
+                           c->fd, revents);
+
+            /*
+             * if the error events were returned, add POLLIN and POLLOUT
+             * to handle the events at least in one active handler
+             */
+
+            revents |= POLLIN|POLLOUT;
+        }
+
+        if ((revents & (POLLIN|POLLRDHUP)) && rev->active) {
+
+            rev->ready = 1;
+
+            if (flags & NGX_POST_EVENTS) {
+                queue = rev->accept ? &ngx_posted_accept_events
+                                    : &ngx_posted_events;
+
+                ngx_post_event(rev, queue);
+
+            } else {
+                rev->handler(rev);
+            }
+        }
+
+        wev = c->write;
+
+        if ((revents & POLLOUT) && wev->active) {
+
+            if (c->fd == -1 || wev->instance != instance) {
+
+                /*
+                 * the stale event from a file descriptor
+                 * that was just closed in this iteration
+                 */
+
+                ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                               "io_uring: stale event %p", c);
+                continue;
+            }
+
+            wev->ready = 1;
+#if (NGX_THREADS)
+            wev->complete = 1;
+#endif
+
+            if (flags & NGX_POST_EVENTS) {
+                ngx_post_event(wev, &ngx_posted_events);
+
+            } else {
+                wev->handler(wev);
+            }
+        }
+    }
+
+    if (i == 0 && timer == NGX_TIMER_INFINITE && err == 0 && n == 0) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, 0,
+                      "io_uring_enter() returned no events without timeout");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_io_uring_create_conf(ngx_cycle_t *cycle)
+{
+    ngx_io_uring_conf_t  *urcf;
+
+    urcf = ngx_palloc(cycle->pool, sizeof(ngx_io_uring_conf_t));
+    if (urcf == NULL) {
+        return NULL;
+    }
+
+    urcf->entries = NGX_CONF_UNSET;
+    urcf->events = NGX_CONF_UNSET;
+
+    return urcf;
+}
+
+
+static char *
+ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_io_uring_conf_t *urcf = conf;
+
+    ngx_conf_init_uint_value(urcf->entries, 1024);
+    ngx_conf_init_uint_value(urcf->events, 512);
+
+    return NGX_CONF_OK;
+}
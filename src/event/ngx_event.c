@@ -164,6 +164,13 @@ static ngx_command_t  ngx_event_core_commands[] = {
       offsetof(ngx_event_conf_t, accept_mutex_delay),
       NULL },
 
+    { ngx_string("timer_wheel"),
+      NGX_EVENT_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      0,
+      offsetof(ngx_event_conf_t, timer_wheel),
+      NULL },
+
     { ngx_string("debug_connection"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_event_debug_connection,
@@ -665,6 +672,8 @@ ngx_event_process_init(ngx_cycle_t *cycle)
     ngx_queue_init(&ngx_posted_accept_events);
     ngx_queue_init(&ngx_posted_events);
 
+    ngx_event_timer_wheel = ecf->timer_wheel;
+
     if (ngx_event_timer_init(cycle->log) == NGX_ERROR) {
         return NGX_ERROR;
     }
@@ -1272,6 +1281,7 @@ ngx_event_core_create_conf(ngx_cycle_t *cycle)
     ecf->multi_accept = NGX_CONF_UNSET;
     ecf->accept_mutex = NGX_CONF_UNSET;
     ecf->accept_mutex_delay = NGX_CONF_UNSET_MSEC;
+    ecf->timer_wheel = NGX_CONF_UNSET;
     ecf->name = (void *) NGX_CONF_UNSET;
 
 #if (NGX_DEBUG)
@@ -1377,6 +1387,32 @@ ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf)
                             500);
 #endif
 
+    ngx_conf_init_value(ecf->timer_wheel, 0);
+
+    if (!ecf->timer_wheel) {
+        return NGX_CONF_OK;
+    }
+
+    /* these modules walk the timer rbtree directly */
+
+    for (i = 0; cycle->modules[i]; i++) {
+
+        if (ngx_strcmp(cycle->modules[i]->name, "ngx_http_lua_module") == 0) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                          "\"timer_wheel\" is incompatible "
+                          "with ngx_http_lua_module");
+            return NGX_CONF_ERROR;
+        }
+
+        if (ngx_strcmp(cycle->modules[i]->name, "ngx_http_debug_timer_module")
+            == 0)
+        {
+            ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                          "ngx_http_debug_timer_module does not show "
+                          "the timers of \"timer_wheel\"");
+        }
+    }
+
     return NGX_CONF_OK;
 }
 
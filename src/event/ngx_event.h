@@ -175,6 +175,10 @@ struct ngx_event_aio_s {
     size_t                     nbytes;
 #endif
 
+#if (NGX_HAVE_FILE_IO_URING)
+    size_t                     nread;
+#endif
+
     ngx_aiocb_t                aiocb;
     ngx_event_t                event;
 };
@@ -469,6 +473,8 @@ typedef struct {
 
     ngx_msec_t    accept_mutex_delay;
 
+    ngx_flag_t    timer_wheel;
+
     u_char       *name;
 
 #if (NGX_DEBUG)
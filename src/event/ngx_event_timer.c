@@ -10,9 +10,59 @@
 #include <ngx_event.h>
 
 
+/*
+ * The timing wheel keeps timers in lists instead of the rbtree, so adding
+ * and deleting a timer costs O(1).  The root level has a slot per
+ * millisecond, every upper level slot covers a whole turn of the level
+ * below it, the timers of an upper level slot are redistributed to the
+ * lower levels when the time reaches the slot.  A bitmap of non-empty
+ * slots allows to find the next expiration time without scanning lists.
+ *
+ * The timer rbtree node is reused: "left" and "right" link the slot list,
+ * "parent" points to the list head.
+ */
+
+#define NGX_TIMER_WHEEL_ROOT_BITS  8
+#define NGX_TIMER_WHEEL_ROOT_SIZE  (1 << NGX_TIMER_WHEEL_ROOT_BITS)
+#define NGX_TIMER_WHEEL_ROOT_MASK  (NGX_TIMER_WHEEL_ROOT_SIZE - 1)
+
+#define NGX_TIMER_WHEEL_BITS       6
+#define NGX_TIMER_WHEEL_SIZE       (1 << NGX_TIMER_WHEEL_BITS)
+#define NGX_TIMER_WHEEL_MASK       (NGX_TIMER_WHEEL_SIZE - 1)
+
+#define NGX_TIMER_WHEEL_LEVELS     4
+
+#define NGX_TIMER_WHEEL_SLOTS                                                 \
+    (NGX_TIMER_WHEEL_ROOT_SIZE + NGX_TIMER_WHEEL_LEVELS * NGX_TIMER_WHEEL_SIZE)
+
+/* the wheel spans 2^32 milliseconds, longer timers are rescheduled */
+#define NGX_TIMER_WHEEL_MAX        0xffffffff
+
+
+typedef struct {
+    ngx_msec_t                 now;        /* the next tick to process,
+                                              already cascaded */
+    ngx_uint_t                 count;
+    uint64_t                   bitmap[NGX_TIMER_WHEEL_SLOTS / 64];
+    ngx_rbtree_node_t          slots[NGX_TIMER_WHEEL_SLOTS];
+} ngx_event_timer_wheel_t;
+
+
+static ngx_msec_t ngx_event_wheel_next(void);
+static void ngx_event_wheel_expire(void);
+static void ngx_event_wheel_advance(ngx_msec_t now);
+static void ngx_event_wheel_insert(ngx_rbtree_node_t *node);
+static void ngx_event_wheel_cascade(ngx_uint_t slot);
+static ngx_uint_t ngx_event_wheel_ctz(uint64_t bits);
+
+
 ngx_rbtree_t              ngx_event_timer_rbtree;
 static ngx_rbtree_node_t  ngx_event_timer_sentinel;
 
+ngx_uint_t                ngx_event_timer_wheel;
+
+static ngx_event_timer_wheel_t  ngx_event_wheel;
+
 /*
  * the event timer rbtree may contain the duplicate keys, however,
  * it should not be a problem, because we use the rbtree to find
@@ -22,9 +72,28 @@ static ngx_rbtree_node_t  ngx_event_timer_sentinel;
 ngx_int_t
 ngx_event_timer_init(ngx_log_t *log)
 {
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *head;
+
     ngx_rbtree_init(&ngx_event_timer_rbtree, &ngx_event_timer_sentinel,
                     ngx_rbtree_insert_timer_value);
 
+    if (!ngx_event_timer_wheel) {
+        return NGX_OK;
+    }
+
+    ngx_memzero(&ngx_event_wheel, sizeof(ngx_event_timer_wheel_t));
+
+    for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+        head = &ngx_event_wheel.slots[i];
+        head->left = head;
+        head->right = head;
+    }
+
+    ngx_event_wheel.now = ngx_current_msec;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, log, 0, "event timer wheel");
+
     return NGX_OK;
 }
 
@@ -35,6 +104,16 @@ ngx_event_find_timer(void)
     ngx_msec_int_t      timer;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        if (ngx_event_wheel.count == 0) {
+            return NGX_TIMER_INFINITE;
+        }
+
+        timer = (ngx_msec_int_t) (ngx_event_wheel_next() - ngx_current_msec);
+
+        return (ngx_msec_t) (timer > 0 ? timer : 0);
+    }
+
     if (ngx_event_timer_rbtree.root == &ngx_event_timer_sentinel) {
         return NGX_TIMER_INFINITE;
     }
@@ -56,6 +135,11 @@ ngx_event_expire_timers(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        ngx_event_wheel_expire();
+        return;
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
 
     for ( ;; ) {
@@ -99,8 +183,27 @@ ngx_event_expire_timers(void)
 ngx_int_t
 ngx_event_no_timers_left(void)
 {
+    ngx_uint_t          i;
     ngx_event_t        *ev;
-    ngx_rbtree_node_t  *node, *root, *sentinel;
+    ngx_rbtree_node_t  *node, *root, *sentinel, *head;
+
+    if (ngx_event_timer_wheel) {
+
+        for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+            head = &ngx_event_wheel.slots[i];
+
+            for (node = head->right; node != head; node = node->right) {
+                ev = (ngx_event_t *)
+                         ((char *) node - offsetof(ngx_event_t, timer));
+
+                if (!ev->cancelable) {
+                    return NGX_AGAIN;
+                }
+            }
+        }
+
+        return NGX_OK;
+    }
 
     sentinel = ngx_event_timer_rbtree.sentinel;
     root = ngx_event_timer_rbtree.root;
@@ -124,3 +227,301 @@ ngx_event_no_timers_left(void)
 
     return NGX_OK;
 }
+
+
+void
+ngx_event_timer_wheel_add(ngx_event_t *ev)
+{
+    ngx_event_wheel_insert(&ev->timer);
+    ngx_event_wheel.count++;
+}
+
+
+void
+ngx_event_timer_wheel_del(ngx_event_t *ev)
+{
+    ngx_uint_t          slot;
+    ngx_rbtree_node_t  *node, *head;
+
+    node = &ev->timer;
+    head = node->parent;
+
+    node->left->right = node->right;
+    node->right->left = node->left;
+
+    ngx_event_wheel.count--;
+
+    if (head->right == head
+        && head >= &ngx_event_wheel.slots[0]
+        && head < &ngx_event_wheel.slots[NGX_TIMER_WHEEL_SLOTS])
+    {
+        slot = head - ngx_event_wheel.slots;
+        ngx_event_wheel.bitmap[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+    }
+}
+
+
+static ngx_msec_t
+ngx_event_wheel_next(void)
+{
+    uint64_t    bits;
+    ngx_uint_t  i, n, cur, level, shift, found;
+    ngx_msec_t  now, next, t;
+
+    now = ngx_event_wheel.now;
+    cur = now & NGX_TIMER_WHEEL_ROOT_MASK;
+
+    /* root slots up to the end of the turn hold exact times */
+
+    for (i = cur >> 6; i < NGX_TIMER_WHEEL_ROOT_SIZE / 64; i++) {
+        bits = ngx_event_wheel.bitmap[i];
+
+        if (i == cur >> 6) {
+            bits &= ~(uint64_t) 0 << (cur & 63);
+        }
+
+        if (bits) {
+            return now - cur + i * 64 + ngx_event_wheel_ctz(bits);
+        }
+    }
+
+    /* root slots before the current one belong to the next turn */
+
+    next = now + NGX_TIMER_WHEEL_ROOT_SIZE - cur;
+    found = 0;
+
+    for (i = 0; i < NGX_TIMER_WHEEL_ROOT_SIZE / 64; i++) {
+        if (ngx_event_wheel.bitmap[i]) {
+            found = 1;
+            break;
+        }
+    }
+
+    /* upper level slots are due when the time reaches their start */
+
+    for (level = 0, shift = NGX_TIMER_WHEEL_ROOT_BITS;
+         level < NGX_TIMER_WHEEL_LEVELS;
+         level++, shift += NGX_TIMER_WHEEL_BITS)
+    {
+        bits = ngx_event_wheel.bitmap[NGX_TIMER_WHEEL_ROOT_SIZE / 64 + level];
+
+        if (bits == 0) {
+            continue;
+        }
+
+        /* rotate the bitmap to start from the slot after the current one */
+
+        cur = (now >> shift) & NGX_TIMER_WHEEL_MASK;
+        n = (cur + 1) & NGX_TIMER_WHEEL_MASK;
+        bits = (bits >> n) | (bits << ((64 - n) & 63));
+
+        t = ((now >> shift) + ngx_event_wheel_ctz(bits) + 1) << shift;
+
+        if (!found || (ngx_msec_int_t) (t - next) < 0) {
+            next = t;
+            found = 1;
+        }
+    }
+
+    return next;
+}
+
+
+static void
+ngx_event_wheel_expire(void)
+{
+    ngx_uint_t          slot;
+    ngx_msec_t          next;
+    ngx_event_t        *ev;
+    ngx_rbtree_node_t   list, *head, *node;
+
+    for ( ;; ) {
+
+        if (ngx_event_wheel.count == 0) {
+            ngx_event_wheel.now = ngx_current_msec + 1;
+            return;
+        }
+
+        next = ngx_event_wheel_next();
+
+        if ((ngx_msec_int_t) (next - ngx_current_msec) > 0) {
+
+            /* nothing is due up to the current time */
+
+            ngx_event_wheel_advance(ngx_current_msec + 1);
+            return;
+        }
+
+        ngx_event_wheel_advance(next);
+
+        slot = next & NGX_TIMER_WHEEL_ROOT_MASK;
+        head = &ngx_event_wheel.slots[slot];
+
+        if (head->right == head) {
+            ngx_event_wheel_advance(next + 1);
+            continue;
+        }
+
+        /* move the whole slot to a private list and run it */
+
+        list.right = head->right;
+        list.left = head->left;
+        list.right->left = &list;
+        list.left->right = &list;
+
+        head->left = head;
+        head->right = head;
+
+        ngx_event_wheel.bitmap[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+
+        ngx_event_wheel_advance(next + 1);
+
+        for (node = list.right; node != &list; node = list.right) {
+            ev = (ngx_event_t *) ((char *) node - offsetof(ngx_event_t, timer));
+
+            ngx_event_timer_wheel_del(ev);
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                           "event timer del: %d: %M",
+                           ngx_event_ident(ev->data), ev->timer.key);
+
+#if (NGX_DEBUG)
+            ev->timer.left = NULL;
+            ev->timer.right = NULL;
+            ev->timer.parent = NULL;
+#endif
+
+            ev->timer_set = 0;
+
+            ev->timedout = 1;
+
+            ev->handler(ev);
+        }
+    }
+}
+
+
+static void
+ngx_event_wheel_advance(ngx_msec_t now)
+{
+    ngx_uint_t  level, shift, idx;
+
+    if (ngx_event_wheel.now == now) {
+        return;
+    }
+
+    /*
+     * the ticks skipped, if any, are known to have nothing to expire
+     * or to cascade
+     */
+
+    ngx_event_wheel.now = now;
+
+    if ((now & NGX_TIMER_WHEEL_ROOT_MASK) != 0) {
+        return;
+    }
+
+    for (level = 0, shift = NGX_TIMER_WHEEL_ROOT_BITS;
+         level < NGX_TIMER_WHEEL_LEVELS;
+         level++, shift += NGX_TIMER_WHEEL_BITS)
+    {
+        idx = (now >> shift) & NGX_TIMER_WHEEL_MASK;
+
+        ngx_event_wheel_cascade(NGX_TIMER_WHEEL_ROOT_SIZE
+                                + level * NGX_TIMER_WHEEL_SIZE + idx);
+
+        if (idx != 0) {
+            break;
+        }
+    }
+}
+
+
+static void
+ngx_event_wheel_insert(ngx_rbtree_node_t *node)
+{
+    ngx_uint_t          slot, shift;
+    ngx_msec_t          key;
+    ngx_msec_int_t      diff;
+    ngx_rbtree_node_t  *head;
+
+    key = node->key;
+    diff = (ngx_msec_int_t) (key - ngx_event_wheel.now);
+
+    if (diff < 0) {
+        slot = ngx_event_wheel.now & NGX_TIMER_WHEEL_ROOT_MASK;
+
+    } else if (diff < NGX_TIMER_WHEEL_ROOT_SIZE) {
+        slot = key & NGX_TIMER_WHEEL_ROOT_MASK;
+
+    } else {
+        if ((uint64_t) diff > NGX_TIMER_WHEEL_MAX) {
+            diff = NGX_TIMER_WHEEL_MAX;
+            key = ngx_event_wheel.now + NGX_TIMER_WHEEL_MAX;
+        }
+
+        slot = NGX_TIMER_WHEEL_ROOT_SIZE;
+        shift = NGX_TIMER_WHEEL_ROOT_BITS;
+
+        while ((uint64_t) diff
+               >= (uint64_t) 1 << (shift + NGX_TIMER_WHEEL_BITS))
+        {
+            slot += NGX_TIMER_WHEEL_SIZE;
+            shift += NGX_TIMER_WHEEL_BITS;
+        }
+
+        slot += (key >> shift) & NGX_TIMER_WHEEL_MASK;
+    }
+
+    head = &ngx_event_wheel.slots[slot];
+
+    node->parent = head;
+    node->right = head;
+    node->left = head->left;
+    head->left->right = node;
+    head->left = node;
+
+    ngx_event_wheel.bitmap[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+}
+
+
+static void
+ngx_event_wheel_cascade(ngx_uint_t slot)
+{
+    ngx_rbtree_node_t  *head, *node, *next;
+
+    head = &ngx_event_wheel.slots[slot];
+    node = head->right;
+
+    head->left = head;
+    head->right = head;
+
+    ngx_event_wheel.bitmap[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+
+    while (node != head) {
+        next = node->right;
+        ngx_event_wheel_insert(node);
+        node = next;
+    }
+}
+
+
+static ngx_uint_t
+ngx_event_wheel_ctz(uint64_t bits)
+{
+#if (NGX_HAVE_GCC_CTZLL)
+
+    return __builtin_ctzll(bits);
+
+#else
+
+    ngx_uint_t  n;
+
+    for (n = 0; (bits & 1) == 0; n++) {
+        bits >>= 1;
+    }
+
+    return n;
+
+#endif
+}
@@ -9,11 +9,19 @@
 #include <ngx_core.h>
 #include <ngx_http.h>
 
+#if (T_NGX_MULTI_UPSTREAM)
+#include <ngx_http_multi_upstream_module.h>
+#endif
+
 
 typedef struct {
     ngx_http_upstream_conf_t   upstream;
     ngx_int_t                  index;
     ngx_uint_t                 gzip_flag;
+#if (T_NGX_MULTI_UPSTREAM)
+    ngx_uint_t                 batch;
+    ngx_msec_t                 batch_window;
+#endif
 } ngx_http_memcached_loc_conf_t;
 
 
@@ -24,6 +32,44 @@ typedef struct {
 } ngx_http_memcached_ctx_t;
 
 
+#if (T_NGX_MULTI_UPSTREAM)
+
+typedef enum {
+    ngx_http_memcached_batch_st_line = 0,
+    ngx_http_memcached_batch_st_value,
+    ngx_http_memcached_batch_st_data,
+    ngx_http_memcached_batch_st_end,
+    ngx_http_memcached_batch_st_error
+} ngx_http_memcached_batch_state_e;
+
+
+typedef struct {
+    ngx_multi_request_t        multi_r;
+    ngx_str_t                  key;
+    unsigned                   sent:1;
+} ngx_http_memcached_batch_key_t;
+
+
+/* the keys of a multi connection, sent and answered by one "get" */
+
+typedef struct {
+    ngx_connection_t                 *connection;
+
+    ngx_multi_request_t              *pending;
+    ngx_event_t                       flush;
+
+    ngx_multi_request_t              *current;
+    ngx_uint_t                        index;
+    ngx_http_memcached_batch_key_t   *value;
+    ngx_buf_t                         line;
+    ngx_str_t                         key;
+    size_t                            rest;
+    ngx_http_memcached_batch_state_e  state;
+} ngx_http_memcached_batch_t;
+
+#endif
+
+
 static ngx_int_t ngx_http_memcached_create_request(ngx_http_request_t *r);
 static ngx_int_t ngx_http_memcached_reinit_request(ngx_http_request_t *r);
 static ngx_int_t ngx_http_memcached_process_header(ngx_http_request_t *r);
@@ -33,12 +79,41 @@ static void ngx_http_memcached_abort_request(ngx_http_request_t *r);
 static void ngx_http_memcached_finalize_request(ngx_http_request_t *r,
     ngx_int_t rc);
 
+#if (T_NGX_MULTI_UPSTREAM)
+static ngx_int_t ngx_http_memcached_batch_output_filter(void *data,
+    ngx_chain_t *in);
+static ngx_http_memcached_batch_t *ngx_http_memcached_batch_get(
+    ngx_connection_t *pc);
+static void ngx_http_memcached_batch_flush_handler(ngx_event_t *ev);
+static ngx_int_t ngx_http_memcached_batch_flush(
+    ngx_http_memcached_batch_t *mb);
+static void ngx_http_memcached_batch_cleanup(void *data);
+static ngx_int_t ngx_http_memcached_batch_process_header(
+    ngx_http_request_t *r);
+static ngx_int_t ngx_http_memcached_batch_read_line(ngx_http_request_t *r,
+    ngx_http_memcached_batch_t *mb);
+static ngx_http_memcached_batch_key_t *ngx_http_memcached_batch_next(
+    ngx_http_memcached_batch_t *mb);
+static void ngx_http_memcached_batch_unlink(
+    ngx_http_memcached_batch_key_t *k);
+static void ngx_http_memcached_batch_done(ngx_connection_t *pc,
+    ngx_http_memcached_batch_t *mb);
+static ngx_int_t ngx_http_memcached_batch_header(ngx_http_request_t *r,
+    u_char *data, size_t len);
+static ngx_int_t ngx_http_memcached_batch_input(ngx_http_request_t *r,
+    u_char *data, size_t len);
+#endif
+
 static void *ngx_http_memcached_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_memcached_merge_loc_conf(ngx_conf_t *cf,
     void *parent, void *child);
 
 static char *ngx_http_memcached_pass(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+#if (T_NGX_MULTI_UPSTREAM)
+static char *ngx_http_memcached_batch(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+#endif
 
 
 static ngx_conf_bitmask_t  ngx_http_memcached_next_upstream_masks[] = {
@@ -130,6 +205,15 @@ static ngx_command_t  ngx_http_memcached_commands[] = {
       offsetof(ngx_http_memcached_loc_conf_t, gzip_flag),
       NULL },
 
+#if (T_NGX_MULTI_UPSTREAM)
+    { ngx_string("memcached_batch"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE12,
+      ngx_http_memcached_batch,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+#endif
+
 #if (T_UPSTREAM_TRIES)
     { ngx_string("memcached_upstream_tries"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
@@ -222,6 +306,12 @@ ngx_http_memcached_handler(ngx_http_request_t *r)
     u->abort_request = ngx_http_memcached_abort_request;
     u->finalize_request = ngx_http_memcached_finalize_request;
 
+#if (T_NGX_MULTI_UPSTREAM)
+    if (mlcf->batch) {
+        u->multi_mode = NGX_MULTI_UPS_SUPPORT_MULTI;
+    }
+#endif
+
     ctx = ngx_palloc(r->pool, sizeof(ngx_http_memcached_ctx_t));
     if (ctx == NULL) {
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
@@ -304,6 +394,14 @@ ngx_http_memcached_create_request(ngx_http_request_t *r)
 
     *b->last++ = CR; *b->last++ = LF;
 
+#if (T_NGX_MULTI_UPSTREAM)
+    if (r->upstream->multi_mode & NGX_MULTI_UPS_SUPPORT_MULTI) {
+        r->upstream->output.output_filter =
+                                        ngx_http_memcached_batch_output_filter;
+        r->upstream->output.filter_ctx = r;
+    }
+#endif
+
     return NGX_OK;
 }
 
@@ -592,6 +690,821 @@ ngx_http_memcached_finalize_request(ngx_http_request_t *r, ngx_int_t rc)
 }
 
 
+#if (T_NGX_MULTI_UPSTREAM)
+
+static ngx_int_t
+ngx_http_memcached_batch_output_filter(void *data, ngx_chain_t *in)
+{
+    ngx_http_request_t *r = data;
+
+    ngx_chain_t                     *cl;
+    ngx_array_t                     *keys;
+    ngx_connection_t                *pc;
+    ngx_http_request_t              *fake_r;
+    ngx_http_upstream_t             *u;
+    ngx_multi_request_t             *multi_r;
+    ngx_http_memcached_ctx_t        *ctx;
+    ngx_http_memcached_batch_t      *mb;
+    ngx_http_memcached_batch_key_t  *k;
+    ngx_http_memcached_loc_conf_t   *mlcf;
+
+    u = r->upstream;
+
+    if (!u->multi) {
+        return ngx_chain_writer(&u->writer, in);
+    }
+
+    pc = u->peer.connection;
+    fake_r = pc->data;
+
+    if (r == fake_r || in == NULL) {
+        return ngx_chain_writer(&fake_r->upstream->writer, NULL);
+    }
+
+    mb = ngx_http_memcached_batch_get(pc);
+    if (mb == NULL) {
+        return NGX_ERROR;
+    }
+
+    mlcf = ngx_http_get_module_loc_conf(r, ngx_http_memcached_module);
+    ctx = ngx_http_get_module_ctx(r, ngx_http_memcached_module);
+
+    if (mb->pending == NULL) {
+        multi_r = ngx_create_multi_request(pc, NULL);
+        if (multi_r == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_queue_init(&multi_r->front_queue);
+
+        keys = ngx_array_create(multi_r->pool, mlcf->batch,
+                                sizeof(ngx_http_memcached_batch_key_t));
+        if (keys == NULL) {
+            ngx_destroy_pool(multi_r->pool);
+            return NGX_ERROR;
+        }
+
+        multi_r->ctx = keys;
+        mb->pending = multi_r;
+
+        if (mlcf->batch_window) {
+            ngx_add_timer(&mb->flush, mlcf->batch_window);
+
+        } else {
+            ngx_post_event(&mb->flush, &ngx_posted_events);
+        }
+    }
+
+    multi_r = mb->pending;
+    keys = multi_r->ctx;
+
+    if (r->backend_r == NULL) {
+        r->backend_r = ngx_pcalloc(r->connection->pool, sizeof(ngx_queue_t));
+        if (r->backend_r == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_queue_init(r->backend_r);
+    }
+
+    k = ngx_array_push(keys);
+    if (k == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(k, sizeof(ngx_http_memcached_batch_key_t));
+
+    k->key.data = ngx_pstrdup(multi_r->pool, &ctx->key);
+    if (k->key.data == NULL) {
+        keys->nelts--;
+        return NGX_ERROR;
+    }
+
+    k->key.len = ctx->key.len;
+
+    k->multi_r.data = r;
+    k->multi_r.pool = multi_r->pool;
+    k->multi_r.keep = 1;
+
+    ngx_queue_init(&k->multi_r.backend_queue);
+    ngx_queue_insert_tail(r->backend_r, &k->multi_r.front_queue);
+
+    for (cl = in; cl; cl = cl->next) {
+        cl->buf->pos = cl->buf->last;
+    }
+
+    fake_r->upstream->process_header = ngx_http_memcached_batch_process_header;
+
+    if (keys->nelts == keys->nalloc) {
+        return ngx_http_memcached_batch_flush(mb);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_http_memcached_batch_t *
+ngx_http_memcached_batch_get(ngx_connection_t *pc)
+{
+    ngx_pool_cleanup_t          *cln;
+    ngx_http_request_t          *fake_r;
+    ngx_http_memcached_batch_t  *mb;
+
+    fake_r = pc->data;
+
+    mb = ngx_http_get_module_ctx(fake_r, ngx_http_memcached_module);
+
+    if (mb) {
+        return mb;
+    }
+
+    mb = ngx_pcalloc(pc->pool, sizeof(ngx_http_memcached_batch_t));
+    if (mb == NULL) {
+        return NULL;
+    }
+
+    mb->line.start = ngx_palloc(pc->pool, fake_r->upstream->conf->buffer_size);
+    if (mb->line.start == NULL) {
+        return NULL;
+    }
+
+    mb->line.pos = mb->line.start;
+    mb->line.last = mb->line.start;
+    mb->line.end = mb->line.start + fake_r->upstream->conf->buffer_size;
+
+    mb->connection = pc;
+
+    mb->flush.handler = ngx_http_memcached_batch_flush_handler;
+    mb->flush.data = mb;
+    mb->flush.log = pc->log;
+
+    cln = ngx_pool_cleanup_add(pc->pool, 0);
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    cln->handler = ngx_http_memcached_batch_cleanup;
+    cln->data = mb;
+
+    ngx_http_set_ctx(fake_r, mb, ngx_http_memcached_module);
+
+    return mb;
+}
+
+
+static void
+ngx_http_memcached_batch_flush_handler(ngx_event_t *ev)
+{
+    ngx_http_memcached_batch_t *mb = ev->data;
+
+    if (ngx_http_memcached_batch_flush(mb) == NGX_ERROR) {
+        ngx_log_error(NGX_LOG_ERR, ev->log, 0,
+                      "memcached batch sending failed");
+
+        /* the requests sent are retried when the connection times out */
+
+        ngx_http_multi_upstream_connection_detach(mb->connection);
+    }
+}
+
+
+static ngx_int_t
+ngx_http_memcached_batch_flush(ngx_http_memcached_batch_t *mb)
+{
+    size_t                           len;
+    ngx_int_t                        rc;
+    ngx_buf_t                       *b;
+    ngx_uint_t                       i;
+    ngx_chain_t                     *cl;
+    ngx_array_t                     *keys;
+    ngx_connection_t                *pc;
+    ngx_http_request_t              *fake_r;
+    ngx_multi_request_t             *multi_r;
+    ngx_multi_connection_t          *multi_c;
+    ngx_http_memcached_batch_key_t  *k;
+
+    multi_r = mb->pending;
+
+    if (multi_r == NULL) {
+        return NGX_OK;
+    }
+
+    mb->pending = NULL;
+
+    if (mb->flush.timer_set) {
+        ngx_del_timer(&mb->flush);
+    }
+
+    if (mb->flush.posted) {
+        ngx_delete_posted_event(&mb->flush);
+    }
+
+    pc = mb->connection;
+    fake_r = pc->data;
+    multi_c = ngx_get_multi_connection(pc);
+
+    keys = multi_r->ctx;
+    k = keys->elts;
+
+    /* the keys of the requests finalized while waiting are not sent */
+
+    len = 0;
+
+    for (i = 0; i < keys->nelts; i++) {
+        if (k[i].multi_r.data) {
+            len += sizeof(" ") - 1 + k[i].key.len;
+            k[i].sent = 1;
+        }
+    }
+
+    if (len == 0) {
+        ngx_destroy_pool(multi_r->pool);
+        return NGX_OK;
+    }
+
+    len += sizeof("get") - 1 + sizeof(CRLF) - 1;
+
+    b = ngx_create_temp_buf(multi_r->pool, len);
+    if (b == NULL) {
+        goto failed;
+    }
+
+    cl = ngx_alloc_chain_link(multi_r->pool);
+    if (cl == NULL) {
+        goto failed;
+    }
+
+    cl->buf = b;
+    cl->next = NULL;
+
+    b->last = ngx_cpymem(b->last, "get", sizeof("get") - 1);
+
+    for (i = 0; i < keys->nelts; i++) {
+        if (k[i].sent) {
+            *b->last++ = ' ';
+            b->last = ngx_cpymem(b->last, k[i].key.data, k[i].key.len);
+        }
+    }
+
+    *b->last++ = CR; *b->last++ = LF;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "memcached batch of %ui keys: \"%*s\"",
+                   keys->nelts, (size_t) (b->last - b->pos - 2), b->pos);
+
+    multi_r->out = cl;
+
+    ngx_queue_insert_tail(&multi_c->send_list, &multi_r->backend_queue);
+
+    rc = ngx_chain_writer(&fake_r->upstream->writer, cl);
+
+    if (rc == NGX_AGAIN) {
+        if (ngx_handle_write_event(pc->write, 0) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return rc;
+
+failed:
+
+    for (i = 0; i < keys->nelts; i++) {
+        ngx_http_memcached_batch_unlink(&k[i]);
+    }
+
+    ngx_destroy_pool(multi_r->pool);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_http_memcached_batch_cleanup(void *data)
+{
+    ngx_http_memcached_batch_t *mb = data;
+
+    ngx_uint_t                       i;
+    ngx_array_t                     *keys;
+    ngx_http_memcached_batch_key_t  *k;
+
+    if (mb->flush.timer_set) {
+        ngx_del_timer(&mb->flush);
+    }
+
+    if (mb->flush.posted) {
+        ngx_delete_posted_event(&mb->flush);
+    }
+
+    if (mb->pending) {
+        keys = mb->pending->ctx;
+        k = keys->elts;
+
+        for (i = 0; i < keys->nelts; i++) {
+            ngx_http_memcached_batch_unlink(&k[i]);
+        }
+
+        ngx_destroy_pool(mb->pending->pool);
+        mb->pending = NULL;
+    }
+}
+
+
+static ngx_int_t
+ngx_http_memcached_batch_process_header(ngx_http_request_t *r)
+{
+    size_t                           n;
+    ngx_int_t                        rc;
+    ngx_buf_t                       *b;
+    ngx_connection_t                *pc;
+    ngx_http_request_t              *real_r;
+    ngx_multi_connection_t          *multi_c;
+    ngx_http_memcached_batch_t      *mb;
+    ngx_http_memcached_batch_key_t  *k;
+
+    b = &r->upstream->buffer;
+    pc = r->connection;
+    multi_c = ngx_get_multi_connection(pc);
+
+    mb = ngx_http_get_module_ctx(r, ngx_http_memcached_module);
+
+    multi_c->cur = NULL;
+
+    for ( ;; ) {
+
+        if (mb->current == NULL) {
+
+            if (b->pos == b->last) {
+                return NGX_AGAIN;
+            }
+
+            if (ngx_queue_empty(&multi_c->send_list)) {
+                ngx_log_error(NGX_LOG_ERR, pc->log, 0,
+                              "memcached sent response to no request");
+                return NGX_HTTP_UPSTREAM_INVALID_HEADER;
+            }
+
+            mb->current = ngx_queue_data(ngx_queue_head(&multi_c->send_list),
+                                         ngx_multi_request_t, backend_queue);
+            mb->index = 0;
+            mb->state = ngx_http_memcached_batch_st_line;
+            mb->line.last = mb->line.start;
+        }
+
+        switch (mb->state) {
+
+        case ngx_http_memcached_batch_st_line:
+
+            rc = ngx_http_memcached_batch_read_line(r, mb);
+
+            if (rc != NGX_OK) {
+                return rc;
+            }
+
+            continue;
+
+        case ngx_http_memcached_batch_st_value:
+
+            k = ngx_http_memcached_batch_next(mb);
+
+            if (k == NULL) {
+                ngx_log_error(NGX_LOG_ERR, pc->log, 0,
+                              "memcached sent value of unknown key \"%V\"",
+                              &mb->key);
+                return NGX_HTTP_UPSTREAM_INVALID_HEADER;
+            }
+
+            real_r = k->multi_r.data;
+
+            if (k->key.len != mb->key.len
+                || ngx_strncmp(k->key.data, mb->key.data, mb->key.len) != 0)
+            {
+                /* the values come in the order of the keys */
+
+                ngx_http_memcached_batch_unlink(k);
+
+                if (real_r == NULL) {
+                    continue;
+                }
+
+                multi_c->cur = real_r;
+
+                return ngx_http_memcached_batch_header(real_r,
+                                                       (u_char *) "END" CRLF,
+                                                       sizeof("END" CRLF) - 1);
+            }
+
+            mb->value = k;
+            mb->state = ngx_http_memcached_batch_st_data;
+
+            if (real_r == NULL) {
+                continue;
+            }
+
+            multi_c->cur = real_r;
+
+            return ngx_http_memcached_batch_header(real_r, mb->line.start,
+                                             mb->line.last - mb->line.start);
+
+        case ngx_http_memcached_batch_st_data:
+
+            if (b->pos == b->last) {
+                return NGX_AGAIN;
+            }
+
+            k = mb->value;
+            real_r = k->multi_r.data;
+
+            n = ngx_min((size_t) (b->last - b->pos), mb->rest);
+            rc = NGX_OK;
+
+            if (real_r) {
+                rc = ngx_http_memcached_batch_input(real_r, b->pos, n);
+            }
+
+            b->pos += n;
+            mb->rest -= n;
+
+            if (mb->rest == 0) {
+
+                /* the trailer ends the value as if it was fetched alone */
+
+                if (real_r && rc == NGX_OK) {
+                    rc = ngx_http_memcached_batch_input(real_r,
+                                                        (u_char *) "END" CRLF,
+                                                        sizeof("END" CRLF) - 1);
+                }
+
+                ngx_http_memcached_batch_unlink(k);
+
+                mb->state = ngx_http_memcached_batch_st_line;
+                mb->line.last = mb->line.start;
+            }
+
+            if (real_r == NULL) {
+                continue;
+            }
+
+            multi_c->cur = real_r;
+
+            if (rc != NGX_OK) {
+                return NGX_HTTP_UPSTREAM_PARSE_ERROR;
+            }
+
+            return NGX_HTTP_UPSTREAM_GET_BODY_DATA;
+
+        default: /* ngx_http_memcached_batch_st_end, st_error */
+
+            k = ngx_http_memcached_batch_next(mb);
+
+            if (k == NULL) {
+                ngx_http_memcached_batch_done(pc, mb);
+                continue;
+            }
+
+            real_r = k->multi_r.data;
+
+            ngx_http_memcached_batch_unlink(k);
+
+            if (real_r == NULL) {
+                continue;
+            }
+
+            multi_c->cur = real_r;
+
+            if (mb->state == ngx_http_memcached_batch_st_error) {
+                return NGX_HTTP_UPSTREAM_PARSE_ERROR;
+            }
+
+            return ngx_http_memcached_batch_header(real_r,
+                                                   (u_char *) "END" CRLF,
+                                                   sizeof("END" CRLF) - 1);
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_http_memcached_batch_read_line(ngx_http_request_t *r,
+    ngx_http_memcached_batch_t *mb)
+{
+    u_char     *p, *last, *start;
+    size_t      n;
+    ngx_buf_t  *b;
+    ngx_str_t   line;
+
+    b = &r->upstream->buffer;
+
+    if (b->pos == b->last) {
+        return NGX_AGAIN;
+    }
+
+    p = ngx_strlchr(b->pos, b->last, LF);
+
+    n = (p ? p + 1 : b->last) - b->pos;
+
+    if (n > (size_t) (mb->line.end - mb->line.last)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "memcached sent too long line");
+        return NGX_HTTP_UPSTREAM_INVALID_HEADER;
+    }
+
+    mb->line.last = ngx_cpymem(mb->line.last, b->pos, n);
+    b->pos += n;
+
+    if (p == NULL) {
+        return NGX_AGAIN;
+    }
+
+    line.data = mb->line.start;
+    line.len = mb->line.last - mb->line.start - 1;
+
+    if (line.len == 0 || line.data[line.len - 1] != CR) {
+        goto invalid;
+    }
+
+    line.len--;
+    last = line.data + line.len;
+
+    if (ngx_strncmp(line.data, "VALUE ", sizeof("VALUE ") - 1) == 0) {
+
+        /* VALUE <key> <flags> <bytes> [<cas unique>] */
+
+        mb->key.data = line.data + sizeof("VALUE ") - 1;
+
+        p = ngx_strlchr(mb->key.data, last, ' ');
+        if (p == NULL) {
+            goto invalid;
+        }
+
+        mb->key.len = p - mb->key.data;
+
+        p = ngx_strlchr(p + 1, last, ' ');
+        if (p == NULL) {
+            goto invalid;
+        }
+
+        start = p + 1;
+
+        p = ngx_strlchr(start, last, ' ');
+        if (p == NULL) {
+            p = last;
+        }
+
+        mb->rest = ngx_atosz(start, p - start);
+        if (mb->rest == (size_t) NGX_ERROR) {
+            goto invalid;
+        }
+
+        mb->rest += sizeof(CRLF) - 1;
+        mb->state = ngx_http_memcached_batch_st_value;
+
+        return NGX_OK;
+    }
+
+    if (line.len == sizeof("END") - 1
+        && ngx_strncmp(line.data, "END", sizeof("END") - 1) == 0)
+    {
+        mb->state = ngx_http_memcached_batch_st_end;
+        return NGX_OK;
+    }
+
+    if (ngx_strncmp(line.data, "ERROR", sizeof("ERROR") - 1) == 0
+        || ngx_strncmp(line.data, "CLIENT_ERROR", sizeof("CLIENT_ERROR") - 1)
+           == 0
+        || ngx_strncmp(line.data, "SERVER_ERROR", sizeof("SERVER_ERROR") - 1)
+           == 0)
+    {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "memcached sent error response: \"%V\"", &line);
+
+        mb->state = ngx_http_memcached_batch_st_error;
+        return NGX_OK;
+    }
+
+invalid:
+
+    ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                  "memcached sent invalid response: \"%*s\"",
+                  mb->line.last - mb->line.start, mb->line.start);
+
+    return NGX_HTTP_UPSTREAM_INVALID_HEADER;
+}
+
+
+static ngx_http_memcached_batch_key_t *
+ngx_http_memcached_batch_next(ngx_http_memcached_batch_t *mb)
+{
+    ngx_array_t                     *keys;
+    ngx_http_memcached_batch_key_t  *k;
+
+    keys = mb->current->ctx;
+    k = keys->elts;
+
+    while (mb->index < keys->nelts) {
+        if (k[mb->index++].sent) {
+            return &k[mb->index - 1];
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_http_memcached_batch_unlink(ngx_http_memcached_batch_key_t *k)
+{
+    ngx_queue_remove(&k->multi_r.front_queue);
+    ngx_queue_init(&k->multi_r.front_queue);
+
+    k->multi_r.data = NULL;
+}
+
+
+static void
+ngx_http_memcached_batch_done(ngx_connection_t *pc,
+    ngx_http_memcached_batch_t *mb)
+{
+    ngx_uint_t                       i;
+    ngx_array_t                     *keys;
+    ngx_multi_request_t             *multi_r;
+    ngx_multi_connection_t          *multi_c;
+    ngx_http_memcached_batch_key_t  *k;
+
+    multi_r = mb->current;
+    mb->current = NULL;
+
+    keys = multi_r->ctx;
+    k = keys->elts;
+
+    for (i = 0; i < keys->nelts; i++) {
+        ngx_http_memcached_batch_unlink(&k[i]);
+    }
+
+    ngx_queue_remove(&multi_r->backend_queue);
+
+    if (ngx_buf_size(multi_r->out->buf)) {
+        /* the response came before the request was sent in full */
+        multi_c = ngx_get_multi_connection(pc);
+        ngx_queue_insert_tail(&multi_c->leak_list, &multi_r->backend_queue);
+        return;
+    }
+
+    ngx_destroy_pool(multi_r->pool);
+}
+
+
+static ngx_int_t
+ngx_http_memcached_batch_header(ngx_http_request_t *r, u_char *data,
+    size_t len)
+{
+    ngx_buf_t            *b;
+    ngx_http_upstream_t  *u;
+
+    u = r->upstream;
+    b = &u->buffer;
+
+    if (len > (size_t) (b->end - b->start)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "memcached sent too long line");
+        return NGX_HTTP_UPSTREAM_PARSE_ERROR;
+    }
+
+    b->pos = b->start;
+    b->last = ngx_cpymem(b->start, data, len);
+
+    u->state->bytes_received += len;
+
+    if (u->process_header(r) != NGX_OK) {
+        return NGX_HTTP_UPSTREAM_PARSE_ERROR;
+    }
+
+    return NGX_HTTP_UPSTREAM_HEADER_END;
+}
+
+
+static ngx_int_t
+ngx_http_memcached_batch_input(ngx_http_request_t *r, u_char *data,
+    size_t len)
+{
+    size_t                n;
+    ngx_buf_t            *b;
+    ngx_http_upstream_t  *u;
+
+    u = r->upstream;
+    b = &u->buffer;
+
+    while (len) {
+
+        if (b->last == b->end) {
+
+            if (u->out_bufs == NULL && u->busy_bufs == NULL) {
+                b->pos = b->start;
+                b->last = b->start;
+
+            } else {
+
+                /*
+                 * the client is slower than the connection, the value
+                 * is kept aside not to delay the values that follow
+                 */
+
+                b->start = ngx_palloc(r->pool, u->conf->buffer_size);
+                if (b->start == NULL) {
+                    return NGX_ERROR;
+                }
+
+                b->pos = b->start;
+                b->last = b->start;
+                b->end = b->start + u->conf->buffer_size;
+            }
+        }
+
+        n = ngx_min(len, (size_t) (b->end - b->last));
+
+        ngx_memcpy(b->last, data, n);
+
+        u->state->bytes_received += n;
+        u->state->response_length += n;
+
+        if (u->input_filter(u->input_filter_ctx, n) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        data += n;
+        len -= n;
+    }
+
+    return NGX_OK;
+}
+
+
+static char *
+ngx_http_memcached_batch(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_memcached_loc_conf_t *mlcf = conf;
+
+    ngx_int_t    n;
+    ngx_str_t   *value, s;
+    ngx_uint_t   i;
+
+    if (mlcf->batch != NGX_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+    i = 1;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts > 2) {
+            goto invalid;
+        }
+
+        mlcf->batch = 0;
+        mlcf->batch_window = 0;
+
+        return NGX_CONF_OK;
+    }
+
+    n = ngx_atoi(value[1].data, value[1].len);
+    if (n == NGX_ERROR || n == 0) {
+        goto invalid;
+    }
+
+    mlcf->batch = n;
+    mlcf->batch_window = 0;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "window=", 7) == 0) {
+
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            mlcf->batch_window = ngx_parse_time(&s, 0);
+            if (mlcf->batch_window == (ngx_msec_t) NGX_ERROR) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+#endif
+
+
 static void *
 ngx_http_memcached_create_loc_conf(ngx_conf_t *cf)
 {
@@ -640,6 +1553,11 @@ ngx_http_memcached_create_loc_conf(ngx_conf_t *cf)
     conf->index = NGX_CONF_UNSET;
     conf->gzip_flag = NGX_CONF_UNSET_UINT;
 
+#if (T_NGX_MULTI_UPSTREAM)
+    conf->batch = NGX_CONF_UNSET_UINT;
+    conf->batch_window = NGX_CONF_UNSET_MSEC;
+#endif
+
     return conf;
 }
 
@@ -697,6 +1615,11 @@ ngx_http_memcached_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_uint_value(conf->gzip_flag, prev->gzip_flag, 0);
 
+#if (T_NGX_MULTI_UPSTREAM)
+    ngx_conf_merge_uint_value(conf->batch, prev->batch, 0);
+    ngx_conf_merge_msec_value(conf->batch_window, prev->batch_window, 0);
+#endif
+
     return NGX_CONF_OK;
 }
 
@@ -9,6 +9,10 @@
 #include <ngx_core.h>
 #include <ngx_http.h>
 
+#if (T_NGX_MULTI_UPSTREAM)
+#include <ngx_http_multi_upstream_module.h>
+#endif
+
 
 typedef struct {
     ngx_array_t                    caches;  /* ngx_http_file_cache_t * */
@@ -87,6 +91,10 @@ typedef struct {
 
     ngx_uint_t                     http_version;
 
+#if (T_NGX_MULTI_UPSTREAM)
+    ngx_flag_t                     pipelining;
+#endif
+
     ngx_uint_t                     headers_hash_max_size;
     ngx_uint_t                     headers_hash_bucket_size;
 
@@ -119,6 +127,26 @@ typedef struct {
 } ngx_http_proxy_ctx_t;
 
 
+#if (T_NGX_MULTI_UPSTREAM)
+
+/* the state of a connection shared by pipelined requests */
+
+typedef struct {
+    ngx_multi_request_t           *request;
+    ngx_buf_t                      header;
+    ngx_http_status_t              status;
+    ngx_http_chunked_t             chunked;
+    off_t                          length;
+
+    unsigned                       body:1;
+    unsigned                       chunked_body:1;
+    unsigned                       close:1;
+    unsigned                       detached:1;
+} ngx_http_proxy_pipelining_t;
+
+#endif
+
+
 static ngx_int_t ngx_http_proxy_eval(ngx_http_request_t *r,
     ngx_http_proxy_ctx_t *ctx, ngx_http_proxy_loc_conf_t *plcf);
 #if (NGX_HTTP_CACHE)
@@ -142,6 +170,23 @@ static void ngx_http_proxy_abort_request(ngx_http_request_t *r);
 static void ngx_http_proxy_finalize_request(ngx_http_request_t *r,
     ngx_int_t rc);
 
+#if (T_NGX_MULTI_UPSTREAM)
+static ngx_int_t ngx_http_proxy_pipelining_test(ngx_http_request_t *r,
+    ngx_http_proxy_loc_conf_t *plcf);
+static ngx_int_t ngx_http_proxy_pipelining_output_filter(void *data,
+    ngx_chain_t *in);
+static ngx_int_t ngx_http_proxy_pipelining_process_header(
+    ngx_http_request_t *r);
+static void ngx_http_proxy_pipelining_reset(ngx_http_request_t *r,
+    ngx_http_proxy_pipelining_t *pp);
+static ngx_int_t ngx_http_proxy_pipelining_parse_header(ngx_http_request_t *r,
+    ngx_http_proxy_pipelining_t *pp);
+static ngx_int_t ngx_http_proxy_pipelining_pass_header(ngx_http_request_t *r,
+    ngx_http_proxy_pipelining_t *pp);
+static void ngx_http_proxy_pipelining_done(ngx_connection_t *pc,
+    ngx_http_proxy_pipelining_t *pp);
+#endif
+
 static ngx_int_t ngx_http_proxy_host_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_proxy_port_variable(ngx_http_request_t *r,
@@ -194,6 +239,8 @@ static char *ngx_http_proxy_ssl_password_file(ngx_conf_t *cf,
 #endif
 
 static char *ngx_http_proxy_lowat_check(ngx_conf_t *cf, void *post, void *data);
+static char *ngx_http_proxy_splice_check(ngx_conf_t *cf, void *post,
+    void *data);
 
 static ngx_int_t ngx_http_proxy_rewrite_regex(ngx_conf_t *cf,
     ngx_http_proxy_rewrite_t *pr, ngx_str_t *regex, ngx_uint_t caseless);
@@ -208,6 +255,9 @@ static void ngx_http_proxy_set_vars(ngx_url_t *u, ngx_http_proxy_vars_t *v);
 static ngx_conf_post_t  ngx_http_proxy_lowat_post =
     { ngx_http_proxy_lowat_check };
 
+static ngx_conf_post_t  ngx_http_proxy_splice_post =
+    { ngx_http_proxy_splice_check };
+
 
 static ngx_conf_bitmask_t  ngx_http_proxy_next_upstream_masks[] = {
     { ngx_string("error"), NGX_HTTP_UPSTREAM_FT_ERROR },
@@ -303,6 +353,13 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.buffering),
       NULL },
 
+    { ngx_string("proxy_splice"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.splice),
+      &ngx_http_proxy_splice_post },
+
     { ngx_string("proxy_request_buffering"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
       ngx_conf_set_flag_slot,
@@ -529,6 +586,13 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_lock),
       NULL },
 
+    { ngx_string("proxy_cache_lock_stream"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_lock_stream),
+      NULL },
+
     { ngx_string("proxy_cache_lock_timeout"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_msec_slot,
@@ -645,6 +709,17 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, http_version),
       &ngx_http_proxy_http_version },
 
+#if (T_NGX_MULTI_UPSTREAM)
+
+    { ngx_string("proxy_pipelining"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, pipelining),
+      NULL },
+
+#endif
+
 #if (NGX_HTTP_SSL)
 
     { ngx_string("proxy_ssl_session_reuse"),
@@ -921,6 +996,13 @@ ngx_http_proxy_handler(ngx_http_request_t *r)
 
     u->buffering = plcf->upstream.buffering;
 
+#if (T_NGX_MULTI_UPSTREAM)
+    if (plcf->pipelining && ngx_http_proxy_pipelining_test(r, plcf) == NGX_OK)
+    {
+        u->multi_mode = NGX_MULTI_UPS_SUPPORT_MULTI;
+    }
+#endif
+
     u->pipe = ngx_pcalloc(r->pool, sizeof(ngx_event_pipe_t));
     if (u->pipe == NULL) {
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
@@ -1524,6 +1606,13 @@ ngx_http_proxy_create_request(ngx_http_request_t *r)
     b->flush = 1;
     cl->next = NULL;
 
+#if (T_NGX_MULTI_UPSTREAM)
+    if (u->multi_mode & NGX_MULTI_UPS_SUPPORT_MULTI) {
+        u->output.output_filter = ngx_http_proxy_pipelining_output_filter;
+        u->output.filter_ctx = r;
+    }
+#endif
+
     return NGX_OK;
 }
 
@@ -2361,6 +2450,584 @@ ngx_http_proxy_finalize_request(ngx_http_request_t *r, ngx_int_t rc)
 }
 
 
+#if (T_NGX_MULTI_UPSTREAM)
+
+static ngx_int_t
+ngx_http_proxy_pipelining_test(ngx_http_request_t *r,
+    ngx_http_proxy_loc_conf_t *plcf)
+{
+    /*
+     * only requests without a body, which may be repeated, share
+     * a connection with others: the responses come in order and
+     * a request cannot be taken back once it is queued
+     */
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD|NGX_HTTP_PUT
+                       |NGX_HTTP_DELETE|NGX_HTTP_OPTIONS|NGX_HTTP_TRACE)))
+    {
+        return NGX_DECLINED;
+    }
+
+    if (plcf->http_version != NGX_HTTP_VERSION_11
+        || plcf->method
+        || plcf->body_values
+        || r->headers_in.content_length_n > 0
+        || r->headers_in.chunked
+        || r->headers_in.upgrade)
+    {
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_proxy_pipelining_output_filter(void *data, ngx_chain_t *in)
+{
+    ngx_http_request_t *r = data;
+
+    size_t                   size;
+    ngx_buf_t               *b;
+    ngx_chain_t             *cl, *out;
+    ngx_connection_t        *pc;
+    ngx_http_request_t      *fake_r;
+    ngx_http_upstream_t     *u;
+    ngx_multi_request_t     *multi_r;
+    ngx_multi_connection_t  *multi_c;
+
+    u = r->upstream;
+
+    if (!u->multi) {
+        return ngx_chain_writer(&u->writer, in);
+    }
+
+    pc = u->peer.connection;
+    fake_r = pc->data;
+    out = NULL;
+
+    if (r != fake_r && in) {
+
+        /* the request is queued on the connection once it is created */
+
+        size = 0;
+
+        for (cl = in; cl; cl = cl->next) {
+            size += (size_t) ngx_buf_size(cl->buf);
+        }
+
+        multi_r = ngx_create_multi_request(pc, r);
+        if (multi_r == NULL) {
+            return NGX_ERROR;
+        }
+
+        b = ngx_create_temp_buf(multi_r->pool, size);
+        if (b == NULL) {
+            ngx_destroy_pool(multi_r->pool);
+            return NGX_ERROR;
+        }
+
+        for (cl = in; cl; cl = cl->next) {
+            b->last = ngx_cpymem(b->last, cl->buf->pos,
+                                 cl->buf->last - cl->buf->pos);
+            cl->buf->pos = cl->buf->last;
+        }
+
+        b->flush = 1;
+
+        out = ngx_alloc_chain_link(multi_r->pool);
+        if (out == NULL) {
+            ngx_destroy_pool(multi_r->pool);
+            return NGX_ERROR;
+        }
+
+        out->buf = b;
+        out->next = NULL;
+
+        multi_r->out = out;
+        multi_r->keep = 1;
+
+        if (r->backend_r == NULL) {
+            r->backend_r = ngx_pcalloc(r->connection->pool,
+                                       sizeof(ngx_queue_t));
+            if (r->backend_r == NULL) {
+                ngx_destroy_pool(multi_r->pool);
+                return NGX_ERROR;
+            }
+
+            ngx_queue_init(r->backend_r);
+        }
+
+        multi_c = ngx_get_multi_connection(pc);
+
+        ngx_queue_insert_tail(&multi_c->send_list, &multi_r->backend_queue);
+        ngx_queue_insert_tail(r->backend_r, &multi_r->front_queue);
+
+        u->buffering = 0;
+
+        fake_r->upstream->process_header =
+                                     ngx_http_proxy_pipelining_process_header;
+    }
+
+    return ngx_chain_writer(&fake_r->upstream->writer, out);
+}
+
+
+static ngx_int_t
+ngx_http_proxy_pipelining_process_header(ngx_http_request_t *r)
+{
+    off_t                         n, size;
+    ngx_int_t                     rc;
+    ngx_buf_t                    *b, *rb, buf;
+    ngx_connection_t             *pc;
+    ngx_http_request_t           *real_r;
+    ngx_http_upstream_t          *u, *ru;
+    ngx_multi_connection_t       *multi_c;
+    ngx_http_proxy_pipelining_t  *pp;
+
+    u = r->upstream;
+    b = &u->buffer;
+    pc = u->peer.connection;
+    multi_c = ngx_get_multi_connection(pc);
+
+    pp = ngx_http_get_module_ctx(r, ngx_http_proxy_module);
+
+    if (pp == NULL) {
+        pp = ngx_pcalloc(r->pool, sizeof(ngx_http_proxy_pipelining_t));
+        if (pp == NULL) {
+            return NGX_ERROR;
+        }
+
+        pp->header.start = ngx_palloc(r->pool, u->conf->buffer_size);
+        if (pp->header.start == NULL) {
+            return NGX_ERROR;
+        }
+
+        pp->header.end = pp->header.start + u->conf->buffer_size;
+
+        ngx_http_set_ctx(r, pp, ngx_http_proxy_module);
+    }
+
+    multi_c->cur = NULL;
+
+    for ( ;; ) {
+
+        if (b->pos == b->last) {
+            return NGX_AGAIN;
+        }
+
+        if (pp->request == NULL) {
+
+            if (ngx_queue_empty(&multi_c->send_list)) {
+                ngx_log_error(NGX_LOG_ERR, pc->log, 0,
+                              "upstream sent response to no request");
+                return NGX_HTTP_UPSTREAM_INVALID_HEADER;
+            }
+
+            pp->request = ngx_queue_data(ngx_queue_head(&multi_c->send_list),
+                                         ngx_multi_request_t, backend_queue);
+
+            ngx_http_proxy_pipelining_reset(r, pp);
+        }
+
+        real_r = pp->request->data;
+
+        if (!pp->body) {
+            rc = ngx_http_proxy_pipelining_parse_header(r, pp);
+
+            if (rc == NGX_AGAIN) {
+                continue;
+            }
+
+            if (rc == NGX_DECLINED) {
+                /* an interim response, the final one follows */
+                ngx_http_proxy_pipelining_reset(r, pp);
+                continue;
+            }
+
+            if (rc == NGX_ERROR) {
+                return NGX_HTTP_UPSTREAM_INVALID_HEADER;
+            }
+
+            pp->body = 1;
+
+            if (real_r) {
+                rc = ngx_http_proxy_pipelining_pass_header(real_r, pp);
+            }
+
+            if (pp->length == 0) {
+                ngx_http_proxy_pipelining_done(pc, pp);
+            }
+
+            if (real_r == NULL) {
+                continue;
+            }
+
+            multi_c->cur = real_r;
+
+            if (rc != NGX_OK) {
+                return NGX_HTTP_UPSTREAM_PARSE_ERROR;
+            }
+
+            return NGX_HTTP_UPSTREAM_HEADER_END;
+        }
+
+        n = b->last - b->pos;
+        rc = NGX_OK;
+        ru = NULL;
+        rb = NULL;
+
+        if (real_r) {
+            ru = real_r->upstream;
+            rb = &ru->buffer;
+
+            if (rb->last == rb->end) {
+
+                if (ru->out_bufs == NULL && ru->busy_bufs == NULL) {
+                    rb->pos = rb->start;
+                    rb->last = rb->start;
+
+                } else {
+
+                    /*
+                     * the client is slower than the connection, the body
+                     * is kept aside not to delay the responses that follow
+                     */
+
+                    rb->start = ngx_palloc(real_r->pool, u->conf->buffer_size);
+                    if (rb->start == NULL) {
+                        return NGX_ERROR;
+                    }
+
+                    rb->pos = rb->start;
+                    rb->last = rb->start;
+                    rb->end = rb->start + u->conf->buffer_size;
+                }
+            }
+
+            n = ngx_min(n, rb->end - rb->last);
+        }
+
+        if (!pp->chunked_body) {
+            n = ngx_min(n, pp->length);
+            pp->length -= n;
+
+        } else {
+            buf.pos = b->pos;
+            buf.last = b->pos + n;
+
+            while (buf.pos < buf.last) {
+
+                if (pp->chunked.size) {
+                    size = ngx_min(pp->chunked.size, buf.last - buf.pos);
+                    pp->chunked.size -= size;
+                    buf.pos += size;
+                    continue;
+                }
+
+                rc = ngx_http_parse_chunked(r, &buf, &pp->chunked);
+
+                if (rc == NGX_OK) {
+                    continue;
+                }
+
+                if (rc == NGX_DONE) {
+                    pp->length = 0;
+                    break;
+                }
+
+                if (rc == NGX_AGAIN) {
+                    break;
+                }
+
+                ngx_log_error(NGX_LOG_ERR, pc->log, 0,
+                              "upstream sent invalid chunked response");
+
+                return NGX_HTTP_UPSTREAM_INVALID_HEADER;
+            }
+
+            n = buf.pos - b->pos;
+        }
+
+        if (real_r) {
+            ngx_memcpy(rb->last, b->pos, n);
+
+            ru->state->bytes_received += n;
+            ru->state->response_length += n;
+
+            rc = ru->input_filter(ru->input_filter_ctx, n);
+        }
+
+        b->pos += n;
+
+        if (pp->length == 0) {
+            ngx_http_proxy_pipelining_done(pc, pp);
+        }
+
+        if (real_r == NULL) {
+            continue;
+        }
+
+        multi_c->cur = real_r;
+
+        if (rc == NGX_ERROR) {
+            return NGX_HTTP_UPSTREAM_PARSE_ERROR;
+        }
+
+        return NGX_HTTP_UPSTREAM_GET_BODY_DATA;
+    }
+}
+
+
+static void
+ngx_http_proxy_pipelining_reset(ngx_http_request_t *r,
+    ngx_http_proxy_pipelining_t *pp)
+{
+    pp->header.pos = pp->header.start;
+    pp->header.last = pp->header.start;
+
+    ngx_memzero(&pp->status, sizeof(ngx_http_status_t));
+    ngx_memzero(&pp->chunked, sizeof(ngx_http_chunked_t));
+
+    pp->length = -1;
+    pp->body = 0;
+    pp->chunked_body = 0;
+    pp->close = 0;
+
+    r->state = 0;
+}
+
+
+static ngx_int_t
+ngx_http_proxy_pipelining_parse_header(ngx_http_request_t *r,
+    ngx_http_proxy_pipelining_t *pp)
+{
+    size_t       n, len;
+    u_char      *start;
+    ngx_int_t    rc;
+    ngx_buf_t   *b, *h;
+    ngx_str_t    value;
+
+    b = &r->upstream->buffer;
+    h = &pp->header;
+
+    n = ngx_min(b->last - b->pos, h->end - h->last);
+
+    h->last = ngx_cpymem(h->last, b->pos, n);
+    b->pos += n;
+
+    if (pp->status.code == 0) {
+        rc = ngx_http_parse_status_line(r, h, &pp->status);
+
+        if (rc == NGX_AGAIN) {
+            goto again;
+        }
+
+        if (rc == NGX_ERROR) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "upstream sent no valid HTTP/1.1 header");
+            return NGX_ERROR;
+        }
+
+        if (pp->status.http_version < NGX_HTTP_VERSION_11) {
+            pp->close = 1;
+        }
+    }
+
+    for ( ;; ) {
+
+        rc = ngx_http_parse_header_line(r, h, 1);
+
+        if (rc == NGX_OK) {
+            len = r->header_name_end - r->header_name_start;
+
+            value.data = r->header_start;
+            value.len = r->header_end - r->header_start;
+
+            if (len == sizeof("Content-Length") - 1
+                && ngx_strncasecmp(r->header_name_start,
+                                   (u_char *) "Content-Length", len)
+                   == 0)
+            {
+                pp->length = ngx_atoof(value.data, value.len);
+
+                if (pp->length == NGX_ERROR) {
+                    ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                                  "upstream sent invalid "
+                                  "\"Content-Length\" header: \"%V\"",
+                                  &value);
+                    return NGX_ERROR;
+                }
+
+            } else if (len == sizeof("Transfer-Encoding") - 1
+                       && ngx_strncasecmp(r->header_name_start,
+                                          (u_char *) "Transfer-Encoding", len)
+                          == 0)
+            {
+                if (value.len != sizeof("chunked") - 1
+                    || ngx_strncasecmp(value.data, (u_char *) "chunked",
+                                       value.len)
+                       != 0)
+                {
+                    ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                                  "upstream sent unknown "
+                                  "\"Transfer-Encoding\": \"%V\"", &value);
+                    return NGX_ERROR;
+                }
+
+                pp->chunked_body = 1;
+
+            } else if (len == sizeof("Connection") - 1
+                       && ngx_strncasecmp(r->header_name_start,
+                                          (u_char *) "Connection", len)
+                          == 0)
+            {
+                if (ngx_strlcasestrn(value.data, value.data + value.len,
+                                     (u_char *) "close", 5 - 1)
+                    != NULL)
+                {
+                    pp->close = 1;
+                }
+            }
+
+            continue;
+        }
+
+        if (rc == NGX_HTTP_PARSE_HEADER_DONE) {
+            break;
+        }
+
+        if (rc == NGX_AGAIN) {
+            goto again;
+        }
+
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "upstream sent invalid header");
+
+        return NGX_ERROR;
+    }
+
+    /* the bytes behind the header belong to the body */
+
+    b->pos -= h->last - h->pos;
+    h->last = h->pos;
+
+    if (pp->status.code < NGX_HTTP_OK) {
+
+        if (pp->status.code == NGX_HTTP_SWITCHING_PROTOCOLS) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "upstream switched protocols "
+                          "on pipelined connection");
+            return NGX_ERROR;
+        }
+
+        return NGX_DECLINED;
+    }
+
+    start = pp->request->out->buf->start;
+
+    if (pp->status.code == NGX_HTTP_NO_CONTENT
+        || pp->status.code == NGX_HTTP_NOT_MODIFIED
+        || ngx_strncmp(start, "HEAD ", 5) == 0)
+    {
+        pp->length = 0;
+        pp->chunked_body = 0;
+
+    } else if (pp->chunked_body) {
+        pp->length = -1;
+
+    } else if (pp->length == -1) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "upstream sent response of unknown length "
+                      "on pipelined connection");
+        return NGX_ERROR;
+    }
+
+    if (pp->close && !pp->detached) {
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0,
+                      "upstream closes pipelined connection");
+
+        ngx_http_multi_upstream_connection_detach(r->connection);
+        pp->detached = 1;
+    }
+
+    return NGX_OK;
+
+again:
+
+    if (h->last == h->end) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "upstream sent too big header");
+        return NGX_ERROR;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static ngx_int_t
+ngx_http_proxy_pipelining_pass_header(ngx_http_request_t *r,
+    ngx_http_proxy_pipelining_t *pp)
+{
+    size_t                n;
+    ngx_int_t             rc;
+    ngx_buf_t            *b;
+    ngx_http_upstream_t  *u;
+
+    u = r->upstream;
+    b = &u->buffer;
+
+    n = pp->header.pos - pp->header.start;
+
+    if (n > (size_t) (b->end - b->start)) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "upstream sent too big header");
+        return NGX_ERROR;
+    }
+
+    b->pos = b->start;
+    b->last = ngx_cpymem(b->start, pp->header.start, n);
+
+    u->state->bytes_received += n;
+
+    rc = u->process_header(r);
+
+    if (rc == NGX_AGAIN) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "upstream sent incomplete header");
+        return NGX_ERROR;
+    }
+
+    return rc;
+}
+
+
+static void
+ngx_http_proxy_pipelining_done(ngx_connection_t *pc,
+    ngx_http_proxy_pipelining_t *pp)
+{
+    ngx_multi_request_t     *multi_r;
+    ngx_multi_connection_t  *multi_c;
+
+    multi_r = pp->request;
+    pp->request = NULL;
+
+    ngx_queue_remove(&multi_r->backend_queue);
+    ngx_queue_remove(&multi_r->front_queue);
+
+    if (ngx_buf_size(multi_r->out->buf)) {
+        /* the response came before the request was sent in full */
+        multi_c = ngx_get_multi_connection(pc);
+        ngx_queue_insert_tail(&multi_c->leak_list, &multi_r->backend_queue);
+        return;
+    }
+
+    ngx_destroy_pool(multi_r->pool);
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_proxy_host_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
@@ -2844,6 +3511,7 @@ ngx_http_proxy_create_loc_conf(ngx_conf_t *cf)
     conf->upstream.store_access = NGX_CONF_UNSET_UINT;
     conf->upstream.next_upstream_tries = NGX_CONF_UNSET_UINT;
     conf->upstream.buffering = NGX_CONF_UNSET;
+    conf->upstream.splice = NGX_CONF_UNSET;
     conf->upstream.request_buffering = NGX_CONF_UNSET;
     conf->upstream.ignore_client_abort = NGX_CONF_UNSET;
     conf->upstream.force_ranges = NGX_CONF_UNSET;
@@ -2877,6 +3545,7 @@ ngx_http_proxy_create_loc_conf(ngx_conf_t *cf)
     conf->upstream.cache_lock = NGX_CONF_UNSET;
     conf->upstream.cache_lock_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.cache_lock_age = NGX_CONF_UNSET_MSEC;
+    conf->upstream.cache_lock_stream = NGX_CONF_UNSET;
     conf->upstream.cache_revalidate = NGX_CONF_UNSET;
     conf->upstream.cache_convert_head = NGX_CONF_UNSET;
     conf->upstream.cache_background_update = NGX_CONF_UNSET;
@@ -2906,6 +3575,10 @@ ngx_http_proxy_create_loc_conf(ngx_conf_t *cf)
 
     conf->http_version = NGX_CONF_UNSET_UINT;
 
+#if (T_NGX_MULTI_UPSTREAM)
+    conf->pipelining = NGX_CONF_UNSET;
+#endif
+
     conf->headers_hash_max_size = NGX_CONF_UNSET_UINT;
     conf->headers_hash_bucket_size = NGX_CONF_UNSET_UINT;
 
@@ -2958,6 +3631,9 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->upstream.buffering,
                               prev->upstream.buffering, 1);
 
+    ngx_conf_merge_value(conf->upstream.splice,
+                              prev->upstream.splice, 0);
+
     ngx_conf_merge_value(conf->upstream.request_buffering,
                               prev->upstream.request_buffering, 1);
 
@@ -3182,6 +3858,9 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_msec_value(conf->upstream.cache_lock_age,
                               prev->upstream.cache_lock_age, 5000);
 
+    ngx_conf_merge_value(conf->upstream.cache_lock_stream,
+                              prev->upstream.cache_lock_stream, 0);
+
     ngx_conf_merge_value(conf->upstream.cache_revalidate,
                               prev->upstream.cache_revalidate, 0);
 
@@ -3301,6 +3980,10 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_uint_value(conf->http_version, prev->http_version,
                               NGX_HTTP_VERSION_10);
 
+#if (T_NGX_MULTI_UPSTREAM)
+    ngx_conf_merge_value(conf->pipelining, prev->pipelining, 0);
+#endif
+
     ngx_conf_merge_uint_value(conf->headers_hash_max_size,
                               prev->headers_hash_max_size, 512);
 
@@ -4257,6 +4940,25 @@ ngx_http_proxy_lowat_check(ngx_conf_t *cf, void *post, void *data)
 }
 
 
+static char *
+ngx_http_proxy_splice_check(ngx_conf_t *cf, void *post, void *data)
+{
+#if !(NGX_HAVE_SPLICE)
+    ngx_flag_t *fp = data;
+
+    if (*fp) {
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "\"proxy_splice\" is not supported, ignored");
+
+        *fp = 0;
+    }
+
+#endif
+
+    return NGX_CONF_OK;
+}
+
+
 #if (NGX_HTTP_SSL)
 
 static ngx_int_t
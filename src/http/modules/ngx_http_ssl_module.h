@@ -25,6 +25,7 @@ typedef struct {
 
     ngx_flag_t                      prefer_server_ciphers;
     ngx_flag_t                      early_data;
+    ngx_flag_t                      ktls;
 
     ngx_uint_t                      protocols;
 
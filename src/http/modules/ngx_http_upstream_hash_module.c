@@ -28,6 +28,7 @@ typedef struct {
 typedef struct {
     ngx_http_complex_value_t            key;
     ngx_http_upstream_chash_points_t   *points;
+    ngx_uint_t                          bounded;
 } ngx_http_upstream_hash_srv_conf_t;
 
 
@@ -39,6 +40,7 @@ typedef struct {
     ngx_uint_t                          tries;
     ngx_uint_t                          rehash;
     uint32_t                            hash;
+    ngx_uint_t                          counted;
     ngx_event_get_peer_pt               get_rr_peer;
 } ngx_http_upstream_hash_peer_data_t;
 
@@ -60,6 +62,8 @@ static ngx_int_t ngx_http_upstream_init_chash_peer(ngx_http_request_t *r,
     ngx_http_upstream_srv_conf_t *us);
 static ngx_int_t ngx_http_upstream_get_chash_peer(ngx_peer_connection_t *pc,
     void *data);
+static void ngx_http_upstream_free_chash_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
 
 static void *ngx_http_upstream_hash_create_conf(ngx_conf_t *cf);
 static char *ngx_http_upstream_hash(ngx_conf_t *cf, ngx_command_t *cmd,
@@ -69,7 +73,7 @@ static char *ngx_http_upstream_hash(ngx_conf_t *cf, ngx_command_t *cmd,
 static ngx_command_t  ngx_http_upstream_hash_commands[] = {
 
     { ngx_string("hash"),
-      NGX_HTTP_UPS_CONF|NGX_CONF_TAKE12,
+      NGX_HTTP_UPS_CONF|NGX_CONF_TAKE123,
       ngx_http_upstream_hash,
       NGX_HTTP_SRV_CONF_OFFSET,
       0,
@@ -156,6 +160,7 @@ ngx_http_upstream_init_hash_peer(ngx_http_request_t *r,
     hp->tries = 0;
     hp->rehash = 0;
     hp->hash = 0;
+    hp->counted = 0;
     hp->get_rr_peer = ngx_http_upstream_get_round_robin_peer;
 
     return NGX_OK;
@@ -489,6 +494,10 @@ ngx_http_upstream_init_chash_peer(ngx_http_request_t *r,
     hp = r->upstream->peer.data;
     hcf = ngx_http_conf_upstream_srv_conf(us, ngx_http_upstream_hash_module);
 
+    if (hcf->bounded) {
+        r->upstream->peer.free = ngx_http_upstream_free_chash_peer;
+    }
+
     hash = ngx_crc32_long(hp->key.data, hp->key.len);
 
     ngx_http_upstream_rr_peers_rlock(hp->rrp.peers);
@@ -510,7 +519,7 @@ ngx_http_upstream_get_chash_peer(ngx_peer_connection_t *pc, void *data)
     intptr_t                            m;
     ngx_str_t                          *server;
     ngx_int_t                           total;
-    ngx_uint_t                          i, n, best_i;
+    ngx_uint_t                          i, n, best_i, load, weight;
     ngx_http_upstream_rr_peer_t        *peer, *best;
     ngx_http_upstream_chash_point_t    *point;
     ngx_http_upstream_chash_points_t   *points;
@@ -535,6 +544,15 @@ ngx_http_upstream_get_chash_peer(ngx_peer_connection_t *pc, void *data)
     points = hcf->points;
     point = &points->point[0];
 
+    /*
+     * with bounded loads a peer takes at most "bounded" times its share
+     * of the active requests, counting this one, the others go on along
+     * the ring
+     */
+
+    load = (hp->rrp.peers->conns + 1) * hcf->bounded;
+    weight = hp->rrp.peers->total_weight * 100;
+
     for ( ;; ) {
         server = point[hp->hash % points->number].server;
 
@@ -572,6 +590,12 @@ ngx_http_upstream_get_chash_peer(ngx_peer_connection_t *pc, void *data)
                 continue;
             }
 
+            if (hcf->bounded
+                && peer->conns * weight >= load * peer->weight)
+            {
+                continue;
+            }
+
             if (peer->server.len != server->len
                 || ngx_strncmp(peer->server.data, server->data, server->len)
                    != 0)
@@ -616,6 +640,11 @@ found:
 
     best->conns++;
 
+    if (hcf->bounded) {
+        hp->rrp.peers->conns++;
+        hp->counted = 1;
+    }
+
     if (now - best->checked > best->fail_timeout) {
         best->checked = now;
     }
@@ -631,6 +660,24 @@ found:
 }
 
 
+static void
+ngx_http_upstream_free_chash_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
+{
+    ngx_http_upstream_hash_peer_data_t  *hp = data;
+
+    if (hp->counted) {
+        hp->counted = 0;
+
+        ngx_http_upstream_rr_peers_wlock(hp->rrp.peers);
+        hp->rrp.peers->conns--;
+        ngx_http_upstream_rr_peers_unlock(hp->rrp.peers);
+    }
+
+    ngx_http_upstream_free_round_robin_peer(pc, data, state);
+}
+
+
 static void *
 ngx_http_upstream_hash_create_conf(ngx_conf_t *cf)
 {
@@ -642,6 +689,7 @@ ngx_http_upstream_hash_create_conf(ngx_conf_t *cf)
     }
 
     conf->points = NULL;
+    conf->bounded = 0;
 
     return conf;
 }
@@ -652,6 +700,7 @@ ngx_http_upstream_hash(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_http_upstream_hash_srv_conf_t  *hcf = conf;
 
+    ngx_int_t                          bounded;
     ngx_str_t                         *value;
     ngx_http_upstream_srv_conf_t      *uscf;
     ngx_http_compile_complex_value_t   ccv;
@@ -694,5 +743,26 @@ ngx_http_upstream_hash(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    if (cf->args->nelts == 4) {
+
+        if (ngx_strncmp(value[3].data, "bounded=", 8) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[3]);
+            return NGX_CONF_ERROR;
+        }
+
+        bounded = ngx_atofp(value[3].data + 8, value[3].len - 8, 2);
+
+        if (bounded == NGX_ERROR || bounded <= 100) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid bounded load factor \"%V\", "
+                               "it must be greater than 1", &value[3]);
+            return NGX_CONF_ERROR;
+        }
+
+        hcf->bounded = bounded;
+    }
+
     return NGX_CONF_OK;
 }
+
@@ -36,6 +36,16 @@ typedef struct {
 } ngx_http_cache_valid_t;
 
 
+typedef struct {
+    off_t                            size;
+    size_t                           body_start;
+    ngx_uint_t                       count;
+    unsigned                         done:1;
+    unsigned                         error:1;
+    u_char                           name[1];
+} ngx_http_file_cache_fill_t;
+
+
 typedef struct {
     ngx_rbtree_node_t                node;
     ngx_queue_t                      queue;
@@ -59,9 +69,27 @@ typedef struct {
     size_t                           body_start;
     off_t                            fs_size;
     ngx_msec_t                       lock_time;
+    ngx_http_file_cache_fill_t      *fill;
 } ngx_http_file_cache_node_t;
 
 
+typedef struct {
+    ngx_rbtree_node_t                node;
+    ngx_queue_t                      queue;
+
+    u_char                           key[NGX_HTTP_CACHE_KEY_LEN
+                                         - sizeof(ngx_rbtree_key_t)];
+
+    ngx_uint_t                       count;
+    unsigned                         ready:1;
+    unsigned                         deleted:1;
+
+    ngx_file_uniq_t                  uniq;
+    off_t                            length;
+    u_char                           data[1];
+} ngx_http_file_cache_memory_node_t;
+
+
 struct ngx_http_cache_s {
     ngx_file_t                       file;
     ngx_array_t                      keys;
@@ -94,6 +122,11 @@ struct ngx_http_cache_s {
 
     ngx_http_file_cache_t           *file_cache;
     ngx_http_file_cache_node_t      *node;
+    ngx_http_file_cache_memory_node_t  *memory;
+    ngx_http_file_cache_fill_t      *fill;
+
+    ngx_chain_t                     *free;
+    ngx_chain_t                     *busy;
 
 #if (NGX_THREADS || NGX_COMPAT)
     ngx_thread_task_t               *thread_task;
@@ -107,7 +140,9 @@ struct ngx_http_cache_s {
     ngx_event_t                      wait_event;
 
     unsigned                         lock:1;
+    unsigned                         lock_stream:1;
     unsigned                         waiting:1;
+    unsigned                         streaming:1;
 
     unsigned                         updated:1;
     unsigned                         updating:1;
@@ -151,9 +186,20 @@ typedef struct {
     off_t                            size;
     ngx_uint_t                       count;
     ngx_uint_t                       watermark;
+    time_t                           snapshot;
 } ngx_http_file_cache_sh_t;
 
 
+typedef struct {
+    ngx_rbtree_t                     rbtree;
+    ngx_rbtree_node_t                sentinel;
+    ngx_queue_t                      queue;
+    ngx_uint_t                       mask;
+    ngx_uint_t                       samples;
+    u_char                          *sketch;
+} ngx_http_file_cache_memory_sh_t;
+
+
 struct ngx_http_file_cache_s {
     ngx_http_file_cache_sh_t        *sh;
     ngx_slab_pool_t                 *shpool;
@@ -177,8 +223,18 @@ struct ngx_http_file_cache_s {
     ngx_msec_t                       manager_sleep;
     ngx_msec_t                       manager_threshold;
 
+    ngx_str_t                        snapshot;
+    u_char                          *snapshot_temp;
+    time_t                           snapshot_interval;
+    time_t                           snapshot_next;
+
     ngx_shm_zone_t                  *shm_zone;
 
+    ngx_http_file_cache_memory_sh_t *memory_sh;
+    ngx_slab_pool_t                 *memory_shpool;
+    ngx_shm_zone_t                  *memory_zone;
+    off_t                            memory_max;
+
     ngx_uint_t                       use_temp_path;
                                      /* unsigned use_temp_path:1 */
 };
@@ -190,6 +246,7 @@ void ngx_http_file_cache_create_key(ngx_http_request_t *r);
 ngx_int_t ngx_http_file_cache_open(ngx_http_request_t *r);
 ngx_int_t ngx_http_file_cache_set_header(ngx_http_request_t *r, u_char *buf);
 void ngx_http_file_cache_update(ngx_http_request_t *r, ngx_temp_file_t *tf);
+void ngx_http_file_cache_fill(ngx_http_request_t *r, ngx_temp_file_t *tf);
 void ngx_http_file_cache_update_header(ngx_http_request_t *r);
 ngx_int_t ngx_http_cache_send(ngx_http_request_t *);
 void ngx_http_file_cache_free(ngx_http_cache_t *c, ngx_temp_file_t *tf);
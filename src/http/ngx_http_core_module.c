@@ -4792,6 +4792,18 @@ ngx_http_core_set_aio(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 #endif
     }
 
+    if (ngx_strcmp(value[1].data, "io_uring") == 0) {
+#if (NGX_HAVE_FILE_IO_URING)
+        clcf->aio = NGX_HTTP_AIO_IO_URING;
+        return NGX_CONF_OK;
+#else
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"aio io_uring\" "
+                           "is unsupported on this platform");
+        return NGX_CONF_ERROR;
+#endif
+    }
+
 #if (NGX_HAVE_AIO_SENDFILE)
 
     if (ngx_strcmp(value[1].data, "sendfile") == 0) {
@@ -34,6 +34,7 @@ typedef struct ngx_thread_pool_s  ngx_thread_pool_t;
 #define NGX_HTTP_AIO_OFF                0
 #define NGX_HTTP_AIO_ON                 1
 #define NGX_HTTP_AIO_THREADS            2
+#define NGX_HTTP_AIO_IO_URING           3
 
 
 #define NGX_HTTP_SATISFY_ALL            0
@@ -11,11 +11,63 @@
 #include <ngx_md5.h>
 
 
+#define NGX_HTTP_FILE_CACHE_SNAPSHOT_MAGIC    0x70616e73
+#define NGX_HTTP_FILE_CACHE_SNAPSHOT_VERSION  1
+
+/*
+ * files modified shortly before a snapshot was started might have
+ * been renamed into the cache after their nodes were copied
+ */
+#define NGX_HTTP_FILE_CACHE_SNAPSHOT_SLACK    60
+
+/* nodes copied per a hold of the keys zone mutex */
+#define NGX_HTTP_FILE_CACHE_SNAPSHOT_BATCH    1000
+
+/* objects seen less often are not admitted to the memory zone */
+#define NGX_HTTP_FILE_CACHE_MEMORY_ADMIT      2
+
+#define NGX_HTTP_FILE_CACHE_MEMORY_ROWS       4
+
+/* how often requests following a cache fill look for new data */
+#define NGX_HTTP_FILE_CACHE_STREAM_INTERVAL   20
+
+
+typedef struct {
+    uint32_t                         magic;
+    uint32_t                         version;
+    uint32_t                         crc32;
+    uint32_t                         bsize;
+    uint64_t                         count;
+    int64_t                          time;
+} ngx_http_file_cache_snapshot_header_t;
+
+
+typedef struct {
+    u_char                           key[NGX_HTTP_CACHE_KEY_LEN];
+    int64_t                          expire;
+    int64_t                          valid_sec;
+    int64_t                          fs_size;
+    uint64_t                         body_start;
+    uint64_t                         uniq;
+    uint32_t                         uses;
+    uint32_t                         valid_msec;
+} ngx_http_file_cache_snapshot_node_t;
+
+
 static ngx_int_t ngx_http_file_cache_lock(ngx_http_request_t *r,
     ngx_http_cache_t *c);
 static void ngx_http_file_cache_lock_wait_handler(ngx_event_t *ev);
 static void ngx_http_file_cache_lock_wait(ngx_http_request_t *r,
     ngx_http_cache_t *c);
+static ngx_int_t ngx_http_file_cache_stream_open(ngx_http_request_t *r,
+    ngx_http_cache_t *c);
+static ngx_int_t ngx_http_file_cache_stream(ngx_http_request_t *r,
+    ngx_http_cache_t *c);
+static void ngx_http_file_cache_stream_handler(ngx_event_t *ev);
+static void ngx_http_file_cache_stream_write_handler(ngx_http_request_t *r);
+static void ngx_http_file_cache_stream_cleanup(void *data);
+static void ngx_http_file_cache_fill_finalize(ngx_http_cache_t *c,
+    off_t size, ngx_uint_t error);
 static ngx_int_t ngx_http_file_cache_read(ngx_http_request_t *r,
     ngx_http_cache_t *c);
 static ssize_t ngx_http_file_cache_aio_read(ngx_http_request_t *r,
@@ -63,6 +115,35 @@ static ngx_int_t ngx_http_file_cache_add(ngx_http_file_cache_t *cache,
 static ngx_int_t ngx_http_file_cache_delete_file(ngx_tree_ctx_t *ctx,
     ngx_str_t *path);
 static void ngx_http_file_cache_set_watermark(ngx_http_file_cache_t *cache);
+static void ngx_http_file_cache_load_snapshot(ngx_http_file_cache_t *cache,
+    ngx_log_t *log);
+static time_t ngx_http_file_cache_snapshot(ngx_http_file_cache_t *cache);
+static ngx_int_t ngx_http_file_cache_write_snapshot(
+    ngx_http_file_cache_t *cache);
+static ngx_rbtree_node_t *ngx_http_file_cache_snapshot_next(
+    ngx_http_file_cache_t *cache, u_char *key);
+static int ngx_libc_cdecl ngx_http_file_cache_snapshot_cmp(const void *one,
+    const void *two);
+
+static ngx_int_t ngx_http_file_cache_memory_init(ngx_shm_zone_t *shm_zone,
+    void *data);
+static ngx_int_t ngx_http_file_cache_memory_open(ngx_http_request_t *r,
+    ngx_http_cache_t *c);
+static void ngx_http_file_cache_memory_admit(ngx_http_request_t *r,
+    ngx_http_cache_t *c);
+static void ngx_http_file_cache_memory_delete(ngx_http_file_cache_t *cache,
+    u_char *key);
+static void ngx_http_file_cache_memory_cleanup(void *data);
+static ngx_http_file_cache_memory_node_t *
+    ngx_http_file_cache_memory_lookup(ngx_http_file_cache_t *cache,
+    u_char *key);
+static void ngx_http_file_cache_memory_rbtree_insert_value(
+    ngx_rbtree_node_t *temp, ngx_rbtree_node_t *node,
+    ngx_rbtree_node_t *sentinel);
+static void ngx_http_file_cache_memory_free(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_memory_node_t *mn);
+static ngx_uint_t ngx_http_file_cache_memory_frequency(
+    ngx_http_file_cache_t *cache, u_char *key, ngx_uint_t add);
 
 
 ngx_str_t  ngx_http_cache_status[] = {
@@ -168,6 +249,12 @@ ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 
     cache->shpool->log_nomem = 0;
 
+    cache->sh->snapshot = 0;
+
+    if (cache->snapshot.len) {
+        ngx_http_file_cache_load_snapshot(cache, shm_zone->shm.log);
+    }
+
     return NGX_OK;
 }
 
@@ -343,6 +430,18 @@ ngx_http_file_cache_open(ngx_http_request_t *r)
         goto done;
     }
 
+    if (c->exists && cache->memory_zone) {
+        rc = ngx_http_file_cache_memory_open(r, c);
+
+        if (rc == NGX_OK) {
+            return ngx_http_file_cache_read(r, c);
+        }
+
+        if (rc == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     ngx_memzero(&of, sizeof(ngx_open_file_info_t));
@@ -402,6 +501,7 @@ done:
 static ngx_int_t
 ngx_http_file_cache_lock(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
+    ngx_int_t                  rc;
     ngx_msec_t                 now, timer;
     ngx_http_file_cache_t     *cache;
 
@@ -434,6 +534,14 @@ ngx_http_file_cache_lock(ngx_http_request_t *r, ngx_http_cache_t *c)
         return NGX_DECLINED;
     }
 
+    if (c->lock_stream) {
+        rc = ngx_http_file_cache_stream_open(r, c);
+
+        if (rc != NGX_DECLINED) {
+            return rc;
+        }
+    }
+
     if (c->lock_timeout == 0) {
         return NGX_HTTP_CACHE_SCARCE;
     }
@@ -450,6 +558,10 @@ ngx_http_file_cache_lock(ngx_http_request_t *r, ngx_http_cache_t *c)
 
     timer = c->wait_time - now;
 
+    if (c->lock_stream && timer > NGX_HTTP_FILE_CACHE_STREAM_INTERVAL) {
+        timer = NGX_HTTP_FILE_CACHE_STREAM_INTERVAL;
+    }
+
     ngx_add_timer(&c->wait_event, (timer > 500) ? 500 : timer);
 
     r->main->blocked++;
@@ -505,11 +617,24 @@ ngx_http_file_cache_lock_wait(ngx_http_request_t *r, ngx_http_cache_t *c)
 
     if (c->node->updating && (ngx_msec_int_t) timer > 0) {
         wait = 1;
+
+        /* the response being cached can be followed */
+
+        if (c->lock_stream
+            && c->node->fill
+            && c->node->fill->size >= (off_t) c->node->fill->body_start)
+        {
+            wait = 0;
+        }
     }
 
     ngx_shmtx_unlock(&cache->shpool->mutex);
 
     if (wait) {
+        if (c->lock_stream && timer > NGX_HTTP_FILE_CACHE_STREAM_INTERVAL) {
+            timer = NGX_HTTP_FILE_CACHE_STREAM_INTERVAL;
+        }
+
         ngx_add_timer(&c->wait_event, (timer > 500) ? 500 : timer);
         return;
     }
@@ -522,6 +647,294 @@ wakeup:
 }
 
 
+static ngx_int_t
+ngx_http_file_cache_stream_open(ngx_http_request_t *r, ngx_http_cache_t *c)
+{
+    size_t                       len;
+    u_char                      *name;
+    ngx_fd_t                     fd;
+    ngx_int_t                    rc;
+    ngx_pool_cleanup_t          *cln;
+    ngx_pool_cleanup_file_t     *clnf;
+    ngx_http_file_cache_t       *cache;
+    ngx_http_file_cache_fill_t  *fill;
+
+    cache = c->file_cache;
+
+    cln = ngx_pool_cleanup_add(r->pool, sizeof(ngx_pool_cleanup_file_t));
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    fill = c->node->fill;
+
+    if (fill == NULL
+        || fill->done
+        || fill->error
+        || fill->size < (off_t) fill->body_start)
+    {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+        return NGX_DECLINED;
+    }
+
+    len = ngx_strlen(fill->name);
+
+    name = ngx_pnalloc(r->pool, len + 1);
+    if (name == NULL) {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(name, fill->name, len + 1);
+
+    fill->count++;
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    c->fill = fill;
+    c->streaming = 1;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache stream: \"%s\"", name);
+
+    fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+
+        /* the file is already renamed or removed */
+
+        ngx_http_file_cache_stream_cleanup(c);
+        c->lock_stream = 0;
+        return NGX_DECLINED;
+    }
+
+    cln->handler = ngx_pool_cleanup_file;
+    clnf = cln->data;
+
+    clnf->fd = fd;
+    clnf->name = name;
+    clnf->log = r->pool->log;
+
+    cln = ngx_pool_cleanup_add(r->pool, 0);
+    if (cln == NULL) {
+        ngx_http_file_cache_stream_cleanup(c);
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_http_file_cache_stream_cleanup;
+    cln->data = c;
+
+    c->file.fd = fd;
+    c->file.log = r->connection->log;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+    c->length = fill->size;
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    c->buf = ngx_create_temp_buf(r->pool, c->body_start);
+    if (c->buf == NULL) {
+        return NGX_ERROR;
+    }
+
+    rc = ngx_http_file_cache_read(r, c);
+
+    if (rc == NGX_OK) {
+        return NGX_OK;
+    }
+
+    /* fall back to waiting for the cache file */
+
+    ngx_http_file_cache_stream_cleanup(c);
+
+    ngx_pool_run_cleanup_file(r->pool, fd);
+    c->file.fd = NGX_INVALID_FILE;
+
+    c->lock_stream = 0;
+
+    return (rc == NGX_ERROR) ? NGX_ERROR : NGX_DECLINED;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_stream(ngx_http_request_t *r, ngx_http_cache_t *c)
+{
+    off_t                       size;
+    ngx_int_t                   rc;
+    ngx_buf_t                  *b;
+    ngx_uint_t                  done, error, last;
+    ngx_chain_t                *out;
+    ngx_connection_t           *conn;
+    ngx_http_file_cache_t      *cache;
+    ngx_http_core_loc_conf_t   *clcf;
+
+    cache = c->file_cache;
+    conn = r->connection;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    size = c->fill->size;
+    done = c->fill->done;
+    error = c->fill->error;
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    if (error) {
+        ngx_log_error(NGX_LOG_ERR, conn->log, 0,
+                      "cache file \"%s\" was not completed", c->file.name.data);
+        return NGX_ERROR;
+    }
+
+    out = NULL;
+    last = 0;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, conn->log, 0,
+                   "http file cache stream: %O of %O d:%ui",
+                   c->length, size, done);
+
+    /* new data are added once the previous ones are sent */
+
+    if ((size > c->length || done) && c->busy == NULL) {
+        out = ngx_chain_get_free_buf(r->pool, &c->free);
+        if (out == NULL) {
+            return NGX_ERROR;
+        }
+
+        b = out->buf;
+        ngx_memzero(b, sizeof(ngx_buf_t));
+
+        b->tag = (ngx_buf_tag_t) &ngx_http_file_cache_stream;
+        b->file = &c->file;
+        b->file_pos = c->length;
+        b->file_last = size;
+        b->in_file = (size > c->length) ? 1 : 0;
+        b->flush = 1;
+
+        if (done) {
+            b->last_buf = (r == r->main) ? 1 : 0;
+            b->last_in_chain = 1;
+            b->sync = b->in_file ? 0 : 1;
+        }
+
+        c->length = size;
+        last = done;
+    }
+
+    rc = ngx_http_output_filter(r, out);
+
+    ngx_chain_update_chains(r->pool, &c->free, &c->busy, &out,
+                            (ngx_buf_tag_t) &ngx_http_file_cache_stream);
+
+    if (rc == NGX_ERROR || last) {
+
+        /* the rest is sent by ngx_http_writer() */
+
+        ngx_http_file_cache_stream_cleanup(c);
+        return (rc == NGX_AGAIN) ? NGX_OK : rc;
+    }
+
+    if (conn->buffered) {
+        clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+        if (ngx_handle_write_event(conn->write, clcf->send_lowat) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        if (!conn->write->ready) {
+            ngx_add_timer(conn->write, clcf->send_timeout);
+
+        } else if (conn->write->timer_set) {
+            ngx_del_timer(conn->write);
+        }
+
+    } else if (conn->write->timer_set) {
+        ngx_del_timer(conn->write);
+    }
+
+    if (!c->wait_event.timer_set) {
+        ngx_add_timer(&c->wait_event, NGX_HTTP_FILE_CACHE_STREAM_INTERVAL);
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static void
+ngx_http_file_cache_stream_handler(ngx_event_t *ev)
+{
+    ngx_int_t            rc;
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
+
+    r = ev->data;
+    c = r->connection;
+
+    ngx_http_set_log_request(c->log, r);
+
+    rc = ngx_http_file_cache_stream(r, r->cache);
+
+    if (rc != NGX_AGAIN) {
+        ngx_http_finalize_request(r, rc);
+    }
+
+    ngx_http_run_posted_requests(c);
+}
+
+
+static void
+ngx_http_file_cache_stream_write_handler(ngx_http_request_t *r)
+{
+    ngx_int_t          rc;
+    ngx_event_t       *wev;
+    ngx_http_cache_t  *c;
+
+    c = r->cache;
+    wev = r->connection->write;
+
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, NGX_ETIMEDOUT,
+                      "client timed out");
+        r->connection->timedout = 1;
+
+        if (c->wait_event.timer_set) {
+            ngx_del_timer(&c->wait_event);
+        }
+
+        ngx_http_file_cache_stream_cleanup(c);
+        ngx_http_finalize_request(r, NGX_HTTP_REQUEST_TIME_OUT);
+        return;
+    }
+
+    rc = ngx_http_file_cache_stream(r, c);
+
+    if (rc != NGX_AGAIN) {
+        if (c->wait_event.timer_set) {
+            ngx_del_timer(&c->wait_event);
+        }
+
+        ngx_http_finalize_request(r, rc);
+    }
+}
+
+
+static void
+ngx_http_file_cache_stream_cleanup(void *data)
+{
+    ngx_http_cache_t  *c = data;
+
+    if (c->fill == NULL || !c->streaming) {
+        return;
+    }
+
+    if (c->wait_event.timer_set) {
+        ngx_del_timer(&c->wait_event);
+    }
+
+    ngx_http_file_cache_fill_finalize(c, -1, 0);
+}
+
+
 static ngx_int_t
 ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
@@ -595,6 +1008,11 @@ ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
         if (ngx_memcmp(c->variant, h->variant, NGX_HTTP_CACHE_KEY_LEN) != 0) {
             ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "http file cache vary mismatch");
+
+            if (c->streaming) {
+                return NGX_DECLINED;
+            }
+
             return ngx_http_file_cache_reopen(r, c);
         }
     }
@@ -615,7 +1033,7 @@ ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 
     cache = c->file_cache;
 
-    if (cache->sh->cold) {
+    if (cache->sh->cold && !c->streaming) {
 
         ngx_shmtx_lock(&cache->shpool->mutex);
 
@@ -659,6 +1077,10 @@ ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
         return rc;
     }
 
+    if (cache->memory_zone && c->memory == NULL && !c->streaming) {
+        ngx_http_file_cache_memory_admit(r, c);
+    }
+
     return NGX_OK;
 }
 
@@ -666,13 +1088,28 @@ ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 static ssize_t
 ngx_http_file_cache_aio_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
-#if (NGX_HAVE_FILE_AIO || NGX_THREADS)
     ssize_t                    n;
+#if (NGX_HAVE_FILE_AIO || NGX_THREADS)
     ngx_http_core_loc_conf_t  *clcf;
 
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 #endif
 
+    if (c->memory) {
+        n = ngx_min(c->length, (off_t) c->body_start);
+
+        ngx_memcpy(c->buf->pos, c->memory->data, n);
+
+        return n;
+    }
+
+    if (c->streaming) {
+
+        /* the header has just been written */
+
+        return ngx_read_file(&c->file, c->buf->pos, c->body_start, 0);
+    }
+
 #if (NGX_HAVE_FILE_AIO)
 
     if (clcf->aio == NGX_HTTP_AIO_ON && ngx_file_aio) {
@@ -696,6 +1133,30 @@ ngx_http_file_cache_aio_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 
 #endif
 
+#if (NGX_HAVE_FILE_IO_URING)
+
+    if (clcf->aio == NGX_HTTP_AIO_IO_URING && ngx_file_io_uring) {
+        n = ngx_file_io_uring_read(&c->file, c->buf->pos, c->body_start, 0,
+                                   r->pool);
+
+        if (n != NGX_AGAIN) {
+            c->reading = 0;
+            return n;
+        }
+
+        c->reading = 1;
+
+        c->file.aio->data = r;
+        c->file.aio->handler = ngx_http_cache_aio_event_handler;
+
+        r->main->blocked++;
+        r->aio = 1;
+
+        return NGX_AGAIN;
+    }
+
+#endif
+
 #if (NGX_THREADS)
 
     if (clcf->aio == NGX_HTTP_AIO_THREADS) {
@@ -1228,6 +1689,8 @@ ngx_http_file_cache_reopen(ngx_http_request_t *r, ngx_http_cache_t *c)
 
     ngx_shmtx_unlock(&cache->shpool->mutex);
 
+    ngx_http_file_cache_memory_cleanup(c);
+
     c->secondary = 1;
     c->file.name.len = 0;
     c->body_start = c->buf->end - c->buf->start;
@@ -1407,6 +1870,10 @@ ngx_http_file_cache_update(ngx_http_request_t *r, ngx_temp_file_t *tf)
         }
     }
 
+    if (c->fill) {
+        ngx_http_file_cache_fill_finalize(c, tf->offset, rc != NGX_OK);
+    }
+
     ngx_shmtx_lock(&cache->shpool->mutex);
 
     c->node->count--;
@@ -1424,18 +1891,119 @@ ngx_http_file_cache_update(ngx_http_request_t *r, ngx_temp_file_t *tf)
     c->node->updating = 0;
 
     ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    if (cache->memory_zone) {
+        ngx_http_file_cache_memory_delete(cache, c->key);
+    }
 }
 
 
 void
-ngx_http_file_cache_update_header(ngx_http_request_t *r)
+ngx_http_file_cache_fill(ngx_http_request_t *r, ngx_temp_file_t *tf)
 {
-    ssize_t                        n;
-    ngx_err_t                      err;
-    ngx_file_t                     file;
-    ngx_file_info_t                fi;
-    ngx_http_cache_t              *c;
-    ngx_http_file_cache_header_t   h;
+    size_t                       len;
+    ngx_http_cache_t            *c;
+    ngx_http_file_cache_t       *cache;
+    ngx_http_file_cache_fill_t  *fill;
+
+    c = r->cache;
+
+    if (!c->updating || c->updated || tf->file.fd == NGX_INVALID_FILE) {
+        return;
+    }
+
+    cache = c->file_cache;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    fill = c->fill;
+
+    if (fill == NULL) {
+        len = tf->file.name.len;
+
+        fill = ngx_slab_alloc_locked(cache->shpool,
+                                     sizeof(ngx_http_file_cache_fill_t) + len);
+        if (fill == NULL) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+            c->lock_stream = 0;
+            return;
+        }
+
+        fill->size = 0;
+        fill->body_start = c->body_start;
+        fill->count = 1;
+        fill->done = 0;
+        fill->error = 0;
+
+        ngx_memcpy(fill->name, tf->file.name.data, len);
+        fill->name[len] = '\0';
+
+        c->fill = fill;
+        c->node->fill = fill;
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http file cache fill: \"%V\"", &tf->file.name);
+    }
+
+    if (fill->size != tf->offset) {
+        fill->size = tf->offset;
+
+        /* the lock is not stale while the response is being received */
+
+        if (c->node->lock_time == c->lock_time) {
+            c->lock_time = ngx_current_msec + c->lock_age;
+            c->node->lock_time = c->lock_time;
+        }
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+}
+
+
+static void
+ngx_http_file_cache_fill_finalize(ngx_http_cache_t *c, off_t size,
+    ngx_uint_t error)
+{
+    ngx_http_file_cache_t       *cache;
+    ngx_http_file_cache_fill_t  *fill;
+
+    fill = c->fill;
+    cache = c->file_cache;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    if (!c->streaming) {
+        if (size >= 0) {
+            fill->size = size;
+        }
+
+        fill->done = 1;
+        fill->error = error;
+
+        if (c->node && c->node->fill == fill) {
+            c->node->fill = NULL;
+        }
+    }
+
+    if (--fill->count == 0) {
+        ngx_slab_free_locked(cache->shpool, fill);
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    c->fill = NULL;
+}
+
+
+void
+ngx_http_file_cache_update_header(ngx_http_request_t *r)
+{
+    ssize_t                        n;
+    ngx_err_t                      err;
+    ngx_file_t                     file;
+    ngx_file_info_t                fi;
+    ngx_http_cache_t              *c;
+    ngx_http_file_cache_header_t   h;
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                    "http file cache update header");
@@ -1550,6 +2118,10 @@ ngx_http_file_cache_update_header(ngx_http_request_t *r)
     (void) ngx_write_file(&file, (u_char *) &h,
                           sizeof(ngx_http_file_cache_header_t), 0);
 
+    if (c->file_cache->memory_zone) {
+        ngx_http_file_cache_memory_delete(c->file_cache, c->key);
+    }
+
 done:
 
     if (ngx_close_file(file.fd) == NGX_FILE_ERROR) {
@@ -1572,6 +2144,31 @@ ngx_http_cache_send(ngx_http_request_t *r)
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                    "http file cache send: %s", c->file.name.data);
 
+    if (c->streaming) {
+
+        /* the final length is not known yet */
+
+        r->allow_ranges = 0;
+
+        rc = ngx_http_send_header(r);
+
+        if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+            return rc;
+        }
+
+        c->length = c->body_start;
+
+        c->wait_event.handler = ngx_http_file_cache_stream_handler;
+        c->wait_event.data = r;
+        c->wait_event.log = r->connection->log;
+
+        r->write_event_handler = ngx_http_file_cache_stream_write_handler;
+
+        rc = ngx_http_file_cache_stream(r, c);
+
+        return (rc == NGX_AGAIN) ? NGX_DONE : rc;
+    }
+
     if (r != r->main && c->length - c->body_start == 0) {
         return ngx_http_send_header(r);
     }
@@ -1583,9 +2180,11 @@ ngx_http_cache_send(ngx_http_request_t *r)
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
-    b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t));
-    if (b->file == NULL) {
-        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    if (c->memory == NULL) {
+        b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t));
+        if (b->file == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
     }
 
     rc = ngx_http_send_header(r);
@@ -1594,17 +2193,29 @@ ngx_http_cache_send(ngx_http_request_t *r)
         return rc;
     }
 
-    b->file_pos = c->body_start;
-    b->file_last = c->length;
+    if (c->memory) {
+
+        /* the node is referenced until the request pool is destroyed */
+
+        b->pos = c->memory->data + c->body_start;
+        b->last = c->memory->data + c->length;
+
+        b->memory = (c->length - c->body_start) ? 1: 0;
+
+    } else {
+        b->file_pos = c->body_start;
+        b->file_last = c->length;
+
+        b->in_file = (c->length - c->body_start) ? 1: 0;
+
+        b->file->fd = c->file.fd;
+        b->file->name = c->file.name;
+        b->file->log = r->connection->log;
+    }
 
-    b->in_file = (c->length - c->body_start) ? 1: 0;
     b->last_buf = (r == r->main) ? 1: 0;
     b->last_in_chain = 1;
 
-    b->file->fd = c->file.fd;
-    b->file->name = c->file.name;
-    b->file->log = r->connection->log;
-
     out.buf = b;
     out.next = NULL;
 
@@ -1627,6 +2238,10 @@ ngx_http_file_cache_free(ngx_http_cache_t *c, ngx_temp_file_t *tf)
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
                    "http file cache free, fd: %d", c->file.fd);
 
+    if (c->fill && !c->streaming) {
+        ngx_http_file_cache_fill_finalize(c, -1, 1);
+    }
+
     ngx_shmtx_lock(&cache->shpool->mutex);
 
     fcn = c->node;
@@ -1909,8 +2524,10 @@ ngx_http_file_cache_delete(ngx_http_file_cache_t *cache, ngx_queue_t *q,
 {
     u_char                      *p;
     size_t                       len;
+    ngx_err_t                    err;
     ngx_path_t                  *path;
     ngx_http_file_cache_node_t  *fcn;
+    u_char                       key[NGX_HTTP_CACHE_KEY_LEN];
 
     fcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
 
@@ -1925,10 +2542,18 @@ ngx_http_file_cache_delete(ngx_http_file_cache_t *cache, ngx_queue_t *q,
         p = ngx_hex_dump(p, fcn->key, len);
         *p = '\0';
 
+        ngx_memcpy(key, (u_char *) &fcn->node.key, sizeof(ngx_rbtree_key_t));
+        ngx_memcpy(&key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                   NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
         fcn->count++;
         fcn->deleting = 1;
         ngx_shmtx_unlock(&cache->shpool->mutex);
 
+        if (cache->memory_zone) {
+            ngx_http_file_cache_memory_delete(cache, key);
+        }
+
         len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
         ngx_create_hashed_filename(path, name, len);
 
@@ -1936,8 +2561,17 @@ ngx_http_file_cache_delete(ngx_http_file_cache_t *cache, ngx_queue_t *q,
                        "http file cache expire: \"%s\"", name);
 
         if (ngx_delete_file(name) == NGX_FILE_ERROR) {
-            ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
-                          ngx_delete_file_n " \"%s\" failed", name);
+            err = ngx_errno;
+
+            /*
+             * a node restored from a snapshot may refer to a file
+             * removed after the snapshot was written
+             */
+
+            if (err != NGX_ENOENT || cache->snapshot.len == 0) {
+                ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, err,
+                              ngx_delete_file_n " \"%s\" failed", name);
+            }
         }
 
         ngx_shmtx_lock(&cache->shpool->mutex);
@@ -2019,6 +2653,14 @@ ngx_http_file_cache_manager(void *data)
 
 done:
 
+    if (cache->snapshot.len) {
+        wait = ngx_http_file_cache_snapshot(cache);
+
+        if ((ngx_msec_t) wait * 1000 < next) {
+            next = (ngx_msec_t) wait * 1000;
+        }
+    }
+
     elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
 
     ngx_log_debug3(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
@@ -2090,11 +2732,18 @@ ngx_http_file_cache_manage_file(ngx_tree_ctx_t *ctx, ngx_str_t *path)
 
     cache = ctx->data;
 
-    if (ngx_http_file_cache_add_file(ctx, path) != NGX_OK) {
-        (void) ngx_http_file_cache_delete_file(ctx, path);
+    /* files older than the snapshot are already in the keys zone */
+
+    if (ctx->mtime >= cache->sh->snapshot) {
+
+        if (ngx_http_file_cache_add_file(ctx, path) != NGX_OK) {
+            (void) ngx_http_file_cache_delete_file(ctx, path);
+        }
+
+        cache->files++;
     }
 
-    if (++cache->files >= cache->loader_files) {
+    if (cache->files >= cache->loader_files) {
         ngx_http_file_cache_loader_sleep(cache);
 
     } else {
@@ -2236,6 +2885,15 @@ ngx_http_file_cache_add(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
 
     } else {
         ngx_queue_remove(&fcn->queue);
+
+        if (fcn->exists && cache->sh->snapshot) {
+
+            /* the file was rewritten after the snapshot */
+
+            cache->sh->size += c->fs_size - fcn->fs_size;
+            fcn->fs_size = c->fs_size;
+            fcn->body_start = 0;
+        }
     }
 
     fcn->expire = ngx_time() + cache->inactive;
@@ -2273,163 +2931,1056 @@ ngx_http_file_cache_set_watermark(ngx_http_file_cache_t *cache)
 }
 
 
-time_t
-ngx_http_file_cache_valid(ngx_array_t *cache_valid, ngx_uint_t status)
+static void
+ngx_http_file_cache_load_snapshot(ngx_http_file_cache_t *cache, ngx_log_t *log)
 {
-    ngx_uint_t               i;
-    ngx_http_cache_valid_t  *valid;
+    off_t                                   size;
+    size_t                                  len;
+    u_char                                 *addr;
+    ngx_fd_t                                fd;
+    ngx_err_t                               err;
+    ngx_uint_t                              i, n;
+    ngx_file_info_t                         fi;
+    ngx_http_file_cache_node_t             *fcn;
+    ngx_http_file_cache_snapshot_node_t    *sn;
+    ngx_http_file_cache_snapshot_header_t  *hdr;
+
+    fd = ngx_open_file(cache->snapshot.data, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        err = ngx_errno;
 
-    if (cache_valid == NULL) {
-        return 0;
+        if (err != NGX_ENOENT) {
+            ngx_log_error(NGX_LOG_CRIT, log, err,
+                          ngx_open_file_n " \"%s\" failed",
+                          cache->snapshot.data);
+        }
+
+        return;
     }
 
-    valid = cache_valid->elts;
-    for (i = 0; i < cache_valid->nelts; i++) {
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", cache->snapshot.data);
+        goto close;
+    }
 
-        if (valid[i].status == 0) {
-            return valid[i].valid;
-        }
+    size = ngx_file_size(&fi);
 
-        if (valid[i].status == status) {
-            return valid[i].valid;
-        }
+    if (size < (off_t) sizeof(ngx_http_file_cache_snapshot_header_t)) {
+        goto invalid;
     }
 
-    return 0;
-}
+    len = (size_t) size;
 
+    addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
 
-char *
-ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
-{
-    char  *confp = conf;
+    if (addr == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      "mmap(\"%s\") failed", cache->snapshot.data);
+        goto close;
+    }
 
-    off_t                   max_size;
-    u_char                 *last, *p;
-    time_t                  inactive;
-    ssize_t                 size;
-    ngx_str_t               s, name, *value;
-    ngx_int_t               loader_files, manager_files;
-    ngx_msec_t              loader_sleep, manager_sleep, loader_threshold,
-                            manager_threshold;
-    ngx_uint_t              i, n, use_temp_path;
-    ngx_array_t            *caches;
-    ngx_http_file_cache_t  *cache, **ce;
+    hdr = (ngx_http_file_cache_snapshot_header_t *) addr;
+    sn = (ngx_http_file_cache_snapshot_node_t *) (hdr + 1);
 
-    cache = ngx_pcalloc(cf->pool, sizeof(ngx_http_file_cache_t));
-    if (cache == NULL) {
-        return NGX_CONF_ERROR;
-    }
+    size -= sizeof(ngx_http_file_cache_snapshot_header_t);
 
-    cache->path = ngx_pcalloc(cf->pool, sizeof(ngx_path_t));
-    if (cache->path == NULL) {
-        return NGX_CONF_ERROR;
+    if (hdr->magic != NGX_HTTP_FILE_CACHE_SNAPSHOT_MAGIC
+        || hdr->version != NGX_HTTP_FILE_CACHE_SNAPSHOT_VERSION
+        || hdr->bsize != cache->bsize
+        || size % sizeof(ngx_http_file_cache_snapshot_node_t)
+        || (uint64_t) size / sizeof(ngx_http_file_cache_snapshot_node_t)
+           != hdr->count
+        || hdr->crc32 != ngx_crc32_long((u_char *) sn, (size_t) size))
+    {
+        munmap(addr, len);
+        goto invalid;
     }
 
-    use_temp_path = 1;
-
-    inactive = 600;
+    n = 0;
 
-    loader_files = 100;
-    loader_sleep = 50;
-    loader_threshold = 200;
+    ngx_shmtx_lock(&cache->shpool->mutex);
 
-    manager_files = 100;
-    manager_sleep = 50;
-    manager_threshold = 200;
+    for (i = 0; i < hdr->count; i++) {
 
-    name.len = 0;
-    size = 0;
-    max_size = NGX_MAX_OFF_T_VALUE;
+        /*
+         * expired nodes are loaded as well: their files are older
+         * than the snapshot and are thus removed by the cache manager only
+         */
 
-    value = cf->args->elts;
+        if (ngx_http_file_cache_lookup(cache, sn[i].key) != NULL) {
+            continue;
+        }
 
-    cache->path->name = value[1];
+        fcn = ngx_slab_calloc_locked(cache->shpool,
+                                     sizeof(ngx_http_file_cache_node_t));
+        if (fcn == NULL) {
+            break;
+        }
 
-    if (cache->path->name.data[cache->path->name.len - 1] == '/') {
-        cache->path->name.len--;
-    }
+        ngx_memcpy((u_char *) &fcn->node.key, sn[i].key,
+                   sizeof(ngx_rbtree_key_t));
 
-    if (ngx_conf_full_name(cf->cycle, &cache->path->name, 0) != NGX_OK) {
-        return NGX_CONF_ERROR;
-    }
+        ngx_memcpy(fcn->key, &sn[i].key[sizeof(ngx_rbtree_key_t)],
+                   NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
 
-    for (i = 2; i < cf->args->nelts; i++) {
+        ngx_rbtree_insert(&cache->sh->rbtree, &fcn->node);
 
-        if (ngx_strncmp(value[i].data, "levels=", 7) == 0) {
+        /* nodes are stored from the least recently used one */
 
-            p = value[i].data + 7;
-            last = value[i].data + value[i].len;
+        ngx_queue_insert_head(&cache->sh->queue, &fcn->queue);
 
-            for (n = 0; n < NGX_MAX_PATH_LEVEL && p < last; n++) {
+        fcn->uses = sn[i].uses;
+        fcn->valid_msec = sn[i].valid_msec;
+        fcn->exists = 1;
+        fcn->uniq = sn[i].uniq;
+        fcn->expire = sn[i].expire;
+        fcn->valid_sec = sn[i].valid_sec;
+        fcn->body_start = sn[i].body_start;
+        fcn->fs_size = sn[i].fs_size;
 
-                if (*p > '0' && *p < '3') {
+        cache->sh->size += fcn->fs_size;
+        cache->sh->count++;
+        n++;
+    }
 
-                    cache->path->level[n] = *p++ - '0';
-                    cache->path->len += cache->path->level[n] + 1;
+    ngx_shmtx_unlock(&cache->shpool->mutex);
 
-                    if (p == last) {
-                        break;
-                    }
+    if (i == hdr->count) {
+        cache->sh->snapshot = hdr->time - NGX_HTTP_FILE_CACHE_SNAPSHOT_SLACK;
 
-                    if (*p++ == ':' && n < NGX_MAX_PATH_LEVEL - 1 && p < last) {
-                        continue;
-                    }
+        ngx_log_error(NGX_LOG_NOTICE, log, 0,
+                      "http file cache snapshot \"%s\": %ui entries loaded",
+                      cache->snapshot.data, n);
 
-                    goto invalid_levels;
-                }
+    } else {
+        ngx_log_error(NGX_LOG_WARN, log, 0,
+                      "http file cache snapshot \"%s\": %ui entries loaded, "
+                      "the rest does not fit%s",
+                      cache->snapshot.data, n, cache->shpool->log_ctx);
+    }
 
-                goto invalid_levels;
-            }
+    munmap(addr, len);
 
-            if (cache->path->len < 10 + NGX_MAX_PATH_LEVEL) {
-                continue;
-            }
+    goto close;
 
-        invalid_levels:
+invalid:
 
-            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                               "invalid \"levels\" \"%V\"", &value[i]);
-            return NGX_CONF_ERROR;
-        }
+    ngx_log_error(NGX_LOG_WARN, log, 0,
+                  "http file cache snapshot \"%s\" is invalid, ignored",
+                  cache->snapshot.data);
 
-        if (ngx_strncmp(value[i].data, "use_temp_path=", 14) == 0) {
+close:
 
-            if (ngx_strcmp(&value[i].data[14], "on") == 0) {
-                use_temp_path = 1;
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", cache->snapshot.data);
+    }
+}
 
-            } else if (ngx_strcmp(&value[i].data[14], "off") == 0) {
-                use_temp_path = 0;
 
-            } else {
-                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                                   "invalid use_temp_path value \"%V\", "
-                                   "it must be \"on\" or \"off\"",
-                                   &value[i]);
-                return NGX_CONF_ERROR;
-            }
+static time_t
+ngx_http_file_cache_snapshot(ngx_http_file_cache_t *cache)
+{
+    time_t  now;
 
-            continue;
-        }
+    now = ngx_time();
 
-        if (ngx_strncmp(value[i].data, "keys_zone=", 10) == 0) {
+    if (cache->snapshot_next == 0) {
+        cache->snapshot_next = now + cache->snapshot_interval;
+    }
 
-            name.data = value[i].data + 10;
+    if (now < cache->snapshot_next) {
+        return cache->snapshot_next - now;
+    }
 
-            p = (u_char *) ngx_strchr(name.data, ':');
+    cache->snapshot_next = now + cache->snapshot_interval;
 
-            if (p == NULL) {
-                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                                   "invalid keys zone size \"%V\"", &value[i]);
-                return NGX_CONF_ERROR;
-            }
+    /* an incomplete keys zone is not worth saving */
 
-            name.len = p - name.data;
+    if (!cache->sh->cold) {
+        (void) ngx_http_file_cache_write_snapshot(cache);
+    }
 
-            s.data = p + 1;
-            s.len = value[i].data + value[i].len - s.data;
+    return cache->snapshot_interval;
+}
 
-            size = ngx_parse_size(&s);
+
+static ngx_int_t
+ngx_http_file_cache_write_snapshot(ngx_http_file_cache_t *cache)
+{
+    u_char                                 *buf, *p;
+    size_t                                  size;
+    ssize_t                                 n;
+    ngx_fd_t                                fd;
+    ngx_uint_t                              i, b, count;
+    ngx_rbtree_node_t                      *node, *sentinel;
+    ngx_http_file_cache_node_t             *fcn;
+    ngx_http_file_cache_snapshot_node_t    *sn;
+    ngx_http_file_cache_snapshot_header_t  *hdr;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+    count = cache->sh->count;
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    /* the keys zone may grow while it is copied */
+
+    count += count / 8 + NGX_HTTP_FILE_CACHE_SNAPSHOT_BATCH;
+
+    buf = ngx_alloc(sizeof(ngx_http_file_cache_snapshot_header_t)
+                    + count * sizeof(ngx_http_file_cache_snapshot_node_t),
+                    ngx_cycle->log);
+    if (buf == NULL) {
+        return NGX_ERROR;
+    }
+
+    hdr = (ngx_http_file_cache_snapshot_header_t *) buf;
+    sn = (ngx_http_file_cache_snapshot_node_t *) (hdr + 1);
+
+    hdr->time = ngx_time();
+
+    /*
+     * the nodes are copied in the rbtree order in batches, so that
+     * workers are not blocked for long; the next batch starts after
+     * the last key copied, and every node which exists during the whole
+     * walk is copied once regardless of nodes added or removed meanwhile
+     */
+
+    i = 0;
+
+    for ( ;; ) {
+
+        if (count - i < NGX_HTTP_FILE_CACHE_SNAPSHOT_BATCH) {
+            count *= 2;
+
+            p = ngx_alloc(sizeof(ngx_http_file_cache_snapshot_header_t)
+                          + count * sizeof(ngx_http_file_cache_snapshot_node_t),
+                          ngx_cycle->log);
+            if (p == NULL) {
+                ngx_free(buf);
+                return NGX_ERROR;
+            }
+
+            ngx_memcpy(p, buf, sizeof(ngx_http_file_cache_snapshot_header_t)
+                       + i * sizeof(ngx_http_file_cache_snapshot_node_t));
+
+            ngx_free(buf);
+
+            buf = p;
+            hdr = (ngx_http_file_cache_snapshot_header_t *) buf;
+            sn = (ngx_http_file_cache_snapshot_node_t *) (hdr + 1);
+        }
+
+        ngx_shmtx_lock(&cache->shpool->mutex);
+
+        sentinel = cache->sh->rbtree.sentinel;
+
+        if (i == 0) {
+            node = cache->sh->rbtree.root;
+            node = (node == sentinel) ? NULL
+                                      : ngx_rbtree_min(node, sentinel);
+
+        } else {
+            node = ngx_http_file_cache_snapshot_next(cache, sn[i - 1].key);
+        }
+
+        for (b = 0;
+             node && b < NGX_HTTP_FILE_CACHE_SNAPSHOT_BATCH;
+             node = ngx_rbtree_next(&cache->sh->rbtree, node))
+        {
+            fcn = (ngx_http_file_cache_node_t *) node;
+
+            if (!fcn->exists || fcn->deleting) {
+                continue;
+            }
+
+            ngx_memcpy(sn[i].key, (u_char *) &fcn->node.key,
+                       sizeof(ngx_rbtree_key_t));
+
+            ngx_memcpy(&sn[i].key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                       NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+            sn[i].expire = fcn->expire;
+            sn[i].valid_sec = fcn->valid_sec;
+            sn[i].fs_size = fcn->fs_size;
+            sn[i].body_start = fcn->body_start;
+            sn[i].uniq = fcn->uniq;
+            sn[i].uses = fcn->uses;
+            sn[i].valid_msec = fcn->valid_msec;
+
+            i++;
+            b++;
+        }
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        if (node == NULL) {
+            break;
+        }
+    }
+
+    /*
+     * the expiration time of a node is updated on each access,
+     * so sorting by it restores the least recently used order
+     */
+
+    ngx_qsort(sn, i, sizeof(ngx_http_file_cache_snapshot_node_t),
+              ngx_http_file_cache_snapshot_cmp);
+
+    size = i * sizeof(ngx_http_file_cache_snapshot_node_t);
+
+    hdr->magic = NGX_HTTP_FILE_CACHE_SNAPSHOT_MAGIC;
+    hdr->version = NGX_HTTP_FILE_CACHE_SNAPSHOT_VERSION;
+    hdr->crc32 = ngx_crc32_long((u_char *) sn, size);
+    hdr->bsize = cache->bsize;
+    hdr->count = i;
+
+    size += sizeof(ngx_http_file_cache_snapshot_header_t);
+
+    fd = ngx_open_file(cache->snapshot_temp, NGX_FILE_WRONLY,
+                       NGX_FILE_TRUNCATE, NGX_FILE_DEFAULT_ACCESS);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", cache->snapshot_temp);
+        ngx_free(buf);
+        return NGX_ERROR;
+    }
+
+    for (p = buf; size; p += n, size -= n) {
+        n = ngx_write_fd(fd, p, size);
+
+        if (n == -1) {
+            ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                          ngx_write_fd_n " \"%s\" failed",
+                          cache->snapshot_temp);
+            goto failed;
+        }
+    }
+
+    /* the snapshot must not be renamed over the old one before it is saved */
+
+    if (fsync(fd) == -1) {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      "fsync() \"%s\" failed", cache->snapshot_temp);
+        goto failed;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", cache->snapshot_temp);
+        fd = NGX_INVALID_FILE;
+        goto failed;
+    }
+
+    if (ngx_rename_file(cache->snapshot_temp, cache->snapshot.data)
+        == NGX_FILE_ERROR)
+    {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_rename_file_n " \"%s\" to \"%s\" failed",
+                      cache->snapshot_temp, cache->snapshot.data);
+        fd = NGX_INVALID_FILE;
+        goto failed;
+    }
+
+    ngx_free(buf);
+
+    ngx_log_error(NGX_LOG_INFO, ngx_cycle->log, 0,
+                  "http file cache snapshot \"%s\": %ui entries saved",
+                  cache->snapshot.data, i);
+
+    return NGX_OK;
+
+failed:
+
+    if (fd != NGX_INVALID_FILE) {
+        (void) ngx_close_file(fd);
+    }
+
+    (void) ngx_delete_file(cache->snapshot_temp);
+
+    ngx_free(buf);
+
+    return NGX_ERROR;
+}
+
+
+static ngx_rbtree_node_t *
+ngx_http_file_cache_snapshot_next(ngx_http_file_cache_t *cache, u_char *key)
+{
+    ngx_int_t                    rc;
+    ngx_rbtree_key_t             node_key;
+    ngx_rbtree_node_t           *node, *next, *sentinel;
+    ngx_http_file_cache_node_t  *fcn;
+
+    /* the first node with a key greater than the given one */
+
+    ngx_memcpy((u_char *) &node_key, key, sizeof(ngx_rbtree_key_t));
+
+    node = cache->sh->rbtree.root;
+    sentinel = cache->sh->rbtree.sentinel;
+    next = NULL;
+
+    while (node != sentinel) {
+
+        if (node_key != node->key) {
+            rc = (node_key < node->key) ? -1 : 1;
+
+        } else {
+            fcn = (ngx_http_file_cache_node_t *) node;
+
+            rc = ngx_memcmp(&key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                            NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+        }
+
+        if (rc < 0) {
+            next = node;
+            node = node->left;
+
+        } else {
+            node = node->right;
+        }
+    }
+
+    return next;
+}
+
+
+static int ngx_libc_cdecl
+ngx_http_file_cache_snapshot_cmp(const void *one, const void *two)
+{
+    ngx_http_file_cache_snapshot_node_t  *first, *second;
+
+    first = (ngx_http_file_cache_snapshot_node_t *) one;
+    second = (ngx_http_file_cache_snapshot_node_t *) two;
+
+    if (first->expire == second->expire) {
+        return 0;
+    }
+
+    return (first->expire < second->expire) ? -1 : 1;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_memory_init(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_file_cache_t  *ocache = data;
+
+    size_t                            len;
+    ngx_uint_t                        width;
+    ngx_http_file_cache_t            *cache;
+    ngx_http_file_cache_memory_sh_t  *sh;
+
+    cache = shm_zone->data;
+
+    if (ocache) {
+        cache->memory_sh = ocache->memory_sh;
+        cache->memory_shpool = ocache->memory_shpool;
+
+        return NGX_OK;
+    }
+
+    cache->memory_shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cache->memory_sh = cache->memory_shpool->data;
+
+        return NGX_OK;
+    }
+
+    sh = ngx_slab_alloc(cache->memory_shpool,
+                        sizeof(ngx_http_file_cache_memory_sh_t));
+    if (sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->memory_sh = sh;
+    cache->memory_shpool->data = sh;
+
+    ngx_rbtree_init(&sh->rbtree, &sh->sentinel,
+                    ngx_http_file_cache_memory_rbtree_insert_value);
+
+    ngx_queue_init(&sh->queue);
+
+    /* about one counter in a row per kilobyte of the zone */
+
+    for (width = 1024; width < shm_zone->shm.size / 1024; width <<= 1) {
+        /* void */
+    }
+
+    sh->sketch = ngx_slab_calloc(cache->memory_shpool,
+                                 NGX_HTTP_FILE_CACHE_MEMORY_ROWS * width);
+    if (sh->sketch == NULL) {
+        return NGX_ERROR;
+    }
+
+    sh->mask = width - 1;
+    sh->samples = 0;
+
+    len = sizeof(" in cache memory zone \"\"") + shm_zone->shm.name.len;
+
+    cache->memory_shpool->log_ctx = ngx_slab_alloc(cache->memory_shpool, len);
+    if (cache->memory_shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(cache->memory_shpool->log_ctx, " in cache memory zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    cache->memory_shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_memory_open(ngx_http_request_t *r, ngx_http_cache_t *c)
+{
+    ngx_pool_cleanup_t                 *cln;
+    ngx_http_file_cache_t              *cache;
+    ngx_http_file_cache_memory_node_t  *mn;
+
+    cache = c->file_cache;
+
+    ngx_shmtx_lock(&cache->memory_shpool->mutex);
+
+    (void) ngx_http_file_cache_memory_frequency(cache, c->key, 1);
+
+    mn = ngx_http_file_cache_memory_lookup(cache, c->key);
+
+    if (mn == NULL || !mn->ready || mn->deleted || mn->uniq != c->uniq) {
+
+        if (mn && mn->ready && mn->count == 0) {
+            ngx_http_file_cache_memory_free(cache, mn);
+        }
+
+        ngx_shmtx_unlock(&cache->memory_shpool->mutex);
+
+        return NGX_DECLINED;
+    }
+
+    mn->count++;
+
+    ngx_queue_remove(&mn->queue);
+    ngx_queue_insert_head(&cache->memory_sh->queue, &mn->queue);
+
+    ngx_shmtx_unlock(&cache->memory_shpool->mutex);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache memory: %O", mn->length);
+
+    c->memory = mn;
+
+    cln = ngx_pool_cleanup_add(r->pool, 0);
+    if (cln == NULL) {
+        ngx_http_file_cache_memory_cleanup(c);
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_http_file_cache_memory_cleanup;
+    cln->data = c;
+
+    c->file.fd = NGX_INVALID_FILE;
+    c->file.log = r->connection->log;
+    c->length = mn->length;
+
+    c->buf = ngx_create_temp_buf(r->pool, c->body_start);
+    if (c->buf == NULL) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_file_cache_memory_admit(ngx_http_request_t *r, ngx_http_cache_t *c)
+{
+    u_char                              key[NGX_HTTP_CACHE_KEY_LEN];
+    ssize_t                             n;
+    ngx_uint_t                          tries, frequency;
+    ngx_queue_t                        *q;
+    ngx_http_file_cache_t              *cache;
+    ngx_http_file_cache_memory_node_t  *mn, *victim;
+
+    cache = c->file_cache;
+
+    if (c->length > cache->memory_max || c->file.fd == NGX_INVALID_FILE) {
+        return;
+    }
+
+    ngx_shmtx_lock(&cache->memory_shpool->mutex);
+
+    frequency = ngx_http_file_cache_memory_frequency(cache, c->key, 0);
+
+    if (frequency < NGX_HTTP_FILE_CACHE_MEMORY_ADMIT) {
+        goto done;
+    }
+
+    mn = ngx_http_file_cache_memory_lookup(cache, c->key);
+
+    if (mn) {
+        if (mn->count) {
+            goto done;
+        }
+
+        ngx_http_file_cache_memory_free(cache, mn);
+    }
+
+    /*
+     * TinyLFU: the least recently used nodes are evicted to make room
+     * only if they are requested less often than the new object
+     */
+
+    for ( ;; ) {
+        mn = ngx_slab_alloc_locked(cache->memory_shpool,
+                                   offsetof(ngx_http_file_cache_memory_node_t,
+                                            data)
+                                   + c->length);
+        if (mn) {
+            break;
+        }
+
+        victim = NULL;
+
+        for (q = ngx_queue_last(&cache->memory_sh->queue), tries = 0;
+             q != ngx_queue_sentinel(&cache->memory_sh->queue) && tries < 20;
+             q = ngx_queue_prev(q), tries++)
+        {
+            mn = ngx_queue_data(q, ngx_http_file_cache_memory_node_t, queue);
+
+            if (mn->count == 0) {
+                victim = mn;
+                break;
+            }
+        }
+
+        if (victim == NULL) {
+            goto done;
+        }
+
+        ngx_memcpy(key, (u_char *) &victim->node.key,
+                   sizeof(ngx_rbtree_key_t));
+        ngx_memcpy(&key[sizeof(ngx_rbtree_key_t)], victim->key,
+                   NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+        if (!victim->deleted
+            && ngx_http_file_cache_memory_frequency(cache, key, 0) > frequency)
+        {
+            goto done;
+        }
+
+        ngx_http_file_cache_memory_free(cache, victim);
+    }
+
+    ngx_memcpy((u_char *) &mn->node.key, c->key, sizeof(ngx_rbtree_key_t));
+    ngx_memcpy(mn->key, &c->key[sizeof(ngx_rbtree_key_t)],
+               NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+    mn->count = 1;
+    mn->ready = 0;
+    mn->deleted = 0;
+    mn->uniq = c->uniq;
+    mn->length = c->length;
+
+    ngx_rbtree_insert(&cache->memory_sh->rbtree, &mn->node);
+    ngx_queue_insert_head(&cache->memory_sh->queue, &mn->queue);
+
+    ngx_shmtx_unlock(&cache->memory_shpool->mutex);
+
+    /* the object is small and was just read, so it is in the page cache */
+
+    n = ngx_read_file(&c->file, mn->data, c->length, 0);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache memory admit: %z of %O", n, c->length);
+
+    ngx_shmtx_lock(&cache->memory_shpool->mutex);
+
+    mn->count--;
+
+    if (n == c->length && !mn->deleted) {
+        mn->ready = 1;
+
+    } else {
+        ngx_http_file_cache_memory_free(cache, mn);
+    }
+
+done:
+
+    ngx_shmtx_unlock(&cache->memory_shpool->mutex);
+}
+
+
+static void
+ngx_http_file_cache_memory_delete(ngx_http_file_cache_t *cache, u_char *key)
+{
+    ngx_http_file_cache_memory_node_t  *mn;
+
+    ngx_shmtx_lock(&cache->memory_shpool->mutex);
+
+    mn = ngx_http_file_cache_memory_lookup(cache, key);
+
+    if (mn) {
+        if (mn->count == 0) {
+            ngx_http_file_cache_memory_free(cache, mn);
+
+        } else {
+            mn->deleted = 1;
+        }
+    }
+
+    ngx_shmtx_unlock(&cache->memory_shpool->mutex);
+}
+
+
+static void
+ngx_http_file_cache_memory_cleanup(void *data)
+{
+    ngx_http_cache_t  *c = data;
+
+    ngx_http_file_cache_t              *cache;
+    ngx_http_file_cache_memory_node_t  *mn;
+
+    mn = c->memory;
+
+    if (mn == NULL) {
+        return;
+    }
+
+    cache = c->file_cache;
+
+    ngx_shmtx_lock(&cache->memory_shpool->mutex);
+
+    mn->count--;
+
+    if (mn->deleted && mn->count == 0) {
+        ngx_http_file_cache_memory_free(cache, mn);
+    }
+
+    ngx_shmtx_unlock(&cache->memory_shpool->mutex);
+
+    c->memory = NULL;
+}
+
+
+static ngx_http_file_cache_memory_node_t *
+ngx_http_file_cache_memory_lookup(ngx_http_file_cache_t *cache, u_char *key)
+{
+    ngx_int_t                           rc;
+    ngx_rbtree_key_t                    node_key;
+    ngx_rbtree_node_t                  *node, *sentinel;
+    ngx_http_file_cache_memory_node_t  *mn;
+
+    ngx_memcpy((u_char *) &node_key, key, sizeof(ngx_rbtree_key_t));
+
+    node = cache->memory_sh->rbtree.root;
+    sentinel = cache->memory_sh->rbtree.sentinel;
+
+    while (node != sentinel) {
+
+        if (node_key < node->key) {
+            node = node->left;
+            continue;
+        }
+
+        if (node_key > node->key) {
+            node = node->right;
+            continue;
+        }
+
+        /* node_key == node->key */
+
+        mn = (ngx_http_file_cache_memory_node_t *) node;
+
+        rc = ngx_memcmp(&key[sizeof(ngx_rbtree_key_t)], mn->key,
+                        NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+        if (rc == 0) {
+            return mn;
+        }
+
+        node = (rc < 0) ? node->left : node->right;
+    }
+
+    /* not found */
+
+    return NULL;
+}
+
+
+static void
+ngx_http_file_cache_memory_rbtree_insert_value(ngx_rbtree_node_t *temp,
+    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
+{
+    ngx_rbtree_node_t                  **p;
+    ngx_http_file_cache_memory_node_t   *mn, *mnt;
+
+    for ( ;; ) {
+
+        if (node->key < temp->key) {
+
+            p = &temp->left;
+
+        } else if (node->key > temp->key) {
+
+            p = &temp->right;
+
+        } else { /* node->key == temp->key */
+
+            mn = (ngx_http_file_cache_memory_node_t *) node;
+            mnt = (ngx_http_file_cache_memory_node_t *) temp;
+
+            p = (ngx_memcmp(mn->key, mnt->key,
+                            NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t))
+                 < 0)
+                    ? &temp->left : &temp->right;
+        }
+
+        if (*p == sentinel) {
+            break;
+        }
+
+        temp = *p;
+    }
+
+    *p = node;
+    node->parent = temp;
+    node->left = sentinel;
+    node->right = sentinel;
+    ngx_rbt_red(node);
+}
+
+
+static void
+ngx_http_file_cache_memory_free(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_memory_node_t *mn)
+{
+    ngx_queue_remove(&mn->queue);
+    ngx_rbtree_delete(&cache->memory_sh->rbtree, &mn->node);
+    ngx_slab_free_locked(cache->memory_shpool, mn);
+}
+
+
+/*
+ * a count-min sketch of request frequencies with conservative increments,
+ * all counters are halved periodically so that old popularity fades away
+ */
+
+static ngx_uint_t
+ngx_http_file_cache_memory_frequency(ngx_http_file_cache_t *cache,
+    u_char *key, ngx_uint_t add)
+{
+    uint32_t                          hash;
+    ngx_uint_t                        i, min;
+    u_char                           *counter[NGX_HTTP_FILE_CACHE_MEMORY_ROWS];
+    ngx_http_file_cache_memory_sh_t  *sh;
+
+    sh = cache->memory_sh;
+
+    min = 255;
+
+    for (i = 0; i < NGX_HTTP_FILE_CACHE_MEMORY_ROWS; i++) {
+
+        /* the key is an md5 hash, so its parts are independent hashes */
+
+        ngx_memcpy(&hash, &key[i * sizeof(uint32_t)], sizeof(uint32_t));
+
+        counter[i] = &sh->sketch[i * (sh->mask + 1) + (hash & sh->mask)];
+
+        if (*counter[i] < min) {
+            min = *counter[i];
+        }
+    }
+
+    if (!add || min == 255) {
+        return min;
+    }
+
+    for (i = 0; i < NGX_HTTP_FILE_CACHE_MEMORY_ROWS; i++) {
+        if (*counter[i] == min) {
+            (*counter[i])++;
+        }
+    }
+
+    if (++sh->samples >= 10 * (sh->mask + 1)) {
+
+        for (i = 0; i < NGX_HTTP_FILE_CACHE_MEMORY_ROWS * (sh->mask + 1); i++) {
+            sh->sketch[i] >>= 1;
+        }
+
+        sh->samples /= 2;
+    }
+
+    return min + 1;
+}
+
+
+time_t
+ngx_http_file_cache_valid(ngx_array_t *cache_valid, ngx_uint_t status)
+{
+    ngx_uint_t               i;
+    ngx_http_cache_valid_t  *valid;
+
+    if (cache_valid == NULL) {
+        return 0;
+    }
+
+    valid = cache_valid->elts;
+    for (i = 0; i < cache_valid->nelts; i++) {
+
+        if (valid[i].status == 0) {
+            return valid[i].valid;
+        }
+
+        if (valid[i].status == status) {
+            return valid[i].valid;
+        }
+    }
+
+    return 0;
+}
+
+
+char *
+ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    char  *confp = conf;
+
+    off_t                   max_size;
+    u_char                 *last, *p;
+    time_t                  inactive, snapshot_interval;
+    ssize_t                 size, memory_size;
+    ngx_str_t               s, name, memory_name, snapshot, *value;
+    ngx_int_t               loader_files, manager_files;
+    ngx_msec_t              loader_sleep, manager_sleep, loader_threshold,
+                            manager_threshold;
+    ngx_uint_t              i, n, use_temp_path;
+    ngx_array_t            *caches;
+    ngx_http_file_cache_t  *cache, **ce;
+
+    cache = ngx_pcalloc(cf->pool, sizeof(ngx_http_file_cache_t));
+    if (cache == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    cache->path = ngx_pcalloc(cf->pool, sizeof(ngx_path_t));
+    if (cache->path == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    use_temp_path = 1;
+
+    inactive = 600;
+
+    loader_files = 100;
+    loader_sleep = 50;
+    loader_threshold = 200;
+
+    manager_files = 100;
+    manager_sleep = 50;
+    manager_threshold = 200;
+
+    ngx_str_null(&snapshot);
+    snapshot_interval = 600;
+
+    name.len = 0;
+    size = 0;
+    max_size = NGX_MAX_OFF_T_VALUE;
+
+    memory_name.len = 0;
+    memory_size = 0;
+
+    value = cf->args->elts;
+
+    cache->path->name = value[1];
+
+    if (cache->path->name.data[cache->path->name.len - 1] == '/') {
+        cache->path->name.len--;
+    }
+
+    if (ngx_conf_full_name(cf->cycle, &cache->path->name, 0) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "levels=", 7) == 0) {
+
+            p = value[i].data + 7;
+            last = value[i].data + value[i].len;
+
+            for (n = 0; n < NGX_MAX_PATH_LEVEL && p < last; n++) {
+
+                if (*p > '0' && *p < '3') {
+
+                    cache->path->level[n] = *p++ - '0';
+                    cache->path->len += cache->path->level[n] + 1;
+
+                    if (p == last) {
+                        break;
+                    }
+
+                    if (*p++ == ':' && n < NGX_MAX_PATH_LEVEL - 1 && p < last) {
+                        continue;
+                    }
+
+                    goto invalid_levels;
+                }
+
+                goto invalid_levels;
+            }
+
+            if (cache->path->len < 10 + NGX_MAX_PATH_LEVEL) {
+                continue;
+            }
+
+        invalid_levels:
+
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid \"levels\" \"%V\"", &value[i]);
+            return NGX_CONF_ERROR;
+        }
+
+        if (ngx_strncmp(value[i].data, "use_temp_path=", 14) == 0) {
+
+            if (ngx_strcmp(&value[i].data[14], "on") == 0) {
+                use_temp_path = 1;
+
+            } else if (ngx_strcmp(&value[i].data[14], "off") == 0) {
+                use_temp_path = 0;
+
+            } else {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid use_temp_path value \"%V\", "
+                                   "it must be \"on\" or \"off\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "keys_zone=", 10) == 0) {
+
+            name.data = value[i].data + 10;
+
+            p = (u_char *) ngx_strchr(name.data, ':');
+
+            if (p == NULL) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid keys zone size \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            name.len = p - name.data;
+
+            s.data = p + 1;
+            s.len = value[i].data + value[i].len - s.data;
+
+            size = ngx_parse_size(&s);
 
             if (size == NGX_ERROR) {
                 ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
@@ -2446,6 +3997,43 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "memory_zone=", 12) == 0) {
+
+            memory_name.data = value[i].data + 12;
+
+            p = (u_char *) ngx_strchr(memory_name.data, ':');
+
+            if (p == NULL) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid memory zone size \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            memory_name.len = p - memory_name.data;
+
+            s.data = p + 1;
+            s.len = value[i].data + value[i].len - s.data;
+
+            memory_size = ngx_parse_size(&s);
+
+            if (memory_size == NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid memory zone size \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            if (memory_size < (ssize_t) (8 * ngx_pagesize)) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "memory zone \"%V\" is too small",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         if (ngx_strncmp(value[i].data, "inactive=", 9) == 0) {
 
             s.len = value[i].len - 9;
@@ -2476,6 +4064,36 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "snapshot=", 9) == 0) {
+
+            snapshot.len = value[i].len - 9;
+            snapshot.data = value[i].data + 9;
+
+            if (ngx_conf_full_name(cf->cycle, &snapshot, 0) != NGX_OK) {
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "snapshot_interval=", 18) == 0) {
+
+            s.len = value[i].len - 18;
+            s.data = value[i].data + 18;
+
+            snapshot_interval = ngx_parse_time(&s, 1);
+            if (snapshot_interval == (time_t) NGX_ERROR
+                || snapshot_interval == 0)
+            {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid snapshot_interval value \"%V\"",
+                           &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         if (ngx_strncmp(value[i].data, "loader_files=", 13) == 0) {
 
             loader_files = ngx_atoi(value[i].data + 13, value[i].len - 13);
@@ -2572,6 +4190,38 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    if (snapshot.len) {
+
+        /* the loader removes unknown files found in the cache directory */
+
+        if (snapshot.len > cache->path->name.len
+            && ngx_strncmp(snapshot.data, cache->path->name.data,
+                           cache->path->name.len)
+               == 0
+            && snapshot.data[cache->path->name.len] == '/')
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "snapshot \"%V\" must be outside of "
+                               "the cache directory", &snapshot);
+            return NGX_CONF_ERROR;
+        }
+
+        cache->snapshot.len = snapshot.len;
+        cache->snapshot.data = ngx_pnalloc(cf->pool, snapshot.len + 1);
+        cache->snapshot_temp = ngx_pnalloc(cf->pool,
+                                           snapshot.len + sizeof(".tmp"));
+
+        if (cache->snapshot.data == NULL || cache->snapshot_temp == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        (void) ngx_cpystrn(cache->snapshot.data, snapshot.data,
+                           snapshot.len + 1);
+        (void) ngx_sprintf(cache->snapshot_temp, "%V.tmp%Z", &snapshot);
+
+        cache->snapshot_interval = snapshot_interval;
+    }
+
     cache->path->manager = ngx_http_file_cache_manager;
     cache->path->loader = ngx_http_file_cache_loader;
     cache->path->data = cache;
@@ -2603,6 +4253,27 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     cache->shm_zone->init = ngx_http_file_cache_init;
     cache->shm_zone->data = cache;
 
+    if (memory_name.len) {
+        cache->memory_zone = ngx_shared_memory_add(cf, &memory_name,
+                                                   memory_size, cmd->post);
+        if (cache->memory_zone == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        if (cache->memory_zone->data) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "duplicate zone \"%V\"", &memory_name);
+            return NGX_CONF_ERROR;
+        }
+
+        cache->memory_zone->init = ngx_http_file_cache_memory_init;
+        cache->memory_zone->data = cache;
+
+        /* an object may take up to 1/8 of the zone */
+
+        cache->memory_max = memory_size / 8;
+    }
+
     cache->use_temp_path = use_temp_path;
 
     cache->inactive = inactive;
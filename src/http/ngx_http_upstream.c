@@ -88,6 +88,12 @@ static void
     ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
     ngx_uint_t do_write);
 static ngx_int_t ngx_http_upstream_non_buffered_filter_init(void *data);
+#if (NGX_HAVE_SPLICE)
+static ngx_uint_t ngx_http_upstream_splice_test(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_splice_body(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+#endif
 static ngx_int_t ngx_http_upstream_non_buffered_filter(void *data,
     ssize_t bytes);
 #if (NGX_THREADS)
@@ -946,6 +952,7 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
         c->lock = u->conf->cache_lock;
         c->lock_timeout = u->conf->cache_lock_timeout;
         c->lock_age = u->conf->cache_lock_age;
+        c->lock_stream = u->conf->cache_lock_stream;
 
         u->cache_status = NGX_HTTP_CACHE_MISS;
     }
@@ -3144,6 +3151,12 @@ ngx_http_upstream_send_response(ngx_http_request_t *r, ngx_http_upstream_t *u)
             return;
         }
 
+#if (NGX_HAVE_SPLICE)
+        if (u->conf->splice) {
+            u->splice = ngx_http_upstream_splice_test(r, u);
+        }
+#endif
+
         if (clcf->tcp_nodelay && ngx_tcp_nodelay(c) != NGX_OK) {
             ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
             return;
@@ -3761,6 +3774,21 @@ ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
 
     for ( ;; ) {
 
+#if (NGX_HAVE_SPLICE)
+
+        if (u->splice_pipe) {
+            rc = ngx_http_upstream_splice_body(r, u);
+
+            if (rc == NGX_AGAIN) {
+                break;
+            }
+
+            ngx_http_upstream_finalize_request(r, u, rc);
+            return;
+        }
+
+#endif
+
         if (do_write) {
 
             if (u->out_bufs || u->busy_bufs || downstream->buffered) {
@@ -3804,6 +3832,30 @@ ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
             }
         }
 
+#if (NGX_HAVE_SPLICE)
+
+        /*
+         * the rest of the body is spliced once the header
+         * and the body read along with it are sent
+         */
+
+        if (u->splice
+            && u->out_bufs == NULL
+            && u->busy_bufs == NULL
+            && !downstream->buffered)
+        {
+            u->splice_pipe = ngx_splice_pipe_get(downstream->log);
+
+            if (u->splice_pipe == NULL) {
+                ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+                return;
+            }
+
+            continue;
+        }
+
+#endif
+
         size = b->end - b->last;
 
         if (size && upstream->read->ready) {
@@ -3871,6 +3923,117 @@ ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
 }
 
 
+#if (NGX_HAVE_SPLICE)
+
+static ngx_uint_t
+ngx_http_upstream_splice_test(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    /*
+     * only a body of a known length passed to the client unchanged
+     * over plain connections may bypass the output filters
+     */
+
+    if (r != r->main
+        || r->header_only
+        || r->chunked
+        || u->headers_in.chunked
+        || u->headers_in.content_length_n <= 0
+        || u->length != u->headers_in.content_length_n
+        || r->headers_out.content_length_n != u->headers_in.content_length_n)
+    {
+        return 0;
+    }
+
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        return 0;
+    }
+#endif
+
+#if (NGX_HTTP_SSL)
+    if (r->connection->ssl || u->peer.connection->ssl) {
+        return 0;
+    }
+#endif
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream splice body: %O", u->length);
+
+    return 1;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_splice_body(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    size_t              size;
+    ssize_t             n;
+    ngx_connection_t   *downstream, *upstream;
+    ngx_splice_pipe_t  *p;
+
+    downstream = r->connection;
+    upstream = u->peer.connection;
+
+    p = u->splice_pipe;
+
+    for ( ;; ) {
+
+        if (p->size && downstream->write->ready) {
+            if (ngx_splice_to(downstream, p) == NGX_ERROR) {
+                return NGX_ERROR;
+            }
+        }
+
+        if (p->size == 0) {
+
+            if (u->length == 0) {
+                u->keepalive = !u->headers_in.connection_close;
+                return NGX_OK;
+            }
+
+            if (upstream->read->eof) {
+                ngx_log_error(NGX_LOG_ERR, upstream->log, 0,
+                              "upstream prematurely closed connection");
+                return NGX_HTTP_BAD_GATEWAY;
+            }
+
+            if (upstream->read->error) {
+                return NGX_HTTP_BAD_GATEWAY;
+            }
+        }
+
+        size = p->capacity - p->size;
+
+        if ((off_t) size > u->length) {
+            size = (size_t) u->length;
+        }
+
+        if (size && upstream->read->ready) {
+
+            n = ngx_splice_from(upstream, p, size);
+
+            if (n == NGX_AGAIN) {
+                break;
+            }
+
+            if (n > 0) {
+                u->state->bytes_received += n;
+                u->state->response_length += n;
+                u->length -= n;
+            }
+
+            continue;
+        }
+
+        break;
+    }
+
+    return NGX_AGAIN;
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_upstream_non_buffered_filter_init(void *data)
 {
@@ -4171,6 +4334,10 @@ ngx_http_upstream_process_request(ngx_http_request_t *r,
 
         if (u->cacheable) {
 
+            if (r->cache->fill || r->cache->lock_stream) {
+                ngx_http_file_cache_fill(r, p->temp_file);
+            }
+
             if (p->upstream_done) {
                 ngx_http_file_cache_update(r, p->temp_file);
 
@@ -4568,10 +4735,19 @@ ngx_http_upstream_finalize_request(ngx_http_request_t *r,
         }
     }
 
+#if (NGX_HAVE_SPLICE)
+    if (u->splice_pipe) {
+        ngx_splice_pipe_free(u->splice_pipe, r->connection->log);
+        u->splice_pipe = NULL;
+    }
+#endif
+
     u->finalize_request(r, rc);
 
     if (u->peer.free && u->peer.sockaddr) {
-        u->peer.free(&u->peer, u->peer.data, 0);
+        u->peer.free(&u->peer, u->peer.data,
+                     u->headers_in.status_n >= NGX_HTTP_INTERNAL_SERVER_ERROR
+                     ? NGX_PEER_ERROR : 0);
         u->peer.sockaddr = NULL;
     }
 
@@ -200,6 +200,7 @@ typedef struct {
     ngx_uint_t                       store_access;
     ngx_uint_t                       next_upstream_tries;
     ngx_flag_t                       buffering;
+    ngx_flag_t                       splice;
     ngx_flag_t                       request_buffering;
     ngx_flag_t                       pass_request_headers;
     ngx_flag_t                       pass_request_body;
@@ -231,6 +232,7 @@ typedef struct {
     ngx_flag_t                       cache_lock;
     ngx_msec_t                       cache_lock_timeout;
     ngx_msec_t                       cache_lock_age;
+    ngx_flag_t                       cache_lock_stream;
 
     ngx_flag_t                       cache_revalidate;
     ngx_flag_t                       cache_convert_head;
@@ -378,6 +380,10 @@ struct ngx_http_upstream_s {
     ngx_chain_t                     *busy_bufs;
     ngx_chain_t                     *free_bufs;
 
+#if (NGX_HAVE_SPLICE)
+    ngx_splice_pipe_t               *splice_pipe;
+#endif
+
     ngx_int_t                      (*input_filter_init)(void *data);
     ngx_int_t                      (*input_filter)(void *data, ssize_t bytes);
     void                            *input_filter_ctx;
@@ -419,6 +425,7 @@ struct ngx_http_upstream_s {
 #endif
 
     unsigned                         buffering:1;
+    unsigned                         splice:1;
     unsigned                         keepalive:1;
     unsigned                         upgrade:1;
 
@@ -476,6 +483,8 @@ ngx_uint_t ngx_http_upstream_check_upstream_down(ngx_str_t *upstream);
 
 void ngx_http_upstream_check_get_peer(ngx_uint_t index);
 void ngx_http_upstream_check_free_peer(ngx_uint_t index);
+void ngx_http_upstream_check_passive(ngx_uint_t index, ngx_uint_t state,
+    ngx_msec_t elapsed);
 
 ngx_uint_t ngx_http_upstream_check_add_dynamic_peer(ngx_pool_t *pool,
     ngx_http_upstream_srv_conf_t *us, ngx_addr_t *peer);
@@ -707,6 +707,11 @@ ngx_http_upstream_free_round_robin_peer(ngx_peer_connection_t *pc, void *data,
 
     peer = rrp->current;
 
+#if (NGX_HTTP_UPSTREAM_CHECK)
+    ngx_http_upstream_check_passive(peer->check_index, state,
+                                    ngx_current_msec - pc->start_time);
+#endif
+
     ngx_http_upstream_rr_peers_rlock(rrp->peers);
     ngx_http_upstream_rr_peer_lock(rrp->peers, peer);
 
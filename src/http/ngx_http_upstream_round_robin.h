@@ -47,6 +47,10 @@ struct ngx_http_upstream_rr_peer_s {
 
     ngx_uint_t                      down;
 
+    /* peak ewma of the response time in microseconds, see the ewma module */
+    ngx_uint_t                      ewma;
+    ngx_msec_t                      ewma_stamp;
+
 #if (NGX_HTTP_SSL || NGX_COMPAT)
     void                           *ssl_session;
     int                             ssl_session_len;
@@ -83,6 +87,9 @@ struct ngx_http_upstream_rr_peers_s {
 
     ngx_uint_t                      total_weight;
 
+    /* active requests of the hash balancers with bounded loads */
+    ngx_uint_t                      conns;
+
     unsigned                        single:1;
     unsigned                        weighted:1;
 
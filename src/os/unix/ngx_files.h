@@ -381,6 +381,15 @@ extern ngx_uint_t  ngx_file_aio;
 
 #endif
 
+#if (NGX_HAVE_FILE_IO_URING)
+
+ssize_t ngx_file_io_uring_read(ngx_file_t *file, u_char *buf, size_t size,
+    off_t offset, ngx_pool_t *pool);
+
+extern ngx_uint_t  ngx_file_io_uring;
+
+#endif
+
 #if (NGX_THREADS)
 ssize_t ngx_thread_read(ngx_file_t *file, u_char *buf, size_t size,
     off_t offset, ngx_pool_t *pool);
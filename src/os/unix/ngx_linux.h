@@ -13,4 +13,13 @@ ngx_chain_t *ngx_linux_sendfile_chain(ngx_connection_t *c, ngx_chain_t *in,
     off_t limit);
 
 
+#if (NGX_HAVE_IO_URING)
+#include <ngx_linux_io_uring.h>
+#endif
+
+#if (NGX_HAVE_SPLICE)
+#include <ngx_linux_splice.h>
+#endif
+
+
 #endif /* _NGX_LINUX_H_INCLUDED_ */
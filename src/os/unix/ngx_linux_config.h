@@ -99,6 +99,12 @@ typedef struct iocb  ngx_aiocb_t;
 #endif
 
 
+#if (NGX_HAVE_IO_URING)
+#include <poll.h>
+#include <linux/io_uring.h>
+#endif
+
+
 #if (NGX_HAVE_CAPABILITIES)
 #include <linux/capability.h>
 #endif
@@ -0,0 +1,310 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * We call io_uring_setup() and io_uring_enter() directly as syscalls
+ * instead of liburing usage, the same way the Linux AIO support does.
+ */
+
+static int
+io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+
+static int
+io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags, void *arg, size_t argsz)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+
+ngx_int_t
+ngx_io_uring_create(ngx_io_uring_t *ring, ngx_uint_t entries, ngx_log_t *log)
+{
+    u_char                  *sq, *cq;
+    struct io_uring_params   p;
+
+    ngx_memzero(ring, sizeof(ngx_io_uring_t));
+    ngx_memzero(&p, sizeof(struct io_uring_params));
+
+    ring->fd = io_uring_setup(entries, &p);
+
+    if (ring->fd == -1) {
+        return NGX_ERROR;
+    }
+
+    ring->features = p.features;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes
+                         + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_ring_size = ngx_max(ring->sq_ring_size, ring->cq_ring_size);
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+
+    if (ring->sq_ring == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "mmap(IORING_OFF_SQ_RING) failed");
+        ring->sq_ring = NULL;
+        goto failed;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ|PROT_WRITE,
+                             MAP_SHARED|MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+
+        if (ring->cq_ring == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          "mmap(IORING_OFF_CQ_RING) failed");
+            ring->cq_ring = NULL;
+            goto failed;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE,
+                      MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if (ring->sqes == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "mmap(IORING_OFF_SQES) failed");
+        ring->sqes = NULL;
+        goto failed;
+    }
+
+    sq = ring->sq_ring;
+    cq = ring->cq_ring;
+
+    ring->sq_head = (unsigned *) (sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sq_flags = (unsigned *) (sq + p.sq_off.flags);
+    ring->sq_mask = *(unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cq_entries = p.cq_entries;
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    ngx_log_debug4(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "io_uring: fd:%d sq:%ud cq:%ud features:%08XD",
+                   ring->fd, p.sq_entries, p.cq_entries, p.features);
+
+    return NGX_OK;
+
+failed:
+
+    ngx_io_uring_destroy(ring, log);
+
+    return NGX_ERROR;
+}
+
+
+void
+ngx_io_uring_destroy(ngx_io_uring_t *ring, ngx_log_t *log)
+{
+    if (ring->sqes) {
+        (void) munmap(ring->sqes, ring->sqes_size);
+        ring->sqes = NULL;
+    }
+
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+        (void) munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+
+    ring->cq_ring = NULL;
+
+    if (ring->sq_ring) {
+        (void) munmap(ring->sq_ring, ring->sq_ring_size);
+        ring->sq_ring = NULL;
+    }
+
+    if (ring->fd != -1 && close(ring->fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ring->fd = -1;
+}
+
+
+struct io_uring_sqe *
+ngx_io_uring_get_sqe(ngx_io_uring_t *ring, ngx_log_t *log)
+{
+    unsigned              head, idx;
+    struct io_uring_sqe  *sqe;
+
+    head = *(volatile unsigned *) ring->sq_head;
+
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+
+        /* the submission queue is full, hand it over to the kernel */
+
+        if (ngx_io_uring_submit(ring, log) != NGX_OK) {
+            return NULL;
+        }
+
+        head = *(volatile unsigned *) ring->sq_head;
+
+        if (ring->sq_local_tail - head >= ring->sq_entries) {
+            ngx_log_error(NGX_LOG_ALERT, log, 0,
+                          "io_uring submission queue overflow");
+            return NULL;
+        }
+    }
+
+    idx = ring->sq_local_tail & ring->sq_mask;
+
+    sqe = &ring->sqes[idx];
+    ngx_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    ring->sq_array[idx] = idx;
+    ring->sq_local_tail++;
+    ring->sq_pending++;
+
+    return sqe;
+}
+
+
+ngx_int_t
+ngx_io_uring_submit(ngx_io_uring_t *ring, ngx_log_t *log)
+{
+    int  n;
+
+    if (ring->sq_pending == 0) {
+        return NGX_OK;
+    }
+
+    n = ngx_io_uring_enter(ring, 0, 0);
+
+    if (n == -1 && ngx_errno != NGX_EINTR && ngx_errno != NGX_EBUSY) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "io_uring_enter() failed");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+int
+ngx_io_uring_enter(ngx_io_uring_t *ring, ngx_uint_t wait, ngx_msec_t timer)
+{
+    int                              n;
+    unsigned                         flags, to_submit;
+    struct __kernel_timespec         ts;
+    struct io_uring_getevents_arg    arg, *parg;
+
+    to_submit = ring->sq_pending;
+
+    if (to_submit) {
+        ngx_memory_barrier();
+        *(volatile unsigned *) ring->sq_tail = ring->sq_local_tail;
+        ngx_memory_barrier();
+    }
+
+    flags = 0;
+    parg = NULL;
+
+    if (wait) {
+        flags |= IORING_ENTER_GETEVENTS;
+
+        if (timer != NGX_TIMER_INFINITE) {
+            ts.tv_sec = timer / 1000;
+            ts.tv_nsec = (timer % 1000) * 1000000;
+
+            ngx_memzero(&arg, sizeof(struct io_uring_getevents_arg));
+            arg.ts = (uint64_t) (uintptr_t) &ts;
+
+            flags |= IORING_ENTER_EXT_ARG;
+            parg = &arg;
+        }
+    }
+
+    n = io_uring_enter(ring->fd, to_submit, wait ? 1 : 0, flags, parg,
+                       parg ? sizeof(struct io_uring_getevents_arg) : 0);
+
+    if (n > 0) {
+        ring->sq_pending -= ngx_min((unsigned) n, ring->sq_pending);
+    }
+
+    return n;
+}
+
+
+struct io_uring_cqe *
+ngx_io_uring_peek_cqe(ngx_io_uring_t *ring)
+{
+    unsigned  head, tail;
+
+    head = *ring->cq_head;
+    tail = *(volatile unsigned *) ring->cq_tail;
+
+    if (head == tail) {
+        return NULL;
+    }
+
+    ngx_memory_barrier();
+
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+
+void
+ngx_io_uring_cqe_seen(ngx_io_uring_t *ring)
+{
+    ngx_memory_barrier();
+    *(volatile unsigned *) ring->cq_head = *ring->cq_head + 1;
+}
+
+
+/*
+ * the completions which did not fit into the full completion queue
+ * are kept by the kernel (IORING_FEAT_NODROP), they are moved back
+ * into the queue by io_uring_enter(IORING_ENTER_GETEVENTS) only;
+ * returns 1 if the queue is to be drained again
+ */
+
+ngx_uint_t
+ngx_io_uring_cq_overflow(ngx_io_uring_t *ring, ngx_log_t *log)
+{
+    if (!(*(volatile unsigned *) ring->sq_flags & IORING_SQ_CQ_OVERFLOW)) {
+        return 0;
+    }
+
+    if (io_uring_enter(ring->fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0) == -1
+        && ngx_errno != NGX_EINTR && ngx_errno != NGX_EBUSY)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "io_uring_enter(IORING_ENTER_GETEVENTS) failed");
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,56 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#ifndef _NGX_LINUX_IO_URING_H_INCLUDED_
+#define _NGX_LINUX_IO_URING_H_INCLUDED_
+
+
+typedef struct {
+    int                    fd;
+    uint32_t               features;
+
+    /* submission queue */
+
+    unsigned              *sq_head;
+    unsigned              *sq_tail;
+    unsigned              *sq_flags;
+    unsigned               sq_mask;
+    unsigned               sq_entries;
+    unsigned              *sq_array;
+    unsigned               sq_local_tail;
+    unsigned               sq_pending;
+    struct io_uring_sqe   *sqes;
+
+    /* completion queue */
+
+    unsigned              *cq_head;
+    unsigned              *cq_tail;
+    unsigned               cq_mask;
+    unsigned               cq_entries;
+    struct io_uring_cqe   *cqes;
+
+    void                  *sq_ring;
+    size_t                 sq_ring_size;
+    void                  *cq_ring;
+    size_t                 cq_ring_size;
+    size_t                 sqes_size;
+} ngx_io_uring_t;
+
+
+ngx_int_t ngx_io_uring_create(ngx_io_uring_t *ring, ngx_uint_t entries,
+    ngx_log_t *log);
+void ngx_io_uring_destroy(ngx_io_uring_t *ring, ngx_log_t *log);
+struct io_uring_sqe *ngx_io_uring_get_sqe(ngx_io_uring_t *ring,
+    ngx_log_t *log);
+ngx_int_t ngx_io_uring_submit(ngx_io_uring_t *ring, ngx_log_t *log);
+int ngx_io_uring_enter(ngx_io_uring_t *ring, ngx_uint_t wait,
+    ngx_msec_t timer);
+struct io_uring_cqe *ngx_io_uring_peek_cqe(ngx_io_uring_t *ring);
+void ngx_io_uring_cqe_seen(ngx_io_uring_t *ring);
+ngx_uint_t ngx_io_uring_cq_overflow(ngx_io_uring_t *ring, ngx_log_t *log);
+
+
+#endif /* _NGX_LINUX_IO_URING_H_INCLUDED_ */
@@ -0,0 +1,345 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * File reads for "aio io_uring".
+ *
+ * A read is first tried with preadv2(RWF_NOWAIT), which returns data
+ * already in the page cache without blocking.  Otherwise an IORING_OP_READ
+ * request is queued to a per worker ring.  Completions are signalled
+ * through an eventfd registered with the ring, the eventfd is watched
+ * by the current event method like any other descriptor.  If only a part
+ * of the range is cached, the rest is queued to the ring as well.  The
+ * contract is the same as the one of ngx_file_aio_read().
+ */
+
+
+#define NGX_FILE_IO_URING_ENTRIES  256
+
+
+static ngx_int_t ngx_file_io_uring_init(ngx_log_t *log);
+static void ngx_file_io_uring_handler(ngx_event_t *ev);
+static void ngx_file_io_uring_event_handler(ngx_event_t *ev);
+
+
+ngx_uint_t                 ngx_file_io_uring = 1;
+
+static ngx_io_uring_t      ngx_file_io_uring_ring;
+
+/* the reads queued, not more than the completion queue holds */
+static ngx_uint_t          ngx_file_io_uring_pending;
+
+
+static int
+io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+ssize_t
+ngx_file_io_uring_read(ngx_file_t *file, u_char *buf, size_t size,
+    off_t offset, ngx_pool_t *pool)
+{
+    size_t                nread;
+    ssize_t               n;
+    ngx_err_t             err;
+    struct iovec          iov;
+    ngx_event_t          *ev;
+    ngx_event_aio_t      *aio;
+    struct io_uring_sqe  *sqe;
+
+    if (!ngx_file_io_uring) {
+        return ngx_read_file(file, buf, size, offset);
+    }
+
+    if (file->aio == NULL && ngx_file_aio_init(file, pool) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    aio = file->aio;
+    ev = &aio->event;
+
+    if (!ev->ready) {
+        ngx_log_error(NGX_LOG_ALERT, file->log, 0,
+                      "second aio post for \"%V\"", &file->name);
+        return NGX_AGAIN;
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_CORE, file->log, 0,
+                   "io_uring complete:%d @%O:%uz %V",
+                   ev->complete, offset, size, &file->name);
+
+    if (ev->complete) {
+        ev->active = 0;
+        ev->complete = 0;
+
+        nread = aio->nread;
+        aio->nread = 0;
+
+        if (aio->res >= 0) {
+            ngx_set_errno(0);
+            return nread + aio->res;
+        }
+
+        ngx_set_errno(-aio->res);
+
+        ngx_log_error(NGX_LOG_CRIT, file->log, ngx_errno,
+                      "io_uring read \"%s\" failed", file->name.data);
+
+        return NGX_ERROR;
+    }
+
+    nread = 0;
+
+    /* try the page cache first */
+
+    iov.iov_base = buf;
+    iov.iov_len = size;
+
+    n = preadv2(file->fd, &iov, 1, offset, RWF_NOWAIT);
+
+    if (n == 0 || (n > 0 && (size_t) n == size)) {
+        file->offset += n;
+        return n;
+    }
+
+    if (n == -1) {
+        err = ngx_errno;
+
+        if (err == NGX_EOPNOTSUPP || err == NGX_ENOSYS) {
+
+            /* the file system does not support RWF_NOWAIT */
+
+        } else if (err != NGX_EAGAIN) {
+            ngx_log_error(NGX_LOG_CRIT, file->log, err,
+                          "preadv2() \"%s\" failed", file->name.data);
+            return NGX_ERROR;
+        }
+
+    } else if (n > 0) {
+
+        /* a partially cached range, the rest is read from the disk */
+
+        nread = n;
+    }
+
+    if (ngx_file_io_uring_ring.sqes == NULL
+        && ngx_file_io_uring_init(file->log) != NGX_OK)
+    {
+        ngx_file_io_uring = 0;
+        goto sync;
+    }
+
+    if (ngx_file_io_uring_pending >= ngx_file_io_uring_ring.cq_entries) {
+        ngx_log_debug1(NGX_LOG_DEBUG_CORE, file->log, 0,
+                       "io_uring reads pending: %ui, read synchronously",
+                       ngx_file_io_uring_pending);
+        goto sync;
+    }
+
+    sqe = ngx_io_uring_get_sqe(&ngx_file_io_uring_ring, file->log);
+    if (sqe == NULL) {
+        goto sync;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = file->fd;
+    sqe->addr = (uint64_t) (uintptr_t) (buf + nread);
+    sqe->len = size - nread;
+    sqe->off = offset + nread;
+    sqe->user_data = (uint64_t) (uintptr_t) ev;
+
+    if (ngx_io_uring_submit(&ngx_file_io_uring_ring, file->log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_file_io_uring_pending++;
+
+    aio->nread = nread;
+
+    ev->handler = ngx_file_io_uring_event_handler;
+    ev->active = 1;
+    ev->ready = 0;
+    ev->complete = 0;
+
+    return NGX_AGAIN;
+
+sync:
+
+    file->offset += nread;
+
+    n = ngx_read_file(file, buf + nread, size - nread, offset + nread);
+
+    if (n == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    return nread + n;
+}
+
+
+static ngx_int_t
+ngx_file_io_uring_init(ngx_log_t *log)
+{
+    int                n, fd;
+    ngx_uint_t         flags;
+    ngx_event_t       *rev;
+    ngx_connection_t  *c;
+
+    if (ngx_io_uring_create(&ngx_file_io_uring_ring,
+                            NGX_FILE_IO_URING_ENTRIES, log)
+        != NGX_OK)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "io_uring_setup() failed, "
+                      "aio io_uring is disabled");
+        return NGX_ERROR;
+    }
+
+    fd = eventfd(0, 0);
+
+    if (fd == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno, "eventfd() failed");
+        goto failed;
+    }
+
+    n = 1;
+
+    if (ioctl(fd, FIONBIO, &n) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "ioctl(eventfd, FIONBIO) failed");
+        goto close_fd;
+    }
+
+    if (io_uring_register(ngx_file_io_uring_ring.fd, IORING_REGISTER_EVENTFD,
+                          &fd, 1)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "io_uring_register(IORING_REGISTER_EVENTFD) failed");
+        goto close_fd;
+    }
+
+    c = ngx_get_connection(fd, log);
+    if (c == NULL) {
+        goto close_fd;
+    }
+
+    rev = c->read;
+
+    rev->handler = ngx_file_io_uring_handler;
+    rev->log = ngx_cycle->log;
+    rev->channel = 1;
+
+    c->log = ngx_cycle->log;
+
+    flags = (ngx_event_flags & NGX_USE_CLEAR_EVENT) ? NGX_CLEAR_EVENT
+                                                    : NGX_LEVEL_EVENT;
+
+    if (ngx_add_event(rev, NGX_READ_EVENT, flags) != NGX_OK) {
+        ngx_free_connection(c);
+        goto close_fd;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, log, 0,
+                   "io_uring read ring:%d eventfd:%d",
+                   ngx_file_io_uring_ring.fd, fd);
+
+    return NGX_OK;
+
+close_fd:
+
+    if (close(fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "eventfd close() failed");
+    }
+
+failed:
+
+    ngx_io_uring_destroy(&ngx_file_io_uring_ring, log);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_file_io_uring_handler(ngx_event_t *ev)
+{
+    int                   n;
+    uint64_t              ready;
+    ngx_event_t          *e;
+    ngx_event_aio_t      *aio;
+    ngx_connection_t     *c;
+    struct io_uring_cqe  *cqe;
+
+    c = ev->data;
+
+    n = read(c->fd, &ready, 8);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring read eventfd: %d", n);
+
+    if (n == -1 && ngx_errno != NGX_EAGAIN) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_errno,
+                      "read(eventfd) failed");
+    }
+
+    for ( ;; ) {
+        cqe = ngx_io_uring_peek_cqe(&ngx_file_io_uring_ring);
+
+        if (cqe == NULL) {
+
+            if (!ngx_io_uring_cq_overflow(&ngx_file_io_uring_ring, ev->log)) {
+                break;
+            }
+
+            cqe = ngx_io_uring_peek_cqe(&ngx_file_io_uring_ring);
+
+            if (cqe == NULL) {
+                break;
+            }
+        }
+
+        e = (ngx_event_t *) (uintptr_t) cqe->user_data;
+        aio = e->data;
+
+        aio->res = cqe->res;
+
+        ngx_io_uring_cqe_seen(&ngx_file_io_uring_ring);
+
+        ngx_file_io_uring_pending--;
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "io_uring read event: %p res:%L", e, aio->res);
+
+        e->complete = 1;
+        e->active = 0;
+        e->ready = 1;
+
+        ngx_post_event(e, &ngx_posted_events);
+    }
+}
+
+
+static void
+ngx_file_io_uring_event_handler(ngx_event_t *ev)
+{
+    ngx_event_aio_t  *aio;
+
+    aio = ev->data;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, ev->log, 0,
+                   "io_uring event handler fd:%d %V",
+                   aio->fd, &aio->file->name);
+
+    aio->handler(ev);
+}
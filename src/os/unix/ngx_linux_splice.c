@@ -0,0 +1,207 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * Zero-copy relaying between two sockets: the data are moved with splice()
+ * from the source socket into a pipe and from the pipe into the destination
+ * socket, and never reach the user space.  Pipes are kept in a small per
+ * worker free list, as creating a pipe costs two descriptors and a page
+ * allocation in the kernel.
+ */
+
+
+#define NGX_SPLICE_PIPE_SIZE        65536
+#define NGX_SPLICE_PIPE_CACHE       64
+
+
+static ngx_splice_pipe_t  *ngx_splice_pipe_cache;
+static ngx_uint_t          ngx_splice_pipe_ncached;
+
+
+ngx_splice_pipe_t *
+ngx_splice_pipe_get(ngx_log_t *log)
+{
+    int                 fd[2], size;
+    ngx_splice_pipe_t  *p;
+
+    p = ngx_splice_pipe_cache;
+
+    if (p) {
+        ngx_splice_pipe_cache = p->next;
+        ngx_splice_pipe_ncached--;
+
+        p->next = NULL;
+
+        return p;
+    }
+
+    p = ngx_alloc(sizeof(ngx_splice_pipe_t), log);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    if (pipe2(fd, O_NONBLOCK|O_CLOEXEC) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno, "pipe2() failed");
+        ngx_free(p);
+        return NULL;
+    }
+
+    size = fcntl(fd[0], F_GETPIPE_SZ);
+
+    p->fd[0] = fd[0];
+    p->fd[1] = fd[1];
+    p->size = 0;
+    p->capacity = (size > 0) ? (size_t) size : NGX_SPLICE_PIPE_SIZE;
+    p->next = NULL;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_CORE, log, 0,
+                   "splice pipe:%d:%d capacity:%uz",
+                   p->fd[0], p->fd[1], p->capacity);
+
+    return p;
+}
+
+
+void
+ngx_splice_pipe_free(ngx_splice_pipe_t *p, ngx_log_t *log)
+{
+    /* a pipe with data left cannot be reused */
+
+    if (p->size == 0 && ngx_splice_pipe_ncached < NGX_SPLICE_PIPE_CACHE) {
+        p->next = ngx_splice_pipe_cache;
+        ngx_splice_pipe_cache = p;
+        ngx_splice_pipe_ncached++;
+        return;
+    }
+
+    if (close(p->fd[0]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno, "pipe close() failed");
+    }
+
+    if (close(p->fd[1]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno, "pipe close() failed");
+    }
+
+    ngx_free(p);
+}
+
+
+ssize_t
+ngx_splice_from(ngx_connection_t *c, ngx_splice_pipe_t *p, size_t size)
+{
+    ssize_t       n;
+    ngx_err_t     err;
+    ngx_event_t  *rev;
+
+    rev = c->read;
+
+    if (size > p->capacity - p->size) {
+        size = p->capacity - p->size;
+    }
+
+    if (size == 0) {
+        return NGX_AGAIN;
+    }
+
+    for ( ;; ) {
+        n = splice(c->fd, NULL, p->fd[1], NULL, size,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "splice from: fd:%d %z of %uz", c->fd, n, size);
+
+        if (n > 0) {
+            p->size += n;
+            return n;
+        }
+
+        if (n == 0) {
+            rev->ready = 0;
+            rev->eof = 1;
+            return 0;
+        }
+
+        err = ngx_socket_errno;
+
+        if (err == NGX_EINTR) {
+            continue;
+        }
+
+        if (err == NGX_EAGAIN) {
+
+            /*
+             * EAGAIN is also returned if the pipe is full, the socket
+             * is known to have no data only when the pipe is empty
+             */
+
+            if (p->size == 0) {
+                rev->ready = 0;
+            }
+
+            return NGX_AGAIN;
+        }
+
+        rev->error = 1;
+        ngx_connection_error(c, err, "splice() failed");
+
+        return NGX_ERROR;
+    }
+}
+
+
+ssize_t
+ngx_splice_to(ngx_connection_t *c, ngx_splice_pipe_t *p)
+{
+    ssize_t       n;
+    ngx_err_t     err;
+    ngx_event_t  *wev;
+
+    wev = c->write;
+
+    if (p->size == 0) {
+        return 0;
+    }
+
+    for ( ;; ) {
+        n = splice(p->fd[0], NULL, c->fd, NULL, p->size,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "splice to: fd:%d %z of %uz", c->fd, n, p->size);
+
+        if (n > 0) {
+            p->size -= n;
+            c->sent += n;
+
+            if (p->size) {
+                wev->ready = 0;
+            }
+
+            return n;
+        }
+
+        err = (n == 0) ? NGX_EPIPE : ngx_socket_errno;
+
+        if (err == NGX_EINTR) {
+            continue;
+        }
+
+        if (err == NGX_EAGAIN) {
+            wev->ready = 0;
+            return NGX_AGAIN;
+        }
+
+        wev->error = 1;
+        ngx_connection_error(c, err, "splice() failed");
+
+        return NGX_ERROR;
+    }
+}
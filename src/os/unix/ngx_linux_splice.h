@@ -0,0 +1,29 @@
+
+/*
+ * Copyright (C) 2010-2019 Alibaba Group Holding Limited
+ */
+
+
+#ifndef _NGX_LINUX_SPLICE_H_INCLUDED_
+#define _NGX_LINUX_SPLICE_H_INCLUDED_
+
+
+typedef struct ngx_splice_pipe_s  ngx_splice_pipe_t;
+
+struct ngx_splice_pipe_s {
+    ngx_fd_t             fd[2];
+    size_t               size;
+    size_t               capacity;
+    ngx_splice_pipe_t   *next;
+};
+
+
+ngx_splice_pipe_t *ngx_splice_pipe_get(ngx_log_t *log);
+void ngx_splice_pipe_free(ngx_splice_pipe_t *p, ngx_log_t *log);
+
+ssize_t ngx_splice_from(ngx_connection_t *c, ngx_splice_pipe_t *p,
+    size_t size);
+ssize_t ngx_splice_to(ngx_connection_t *c, ngx_splice_pipe_t *p);
+
+
+#endif /* _NGX_LINUX_SPLICE_H_INCLUDED_ */
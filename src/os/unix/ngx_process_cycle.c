@@ -56,6 +56,10 @@ sig_atomic_t  ngx_noaccept;
 ngx_uint_t    ngx_noaccepting;
 ngx_uint_t    ngx_restart;
 
+#if (NGX_DYUPS)
+ngx_event_handler_pt  ngx_dyups_channel_handler;
+#endif
+
 
 static u_char  master_process[] = "master process";
 
@@ -1193,6 +1197,14 @@ ngx_channel_handler(ngx_event_t *ev)
             ngx_pipe_broken_action(ev->log, ch.pid, 0);
             break;
 #endif
+
+#if (NGX_DYUPS)
+        case NGX_CMD_DYUPS:
+            if (ngx_dyups_channel_handler) {
+                ngx_dyups_channel_handler(ev);
+            }
+            break;
+#endif
         }
     }
 }
@@ -21,6 +21,9 @@
 #if (T_PIPES)
 #define NGX_CMD_PIPE_BROKEN    6
 #endif
+#if (NGX_DYUPS)
+#define NGX_CMD_DYUPS          7
+#endif
 
 
 #define NGX_PROCESS_SINGLE     0
@@ -68,5 +71,9 @@ extern sig_atomic_t    ngx_reconfigure;
 extern sig_atomic_t    ngx_reopen;
 extern sig_atomic_t    ngx_change_binary;
 
+#if (NGX_DYUPS)
+extern ngx_event_handler_pt  ngx_dyups_channel_handler;
+#endif
+
 
 #endif /* _NGX_PROCESS_CYCLE_H_INCLUDED_ */
@@ -355,3 +355,282 @@ ngx_getcpuinfo(ngx_str_t *cpunumber, ngx_cpuinfo_t *cpuinfo, ngx_log_t *log)
 }
 
 #endif
+
+
+#if (NGX_LINUX)
+
+/*
+ * the files are opened once, on the first read of a zeroed file,
+ * NGX_DECLINED is returned if the kernel does not provide them
+ */
+
+static ssize_t
+ngx_sysinfo_read(ngx_file_t *file, u_char *name, u_char *buf, size_t size,
+    ngx_log_t *log)
+{
+    ssize_t  n;
+
+    if (file->name.data == NULL) {
+        file->name.data = name;
+        file->name.len = ngx_strlen(name);
+
+        file->fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN,
+                                 NGX_FILE_DEFAULT_ACCESS);
+    }
+
+    if (file->fd == NGX_INVALID_FILE) {
+        return NGX_DECLINED;
+    }
+
+    file->log = log;
+
+    n = ngx_read_file(file, buf, size - 1, 0);
+    if (n == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    buf[n] = '\0';
+
+    return n;
+}
+
+
+static uint64_t
+ngx_sysinfo_value(u_char *p, u_char *last, char *key)
+{
+    u_char  *v;
+    size_t   len;
+
+    len = ngx_strlen(key);
+
+    p = ngx_strlcasestrn(p, last, (u_char *) key, len - 1);
+    if (p == NULL) {
+        return 0;
+    }
+
+    p += len;
+
+    for (v = p; v < last && *v >= '0' && *v <= '9'; v++) { /* void */ }
+
+    if (v == p) {
+        return 0;
+    }
+
+    return (uint64_t) ngx_atoof(p, v - p);
+}
+
+
+static ngx_file_t  ngx_pressure_files[3];
+
+static char  *ngx_pressure_names[] = {
+    "/proc/pressure/cpu",
+    "/proc/pressure/memory",
+    "/proc/pressure/io"
+};
+
+
+ngx_int_t
+ngx_getpressure(ngx_uint_t resource, ngx_pressure_t *pressure, ngx_log_t *log)
+{
+    u_char   buf[256];
+    u_char  *p, *last;
+    ssize_t  n;
+
+    ngx_memzero(pressure, sizeof(ngx_pressure_t));
+
+    n = ngx_sysinfo_read(&ngx_pressure_files[resource],
+                         (u_char *) ngx_pressure_names[resource],
+                         buf, sizeof(buf), log);
+    if (n < 0) {
+        return n;
+    }
+
+    /*
+     * some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+     * full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+     */
+
+    last = buf + n;
+
+    p = ngx_strlchr(buf, last, LF);
+    if (p == NULL) {
+        p = last;
+    }
+
+    pressure->some = ngx_sysinfo_value(buf, p, "total=");
+    pressure->full = ngx_sysinfo_value(p, last, "total=");
+
+    return NGX_OK;
+}
+
+
+static ngx_file_t  ngx_cgroupcpu_file;
+
+
+static u_char *
+ngx_cgroupcpu_path(ngx_log_t *log)
+{
+    u_char           *p, *q, *last, *mount, *path, *name;
+    size_t            mlen, plen;
+    ssize_t           n;
+    ngx_file_t        file;
+    static u_char     buf[16384];
+
+    /* the cgroup v2 hierarchy, "... /sys/fs/cgroup rw - cgroup2 ..." */
+
+    ngx_memzero(&file, sizeof(ngx_file_t));
+
+    n = ngx_sysinfo_read(&file, (u_char *) "/proc/self/mountinfo",
+                         buf, sizeof(buf), log);
+
+    if (file.fd != NGX_INVALID_FILE) {
+        ngx_close_file(file.fd);
+    }
+
+    if (n <= 0) {
+        return NULL;
+    }
+
+    last = buf + n;
+
+    p = ngx_strlcasestrn(buf, last, (u_char *) " - cgroup2 ", 11 - 1);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    while (p > buf && p[-1] != LF) {
+        p--;
+    }
+
+    /* skip mount id, parent id, device and root */
+
+    for (n = 0; n < 4; n++) {
+        p = ngx_strlchr(p, last, ' ');
+        if (p == NULL) {
+            return NULL;
+        }
+
+        p++;
+    }
+
+    q = ngx_strlchr(p, last, ' ');
+    if (q == NULL) {
+        return NULL;
+    }
+
+    mlen = q - p;
+
+    mount = ngx_alloc(mlen, log);
+    if (mount == NULL) {
+        return NULL;
+    }
+
+    ngx_memcpy(mount, p, mlen);
+
+    /* the cgroup of the process, "0::/path" */
+
+    ngx_memzero(&file, sizeof(ngx_file_t));
+
+    n = ngx_sysinfo_read(&file, (u_char *) "/proc/self/cgroup",
+                         buf, sizeof(buf), log);
+
+    if (file.fd != NGX_INVALID_FILE) {
+        ngx_close_file(file.fd);
+    }
+
+    name = NULL;
+
+    if (n <= 0) {
+        goto done;
+    }
+
+    last = buf + n;
+
+    for (p = buf; p < last; p = q + 1) {
+
+        q = ngx_strlchr(p, last, LF);
+        if (q == NULL) {
+            q = last;
+        }
+
+        if (q - p > 3 && ngx_strncmp(p, "0::", 3) == 0) {
+            break;
+        }
+    }
+
+    if (p >= last) {
+        goto done;
+    }
+
+    path = p + 3;
+    plen = q - path;
+
+    if (plen == 1) {
+        plen = 0;
+    }
+
+    name = ngx_alloc(mlen + plen + sizeof("/cpu.stat"), log);
+    if (name == NULL) {
+        goto done;
+    }
+
+    p = ngx_cpymem(name, mount, mlen);
+    p = ngx_cpymem(p, path, plen);
+    ngx_memcpy(p, "/cpu.stat", sizeof("/cpu.stat"));
+
+done:
+
+    ngx_free(mount);
+
+    return name;
+}
+
+
+ngx_int_t
+ngx_getcgroupcpu(ngx_cgroupcpu_t *cpu, ngx_log_t *log)
+{
+    u_char             buf[1024];
+    ssize_t            n;
+    static u_char     *name;
+    static ngx_uint_t  searched;
+
+    ngx_memzero(cpu, sizeof(ngx_cgroupcpu_t));
+
+    if (!searched) {
+        searched = 1;
+        name = ngx_cgroupcpu_path(log);
+    }
+
+    if (name == NULL) {
+        return NGX_DECLINED;
+    }
+
+    n = ngx_sysinfo_read(&ngx_cgroupcpu_file, name, buf, sizeof(buf), log);
+    if (n < 0) {
+        return n;
+    }
+
+    cpu->usage = ngx_sysinfo_value(buf, buf + n, "usage_usec ");
+    cpu->nr_periods = ngx_sysinfo_value(buf, buf + n, "nr_periods ");
+    cpu->nr_throttled = ngx_sysinfo_value(buf, buf + n, "nr_throttled ");
+    cpu->throttled = ngx_sysinfo_value(buf, buf + n, "throttled_usec ");
+
+    return NGX_OK;
+}
+
+#else
+
+ngx_int_t
+ngx_getpressure(ngx_uint_t resource, ngx_pressure_t *pressure, ngx_log_t *log)
+{
+    return NGX_DECLINED;
+}
+
+
+ngx_int_t
+ngx_getcgroupcpu(ngx_cgroupcpu_t *cpu, ngx_log_t *log)
+{
+    return NGX_DECLINED;
+}
+
+#endif
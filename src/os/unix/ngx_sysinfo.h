@@ -33,10 +33,33 @@ typedef struct {
 }ngx_cpuinfo_t;
 
 
+#define NGX_PRESSURE_CPU     0
+#define NGX_PRESSURE_MEMORY  1
+#define NGX_PRESSURE_IO      2
+
+
+/* total stall time, in microseconds */
+typedef struct {
+    uint64_t some;
+    uint64_t full;
+} ngx_pressure_t;
+
+
+typedef struct {
+    uint64_t usage;        /* in microseconds */
+    uint64_t nr_periods;
+    uint64_t nr_throttled;
+    uint64_t throttled;    /* in microseconds */
+} ngx_cgroupcpu_t;
+
+
 ngx_int_t ngx_getloadavg(ngx_int_t avg[], ngx_int_t nelem, ngx_log_t *log);
 ngx_int_t ngx_getmeminfo(ngx_meminfo_t *meminfo, ngx_log_t *log);
 ngx_int_t ngx_getcpuinfo(ngx_str_t *cpunumber, ngx_cpuinfo_t *cpuinfo,
     ngx_log_t *log);
+ngx_int_t ngx_getpressure(ngx_uint_t resource, ngx_pressure_t *pressure,
+    ngx_log_t *log);
+ngx_int_t ngx_getcgroupcpu(ngx_cgroupcpu_t *cpu, ngx_log_t *log);
 
 #endif /* _NGX_SYSINFO_H_INCLUDED_ */
 
@@ -33,6 +33,7 @@ typedef struct {
     ngx_flag_t                       proxy_protocol;
     ngx_stream_upstream_local_t     *local;
     ngx_flag_t                       socket_keepalive;
+    ngx_flag_t                       splice;
 
 #if (NGX_STREAM_SSL)
     ngx_flag_t                       ssl_enable;
@@ -76,6 +77,10 @@ static void ngx_stream_proxy_process(ngx_stream_session_t *s,
     ngx_uint_t from_upstream, ngx_uint_t do_write);
 static ngx_int_t ngx_stream_proxy_test_finalize(ngx_stream_session_t *s,
     ngx_uint_t from_upstream);
+#if (NGX_HAVE_SPLICE)
+static ngx_int_t ngx_stream_proxy_splice(ngx_stream_session_t *s,
+    ngx_uint_t from_upstream);
+#endif
 static void ngx_stream_proxy_next_upstream(ngx_stream_session_t *s);
 static void ngx_stream_proxy_finalize(ngx_stream_session_t *s, ngx_uint_t rc);
 static u_char *ngx_stream_proxy_log_error(ngx_log_t *log, u_char *buf,
@@ -88,6 +93,8 @@ static char *ngx_stream_proxy_pass(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_stream_proxy_bind(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_stream_proxy_splice_check(ngx_conf_t *cf, void *post,
+    void *data);
 
 #if (NGX_STREAM_SSL)
 
@@ -115,6 +122,10 @@ static ngx_conf_bitmask_t  ngx_stream_proxy_ssl_protocols[] = {
 #endif
 
 
+static ngx_conf_post_t  ngx_stream_proxy_splice_post =
+    { ngx_stream_proxy_splice_check };
+
+
 static ngx_conf_deprecated_t  ngx_conf_deprecated_proxy_downstream_buffer = {
     ngx_conf_deprecated, "proxy_downstream_buffer", "proxy_buffer_size"
 };
@@ -147,6 +158,13 @@ static ngx_command_t  ngx_stream_proxy_commands[] = {
       offsetof(ngx_stream_proxy_srv_conf_t, socket_keepalive),
       NULL },
 
+    { ngx_string("proxy_splice"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      offsetof(ngx_stream_proxy_srv_conf_t, splice),
+      &ngx_stream_proxy_splice_post },
+
     { ngx_string("proxy_connect_timeout"),
       NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_msec_slot,
@@ -1556,6 +1574,36 @@ ngx_stream_proxy_process(ngx_stream_session_t *s, ngx_uint_t from_upstream,
         send_action = "proxying and sending to upstream";
     }
 
+#if (NGX_HAVE_SPLICE)
+
+    /*
+     * once all buffered data are sent, a plain tcp connection is switched
+     * to splice() and is not switched back
+     */
+
+    if ((from_upstream ? u->downstream_pipe : u->upstream_pipe)
+        || (pscf->splice
+            && dst
+            && c->type == SOCK_STREAM
+#if (NGX_SSL)
+            && c->ssl == NULL
+            && pc->ssl == NULL
+#endif
+            && *out == NULL
+            && *busy == NULL
+            && !dst->buffered
+            && b->pos == b->last))
+    {
+        if (ngx_stream_proxy_splice(s, from_upstream) != NGX_OK) {
+            ngx_stream_proxy_finalize(s, NGX_STREAM_OK);
+            return;
+        }
+
+        goto done;
+    }
+
+#endif
+
     for ( ;; ) {
 
         if (do_write && dst) {
@@ -1662,6 +1710,10 @@ ngx_stream_proxy_process(ngx_stream_session_t *s, ngx_uint_t from_upstream,
         break;
     }
 
+#if (NGX_HAVE_SPLICE)
+done:
+#endif
+
     c->log->action = "proxying connection";
 
     if (ngx_stream_proxy_test_finalize(s, from_upstream) == NGX_OK) {
@@ -1772,6 +1824,144 @@ ngx_stream_proxy_test_finalize(ngx_stream_session_t *s,
 }
 
 
+#if (NGX_HAVE_SPLICE)
+
+static ngx_int_t
+ngx_stream_proxy_splice(ngx_stream_session_t *s, ngx_uint_t from_upstream)
+{
+    char                   *recv_action, *send_action;
+    off_t                  *received, limit;
+    size_t                  size, limit_rate;
+    ssize_t                 n;
+    ngx_uint_t             *packets;
+    ngx_msec_t              delay;
+    ngx_connection_t       *c, *src, *dst;
+    ngx_splice_pipe_t      *p, **pp;
+    ngx_stream_upstream_t  *u;
+
+    u = s->upstream;
+    c = s->connection;
+
+    if (from_upstream) {
+        src = u->peer.connection;
+        dst = c;
+        pp = &u->downstream_pipe;
+        limit_rate = u->download_rate;
+        received = &u->received;
+        packets = &u->responses;
+        recv_action = "proxying and reading from upstream";
+        send_action = "proxying and sending to client";
+
+    } else {
+        src = c;
+        dst = u->peer.connection;
+        pp = &u->upstream_pipe;
+        limit_rate = u->upload_rate;
+        received = &s->received;
+        packets = &u->requests;
+        recv_action = "proxying and reading from client";
+        send_action = "proxying and sending to upstream";
+    }
+
+    p = *pp;
+
+    if (p == NULL) {
+        p = ngx_splice_pipe_get(c->log);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        *pp = p;
+
+        ngx_log_debug1(NGX_LOG_DEBUG_STREAM, c->log, 0,
+                       "stream proxy splice %s",
+                       from_upstream ? "from upstream" : "to upstream");
+    }
+
+    for ( ;; ) {
+
+        if (p->size && dst->write->ready) {
+            c->log->action = send_action;
+
+            if (ngx_splice_to(dst, p) == NGX_ERROR) {
+                return NGX_ERROR;
+            }
+        }
+
+        size = p->capacity - p->size;
+
+        if (size && src->read->ready && !src->read->delayed
+            && !src->read->error && !src->read->eof)
+        {
+            if (limit_rate) {
+                limit = (off_t) limit_rate * (ngx_time() - u->start_sec + 1)
+                        - *received;
+
+                if (limit <= 0) {
+                    src->read->delayed = 1;
+                    delay = (ngx_msec_t) (- limit * 1000 / limit_rate + 1);
+                    ngx_add_timer(src->read, delay);
+                    break;
+                }
+
+                if ((off_t) size > limit) {
+                    size = (size_t) limit;
+                }
+            }
+
+            c->log->action = recv_action;
+
+            n = ngx_splice_from(src, p, size);
+
+            if (n == NGX_AGAIN) {
+                break;
+            }
+
+            if (n == NGX_ERROR) {
+                src->read->eof = 1;
+                n = 0;
+            }
+
+            if (limit_rate) {
+                delay = (ngx_msec_t) (n * 1000 / limit_rate);
+
+                if (delay > 0) {
+                    src->read->delayed = 1;
+                    ngx_add_timer(src->read, delay);
+                }
+            }
+
+            if (from_upstream && u->state->first_byte_time == (ngx_msec_t) -1)
+            {
+                u->state->first_byte_time = ngx_current_msec - u->start_time;
+            }
+
+            (*packets)++;
+            *received += n;
+
+            if (n) {
+                continue;
+            }
+        }
+
+        break;
+    }
+
+    /* the data left in the pipe keep the connection from being closed */
+
+    if (p->size) {
+        dst->buffered |= NGX_SPLICE_BUFFERED;
+
+    } else {
+        dst->buffered &= ~NGX_SPLICE_BUFFERED;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
 static void
 ngx_stream_proxy_next_upstream(ngx_stream_session_t *s)
 {
@@ -1885,6 +2075,20 @@ ngx_stream_proxy_finalize(ngx_stream_session_t *s, ngx_uint_t rc)
         u->peer.sockaddr = NULL;
     }
 
+#if (NGX_HAVE_SPLICE)
+
+    if (u->upstream_pipe) {
+        ngx_splice_pipe_free(u->upstream_pipe, s->connection->log);
+        u->upstream_pipe = NULL;
+    }
+
+    if (u->downstream_pipe) {
+        ngx_splice_pipe_free(u->downstream_pipe, s->connection->log);
+        u->downstream_pipe = NULL;
+    }
+
+#endif
+
     if (pc) {
         ngx_log_debug1(NGX_LOG_DEBUG_STREAM, s->connection->log, 0,
                        "close stream proxy upstream connection: %d", pc->fd);
@@ -1976,6 +2180,7 @@ ngx_stream_proxy_create_srv_conf(ngx_conf_t *cf)
     conf->proxy_protocol = NGX_CONF_UNSET;
     conf->local = NGX_CONF_UNSET_PTR;
     conf->socket_keepalive = NGX_CONF_UNSET;
+    conf->splice = NGX_CONF_UNSET;
 
 #if (NGX_STREAM_SSL)
     conf->ssl_enable = NGX_CONF_UNSET;
@@ -2034,6 +2239,8 @@ ngx_stream_proxy_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->socket_keepalive,
                               prev->socket_keepalive, 0);
 
+    ngx_conf_merge_value(conf->splice, prev->splice, 0);
+
 #if (NGX_STREAM_SSL)
 
     ngx_conf_merge_value(conf->ssl_enable, prev->ssl_enable, 0);
@@ -2315,3 +2522,22 @@ ngx_stream_proxy_bind(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     return NGX_CONF_OK;
 }
+
+
+static char *
+ngx_stream_proxy_splice_check(ngx_conf_t *cf, void *post, void *data)
+{
+#if !(NGX_HAVE_SPLICE)
+    ngx_flag_t *fp = data;
+
+    if (*fp) {
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "\"proxy_splice\" is not supported, ignored");
+
+        *fp = 0;
+    }
+
+#endif
+
+    return NGX_CONF_OK;
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/perl
+
+# Tests for "aio io_uring" file reads.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'io_uring is linux only') unless $^O eq 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http proxy cache/)->plan(6);
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    proxy_cache_path   %%TESTDIR%%/cache  keys_zone=NAME:1m;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        sendfile        off;
+        aio             io_uring;
+        output_buffers  1 64k;
+
+        location /directio/ {
+            alias      %%TESTDIR%%/;
+            directio   512;
+        }
+
+        location /proxy/ {
+            proxy_pass   http://127.0.0.1:8081/;
+            proxy_cache  NAME;
+            proxy_cache_valid  any 1m;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.html', 'X' x 1048576);
+
+$t->try_run('no aio io_uring');
+
+###############################################################################
+
+like(http_get('/index.html'), qr/SEE-THIS/, 'small');
+
+my $r = http_get('/big.html');
+ok($r =~ /\x0d\x0a\x0d\x0a(X+)$/ && length($1) == 1048576, 'big');
+
+$r = http_get('/directio/big.html');
+ok($r =~ /\x0d\x0a\x0d\x0a(X+)$/ && length($1) == 1048576, 'directio');
+
+like(http_get('/proxy/index.html'), qr/SEE-THIS/, 'proxy');
+like(http_get('/proxy/index.html'), qr/SEE-THIS/, 'cached');
+
+$r = http_get('/proxy/big.html');
+$r = http_get('/proxy/big.html');
+ok($r =~ /\x0d\x0a\x0d\x0a(X+)$/ && length($1) == 1048576, 'cached big');
+
+###############################################################################
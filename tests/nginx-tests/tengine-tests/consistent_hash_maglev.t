@@ -0,0 +1,132 @@
+#!/usr/bin/perl
+
+# Tests for consistent_hash with the maglev algorithm.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(6)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream u {
+        consistent_hash $arg_k algorithm=maglev;
+        server 127.0.0.1:8081 id=1;
+        server 127.0.0.1:8082 id=2;
+        server 127.0.0.1:8083 id=3;
+    }
+
+    upstream d {
+        consistent_hash $arg_k algorithm=maglev;
+        server 127.0.0.1:8081 id=1;
+        server 127.0.0.1:8082 id=2;
+        server 127.0.0.1:8083 id=3;
+        server 127.0.0.1:8084 id=4 max_fails=1 fail_timeout=60s;
+    }
+
+    upstream w {
+        consistent_hash $arg_k algorithm=maglev;
+        server 127.0.0.1:8081 id=1 weight=1;
+        server 127.0.0.1:8082 id=2 weight=3;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /u {
+            proxy_pass http://u/;
+        }
+
+        location /d {
+            proxy_pass http://d/;
+        }
+
+        location /w {
+            proxy_pass http://w/;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        listen       127.0.0.1:8082;
+        listen       127.0.0.1:8083;
+        server_name  localhost;
+
+        location / {
+            root %%TESTDIR%%/$server_port;
+        }
+    }
+}
+
+EOF
+
+for my $p (8081 .. 8083) {
+	mkdir($t->testdir() . '/' . port($p));
+	$t->write_file(port($p) . '/index.html', $p);
+}
+
+$t->run();
+
+###############################################################################
+
+my (%u, %n);
+
+for my $k (1 .. 1500) {
+	$u{$k} = peer("/u?k=$k");
+	$n{$u{$k}}++;
+}
+
+ok(!(grep { $_ < 350 || $_ > 650 } map { $n{$_} // 0 } 8081 .. 8083),
+	'distribution');
+is((grep { peer("/u?k=$_") ne $u{$_} } 1 .. 300), 0, 'same key, same peer');
+
+# the keys of the failed peer move, the other keys stay;
+# as with the ring, a request to the failed peer is not retried
+
+peer("/d?k=$_") for 1 .. 20;
+
+my $moved = grep { peer("/d?k=$_") ne $u{$_} } 1 .. 1500;
+
+is((grep { !/^808[123]$/ } map { peer("/d?k=$_") } 1 .. 100), 0,
+	'failed peer ejected');
+is($moved, 0, 'other keys kept');
+
+%n = ();
+$n{ peer("/w?k=$_") }++ for 1 .. 1000;
+
+cmp_ok($n{8082} // 0, '>', 650, 'weight');
+cmp_ok($n{8082} // 0, '<', 850, 'weight bound');
+
+###############################################################################
+
+sub peer {
+	my ($uri) = @_;
+	my ($p) = http_get($uri) =~ /\x0d\x0a\x0d\x0a(\d+)$/;
+	return $p // 'none';
+}
+
+###############################################################################
@@ -0,0 +1,421 @@
+#!/usr/bin/perl
+
+# Tests for dubbo module, Hessian2 encoding of requests and decoding
+# of responses, bodies in memory and in temporary files, multiplexed
+# backend connections opened on demand.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx qw/ :DEFAULT http_end /;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http dubbo multi_upstream/)->plan(23)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream dubbo {
+        multi 1;
+        server 127.0.0.1:%%PORT_8081%%;
+    }
+
+    upstream serial {
+        multi 1;
+        server 127.0.0.1:%%PORT_8081%%;
+    }
+
+    upstream window {
+        multi 2 min=1 max_inflight=1;
+        server 127.0.0.1:%%PORT_8081%%;
+    }
+
+    upstream idle {
+        multi 1;
+        server 127.0.0.1:%%PORT_8081%%;
+    }
+
+    upstream wait {
+        multi 2 min=1 queue_wait=300ms;
+        server 127.0.0.1:%%PORT_8081%%;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        client_body_buffer_size 1m;
+        dubbo_read_timeout 3s;
+
+        location /mem {
+            dubbo_pass_set X-Utf8 "строка";
+            dubbo_pass_set X-Emoji "a😀b";
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 echo dubbo;
+        }
+
+        location /file {
+            client_body_buffer_size 1k;
+            sendfile off;
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 echo dubbo;
+        }
+
+        location /sendfile {
+            client_body_buffer_size 1k;
+            sendfile on;
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 echo dubbo;
+        }
+
+        add_header X-Depth $multi_upstream_queue_depth;
+        add_header X-Connections $multi_upstream_connections;
+
+        location /serial/slow {
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 slow serial;
+        }
+
+        location /serial/fast {
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 echo serial;
+        }
+
+        location /window/slow {
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 slow window;
+        }
+
+        location /window/fast {
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 echo window;
+        }
+
+        location /idle {
+            dubbo_read_timeout 300ms;
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 echo idle;
+        }
+
+        location /wait/slow {
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 slow wait;
+        }
+
+        location /wait/fast {
+            dubbo_pass org.apache.dubbo.demo.DemoService 1.2.3 echo wait;
+        }
+    }
+}
+
+EOF
+
+$t->run_daemon(\&dubbo_daemon, port(8081));
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+
+###############################################################################
+
+my $small = 'SEE-THIS';
+my $large = join '', map { chr($_ % 251) } 1 .. 100000;
+
+is(body(post('/mem', $small)), $small, 'small body');
+is(body(post('/mem', 'x' x 1000)), 'x' x 1000, 'medium body');
+is(body(post('/mem', $large)), $large, 'chunked body');
+is(body(post('/file', $large)), $large, 'body in file');
+is(body(post('/sendfile', $large)), $large, 'body in file sendfile');
+
+my $r = post('/mem', $small);
+
+like($r, qr/X-Version: 1.2.3\x0d/, 'service version');
+like($r, qr/X-Method: echo\x0d/, 'method');
+like($r, qr/X-Utf8: строка\x0d/, 'utf8 string');
+like($r, qr/X-Emoji: a😀b\x0d/, 'surrogate pair');
+like($r, qr/X-Wide: 😀\x0d/, 'surrogate pair decoded');
+like($r, qr/X-Int: 12345\x0d/, 'int value');
+like($r, qr/X-Long: (x{40000})\x0d/, 'chunked string');
+
+# a single connection, the request waits behind the slow one
+
+my $s = http_post_start('/serial/slow');
+select undef, undef, undef, 0.2;
+$r = post('/serial/fast', $small);
+is(conn($r), conn(http_end($s)), 'serial connection');
+like($r, qr/X-Depth: 1\x0d/, 'serial queue depth');
+
+# the connection has max_inflight requests, another one is opened
+
+$s = http_post_start('/window/slow');
+select undef, undef, undef, 0.2;
+$r = post('/window/fast', $small);
+isnt(conn($r), conn(http_end($s)), 'window connection');
+like($r, qr/X-Depth: 0\x0d/, 'window queue depth');
+like($r, qr/X-Connections: 2\x0d/, 'window connections');
+
+# requests share the connection until one waits for queue_wait
+
+$s = http_post_start('/wait/slow');
+select undef, undef, undef, 0.1;
+my $s2 = http_post_start('/wait/fast');
+select undef, undef, undef, 0.4;
+$r = post('/wait/fast', $small);
+
+my $slow = conn(http_end($s));
+
+is(conn(http_end($s2)), $slow, 'queue wait shared');
+isnt(conn($r), $slow, 'queue wait connection');
+like($r, qr/X-Connections: 2\x0d/, 'queue wait connections');
+
+# the window is not kept when no more connections may be opened
+
+$s = http_post_start('/window/slow');
+$s2 = http_post_start('/window/slow');
+select undef, undef, undef, 0.2;
+$r = post('/window/fast', $small);
+http_end($s);
+http_end($s2);
+like($r, qr/X-Depth: 1\x0d/, 'window exceeded');
+
+# an idle connection outlives read_timeout
+
+my $idle = conn(post('/idle', $small));
+select undef, undef, undef, 0.6;
+$r = post('/idle', $small);
+
+is(body($r), $small, 'idle connection');
+is(conn($r), $idle, 'idle connection kept');
+
+###############################################################################
+
+sub post {
+	my ($uri, $body) = @_;
+
+	return http(<<EOF . $body);
+POST $uri HTTP/1.0
+Host: localhost
+Content-Length: @{[ length $body ]}
+
+EOF
+}
+
+sub http_post_start {
+	my ($uri) = @_;
+	return http(<<EOF, start => 1);
+POST $uri HTTP/1.0
+Host: localhost
+Content-Length: 0
+
+EOF
+}
+
+sub conn {
+	my ($r) = @_;
+	return '' unless defined $r;
+	my ($c) = $r =~ /X-Conn: (\d+)/;
+	return $c // '';
+}
+
+sub body {
+	my ($r) = @_;
+	return '' unless defined $r;
+	$r =~ s/.*?\x0d\x0a\x0d\x0a//s;
+	return $r;
+}
+
+sub chars {
+	my ($s) = @_;
+	my ($n, $i) = (0, 0);
+
+	# a 4 bytes sequence is a surrogate pair of 2 characters
+
+	while ($i < length $s) {
+		my $c = ord(substr($s, $i, 1));
+		$i += $c < 0x80 ? 1 : ($c & 0xe0) == 0xc0 ? 2
+			: ($c & 0xf0) == 0xe0 ? 3 : 4;
+		$n += $c >= 0xf0 ? 2 : 1;
+	}
+
+	return $n;
+}
+
+sub bytes {
+	my ($s, $n) = @_;
+	my $i = 0;
+
+	while ($n > 0) {
+		my $c = ord(substr($s, $i, 1));
+		$i += $c < 0x80 ? 1 : ($c & 0xe0) == 0xc0 ? 2
+			: ($c & 0xf0) == 0xe0 ? 3 : 4;
+		$n -= $c >= 0xf0 ? 2 : 1;
+	}
+
+	return $i;
+}
+
+sub decode {
+	my ($s) = @_;
+
+	my $tag = ord(substr($$s, 0, 1, ''));
+
+	return undef if $tag == 0x4e;
+
+	if ($tag == 0x48) {
+		my %m;
+		while (substr($$s, 0, 1) ne 'Z') {
+			my $k = decode($s);
+			$m{$k} = decode($s);
+		}
+		substr($$s, 0, 1, '');
+		return \%m;
+	}
+
+	my ($len, $string, $final) = (0, 0, 1);
+
+	if ($tag <= 0x1f) {
+		($len, $string) = ($tag, 1);
+
+	} elsif ($tag <= 0x2f) {
+		$len = $tag - 0x20;
+
+	} elsif ($tag <= 0x37) {
+		$string = $tag <= 0x33;
+		$len = (($tag - ($string ? 0x30 : 0x34)) << 8)
+			+ ord(substr($$s, 0, 1, ''));
+
+	} elsif (chr($tag) =~ /[SRBA]/) {
+		$len = unpack('n', substr($$s, 0, 2, ''));
+		$string = chr($tag) =~ /[SR]/;
+		$final = chr($tag) =~ /[SB]/;
+
+	} else {
+		die sprintf("unknown tag 0x%02x", $tag);
+	}
+
+	$len = bytes($$s, $len) if $string;
+
+	my $v = substr($$s, 0, $len, '');
+	$v .= decode($s) unless $final;
+
+	return $v;
+}
+
+sub encode_str {
+	my ($s) = @_;
+	my $out = '';
+
+	while (chars($s) > 0x8000) {
+		my $n = bytes($s, 0x8000);
+		$out .= 'R' . pack('n', 0x8000) . substr($s, 0, $n, '');
+	}
+
+	my $n = chars($s);
+
+	return $out . chr($n) . $s if $n <= 31;
+	return $out . chr(0x30 + ($n >> 8)) . chr($n & 0xff) . $s if $n <= 1023;
+	return $out . 'S' . pack('n', $n) . $s;
+}
+
+sub encode_bin {
+	my ($s) = @_;
+	my $out = '';
+
+	while (length($s) > 0x8000) {
+		$out .= 'A' . pack('n', 0x8000) . substr($s, 0, 0x8000, '');
+	}
+
+	my $n = length $s;
+
+	return $out . chr(0x20 + $n) . $s if $n <= 15;
+	return $out . chr(0x34 + ($n >> 8)) . chr($n & 0xff) . $s if $n <= 1023;
+	return $out . 'B' . pack('n', $n) . $s;
+}
+
+sub dubbo_daemon {
+	my ($port) = @_;
+
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . $port,
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+	local $SIG{CHLD} = 'IGNORE';
+
+	while (my $client = $server->accept()) {
+		if (fork()) {
+			close $client;
+			next;
+		}
+
+		$client->autoflush(1);
+
+		while (1) {
+			my $header = read_n($client, 16);
+			last unless defined $header;
+
+			my ($flag, $id, $len) = unpack('x2 C x Q> N', $header);
+			my $payload = read_n($client, $len);
+			last unless defined $payload;
+
+			# heartbeat
+
+			next if $flag & 0x20;
+
+			my @v = map { decode(\$payload) } 1 .. 6;
+			my ($version, $method, $args) = @v[2, 3, 5];
+
+			my $body = delete $args->{body} // '';
+
+			select undef, undef, undef, 1 if $method eq 'slow';
+
+			my $map = 'H'
+				. encode_str('body') . encode_bin($body)
+				. encode_str('status') . encode_str('200')
+				. encode_str('X-Version') . encode_str($version)
+				. encode_str('X-Method') . encode_str($method)
+				. encode_str('X-Conn') . encode_str("$$")
+				. encode_str('X-Wide') . encode_str("\xf0\x9f\x98\x80")
+				. encode_str('X-Int') . "\xd4\x30\x39"
+				. encode_str('X-Long') . encode_str('x' x 40000);
+
+			for my $k (sort keys %$args) {
+				$map .= encode_str($k) . encode_str($args->{$k});
+			}
+
+			$map .= 'Z';
+
+			my $data = "\x94" . $map . 'HZ';
+
+			print $client pack('CCCC Q> N', 0xda, 0xbb, 0x02, 20, $id,
+				length $data) . $data;
+		}
+
+		close $client;
+		exit 0;
+	}
+}
+
+sub read_n {
+	my ($client, $n) = @_;
+	my $buf = '';
+
+	while (length($buf) < $n) {
+		$client->sysread($buf, $n - length($buf), length $buf) or return;
+	}
+
+	return $buf;
+}
+
+###############################################################################
@@ -0,0 +1,216 @@
+#!/usr/bin/perl
+
+# Tests for dynamic resolve in upstream module, names are refreshed by
+# a timer when their answers expire and requests never wait on the resolver.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Time::HiRes qw/ sleep time /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(8)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    resolver 127.0.0.1:%%PORT_8981_UDP%% ipv6=off;
+    resolver_timeout 1s;
+
+    upstream u {
+        dynamic_resolve;
+        server localhost:%%PORT_8081%%;
+    }
+
+    upstream stale {
+        dynamic_resolve fallback=stale;
+        server localhost:%%PORT_8081%%;
+    }
+
+    upstream shutdown {
+        dynamic_resolve fallback=shutdown;
+        server localhost:%%PORT_8081%%;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /u {
+            proxy_pass http://u/;
+        }
+
+        location /stale {
+            proxy_pass http://stale/;
+        }
+
+        location /shutdown {
+            proxy_pass http://shutdown/;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:%%PORT_8081%%;
+        listen       127.0.0.2:%%PORT_8081%%;
+        listen       127.0.0.3:%%PORT_8081%%;
+        server_name  localhost;
+
+        add_header X-Addr $server_addr;
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+
+my $d = $t->testdir();
+
+$t->write_file('addrs', '127.0.0.2 127.0.0.3');
+
+$t->run_daemon(\&dns_daemon, port(8981), $d);
+$t->waitforfile("$d/" . port(8981));
+$t->run();
+
+sleep(0.5);
+
+###############################################################################
+
+# all addresses of the name are used
+
+is(join(' ', sort keys %{{ map { addr('/u') => 1 } 1 .. 10 }}),
+	'127.0.0.2 127.0.0.3', 'addresses expanded');
+
+# the set is swapped when the answer expires
+
+$t->write_file('addrs', '127.0.0.3');
+
+sleep(2.5);
+
+is(join(' ', sort keys %{{ map { addr('/u') => 1 } 1 .. 10 }}),
+	'127.0.0.3', 'addresses refreshed');
+
+# requests do not wait for a slow name server
+
+$t->write_file('delay', '');
+
+my $max = 0;
+
+for (1 .. 10) {
+	my $start = time();
+	addr('/u');
+	$max = time() - $start if time() - $start > $max;
+	sleep(0.2);
+}
+
+cmp_ok($max, "<", 0.4, 'no resolve in requests');
+
+unlink("$d/delay");
+
+like($t->read_file('error.log'), qr/resolved to 1 addresses.*changes:2/,
+	'changes counted');
+
+# refresh fails
+
+$t->write_file('drop', '');
+
+sleep(4);
+
+is(addr('/stale'), '127.0.0.1', 'fallback stale');
+like(http_get('/shutdown'), qr/502 Bad Gateway/, 'fallback shutdown');
+like(http_get('/u'), qr/502 Bad Gateway/, 'fallback next');
+
+like($t->read_file('error.log'), qr/could not be resolved.*failures:1/,
+	'failures counted');
+
+###############################################################################
+
+sub addr {
+	my ($uri) = @_;
+	my ($a) = (http_get($uri) // '') =~ /X-Addr: ([\d.]+)/;
+	return $a // 'none';
+}
+
+sub reply_handler {
+	my ($recv_data, $d) = @_;
+
+	my (@name, $rdata);
+
+	use constant A		=> 1;
+	use constant IN		=> 1;
+
+	# decode name
+
+	my ($len, $offset) = (undef, 12);
+	while (1) {
+		$len = unpack("\@$offset C", $recv_data);
+		last if $len == 0;
+		$offset++;
+		push @name, unpack("\@$offset A$len", $recv_data);
+		$offset += $len;
+	}
+
+	$offset -= 1;
+	my ($id, $type, $class) = unpack("n x$offset n2", $recv_data);
+
+	return unless $type == A && $name[0] eq 'localhost';
+	return if -e "$d/drop";
+
+	sleep(0.6) if -e "$d/delay";
+
+	open my $fh, '<', "$d/addrs";
+	my @addrs = split ' ', <$fh>;
+	close $fh;
+
+	$rdata = join '', map { pack 'n3N nC4', 0xc00c, A, IN, 1, 4, split /\./ }
+		@addrs;
+
+	$len = @name;
+	return pack("n6 (C/a*)$len x n2", $id, 0x8180, 1, scalar @addrs, 0, 0,
+		@name, $type, $class) . $rdata;
+}
+
+sub dns_daemon {
+	my ($port, $d) = @_;
+
+	my ($data, $recv_data);
+	my $socket = IO::Socket::INET->new(
+		LocalAddr => '127.0.0.1',
+		LocalPort => $port,
+		Proto => 'udp',
+	)
+		or die "Can't create listening socket: $!\n";
+
+	# signal we are ready
+
+	open my $fh, '>', "$d/$port";
+	close $fh;
+
+	while (1) {
+		$socket->recv($recv_data, 65536);
+		$data = reply_handler($recv_data, $d);
+		$socket->send($data) if defined $data;
+	}
+}
+
+###############################################################################
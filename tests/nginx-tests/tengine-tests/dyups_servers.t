@@ -0,0 +1,157 @@
+#!/usr/bin/perl
+
+# Tests for dyups server changes, add, remove and set of single servers.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Time::HiRes qw/ sleep /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(15)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+worker_processes 2;
+
+events {
+    accept_mutex off;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    dyups_read_msg_timeout 1h;
+
+    upstream static {
+        server 127.0.0.1:8082;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass http://$arg_u;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location / {
+            dyups_interface;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8082;
+        server_name  localhost;
+        root         %%TESTDIR%%/a;
+    }
+
+    server {
+        listen       127.0.0.1:8083;
+        server_name  localhost;
+        root         %%TESTDIR%%/b;
+    }
+}
+
+EOF
+
+mkdir($t->testdir() . '/a');
+mkdir($t->testdir() . '/b');
+
+$t->write_file('a/index.html', 'A');
+$t->write_file('b/index.html', 'B');
+
+$t->run();
+
+###############################################################################
+
+my $a = port(8082);
+my $b = port(8083);
+
+like(post('/upstream/dy', "server 127.0.0.1:$a;"), qr/success/, 'upstream');
+
+# other workers are notified at once, without waiting for the timer
+
+is(seen(), 'A', 'upstream synced');
+
+like(post('/upstream/dy/add', "server 127.0.0.1:$b;"), qr/success/, 'add');
+is(seen(), 'AB', 'add synced');
+like(get('/upstream/dy'), qr/$b/, 'add listed');
+
+like(post('/upstream/dy/set', "server 127.0.0.1:$b down;"), qr/success/,
+	'set');
+is(seen(), 'A', 'set synced');
+
+like(post('/upstream/dy/set', "server 127.0.0.1:$b;"), qr/success/, 'set up');
+like(post('/upstream/dy/remove', "server 127.0.0.1:$a;"), qr/success/,
+	'remove');
+is(seen(), 'B', 'remove synced');
+unlike(get('/upstream/dy'), qr/$a/, 'remove listed');
+
+like(post('/upstream/dy/add', "server 127.0.0.1:$b;"), qr/409/, 'add exists');
+like(post('/upstream/dy/remove', "server 127.0.0.1:$a;"), qr/404/,
+	'remove missing');
+like(post('/upstream/dy/remove', "server 127.0.0.1:$b;"), qr/400/,
+	'remove last');
+like(post('/upstream/static/add', "server 127.0.0.1:$b;"), qr/405/,
+	'static upstream');
+
+###############################################################################
+
+sub seen {
+	my %seen;
+
+	# let the other worker read its channel
+
+	sleep(0.2);
+
+	for (1 .. 20) {
+		my ($c) = http_get('/?u=dy') =~ /\x0d\x0a\x0d\x0a([AB])$/;
+		$seen{$c // 'X'} = 1;
+	}
+
+	return join '', sort keys %seen;
+}
+
+sub get {
+	my ($uri) = @_;
+	return http_get($uri, socket => IO::Socket::INET->new(
+		PeerAddr => '127.0.0.1:' . port(8081)));
+}
+
+sub post {
+	my ($uri, $body) = @_;
+	my $len = length($body);
+
+	return http(<<EOF, socket => IO::Socket::INET->new(
+POST $uri HTTP/1.0
+Host: localhost
+Content-Length: $len
+
+$body
+EOF
+		PeerAddr => '127.0.0.1:' . port(8081)));
+}
+
+###############################################################################
@@ -0,0 +1,80 @@
+#!/usr/bin/perl
+
+# Tests for the io_uring event method.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'io_uring is linux only') unless $^O eq 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(5);
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+events {
+    use io_uring;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream u {
+        server 127.0.0.1:8081;
+        keepalive 4;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /proxy/ {
+            proxy_pass http://u/;
+            proxy_http_version 1.1;
+            proxy_set_header Connection "";
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.html', 'X' x 1048576);
+
+$t->run();
+
+###############################################################################
+
+like(http_get('/index.html'), qr/SEE-THIS/, 'static');
+like(http_get('/proxy/index.html'), qr/SEE-THIS/, 'proxy');
+like(http_get('/proxy/index.html'), qr/SEE-THIS/, 'proxy keepalive');
+
+my $r = http_get('/big.html');
+ok($r =~ /\x0d\x0a\x0d\x0a(X+)$/ && length($1) == 1048576, 'big response');
+
+$r = http_get('/proxy/big.html');
+ok($r =~ /\x0d\x0a\x0d\x0a(X+)$/ && length($1) == 1048576, 'big proxied');
+
+###############################################################################
@@ -0,0 +1,181 @@
+#!/usr/bin/perl
+
+# Tests for memcached module, keys of concurrent requests batched into
+# one multi-key "get" over multiplexed backend connections.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx qw/ :DEFAULT http_end /;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http memcached map multi_upstream/)
+	->plan(11)->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    map $uri $memcached_key {
+        default  $uri;
+    }
+
+    upstream u {
+        multi 1;
+        server 127.0.0.1:%%PORT_8081%%;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        memcached_read_timeout 3s;
+
+        location / {
+            memcached_pass u;
+            memcached_batch 8 window=200ms;
+        }
+
+        location /full/ {
+            memcached_pass u;
+            memcached_batch 2 window=10s;
+        }
+
+        location /now/ {
+            memcached_pass u;
+            memcached_batch 8;
+        }
+
+        location /off/ {
+            memcached_pass 127.0.0.1:%%PORT_8081%%;
+            memcached_batch off;
+        }
+    }
+}
+
+EOF
+
+my $d = $t->testdir();
+
+$t->run_daemon(\&memcached_daemon, port(8081), $d);
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+
+###############################################################################
+
+like(http_get('/now/a'), qr/200 OK.*value of \/now\/a$/s, 'single key');
+like(http_get('/now/miss'), qr/404 Not Found/, 'miss');
+is(length(body(http_get('/now/large'))), 100000, 'large value');
+like(http_get('/off/a'), qr/value of \/off\/a$/, 'batch off');
+
+# keys of concurrent requests are sent in one "get"
+
+my @s = map { http_get("/b$_", start => 1) } 1 .. 3;
+my @r = map { http_end($_) } @s;
+
+like($r[0], qr/value of \/b1$/, 'batch first');
+like($r[1], qr/value of \/b2$/, 'batch second');
+like($r[2], qr/value of \/b3$/, 'batch third');
+like($t->read_file('gets'), qr/^get( \/b\d){3}$/m, 'batch coalesced');
+
+# misses in the middle of a batch
+
+@s = map { http_get($_, start => 1) } qw(/c1 /miss /c2);
+@r = map { http_end($_) } @s;
+
+is(join(' ', map { /^HTTP\/1.1 (\d+)/ ? $1 : 'none' } @r), '200 404 200',
+	'batch miss');
+
+# the batch is sent as soon as it is full
+
+@s = map { http_get("/full/$_", start => 1) } 1 .. 2;
+@r = map { http_end($_) } @s;
+
+is(scalar(grep { /value of \/full\/\d$/ } @r), 2, 'batch full');
+
+# an error answers the keys of the batch
+
+like(http_get('/now/error'), qr/502 Bad Gateway/, 'error');
+
+###############################################################################
+
+sub body {
+	my ($r) = @_;
+	return '' unless defined $r;
+	$r =~ s/.*?\x0d\x0a\x0d\x0a//s;
+	return $r;
+}
+
+sub memcached_daemon {
+	my ($port, $d) = @_;
+
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . $port,
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+	local $SIG{CHLD} = 'IGNORE';
+
+	while (my $client = $server->accept()) {
+		if (fork()) {
+			close $client;
+			next;
+		}
+
+		$client->autoflush(1);
+
+		while (my $line = <$client>) {
+			$line =~ s/\x0d?\x0a$//;
+
+			open my $fh, '>>', "$d/gets";
+			print $fh "$line\n";
+			close $fh;
+
+			my ($cmd, @keys) = split / /, $line;
+			last unless $cmd eq 'get';
+
+			my $out = '';
+
+			for my $key (@keys) {
+				next if $key =~ /miss/;
+
+				if ($key =~ /error/) {
+					$out .= "SERVER_ERROR failed\x0d\x0a";
+					last;
+				}
+
+				my $v = $key =~ /large/ ? 'x' x 100000 : "value of $key";
+				$out .= "VALUE $key 0 " . length($v) . "\x0d\x0a$v\x0d\x0a";
+			}
+
+			$out .= "END\x0d\x0a" unless $out =~ /ERROR/;
+
+			print $client $out;
+		}
+
+		close $client;
+		exit 0;
+	}
+}
+
+###############################################################################
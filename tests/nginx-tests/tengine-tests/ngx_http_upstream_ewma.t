@@ -0,0 +1,170 @@
+#!/usr/bin/perl
+
+# Copyright (C) 2010-2019 Alibaba Group Holding Limited
+
+# Tests for upstream ewma balancer module.  One backend is slow but never
+# loaded, least_conn keeps sending it every other request, while ewma
+# learns its response time and moves the traffic off it.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Time::HiRes qw/ time /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy upstream_zone ewma/)
+	->has(qw/upstream_least_conn/)->plan(5)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+worker_processes 2;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream least_conn {
+        least_conn;
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+    }
+
+    upstream ewma {
+        ewma;
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+    }
+
+    upstream zone {
+        zone z 64k;
+        ewma decay=30s;
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+    }
+
+    upstream fast {
+        ewma;
+        server 127.0.0.1:8082;
+        server 127.0.0.1:8083;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass http:/$uri;
+        }
+    }
+}
+
+EOF
+
+$t->run_daemon(\&http_daemon, port(8081), 0.3);
+$t->run_daemon(\&http_daemon, port(8082), 0);
+$t->run_daemon(\&http_daemon, port(8083), 0);
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+$t->waitforsocket('127.0.0.1:' . port(8082));
+$t->waitforsocket('127.0.0.1:' . port(8083));
+
+###############################################################################
+
+my $lc = p90('/least_conn');
+
+cmp_ok($lc, '>=', 0.3, 'least_conn tail latency');
+
+# the slow peer is tried once per worker, then avoided
+
+cmp_ok(p90('/ewma'), '<', 0.3, 'ewma tail latency');
+cmp_ok(p90('/zone'), '<', 0.3, 'ewma tail latency in zone');
+
+my %p = map { peer(http_get('/fast')) => 1 } 1 .. 20;
+is(keys %p, 2, 'equal peers balanced');
+
+my $fast = port(8082);
+like(http_get('/ewma'), qr/X-Port: $fast/, 'fast peer kept');
+
+###############################################################################
+
+sub p90 {
+	my ($uri) = @_;
+	my @t;
+
+	for (1 .. 20) {
+		my $start = time();
+		http_get($uri);
+		push @t, time() - $start;
+	}
+
+	@t = sort { $a <=> $b } @t;
+
+	return $t[17];
+}
+
+sub peer {
+	my ($r) = @_;
+	my ($p) = ($r // '') =~ /X-Port: (\d+)/;
+	return $p // 'none';
+}
+
+sub http_daemon {
+	my ($port, $delay) = @_;
+
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . $port,
+		Listen => 16,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+	local $SIG{CHLD} = 'IGNORE';
+
+	while (my $client = $server->accept()) {
+		if (fork()) {
+			close $client;
+			next;
+		}
+
+		$client->autoflush(1);
+
+		while (<$client>) {
+			last if /^\x0d?\x0a?$/;
+		}
+
+		select(undef, undef, undef, $delay) if $delay;
+
+		print $client <<EOF;
+HTTP/1.1 200 OK
+X-Port: $port
+Connection: close
+Content-Length: 2
+
+ok
+EOF
+
+		close $client;
+		exit 0;
+	}
+}
+
+###############################################################################
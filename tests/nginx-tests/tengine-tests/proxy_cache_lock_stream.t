@@ -0,0 +1,215 @@
+#!/usr/bin/perl
+
+# Tests for proxy_cache_lock_stream, requests waiting for a cache lock
+# follow the response being cached.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Select;
+use Time::HiRes qw/ time sleep /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy cache/)->plan(9)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    proxy_cache_path   %%TESTDIR%%/cache  levels=1:2
+                       keys_zone=NAME:1m;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass    http://127.0.0.1:8081;
+            proxy_cache   NAME;
+
+            proxy_cache_lock         on;
+            proxy_cache_lock_stream  on;
+            proxy_cache_lock_timeout 10s;
+        }
+    }
+}
+
+EOF
+
+my $part = 'x' x 19999 . "\n";
+
+$t->run_daemon(\&http_slow_daemon);
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+
+###############################################################################
+
+my $s1 = http_get('/slow', start => 1);
+
+sleep(0.5);
+
+my $start = time();
+my $s2 = http_get('/slow', start => 1);
+
+my ($first, $r2) = read_response($s2);
+my $r1 = join('', $s1->getlines());
+
+cmp_ok($first - $start, '<', 1.5, 'first bytes before the fill is done');
+like($r2, qr/X-Num: 1\x0d?$/m, 'same response');
+is(body($r2), $part x 10, 'streamed body');
+is(body($r1), $part x 10, 'first body');
+
+like(http_get('/slow'), qr/X-Num: 1\x0d?$/m, 'cached');
+
+# a broken response is not completed for the following requests
+
+$s1 = http_get('/broken', start => 1);
+
+sleep(0.5);
+
+$s2 = http_get('/broken', start => 1);
+
+(undef, $r2) = read_response($s2);
+$r1 = join('', $s1->getlines());
+
+like($r2, qr/200 OK/, 'broken header');
+cmp_ok(length(body($r2)), '<', 10 * length($part), 'broken truncated');
+
+like(http_get('/broken'), qr/X-Num: 2\x0d?$/m, 'broken not cached');
+
+# followers of a response with an unknown length
+
+$s1 = http_get('/chunked', start => 1);
+
+sleep(0.5);
+
+$s2 = http_get('/chunked', start => 1);
+(undef, $r2) = read_response($s2);
+$r1 = join('', $s1->getlines());
+
+is(body(dechunk($r2)), $part x 10, 'chunked');
+
+###############################################################################
+
+sub read_response {
+	my ($s) = @_;
+
+	my ($first, $r, $buf) = (undef, '');
+	my $sel = IO::Select->new($s);
+
+	while ($sel->can_read(5)) {
+		my $n = $s->sysread($buf, 65536);
+		last unless $n;
+
+		$r .= $buf;
+		$first = time() if !defined $first && $r =~ /\x0d\x0a\x0d\x0ax/;
+	}
+
+	return ($first, $r);
+}
+
+sub body {
+	my ($r) = @_;
+	return '' unless defined $r;
+	$r =~ s/.*?\x0d\x0a\x0d\x0a//s;
+	return $r;
+}
+
+sub dechunk {
+	my ($r) = @_;
+	my ($head, $body) = $r =~ /(.*?\x0d\x0a\x0d\x0a)(.*)/s;
+	return $r unless $r =~ /Transfer-Encoding: chunked/i;
+
+	my $out = '';
+
+	while ($body =~ s/^([0-9a-f]+)\x0d\x0a//i) {
+		my $len = hex($1);
+		last if $len == 0;
+		$out .= substr($body, 0, $len, '');
+		$body =~ s/^\x0d\x0a//;
+	}
+
+	return $head . $out;
+}
+
+###############################################################################
+
+sub http_slow_daemon {
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . port(8081),
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+
+	my %num;
+
+	while (my $client = $server->accept()) {
+		$client->autoflush(1);
+
+		my $uri = '';
+
+		while (<$client>) {
+			$uri = $1 if /GET (.*) HTTP/;
+			last if /^\x0d?\x0a?$/;
+		}
+
+		next if $uri eq '';
+
+		my $n = ++$num{$uri};
+		my $length = 10 * length($part);
+
+		if ($uri eq '/chunked') {
+			print $client <<"EOF";
+HTTP/1.1 200 OK
+Cache-Control: max-age=300
+X-Num: $n
+Connection: close
+
+EOF
+
+		} else {
+			print $client <<"EOF";
+HTTP/1.1 200 OK
+Cache-Control: max-age=300
+Content-Length: $length
+X-Num: $n
+Connection: close
+
+EOF
+		}
+
+		for my $i (1 .. 10) {
+			last if $uri eq '/broken' && $i > 5 && $n == 1;
+
+			sleep(0.2);
+			print $client $part;
+		}
+
+		close $client;
+	}
+}
+
+###############################################################################
@@ -0,0 +1,99 @@
+#!/usr/bin/perl
+
+# Tests for the "memory_zone" parameter of proxy_cache_path.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use File::Find;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy cache/)->plan(8);
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    proxy_cache_path  %%TESTDIR%%/cache  keys_zone=NAME:1m
+                      memory_zone=MEM:256k;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass         http://127.0.0.1:8081;
+            proxy_cache        NAME;
+            proxy_cache_valid  any 1h;
+
+            add_header  X-Cache-Status  $upstream_cache_status;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+$t->write_file('hot.html', 'SEE-THIS');
+$t->write_file('cold.html', 'SEE-THAT');
+$t->write_file('big.html', 'x' x 40000);
+
+$t->run();
+
+###############################################################################
+
+like(http_get('/hot.html'), qr/MISS.*SEE-THIS/s, 'miss');
+like(http_get('/hot.html'), qr/HIT.*SEE-THIS/s, 'hit');
+like(http_get('/hot.html'), qr/HIT.*SEE-THIS/s, 'hit again');
+
+http_get('/cold.html');
+http_get('/cold.html');
+
+http_get('/big.html') for 1 .. 4;
+
+# objects admitted to the memory zone are served without the cache files
+
+find({ wanted => sub { unlink if -f }, no_chdir => 1 },
+	$t->testdir() . '/cache');
+
+like(http_get('/hot.html'), qr/HIT.*SEE-THIS/s, 'memory hit');
+like(http_get('/hot.html'), qr/HIT.*SEE-THIS/s, 'memory hit again');
+
+like(http(<<EOF), qr/206 Partial.*\x0d\x0a\x0d\x0aE-TH$/s, 'memory range');
+GET /hot.html HTTP/1.0
+Host: localhost
+Range: bytes=2-5
+
+EOF
+
+# an object hit only once is not admitted, a large one does not fit
+
+like(http_get('/cold.html'), qr/MISS.*SEE-THAT/s, 'not admitted');
+like(http_get('/big.html'), qr/MISS/, 'too large');
+
+###############################################################################
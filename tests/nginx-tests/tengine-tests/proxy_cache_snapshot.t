@@ -0,0 +1,99 @@
+#!/usr/bin/perl
+
+# Tests for the "snapshot" parameter of proxy_cache_path.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy cache/)->plan(7);
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    proxy_cache_path  %%TESTDIR%%/cache  keys_zone=NAME:1m
+                      snapshot=%%TESTDIR%%/cache.snap  snapshot_interval=1s;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass         http://127.0.0.1:8081;
+            proxy_cache        NAME;
+            proxy_cache_valid  any 1h;
+
+            add_header  X-Cache-Status  $upstream_cache_status;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+$t->write_file('t1.html', 'SEE-THIS');
+$t->write_file('t2.html', 'SEE-THAT');
+
+# a snapshot which cannot be verified is ignored
+
+$t->write_file('cache.snap', 'garbage');
+
+$t->run();
+
+###############################################################################
+
+like(http_get('/t1.html'), qr/MISS.*SEE-THIS/s, 'miss');
+like(http_get('/t1.html'), qr/HIT.*SEE-THIS/s, 'hit');
+like(http_get('/t2.html'), qr/MISS.*SEE-THAT/s, 'miss 2');
+
+like($t->read_file('error.log'), qr/snapshot .* is invalid, ignored/,
+	'invalid snapshot');
+
+SKIP: {
+skip 'long test', 3 unless $ENV{TEST_NGINX_UNSAFE};
+
+# the snapshot is written once the cache loader is done
+
+sleep 65;
+
+$t->stop();
+
+like($t->read_file('error.log'), qr/snapshot .*: 2 entries saved/, 'saved');
+
+unlink $t->testdir() . '/t1.html';
+
+$t->run();
+
+like($t->read_file('error.log'), qr/snapshot .*: 2 entries loaded/,
+	'loaded');
+like(http_get('/t1.html'), qr/HIT.*SEE-THIS/s, 'hit after restart');
+
+}
+
+###############################################################################
@@ -0,0 +1,201 @@
+#!/usr/bin/perl
+
+# Tests for proxy_pipelining, requests sent one after another over
+# a connection of a multi upstream before the responses come.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx qw/ :DEFAULT http_end /;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy multi_upstream/)->plan(12)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream u {
+        multi 1;
+        server 127.0.0.1:%%PORT_8081%%;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        proxy_http_version 1.1;
+        proxy_set_header Connection "";
+        proxy_read_timeout 3s;
+
+        location / {
+            proxy_pipelining on;
+            proxy_pass http://u;
+        }
+    }
+}
+
+EOF
+
+$t->run_daemon(\&http_daemon, port(8081));
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+
+###############################################################################
+
+is(body(http_get('/fast')), 'fast', 'response');
+is(body(http_get('/chunked')), 'chunked', 'chunked response');
+like(http_get('/nocontent'), qr/ 204 /, 'no content');
+like(http_head('/fast'), qr/200 OK(?!.*fast)/s, 'head');
+is(body(http_get('/fast')), 'fast', 'response after head');
+
+# the request is sent before the slow response comes
+
+my $s = http_get('/slow', start => 1);
+select undef, undef, undef, 0.2;
+my $r = http_get('/fast');
+my $slow = http_end($s);
+
+is(body($slow), 'slow', 'slow response');
+is(conn($r), conn($slow), 'pipelined');
+
+# the response to a request closed by the client is dropped
+
+$s = http_get('/slow', start => 1);
+select undef, undef, undef, 0.2;
+close $s;
+is(body(http_get('/fast')), 'fast', 'response after dropped');
+
+# requests with a body use a connection of their own
+
+$s = http_get('/slow', start => 1);
+select undef, undef, undef, 0.2;
+$r = http(<<EOF);
+POST /fast HTTP/1.0
+Host: localhost
+Content-Length: 4
+
+body
+EOF
+$slow = http_end($s);
+
+is(body($r), 'fast', 'request with body');
+isnt(conn($r), conn($slow), 'request with body not pipelined');
+
+# the connection closed by the upstream is not used again
+
+my $c = conn(http_get('/close'));
+$r = http_get('/fast');
+
+is(body($r), 'fast', 'response after close');
+isnt(conn($r), $c, 'new connection after close');
+
+###############################################################################
+
+sub body {
+	my ($r) = @_;
+	return '' unless defined $r;
+	$r =~ s/.*?\x0d\x0a\x0d\x0a//s;
+	return $r;
+}
+
+sub conn {
+	my ($r) = @_;
+	return '' unless defined $r;
+	my ($c) = $r =~ /X-Conn: (\d+)/;
+	return $c // '';
+}
+
+sub http_daemon {
+	my ($port) = @_;
+
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . $port,
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+	local $SIG{CHLD} = 'IGNORE';
+
+	while (my $client = $server->accept()) {
+		if (fork()) {
+			close $client;
+			next;
+		}
+
+		$client->autoflush(1);
+
+		while (1) {
+			my $headers = '';
+
+			while (<$client>) {
+				$headers .= $_;
+				last if (/^\x0d?\x0a?$/);
+			}
+
+			last unless $headers;
+
+			my ($method, $uri) = $headers =~ /^(\S+) (\S+)/;
+			my ($len) = $headers =~ /Content-Length: (\d+)/i;
+
+			read($client, my $b, $len) if $len;
+
+			my $h = "X-Conn: $$\x0d\x0a";
+			my $body = '';
+
+			if ($uri eq '/slow') {
+				select undef, undef, undef, 0.5;
+				$body = 'slow';
+
+			} elsif ($uri eq '/chunked') {
+				print $client "HTTP/1.1 200 OK\x0d\x0a$h"
+					. "Transfer-Encoding: chunked\x0d\x0a\x0d\x0a"
+					. "3\x0d\x0achu\x0d\x0a4\x0d\x0anked\x0d\x0a"
+					. "0\x0d\x0a\x0d\x0a";
+				next;
+
+			} elsif ($uri eq '/nocontent') {
+				print $client "HTTP/1.1 204 No Content\x0d\x0a$h\x0d\x0a";
+				next;
+
+			} elsif ($uri eq '/close') {
+				$h .= "Connection: close\x0d\x0a";
+				$body = 'close';
+
+			} else {
+				$body = 'fast';
+			}
+
+			print $client "HTTP/1.1 200 OK\x0d\x0a$h"
+				. "Content-Length: " . length($body) . "\x0d\x0a\x0d\x0a"
+				. ($method eq 'HEAD' ? '' : $body);
+
+			last if $uri eq '/close';
+		}
+
+		close $client;
+		exit 0;
+	}
+}
+
+###############################################################################
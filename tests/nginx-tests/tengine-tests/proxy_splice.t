@@ -0,0 +1,115 @@
+#!/usr/bin/perl
+
+# Tests for splice() of unbuffered proxied responses.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Digest::MD5 qw/ md5_hex /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'splice is linux only') unless $^O eq 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http proxy upstream_keepalive gzip/)
+	->plan(7);
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream u {
+        server     127.0.0.1:8081;
+        keepalive  1;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        proxy_buffering     off;
+        proxy_splice        on;
+        proxy_http_version  1.1;
+        proxy_set_header    Connection "";
+
+        location / {
+            proxy_pass  http://u;
+        }
+
+        location /gzip/ {
+            proxy_pass  http://u/;
+            gzip        on;
+            gzip_types  text/plain;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+my $big = join('', map { sprintf "%08d\n", $_ } 1 .. 116509);
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.txt', $big);
+
+$t->run();
+
+###############################################################################
+
+like(http_get('/index.html'), qr/SEE-THIS/, 'small');
+
+my $r = http_get('/big.txt');
+my ($body) = $r =~ /\x0d\x0a\x0d\x0a(.*)$/s;
+is(length($body), length($big), 'big length');
+is(md5_hex($body), md5_hex($big), 'big md5');
+
+$r = http_get('/big.txt');
+($body) = $r =~ /\x0d\x0a\x0d\x0a(.*)$/s;
+is(md5_hex($body), md5_hex($big), 'big keepalive');
+
+like(http_head('/big.txt'), qr/Content-Length: 1048581\x0d\x0a.*\x0d\x0a\x0d\x0a$/s,
+	'head');
+
+# a body changed by a filter is not spliced
+
+$r = http(<<EOF);
+GET /gzip/big.txt HTTP/1.1
+Host: localhost
+Accept-Encoding: gzip
+Connection: close
+
+EOF
+
+like($r, qr/Content-Encoding: gzip.*\x0d\x0a0\x0d\x0a\x0d\x0a$/s, 'gzip');
+
+$r = http_get('/big.txt', start => 1);
+$r->sysread(my $buf, 1024);
+$r->close();
+
+like(http_get('/index.html'), qr/SEE-THIS/, 'after client abort');
+
+###############################################################################
@@ -0,0 +1,140 @@
+#!/usr/bin/perl
+
+# Tests for latency histograms of request statistics.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Time::HiRes qw/ sleep /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy reqstat/)->plan(8)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    req_status_zone key "$arg_k" 1M;
+    req_status_zone_histogram key;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            req_status   key;
+            proxy_pass   http://127.0.0.1:8081;
+        }
+
+        location /all {
+            req_status_show key;
+        }
+
+        location /p {
+            req_status_show key;
+            req_status_show_field req_total rt_p50 rt_p90 rt_p99 rt_p999
+                                  ups_rt_p50 ups_rt_p99;
+        }
+
+        location /hist {
+            req_status_show key;
+            req_status_show_field rt_hist ups_rt_hist;
+        }
+    }
+}
+
+EOF
+
+$t->run_daemon(\&http_daemon);
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+
+###############################################################################
+
+http_get('/fast?k=a') for 1 .. 18;
+http_get('/slow?k=a') for 1 .. 2;
+
+my @f = split /,/, line(http_get('/p'));
+
+is($f[1], 20, 'requests');
+cmp_ok($f[2], '<', 100, 'p50');
+cmp_ok($f[3], '<', 100, 'p90');
+cmp_ok($f[4], '>=', 300, 'p99');
+cmp_ok($f[7], '>=', 300, 'upstream p99');
+
+@f = split /,/, line(http_get('/hist'));
+
+my @b = split / /, $f[1];
+my $n = 0;
+$n += $_ for @b;
+
+is(scalar @b, 64, 'buckets');
+is($n, 20, 'buckets total');
+
+@f = split /,/, line(http_get('/all'));
+
+is(scalar @f, 1 + 29 + 8, 'percentiles shown by default');
+
+###############################################################################
+
+sub line {
+	my ($r) = @_;
+	my ($line) = $r =~ /^(a,.*?)\x0d?$/m;
+	return $line // '';
+}
+
+sub http_daemon {
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . port(8081),
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+
+	while (my $client = $server->accept()) {
+		$client->autoflush(1);
+
+		my $uri = '';
+
+		while (<$client>) {
+			$uri = $1 if /GET (.*) HTTP/;
+			last if /^\x0d?\x0a?$/;
+		}
+
+		sleep(0.3) if $uri =~ /^\/slow/;
+
+		print $client <<EOF;
+HTTP/1.1 200 OK
+Connection: close
+Content-Length: 2
+
+ok
+EOF
+
+		close $client;
+	}
+}
+
+###############################################################################
@@ -0,0 +1,94 @@
+#!/usr/bin/perl
+
+# Tests for request statistics counted by several worker processes.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http reqstat/)->plan(5)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+worker_processes 4;
+
+events {
+    accept_mutex off;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    log_format pid $pid;
+
+    req_status_zone key "$arg_k" 1M;
+
+    server {
+        listen       127.0.0.1:8080 reuseport;
+        server_name  localhost;
+
+        location / {
+            req_status   key;
+            access_log   %%TESTDIR%%/pid.log pid;
+        }
+
+        location /status {
+            req_status_show key;
+            req_status_show_field req_total http_2xx http_4xx;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+http_get('/?k=a') for 1 .. 40;
+http_get('/?k=b') for 1 .. 10;
+http_get('/missing?k=b') for 1 .. 5;
+
+my $r = http_get('/status');
+
+is(line($r, 'a'), 'a,40,40,0', 'counters of a key');
+is(line($r, 'b'), 'b,15,10,5', 'counters of another key');
+
+# more requests, now that the keys are cached by the workers
+
+http_get('/?k=a') for 1 .. 40;
+
+$r = http_get('/status');
+
+is(line($r, 'a'), 'a,80,80,0', 'counters of a cached key');
+is(line($r, 'b'), 'b,15,10,5', 'counters of a key not updated');
+
+my %pids = map { $_ => 1 } split /\n/, $t->read_file('pid.log');
+
+cmp_ok(scalar keys %pids, '>', 1, 'requests served by several workers');
+
+###############################################################################
+
+sub line {
+	my ($r, $key) = @_;
+	my ($line) = $r =~ /^(\Q$key\E,.*?)\x0d?$/m;
+	return $line // '';
+}
+
+###############################################################################
@@ -0,0 +1,172 @@
+#!/usr/bin/perl
+
+# Tests for the resolver cache shared by worker processes, the "zone" and
+# "stale" parameters of the resolver directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Select;
+use Time::HiRes qw/ sleep /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(7)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+worker_processes 2;
+
+events {
+    accept_mutex off;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    resolver 127.0.0.1:%%PORT_8981_UDP%% ipv6=off zone=dns:1m stale=30s;
+    resolver_timeout 1s;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass http://$arg_h:%%PORT_8081%%/;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+
+my $d = $t->testdir();
+
+$t->run_daemon(\&dns_daemon, port(8981), $d);
+$t->run()->waitforfile("$d/" . port(8981));
+
+###############################################################################
+
+# all workers use the name resolved once
+
+like(http_get("/?h=shared.example.net"), qr/SEE-THIS/, 'resolved');
+http_get("/?h=shared.example.net") for 1 .. 10;
+is(queries('shared'), 1, 'resolved once');
+
+# an expired name is served while it is queried again,
+# the name server does not answer the second query
+
+like(http_get("/?h=stale.example.net"), qr/SEE-THIS/, 'stale resolved');
+
+sleep(2.2);
+
+like(http_get("/?h=stale.example.net"), qr/SEE-THIS/, 'stale served');
+
+sleep(0.3);
+
+is(queries('stale'), 2, 'stale refreshed');
+
+# a name is queried again before it expires
+
+like(http_get("/?h=prefetch.example.net"), qr/SEE-THIS/, 'prefetch resolved');
+
+sleep(2.1);
+
+http_get("/?h=prefetch.example.net");
+
+sleep(0.3);
+
+is(queries('prefetch'), 2, 'prefetched');
+
+###############################################################################
+
+sub queries {
+	my ($name) = @_;
+	return -s "$d/q_$name" // 0;
+}
+
+sub reply_handler {
+	my ($recv_data, $d) = @_;
+
+	my (@name, $rdata);
+
+	use constant A		=> 1;
+	use constant IN		=> 1;
+
+	# decode name
+
+	my ($len, $offset) = (undef, 12);
+	while (1) {
+		$len = unpack("\@$offset C", $recv_data);
+		last if $len == 0;
+		$offset++;
+		push @name, unpack("\@$offset A$len", $recv_data);
+		$offset += $len;
+	}
+
+	$offset -= 1;
+	my ($id, $type, $class) = unpack("n x$offset n2", $recv_data);
+
+	my ($host) = @name;
+	my %ttl = (shared => 3600, stale => 1, prefetch => 3);
+
+	return unless $type == A && $ttl{$host};
+
+	open my $fh, '>>', "$d/q_$host";
+	print $fh 'x';
+	close $fh;
+
+	return if $host eq 'stale' && -s "$d/q_$host" > 1;
+
+	$rdata = pack 'n3N nC4', 0xc00c, A, IN, $ttl{$host}, 4, 127, 0, 0, 1;
+
+	$len = @name;
+	return pack("n6 (C/a*)$len x n2", $id, 0x8180, 1, 1, 0, 0, @name,
+		$type, $class) . $rdata;
+}
+
+sub dns_daemon {
+	my ($port, $d) = @_;
+
+	my ($data, $recv_data);
+	my $socket = IO::Socket::INET->new(
+		LocalAddr => '127.0.0.1',
+		LocalPort => $port,
+		Proto => 'udp',
+	)
+		or die "Can't create listening socket: $!\n";
+
+	# signal we are ready
+
+	open my $fh, '>', "$d/$port";
+	close $fh;
+
+	while (1) {
+		$socket->recv($recv_data, 65536);
+		$data = reply_handler($recv_data, $d);
+		$socket->send($data) if defined $data;
+	}
+}
+
+###############################################################################
@@ -0,0 +1,156 @@
+#!/usr/bin/perl
+
+# Tests for session sticky servers found by sid and by name,
+# and for the indexes rebuilt by a dyups update.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Time::HiRes qw/ sleep /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(10)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass http://$arg_u;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location / {
+            dyups_interface;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8082;
+        server_name  localhost;
+        root         %%TESTDIR%%/a;
+    }
+
+    server {
+        listen       127.0.0.1:8083;
+        server_name  localhost;
+        root         %%TESTDIR%%/b;
+    }
+}
+
+EOF
+
+mkdir($t->testdir() . '/a');
+mkdir($t->testdir() . '/b');
+
+$t->write_file('a/index.html', 'A');
+$t->write_file('b/index.html', 'B');
+
+$t->run();
+
+###############################################################################
+
+my $a = port(8082);
+my $b = port(8083);
+my $ss = 'session_sticky cookie=test mode=insert fallback=on;';
+
+like(post('/upstream/ss', "$ss server 127.0.0.1:$a; server 127.0.0.1:$b;"),
+	qr/success/, 'upstream');
+
+# without a cookie, the sid of the peer chosen is found by its name
+
+my %sid;
+
+for (1 .. 2) {
+	my ($c, $s) = sticky();
+	$sid{$c} = $s;
+}
+
+ok($sid{A} && $sid{B} && $sid{A} ne $sid{B}, 'sid by name');
+
+# the server of a known sid is found in the sid index
+
+is(join('', map { (sticky($sid{A}))[0] } 1 .. 4), 'AAAA', 'sid lookup');
+is(join('', map { (sticky($sid{B}))[0] } 1 .. 4), 'BBBB', 'sid lookup 2');
+
+# an unknown sid falls back to another peer, and its sid is set
+
+my ($c, $s) = sticky('unknown');
+is($s, $sid{$c}, 'unknown sid');
+
+# the indexes are built again for the servers of an update
+
+like(post('/upstream/ss', "$ss server 127.0.0.1:$b;"), qr/success/,
+	'update');
+
+is(join('', map { (sticky($sid{B}))[0] } 1 .. 2), 'BB', 'updated sid lookup');
+
+($c, $s) = sticky($sid{A});
+is("$c $s", "B $sid{B}", 'removed sid');
+
+like(post('/upstream/ss', "$ss server 127.0.0.1:$b; server 127.0.0.1:$a;"),
+	qr/success/, 'update again');
+
+is(join('', map { (sticky($sid{A}))[0] } 1 .. 2), 'AA', 'added sid lookup');
+
+###############################################################################
+
+sub sticky {
+	my ($sid) = @_;
+	my $cookie = defined $sid ? "Cookie: test=$sid\n" : '';
+
+	my $r = http(<<EOF);
+GET /?u=ss HTTP/1.0
+Host: localhost
+$cookie
+EOF
+
+	my ($body) = $r =~ /\x0d\x0a\x0d\x0a(.*)$/s;
+	my ($set) = $r =~ /Set-Cookie: test=([^;\x0d]*)/;
+
+	return ($body // '', $set // '');
+}
+
+sub post {
+	my ($uri, $body) = @_;
+	my $len = length($body);
+
+	return http(<<EOF, socket => IO::Socket::INET->new(
+POST $uri HTTP/1.0
+Host: localhost
+Content-Length: $len
+
+$body
+EOF
+		PeerAddr => '127.0.0.1:' . port(8081)));
+}
+
+###############################################################################
@@ -0,0 +1,116 @@
+#!/usr/bin/perl
+
+# Tests for "ssl_ktls", responses are sent with SSL_sendfile() when
+# the kernel TLS is available and with SSL_write() otherwise.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Digest::MD5 qw/ md5_hex /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http http_ssl proxy cache/)
+    ->has_daemon('openssl')->has_daemon('curl');
+
+$t->plan(5)->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    proxy_cache_path  %%TESTDIR%%/cache  keys_zone=NAME:1m;
+
+    server {
+        listen       127.0.0.1:8080 ssl;
+        server_name  localhost;
+
+        ssl_certificate_key  localhost.key;
+        ssl_certificate      localhost.crt;
+
+        ssl_ktls  on;
+        sendfile  on;
+
+        location /proxy/ {
+            proxy_pass         http://127.0.0.1:8081/;
+            proxy_cache        NAME;
+            proxy_cache_valid  any 1m;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+$t->write_file('openssl.conf', <<EOF);
+[ req ]
+default_bits = 2048
+encrypt_key = no
+distinguished_name = req_distinguished_name
+[ req_distinguished_name ]
+EOF
+
+my $d = $t->testdir();
+
+foreach my $name ('localhost') {
+    system('openssl req -x509 -new '
+        . "-config '$d/openssl.conf' -subj '/CN=$name/' "
+        . "-out '$d/$name.crt' -keyout '$d/$name.key' "
+        . ">>$d/openssl.out 2>&1") == 0
+        or die "Can't create certificate for $name: $!\n";
+}
+
+my $big = join('', map { sprintf "%08d\n", $_ } 1 .. 300000);
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.txt', $big);
+
+$t->run();
+
+###############################################################################
+
+like(https_get('/index.html'), qr/SEE-THIS/, 'small');
+is(md5_hex(https_get('/big.txt')), md5_hex($big), 'big');
+is(https_get('/big.txt', '-r 1000000-1000099'), substr($big, 1000000, 100),
+    'range');
+
+https_get('/proxy/big.txt');
+is(md5_hex(https_get('/proxy/big.txt')), md5_hex($big), 'cached');
+is(md5_hex(https_get('/proxy/big.txt', '--http1.0')), md5_hex($big),
+    'cached http 1.0');
+
+###############################################################################
+
+sub https_get {
+    my ($uri, $extra) = @_;
+
+    $extra = '' unless defined $extra;
+
+    my $port = port(8080);
+
+    return `curl -sk $extra https://127.0.0.1:$port$uri`;
+}
+
+###############################################################################
@@ -0,0 +1,130 @@
+#!/usr/bin/perl
+
+# Tests for splice() in the stream proxy module.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Select;
+use Digest::MD5 qw/ md5_hex /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+use Test::Nginx::Stream qw/ stream /;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'splice is linux only') unless $^O eq 'linux';
+
+my $t = Test::Nginx->new()->has(qw/stream/)->plan(5)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+stream {
+    proxy_splice  on;
+
+    server {
+        listen      127.0.0.1:8080;
+        proxy_pass  127.0.0.1:8081;
+    }
+
+    server {
+        listen      127.0.0.1:8082;
+        proxy_pass  127.0.0.1:8081;
+        proxy_download_rate  1m;
+    }
+}
+
+EOF
+
+my $big = join('', map { sprintf "%08d\n", $_ } 1 .. 200000);
+
+$t->run_daemon(\&stream_daemon);
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+
+###############################################################################
+
+my $s = stream('127.0.0.1:' . port(8080));
+
+is($s->io("foo\n", length => 4), "bar\n", 'small');
+
+my $r = $s->io("get\n", length => length($big));
+is(md5_hex($r), md5_hex($big), 'download');
+
+$r = $s->io("put\n" . $big, length => 33);
+is($r, md5_hex($big) . "\n", 'upload');
+
+is($s->io("foo\n", length => 4), "bar\n", 'small again');
+
+$s = stream('127.0.0.1:' . port(8082));
+$r = $s->io("get\n", length => length($big));
+is(md5_hex($r), md5_hex($big), 'download rate');
+
+###############################################################################
+
+sub stream_daemon {
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . port(8081),
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	my $sel = IO::Select->new($server);
+
+	local $SIG{PIPE} = 'IGNORE';
+
+	while (my @ready = $sel->can_read) {
+		foreach my $fh (@ready) {
+			if ($server == $fh) {
+				my $new = $fh->accept;
+				$new->autoflush(1);
+				$sel->add($new);
+
+			} elsif (stream_handle_client($fh)) {
+				$sel->remove($fh);
+				$fh->close;
+			}
+		}
+	}
+}
+
+sub stream_handle_client {
+	my ($client) = @_;
+
+	my $line = $client->getline() or return 1;
+
+	if ($line eq "get\n") {
+		$client->print($big);
+
+	} elsif ($line eq "put\n") {
+		$client->read(my $buffer, length($big)) or return 1;
+		$client->print(md5_hex($buffer) . "\n");
+
+	} else {
+		$line =~ s/foo/bar/g;
+		$client->print($line);
+	}
+
+	$client->flush();
+
+	return 0;
+}
+
+###############################################################################
@@ -0,0 +1,111 @@
+#!/usr/bin/perl
+
+# Tests for sysguard module, system information sampled by one worker
+# to the shared memory, pressure stall information and cgroup throttling.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http sysguard/)->plan(7)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+worker_processes 2;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    sysguard_sample_interval 50ms;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        sysguard on;
+
+        location /free_limit {
+            sysguard_mem free=1000000000M action=/limit;
+            alias %%TESTDIR%%/index.html;
+        }
+
+        location /free_unlimit {
+            sysguard_mem free=1k action=/limit;
+            alias %%TESTDIR%%/index.html;
+        }
+
+        location /psi {
+            sysguard_psi cpu=100% memory=100% io=100% period=500ms
+                         action=/limit;
+            alias %%TESTDIR%%/index.html;
+        }
+
+        location /cgroup {
+            sysguard_cgroup throttled=100% period=200ms action=/limit;
+            alias %%TESTDIR%%/index.html;
+        }
+
+        location /cpu_unlimit {
+            sysguard_cpu usage=100 period=1s action=/limit;
+            alias %%TESTDIR%%/index.html;
+        }
+
+        location /and {
+            sysguard_mode and;
+            sysguard_mem free=1000000000M action=/limit;
+            sysguard_psi cpu=100% action=/limit;
+            alias %%TESTDIR%%/index.html;
+        }
+
+        location /limit {
+            alias %%TESTDIR%%/limit.html;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('limit.html', 'LIMITED');
+
+$t->run();
+
+###############################################################################
+
+# requests are guarded from the start, the first sample is taken
+# when a worker starts
+
+like(http_get('/free_limit'), qr/LIMITED/, 'free limited');
+like(http_get('/free_unlimit'), qr/SEE-THIS/, 'free unlimited');
+
+select undef, undef, undef, 0.6;
+
+like(http_get('/psi'), qr/SEE-THIS/, 'psi unlimited');
+like(http_get('/cgroup'), qr/SEE-THIS/, 'cgroup unlimited');
+like(http_get('/cpu_unlimit'), qr/SEE-THIS/, 'cpu unlimited');
+like(http_get('/and'), qr/SEE-THIS/, 'psi in and mode');
+
+my %r = map { http_get('/free_limit') =~ /LIMITED/ ? (1 => 1) : (0 => 1) }
+	1 .. 10;
+is(join('', keys %r), '1', 'all workers limited');
+
+###############################################################################
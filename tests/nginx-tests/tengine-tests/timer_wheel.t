@@ -0,0 +1,115 @@
+#!/usr/bin/perl
+
+# Tests for the timing wheel event timers.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Socket::INET;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(5);
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+events {
+    timer_wheel  on;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        keepalive_timeout  1s;
+
+        location /proxy {
+            proxy_pass  http://127.0.0.1:8081;
+            proxy_read_timeout  1s;
+        }
+
+        location /long {
+            proxy_pass  http://127.0.0.1:8081;
+            proxy_read_timeout  5s;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+
+$t->run_daemon(\&http_silent_daemon);
+$t->run()->waitforsocket('127.0.0.1:8081');
+
+###############################################################################
+
+like(http_get('/index.html'), qr/SEE-THIS/, 'request');
+
+my $start = time();
+like(http_get('/proxy'), qr/504 Gateway/, 'read timeout');
+cmp_ok(time() - $start, '<', 4, 'read timeout in time');
+
+# the shorter timer must not wait for the longer one
+
+my $long = http_get('/long', start => 1);
+like(http_get('/proxy'), qr/504 Gateway/, 'short timeout with long pending');
+
+# an idle keepalive connection is closed by its timer
+
+my $s = IO::Socket::INET->new(
+    Proto => 'tcp',
+    PeerAddr => '127.0.0.1:' . port(8080)
+)
+    or die "Can't connect to nginx: $!\n";
+
+$s->print("GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+my $closed = eval {
+    local $SIG{ALRM} = sub { die "timeout\n" };
+    alarm(5);
+    1 while $s->sysread(my $buf, 1024);
+    alarm(0);
+    1;
+};
+
+ok($closed, 'keepalive timeout');
+
+###############################################################################
+
+sub http_silent_daemon {
+    my $server = IO::Socket::INET->new(
+        Proto => 'tcp',
+        LocalAddr => '127.0.0.1:' . port(8081),
+        Listen => 5,
+        Reuse => 1
+    )
+        or die "Can't create listening socket: $!\n";
+
+    my @clients;
+
+    while (my $client = $server->accept()) {
+        push @clients, $client;
+    }
+}
+
+###############################################################################
@@ -0,0 +1,156 @@
+#!/usr/bin/perl
+
+# Tests for passive health checks, check_passive directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(8)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream u {
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+
+        check interval=2000 rise=1 fall=100 timeout=1000 default_down=false
+              type=tcp;
+        check_passive fails=3 http_5xx;
+    }
+
+    upstream refused {
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8083 max_fails=0;
+
+        check interval=30000 rise=1 fall=100 timeout=1000 default_down=false
+              type=tcp;
+        check_passive fails=2;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass   http://u;
+        }
+
+        location /refused {
+            proxy_pass   http://refused/;
+        }
+
+        location /status {
+            check_status csv;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location / {
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+
+$t->run_daemon(\&http_error_daemon);
+$t->run()->waitforsocket('127.0.0.1:' . port(8082));
+
+###############################################################################
+
+my $errors = grep { /500 Internal/ } map { http_get('/') } 1 .. 10;
+
+is($errors, 3, 'errors before ejection');
+like(status('u', 8082), qr/,down,/, 'ejected');
+like(status('u', 8081), qr/,up,/, 'good peer up');
+
+my $ok = grep { /SEE-THIS/ } map { http_get('/') } 1 .. 10;
+
+is($ok, 10, 'ejected peer not used');
+
+# refused connections count even though the request is retried
+
+$ok = grep { /SEE-THIS/ } map { http_get('/refused/') } 1 .. 6;
+
+is($ok, 6, 'refused retried');
+like(status('refused', 8083), qr/,down,/, 'refused ejected');
+
+like($t->read_file('error.log'), qr/by passive check/, 'logged');
+
+# the active check brings the peer back
+
+sleep 3;
+
+like(status('u', 8082), qr/,up,/, 'readmitted');
+
+###############################################################################
+
+sub status {
+	my ($upstream, $port) = @_;
+	my ($line) = http_get('/status')
+		=~ /^(\d+,$upstream,127.0.0.1:@{[ port($port) ]},.*)$/m;
+	return $line // '';
+}
+
+sub http_error_daemon {
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . port(8082),
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+
+	while (my $client = $server->accept()) {
+		$client->autoflush(1);
+
+		my $uri = '';
+
+		while (<$client>) {
+			$uri = $1 if /GET (.*) HTTP/;
+			last if /^\x0d?\x0a?$/;
+		}
+
+		next if $uri eq '';
+
+		print $client <<EOF;
+HTTP/1.1 500 Internal Server Error
+Connection: close
+Content-Length: 0
+
+EOF
+
+		close $client;
+	}
+}
+
+###############################################################################
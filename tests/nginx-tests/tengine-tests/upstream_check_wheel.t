@@ -0,0 +1,125 @@
+#!/usr/bin/perl
+
+# Tests for upstream check module, peers partitioned among the workers
+# and checked from a timer wheel.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(8)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+worker_processes 2;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    log_format port $server_port;
+
+    upstream u {
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+        server 127.0.0.1:8083;
+        server 127.0.0.1:8084;
+
+        check interval=300 rise=1 fall=1 timeout=1000 default_down=true
+              type=http;
+        check_http_send "GET /check HTTP/1.0\r\n\r\n";
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            proxy_pass   http://u;
+        }
+
+        location /status {
+            check_status csv;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        listen       127.0.0.1:8082;
+        listen       127.0.0.1:8083;
+        listen       127.0.0.1:8084;
+        server_name  localhost;
+
+        location /check {
+            access_log %%TESTDIR%%/check.log port;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('check', 'OK');
+$t->write_file('index.html', 'SEE-THIS');
+
+$t->run();
+
+###############################################################################
+
+select undef, undef, undef, 2;
+
+my $status = http_get('/status');
+my %checks;
+
+$checks{$_}++ for split /\n/, $t->read_file('check.log');
+
+# every peer is checked by one worker about once an interval
+
+for my $port (8081 .. 8084) {
+	my $n = $checks{port($port)} // 0;
+	ok($n >= 3 && $n <= 9, "checked once an interval $port")
+		or diag("$n checks");
+}
+
+like($status, qr/^0,u,.*,up,/m, 'default down peer up');
+unlike($status, qr/,down,/, 'all peers up');
+
+like(http_get('/'), qr/SEE-THIS/, 'proxied');
+
+SKIP: {
+skip 'no --with-debug', 1 unless $t->has_module('--with-debug');
+
+my %owners;
+
+my @m = $t->read_file('error.log') =~
+	/http check begin handler index: (\d+), owner: -?\d+, ngx_pid: (\d+)/g;
+
+while (my ($index, $pid) = splice @m, 0, 2) {
+	$owners{$index}{$pid} = 1;
+}
+
+my %pids = map { %{$owners{$_}} } keys %owners;
+
+is(join(' ', (map { scalar keys %{$owners{$_}} } sort keys %owners),
+	scalar keys %pids), '1 1 1 1 2', 'peers partitioned');
+
+}
+
+###############################################################################
@@ -0,0 +1,172 @@
+#!/usr/bin/perl
+
+# Tests for consistent hashing with bounded loads, the "bounded" parameter
+# of the hash and consistent_hash directives.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy upstream_zone/)->plan(7)
+	->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon off;
+
+worker_processes 2;
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream hash {
+        zone z1 64k;
+        hash $arg_k consistent;
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+    }
+
+    upstream hash_bounded {
+        zone z2 64k;
+        hash $arg_k consistent bounded=1.25;
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+    }
+
+    upstream chash_bounded {
+        zone z3 64k;
+        consistent_hash $arg_k bounded=1.25;
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+    }
+
+    upstream maglev_bounded {
+        zone z4 64k;
+        consistent_hash $arg_k algorithm=maglev bounded=1.25;
+        server 127.0.0.1:8081;
+        server 127.0.0.1:8082;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /hash {
+            proxy_pass http://hash;
+        }
+
+        location /hash_bounded {
+            proxy_pass http://hash_bounded;
+        }
+
+        location /chash_bounded {
+            proxy_pass http://chash_bounded;
+        }
+
+        location /maglev_bounded {
+            proxy_pass http://maglev_bounded;
+        }
+    }
+}
+
+EOF
+
+$t->run_daemon(\&http_daemon, port(8081));
+$t->run_daemon(\&http_daemon, port(8082));
+$t->run()->waitforsocket('127.0.0.1:' . port(8081));
+$t->waitforsocket('127.0.0.1:' . port(8082));
+
+###############################################################################
+
+is(peers('/hash'), 1, 'hot key, one peer');
+
+is(peers('/hash_bounded'), 2, 'hash bounded');
+is(peers('/chash_bounded'), 2, 'consistent_hash bounded');
+is(peers('/maglev_bounded'), 2, 'maglev bounded');
+
+# without load, a key keeps its peer
+
+for my $uri ('/hash_bounded', '/chash_bounded', '/maglev_bounded') {
+	my %p = map { peer(http_get("$uri?k=cold")) => 1 } 1 .. 5;
+	is(keys %p, 1, "$uri affinity");
+}
+
+###############################################################################
+
+sub peers {
+	my ($uri) = @_;
+
+	my @s = map { http_get("$uri?k=hot&slow=1", start => 1) } 1 .. 6;
+	my %p = map { peer(join '', $_->getlines()) => 1 } @s;
+
+	return scalar keys %p;
+}
+
+sub peer {
+	my ($r) = @_;
+	my ($p) = ($r // '') =~ /X-Port: (\d+)/;
+	return $p // 'none';
+}
+
+sub http_daemon {
+	my ($port) = @_;
+
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:' . $port,
+		Listen => 16,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	local $SIG{PIPE} = 'IGNORE';
+	local $SIG{CHLD} = 'IGNORE';
+
+	while (my $client = $server->accept()) {
+		if (fork()) {
+			close $client;
+			next;
+		}
+
+		$client->autoflush(1);
+
+		my $uri = '';
+
+		while (<$client>) {
+			$uri = $1 if /GET (.*) HTTP/;
+			last if /^\x0d?\x0a?$/;
+		}
+
+		sleep(1) if $uri =~ /slow/;
+
+		print $client <<EOF;
+HTTP/1.1 200 OK
+X-Port: $port
+Connection: close
+Content-Length: 2
+
+ok
+EOF
+
+		close $client;
+		exit 0;
+	}
+}
+
+###############################################################################